@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-compress.h"
+#include "bed-impl.h"
+
+#include <string.h>
+
+#define HASH_BITS 10
+
+#define HASH_SIZE (1U << HASH_BITS)
+
+/*
+ * A sequence which ends a frame has no match.
+ */
+#define NO_MATCH SIZE_MAX
+
+static uint32_t hash(uint32_t value)
+{
+	return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static size_t length_size(size_t length)
+{
+	return length >= 15 ? 1 + (length - 15) / 255 : 0;
+}
+
+static uint8_t *put_length(uint8_t *out, size_t length)
+{
+	if (length >= 15) {
+		length -= 15;
+
+		while (length >= 255) {
+			*out = 255;
+			++out;
+			length -= 255;
+		}
+
+		*out = (uint8_t) length;
+		++out;
+	}
+
+	return out;
+}
+
+/*
+ * Returns NULL in case the sequence does not fit into the output area.
+ */
+static uint8_t *put_sequence(
+	uint8_t *out,
+	const uint8_t *out_end,
+	const uint8_t *literals,
+	size_t literal_count,
+	size_t offset,
+	size_t match_length
+)
+{
+	size_t size = 1 + length_size(literal_count) + literal_count;
+	size_t match_count = 0;
+
+	if (match_length != NO_MATCH) {
+		match_count = match_length - BED_COMPRESS_MIN_MATCH;
+		size += 2 + length_size(match_count);
+	}
+
+	if (size <= (size_t) (out_end - out)) {
+		*out = (uint8_t) (((literal_count < 15 ? literal_count : 15) << 4)
+			| (match_count < 15 ? match_count : 15));
+		out = put_length(out + 1, literal_count);
+		memcpy(out, literals, literal_count);
+		out += literal_count;
+
+		if (match_length != NO_MATCH) {
+			bed_put_le16(out, (uint32_t) offset);
+			out = put_length(out + 2, match_count);
+		}
+	} else {
+		out = NULL;
+	}
+
+	return out;
+}
+
+/*
+ * Returns zero in case the compressed frame is not smaller than the frame.
+ */
+static size_t compress_frame(const uint8_t *in, size_t n, uint8_t *out)
+{
+	uint16_t table [HASH_SIZE];
+	uint8_t *out_begin = out;
+	const uint8_t *out_end = out + n - 1;
+	size_t anchor = 0;
+	size_t pos = 0;
+
+	memset(table, 0, sizeof(table));
+
+	while (out != NULL && pos + BED_COMPRESS_MIN_MATCH <= n) {
+		uint32_t value = bed_get_le32(in + pos);
+		uint32_t h = hash(value);
+		size_t candidate = table [h];
+
+		table [h] = (uint16_t) (pos + 1);
+
+		if (candidate != 0 && bed_get_le32(in + candidate - 1) == value) {
+			size_t ref = candidate - 1;
+			size_t length = BED_COMPRESS_MIN_MATCH;
+
+			while (pos + length < n && in [ref + length] == in [pos + length]) {
+				++length;
+			}
+
+			out = put_sequence(
+				out,
+				out_end,
+				in + anchor,
+				pos - anchor,
+				pos - ref,
+				length
+			);
+			pos += length;
+			anchor = pos;
+		} else {
+			++pos;
+		}
+	}
+
+	if (out != NULL) {
+		out = put_sequence(out, out_end, in + anchor, n - anchor, 0, NO_MATCH);
+	}
+
+	return out != NULL ? (size_t) (out - out_begin) : 0;
+}
+
+size_t bed_compress_bound(size_t n)
+{
+	size_t frame_count = (n + BED_COMPRESS_FRAME_SIZE - 1)
+		/ BED_COMPRESS_FRAME_SIZE;
+
+	return BED_COMPRESS_HEADER_SIZE
+		+ frame_count * BED_COMPRESS_FRAME_HEADER_SIZE + n;
+}
+
+bed_status bed_compress(
+	const void *data,
+	size_t n,
+	void *out,
+	size_t out_size,
+	size_t *out_n
+)
+{
+	bed_status status = BED_SUCCESS;
+	const uint8_t *in = data;
+	uint8_t *header = out;
+	size_t pos = BED_COMPRESS_HEADER_SIZE;
+	size_t done = 0;
+
+	*out_n = 0;
+
+	if ((uint64_t) n > UINT32_MAX) {
+		status = BED_ERROR_INVALID_ADDRESS;
+	} else if (out_size < BED_COMPRESS_HEADER_SIZE) {
+		status = BED_ERROR_UNSATISFIED;
+	}
+
+	while (status == BED_SUCCESS && done != n) {
+		size_t r = n - done;
+		size_t m = r < BED_COMPRESS_FRAME_SIZE ? r : BED_COMPRESS_FRAME_SIZE;
+		uint8_t *frame = header + pos;
+
+		if (out_size - pos >= BED_COMPRESS_FRAME_HEADER_SIZE + m) {
+			size_t stored = compress_frame(
+				in + done,
+				m,
+				frame + BED_COMPRESS_FRAME_HEADER_SIZE
+			);
+			uint32_t flags = 0;
+
+			if (stored == 0) {
+				memcpy(frame + BED_COMPRESS_FRAME_HEADER_SIZE, in + done, m);
+				stored = m;
+				flags = BED_COMPRESS_FRAME_RAW;
+			}
+
+			bed_put_le16(frame, (uint32_t) m);
+			bed_put_le16(frame + 2, (uint32_t) stored | flags);
+			pos += BED_COMPRESS_FRAME_HEADER_SIZE + stored;
+			done += m;
+		} else {
+			status = BED_ERROR_UNSATISFIED;
+		}
+	}
+
+	if (status == BED_SUCCESS) {
+		bed_put_le32(header, BED_COMPRESS_MAGIC);
+		bed_put_le32(header + 4, (uint32_t) n);
+		bed_put_le32(header + 8, (uint32_t) (pos - BED_COMPRESS_HEADER_SIZE));
+		bed_put_le32(header + 12, bed_crc32(0, in, n));
+		bed_put_le32(header + 16, bed_crc32(0, header, 16));
+		*out_n = pos;
+	}
+
+	return status;
+}
+
+bed_status bed_write_compressed_with_skip(
+	const bed_partition *part,
+	const void *data,
+	size_t n,
+	void *work_buffer,
+	size_t work_size,
+	void *page_buffer
+)
+{
+#ifndef BED_CONFIG_READ_ONLY
+	size_t m;
+	bed_status status = bed_compress(data, n, work_buffer, work_size, &m);
+
+	if (status == BED_SUCCESS) {
+		status = bed_write_with_skip(part, work_buffer, m, page_buffer);
+	}
+
+	return status;
+#else /* BED_CONFIG_READ_ONLY */
+	return BED_ERROR_READ_ONLY;
+#endif /* BED_CONFIG_READ_ONLY */
+}
@@ -0,0 +1,243 @@
+/**
+ * @file
+ *
+ * @ingroup BEDCompress
+ *
+ * @brief BED Compressed Image API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_COMPRESS_H
+#define BED_COMPRESS_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDCompress BED Compressed Images
+ *
+ * @ingroup BED
+ *
+ * @brief Stores images like firmware in a compressed format with
+ * bed_write_with_skip() and loads them with bed_read_with_skip().
+ *
+ * A compressed image starts with a header at the begin of the first valid
+ * block.  The header contains a magic number, the image size, the payload
+ * size and a CRC-32 of the image, and is protected by a CRC-32 itself.  The
+ * payload is a sequence of frames.  A frame starts with a frame header which
+ * contains the uncompressed frame size (at most #BED_COMPRESS_FRAME_SIZE
+ * bytes) and the stored frame size.  Frames are compressed with a byte
+ * oriented LZ77 codec similar to the LZ4 block format.  Incompressible frames
+ * are stored raw.  Matches do not cross frame boundaries.  All values are
+ * little endian.
+ *
+ * The decompressor is fed with arbitrary chunks of the payload, e.g. with
+ * the pages delivered to the bed_read_process() function, and writes the
+ * image to a destination buffer.  It needs no further memory.  The load stops
+ * after the last page of the payload.
+ *
+ * @{
+ */
+
+/**
+ * @brief Size of the image header in bytes.
+ */
+#define BED_COMPRESS_HEADER_SIZE 20
+
+/**
+ * @brief Maximum uncompressed size of a frame in bytes.
+ */
+#define BED_COMPRESS_FRAME_SIZE 4096
+
+/**
+ * @brief Decompressor state.
+ *
+ * The members are private.
+ *
+ * @see bed_decompressor_initialize().
+ */
+typedef struct {
+	uint8_t *dest;
+	size_t dest_size;
+	size_t position;
+	size_t image_size;
+	size_t payload_size;
+	size_t payload_position;
+	uint32_t image_crc;
+	size_t frame_begin;
+	size_t frame_end;
+	size_t stored_remaining;
+	size_t length;
+	size_t offset;
+	uint8_t token;
+	uint8_t fill;
+	uint8_t buffer [BED_COMPRESS_HEADER_SIZE];
+	int state;
+	bed_status status;
+} bed_decompressor;
+
+/**
+ * @brief Returns the maximum compressed image size for an image.
+ *
+ * @param[in] n The image size in bytes.
+ */
+size_t bed_compress_bound(size_t n);
+
+/**
+ * @brief Compresses an image.
+ *
+ * @param[in] data The image.
+ * @param[in] n The image size in bytes.
+ * @param[out] out The compressed image.
+ * @param[in] out_size The size of the compressed image buffer.  A size of
+ * bed_compress_bound() bytes is always sufficient.
+ * @param[out] out_n The compressed image size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED The compressed image buffer is too small.
+ * @retval BED_ERROR_INVALID_ADDRESS The image is too large.
+ */
+bed_status bed_compress(
+	const void *data,
+	size_t n,
+	void *out,
+	size_t out_size,
+	size_t *out_n
+);
+
+/**
+ * @brief Compresses an image and writes it to the valid blocks of a
+ * partition.
+ *
+ * @param[in] part The partition.
+ * @param[in] data The image.
+ * @param[in] n The image size in bytes.
+ * @param[in] work_buffer Buffer to store the compressed image.
+ * @param[in] work_size The size of the work buffer.  A size of
+ * bed_compress_bound() bytes is always sufficient.
+ * @param[in] page_buffer Buffer for a page of this partition.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED The work buffer is too small or not enough
+ * valid blocks.
+ * @retval other See bed_compress() and bed_write_with_skip().
+ */
+bed_status bed_write_compressed_with_skip(
+	const bed_partition *part,
+	const void *data,
+	size_t n,
+	void *work_buffer,
+	size_t work_size,
+	void *page_buffer
+);
+
+/**
+ * @brief Initializes a decompressor.
+ *
+ * @param[out] dec The decompressor.
+ * @param[in] dest The destination buffer for the image.
+ * @param[in] dest_size The size of the destination buffer.
+ */
+void bed_decompressor_initialize(
+	bed_decompressor *dec,
+	void *dest,
+	size_t dest_size
+);
+
+/**
+ * @brief Feeds a chunk of a compressed image to a decompressor.
+ *
+ * Data after the end of the compressed image is ignored.
+ *
+ * @param[in, out] dec The decompressor.
+ * @param[in] data The chunk.
+ * @param[in] n The chunk size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED Invalid compressed image.
+ * @retval BED_ERROR_INVALID_ADDRESS The destination buffer is too small.
+ */
+bed_status bed_decompress(bed_decompressor *dec, const void *data, size_t n);
+
+/**
+ * @brief Returns true if the decompressor is complete or failed.
+ */
+bool bed_decompressor_is_done(const bed_decompressor *dec);
+
+/**
+ * @brief Finishes a decompression.
+ *
+ * @param[in] dec The decompressor.
+ * @param[out] n The image size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED Invalid or incomplete compressed image.
+ * @retval BED_ERROR_INVALID_ADDRESS The destination buffer is too small.
+ */
+bed_status bed_decompressor_finish(const bed_decompressor *dec, size_t *n);
+
+/**
+ * @brief Read with skip process function which feeds the pages to a
+ * decompressor.
+ *
+ * The process argument must be the decompressor.  Requests a stop once the
+ * decompressor is done.
+ *
+ * @see bed_read_with_skip().
+ */
+bool bed_decompress_process(
+	void *process_arg,
+	bed_address addr,
+	void *data,
+	size_t n,
+	void *oob,
+	size_t m
+);
+
+/**
+ * @brief Reads a compressed image from the valid blocks of a partition.
+ *
+ * Only the pages up to the end of the compressed image are read.
+ *
+ * @param[in] part The partition.
+ * @param[in] dest The destination buffer for the image.
+ * @param[in] dest_size The size of the destination buffer.
+ * @param[out] n The image size in bytes.
+ * @param[in] page_buffer Buffer for a page of this partition.
+ * @param[in] oob_buffer Buffer for an OOB area of this partition.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval other See bed_decompressor_finish() and bed_read_with_skip().
+ */
+bed_status bed_read_compressed_with_skip(
+	const bed_partition *part,
+	void *dest,
+	size_t dest_size,
+	size_t *n,
+	void *page_buffer,
+	void *oob_buffer
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_COMPRESS_H */
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-impl.h"
+
+uint32_t bed_crc32(uint32_t crc, const void *data, size_t n)
+{
+	const uint8_t *in = data;
+	size_t i;
+
+	crc = ~crc;
+
+	for (i = 0; i < n; ++i) {
+		int j;
+
+		crc ^= in [i];
+
+		for (j = 0; j < 8; ++j) {
+			crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+		}
+	}
+
+	return ~crc;
+}
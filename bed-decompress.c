@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-compress.h"
+#include "bed-impl.h"
+
+#include <string.h>
+
+typedef enum {
+	STATE_HEADER,
+	STATE_FRAME_HEADER,
+	STATE_RAW,
+	STATE_TOKEN,
+	STATE_LITERAL_LENGTH,
+	STATE_LITERALS,
+	STATE_OFFSET,
+	STATE_MATCH_LENGTH,
+	STATE_DONE
+} state;
+
+static void fail(bed_decompressor *dec, bed_status status)
+{
+	dec->status = status;
+	dec->state = STATE_DONE;
+}
+
+static void finish_image(bed_decompressor *dec)
+{
+	if (
+		dec->payload_position == dec->payload_size
+			&& bed_crc32(0, dec->dest, dec->image_size) == dec->image_crc
+	) {
+		dec->state = STATE_DONE;
+	} else {
+		fail(dec, BED_ERROR_UNSATISFIED);
+	}
+}
+
+static void start_image(bed_decompressor *dec)
+{
+	const uint8_t *header = dec->buffer;
+
+	dec->image_size = bed_get_le32(header + 4);
+	dec->payload_size = bed_get_le32(header + 8);
+	dec->image_crc = bed_get_le32(header + 12);
+
+	if (
+		bed_get_le32(header) != BED_COMPRESS_MAGIC
+			|| bed_get_le32(header + 16) != bed_crc32(0, header, 16)
+	) {
+		fail(dec, BED_ERROR_UNSATISFIED);
+	} else if (dec->image_size > dec->dest_size) {
+		fail(dec, BED_ERROR_INVALID_ADDRESS);
+	} else if (dec->image_size == 0) {
+		finish_image(dec);
+	} else {
+		dec->state = STATE_FRAME_HEADER;
+	}
+}
+
+static void start_frame(bed_decompressor *dec)
+{
+	size_t size = bed_get_le16(dec->buffer);
+	uint32_t stored = bed_get_le16(dec->buffer + 2);
+	bool raw = (stored & BED_COMPRESS_FRAME_RAW) != 0;
+
+	stored &= ~(uint32_t) BED_COMPRESS_FRAME_RAW;
+
+	if (
+		size == 0
+			|| size > BED_COMPRESS_FRAME_SIZE
+			|| size > dec->image_size - dec->position
+			|| stored == 0
+			|| (raw && stored != size)
+	) {
+		fail(dec, BED_ERROR_UNSATISFIED);
+	} else {
+		dec->frame_begin = dec->position;
+		dec->frame_end = dec->position + size;
+		dec->stored_remaining = stored;
+		dec->length = stored;
+		dec->state = raw ? STATE_RAW : STATE_TOKEN;
+	}
+}
+
+static void end_frame(bed_decompressor *dec)
+{
+	if (dec->position != dec->frame_end) {
+		fail(dec, BED_ERROR_UNSATISFIED);
+	} else if (dec->position == dec->image_size) {
+		finish_image(dec);
+	} else {
+		dec->state = STATE_FRAME_HEADER;
+	}
+}
+
+static void end_literals(bed_decompressor *dec);
+
+static void start_literals(bed_decompressor *dec)
+{
+	if (dec->length > dec->frame_end - dec->position) {
+		fail(dec, BED_ERROR_UNSATISFIED);
+	} else if (dec->length == 0) {
+		end_literals(dec);
+	} else {
+		dec->state = STATE_LITERALS;
+	}
+}
+
+static void end_literals(bed_decompressor *dec)
+{
+	if (dec->stored_remaining == 0) {
+		end_frame(dec);
+	} else {
+		dec->state = STATE_OFFSET;
+	}
+}
+
+/*
+ * The match may overlap the output, so it is copied byte by byte.
+ */
+static void copy_match(bed_decompressor *dec)
+{
+	size_t length = dec->length + BED_COMPRESS_MIN_MATCH;
+
+	if (length > dec->frame_end - dec->position) {
+		fail(dec, BED_ERROR_UNSATISFIED);
+	} else {
+		uint8_t *out = dec->dest + dec->position;
+		const uint8_t *ref = out - dec->offset;
+		size_t i;
+
+		for (i = 0; i < length; ++i) {
+			out [i] = ref [i];
+		}
+
+		dec->position += length;
+
+		if (dec->stored_remaining == 0) {
+			fail(dec, BED_ERROR_UNSATISFIED);
+		} else {
+			dec->state = STATE_TOKEN;
+		}
+	}
+}
+
+static bool is_in_frame(int s)
+{
+	return s != STATE_HEADER && s != STATE_FRAME_HEADER && s != STATE_DONE;
+}
+
+void bed_decompressor_initialize(
+	bed_decompressor *dec,
+	void *dest,
+	size_t dest_size
+)
+{
+	memset(dec, 0, sizeof(*dec));
+	dec->dest = dest;
+	dec->dest_size = dest_size;
+	dec->state = STATE_HEADER;
+	dec->status = BED_SUCCESS;
+}
+
+static size_t collect(
+	bed_decompressor *dec,
+	const uint8_t *in,
+	size_t available,
+	size_t size
+)
+{
+	size_t consumed = size - dec->fill;
+
+	consumed = consumed < available ? consumed : available;
+	memcpy(dec->buffer + dec->fill, in, consumed);
+	dec->fill = (uint8_t) (dec->fill + consumed);
+
+	return consumed;
+}
+
+static size_t copy_literals(
+	bed_decompressor *dec,
+	const uint8_t *in,
+	size_t available
+)
+{
+	size_t consumed = dec->length < available ? dec->length : available;
+
+	memcpy(dec->dest + dec->position, in, consumed);
+	dec->position += consumed;
+	dec->length -= consumed;
+
+	return consumed;
+}
+
+static void process_offset(bed_decompressor *dec, uint8_t byte)
+{
+	dec->buffer [dec->fill] = byte;
+	++dec->fill;
+
+	if (dec->fill == 2) {
+		dec->fill = 0;
+		dec->offset = bed_get_le16(dec->buffer);
+		dec->length = (size_t) (dec->token & 0xf);
+
+		if (dec->offset == 0 || dec->offset > dec->position - dec->frame_begin) {
+			fail(dec, BED_ERROR_UNSATISFIED);
+		} else if (dec->length == 15) {
+			dec->state = STATE_MATCH_LENGTH;
+		} else {
+			copy_match(dec);
+		}
+	}
+}
+
+/*
+ * Each iteration consumes the input of the current state and afterwards
+ * carries out the state transition.
+ */
+bed_status bed_decompress(bed_decompressor *dec, const void *data, size_t n)
+{
+	const uint8_t *in = data;
+	const uint8_t *end = in + n;
+
+	while (in != end && dec->state != STATE_DONE) {
+		int s = dec->state;
+		size_t available = (size_t) (end - in);
+		size_t consumed = 1;
+		uint8_t byte = *in;
+
+		if (is_in_frame(s)) {
+			if (dec->stored_remaining == 0) {
+				fail(dec, BED_ERROR_UNSATISFIED);
+				break;
+			}
+
+			if (available > dec->stored_remaining) {
+				available = dec->stored_remaining;
+			}
+		}
+
+		switch (s) {
+			case STATE_HEADER:
+				consumed = collect(dec, in, available, BED_COMPRESS_HEADER_SIZE);
+				break;
+			case STATE_FRAME_HEADER:
+				consumed = collect(dec, in, available, BED_COMPRESS_FRAME_HEADER_SIZE);
+				break;
+			case STATE_RAW:
+			case STATE_LITERALS:
+				consumed = copy_literals(dec, in, available);
+				break;
+			default:
+				break;
+		}
+
+		in += consumed;
+
+		if (s != STATE_HEADER) {
+			dec->payload_position += consumed;
+		}
+
+		if (is_in_frame(s)) {
+			dec->stored_remaining -= consumed;
+		}
+
+		switch (s) {
+			case STATE_HEADER:
+				if (dec->fill == BED_COMPRESS_HEADER_SIZE) {
+					dec->fill = 0;
+					start_image(dec);
+				}
+				break;
+			case STATE_FRAME_HEADER:
+				if (dec->fill == BED_COMPRESS_FRAME_HEADER_SIZE) {
+					dec->fill = 0;
+					start_frame(dec);
+				}
+				break;
+			case STATE_RAW:
+				if (dec->length == 0) {
+					end_frame(dec);
+				}
+				break;
+			case STATE_LITERALS:
+				if (dec->length == 0) {
+					end_literals(dec);
+				}
+				break;
+			case STATE_TOKEN:
+				dec->token = byte;
+				dec->length = (size_t) (byte >> 4);
+
+				if (dec->length == 15) {
+					dec->state = STATE_LITERAL_LENGTH;
+				} else {
+					start_literals(dec);
+				}
+				break;
+			case STATE_LITERAL_LENGTH:
+				dec->length += byte;
+
+				if (byte != 255) {
+					start_literals(dec);
+				}
+				break;
+			case STATE_OFFSET:
+				process_offset(dec, byte);
+				break;
+			default:
+				dec->length += byte;
+
+				if (byte != 255) {
+					copy_match(dec);
+				}
+				break;
+		}
+	}
+
+	return dec->status;
+}
+
+bool bed_decompressor_is_done(const bed_decompressor *dec)
+{
+	return dec->state == STATE_DONE;
+}
+
+bed_status bed_decompressor_finish(const bed_decompressor *dec, size_t *n)
+{
+	bed_status status = dec->status;
+
+	*n = 0;
+
+	if (status == BED_SUCCESS) {
+		if (dec->state == STATE_DONE) {
+			*n = dec->image_size;
+		} else {
+			status = BED_ERROR_UNSATISFIED;
+		}
+	}
+
+	return status;
+}
+
+bool bed_decompress_process(
+	void *process_arg,
+	bed_address addr,
+	void *data,
+	size_t n,
+	void *oob,
+	size_t m
+)
+{
+	bed_decompressor *dec = process_arg;
+
+	(void) addr;
+	(void) oob;
+	(void) m;
+
+	bed_decompress(dec, data, n);
+
+	return bed_decompressor_is_done(dec);
+}
+
+bed_status bed_read_compressed_with_skip(
+	const bed_partition *part,
+	void *dest,
+	size_t dest_size,
+	size_t *n,
+	void *page_buffer,
+	void *oob_buffer
+)
+{
+	bed_decompressor dec;
+	bed_status status;
+
+	bed_decompressor_initialize(&dec, dest, dest_size);
+	status = bed_read_with_skip(
+		part,
+		bed_decompress_process,
+		&dec,
+		page_buffer,
+		oob_buffer
+	);
+
+	if (status == BED_SUCCESS || status == BED_ERROR_STOPPED) {
+		status = bed_decompressor_finish(&dec, n);
+	} else {
+		*n = 0;
+	}
+
+	return status;
+}
@@ -356,6 +356,7 @@ static void elbc_init_context(
 	bed->is_block_valid = bed_nand_is_block_valid;
 	bed->read = bed_nand_read;
 	bed->read_oob = bed_nand_read_oob;
+	bed->read_partial = bed_nand_read_partial;
 #ifndef BED_CONFIG_READ_ONLY
 	bed->write = bed_nand_write;
 	bed->write_oob = bed_nand_write_oob;
@@ -377,6 +378,7 @@ static void elbc_init_context(
 	nand->read_page = elbc_read_page;
 #ifndef BED_CONFIG_READ_ONLY
 	nand->write_page = elbc_write_page;
+	nand->write_oob_only = bed_nand_write_oob_only;
 	nand->mark_page_bad = bed_nand_mark_page_bad;
 #endif /* BED_CONFIG_READ_ONLY */
 	nand->ecc_correctable_bits_per_512_bytes = ELBC_ECC_CORRECTABLE_BITS_PER_512_BYTES;
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-erase-pool.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+	BLOCK_IN_USE,
+	BLOCK_DISCARDED,
+	BLOCK_ERASING,
+	BLOCK_CLEAN,
+	BLOCK_BAD
+} block_state;
+
+typedef struct {
+	uint32_t *blocks;
+	uint32_t head;
+	uint32_t count;
+} block_queue;
+
+struct bed_erase_pool {
+	bed_lock lock;
+	bed_partition part;
+	uint32_t block_count;
+	uint32_t clean_block_count;
+	block_queue discarded;
+	block_queue clean;
+	uint8_t *states;
+	bed_lock check_lock;
+	uint8_t *check_buffer;
+};
+
+static void push(block_queue *queue, uint32_t block_count, uint32_t block)
+{
+	queue->blocks [(queue->head + queue->count) % block_count] = block;
+	++queue->count;
+}
+
+static uint32_t pop(block_queue *queue, uint32_t block_count)
+{
+	uint32_t block = queue->blocks [queue->head];
+
+	queue->head = (queue->head + 1) % block_count;
+	--queue->count;
+
+	return block;
+}
+
+/*
+ * The blank checks of concurrent erases share the page buffer of the pool.
+ */
+static bed_status blank_check(bed_erase_pool *pool, bed_address block)
+{
+	bed_status status = BED_SUCCESS;
+	const bed_partition *part = &pool->part;
+	uint16_t page_size = bed_page_size(part);
+	uint16_t oob_free_size = bed_oob_free_size(part);
+	uint8_t *page_buffer = pool->check_buffer;
+	uint8_t *oob_buffer = page_buffer + page_size;
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = oob_free_size,
+		.data = oob_buffer
+	};
+	bed_address page = block;
+	bed_address end = block + bed_block_size(part);
+
+	bed_lock_obtain(&pool->check_lock);
+
+	while (status == BED_SUCCESS && page != end) {
+		status = bed_read_oob(part, page, page_buffer, page_size, &oob);
+		if (
+			status == BED_SUCCESS
+				&& !(bed_is_erased(page_buffer, page_size) && bed_is_erased(oob_buffer, oob_free_size))
+		) {
+			status = BED_ERROR_ERASE;
+		}
+
+		page += page_size;
+	}
+
+	bed_lock_release(&pool->check_lock);
+
+	return status;
+}
+
+static bed_status erase_and_check(bed_erase_pool *pool, uint32_t index)
+{
+	const bed_partition *part = &pool->part;
+	bed_address block = bed_block_to_address(part, index);
+	bed_status status = bed_erase(part, block, BED_ERASE_MARK_BAD_ON_ERROR);
+
+	if (status == BED_SUCCESS) {
+		status = blank_check(pool, block);
+
+		if (status != BED_SUCCESS && !bed_is_system_error(status)) {
+			bed_mark_block_bad(part, block);
+		}
+	}
+
+	return status;
+}
+
+/*
+ * On success the block is clean.  Otherwise it is bad, or returned to the
+ * discarded blocks in case of a system error.
+ */
+static bed_status take_discarded_block(bed_erase_pool *pool, uint32_t *index)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+
+	if (pool->discarded.count > 0) {
+		*index = pop(&pool->discarded, pool->block_count);
+		pool->states [*index] = BLOCK_ERASING;
+
+		bed_lock_release(&pool->lock);
+		status = erase_and_check(pool, *index);
+		bed_lock_obtain(&pool->lock);
+
+		if (status == BED_SUCCESS) {
+			pool->states [*index] = BLOCK_CLEAN;
+		} else if (bed_is_system_error(status)) {
+			pool->states [*index] = BLOCK_DISCARDED;
+			push(&pool->discarded, pool->block_count, *index);
+		} else {
+			pool->states [*index] = BLOCK_BAD;
+		}
+	}
+
+	return status;
+}
+
+bed_erase_pool *bed_erase_pool_create(
+	const bed_partition *part,
+	uint32_t clean_block_count
+)
+{
+	uint32_t block_count = (uint32_t) bed_address_to_block(part, bed_size(part));
+	size_t check_buffer_size = bed_page_size(part) + (size_t) bed_oob_free_size(part);
+	bed_erase_pool *pool = malloc(
+		sizeof(*pool) + block_count * (2 * sizeof(uint32_t) + 1) + check_buffer_size
+	);
+
+	if (pool != NULL) {
+		uint8_t *chunk = (uint8_t *) (pool + 1);
+
+		memset(pool, 0, sizeof(*pool));
+		pool->part = *part;
+		pool->block_count = block_count;
+		pool->clean_block_count = clean_block_count;
+		pool->discarded.blocks = (uint32_t *) chunk;
+		chunk += block_count * sizeof(uint32_t);
+		pool->clean.blocks = (uint32_t *) chunk;
+		chunk += block_count * sizeof(uint32_t);
+		pool->states = chunk;
+		memset(pool->states, BLOCK_IN_USE, block_count);
+		chunk += block_count;
+		pool->check_buffer = chunk;
+
+		if (bed_lock_initialize(&pool->lock) == BED_SUCCESS) {
+			if (bed_lock_initialize(&pool->check_lock) != BED_SUCCESS) {
+				bed_lock_destroy(&pool->lock);
+				free(pool);
+				pool = NULL;
+			}
+		} else {
+			free(pool);
+			pool = NULL;
+		}
+	}
+
+	return pool;
+}
+
+void bed_erase_pool_destroy(bed_erase_pool *pool)
+{
+	bed_lock_destroy(&pool->check_lock);
+	bed_lock_destroy(&pool->lock);
+	free(pool);
+}
+
+bed_status bed_erase_pool_discard(bed_erase_pool *pool, bed_address block)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t index = (uint32_t) bed_address_to_block(&pool->part, block);
+
+	bed_lock_obtain(&pool->lock);
+
+	if (
+		(block & bed_block_mask(&pool->part)) == 0
+			&& index < pool->block_count
+			&& pool->states [index] == BLOCK_IN_USE
+	) {
+		pool->states [index] = BLOCK_DISCARDED;
+		push(&pool->discarded, pool->block_count, index);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	bed_lock_release(&pool->lock);
+
+	return status;
+}
+
+bed_status bed_erase_pool_allocate(bed_erase_pool *pool, bed_address *block)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t index = 0;
+
+	bed_lock_obtain(&pool->lock);
+
+	if (pool->clean.count > 0) {
+		index = pop(&pool->clean, pool->block_count);
+		status = BED_SUCCESS;
+	} else {
+		do {
+			status = take_discarded_block(pool, &index);
+		} while (
+			status != BED_SUCCESS
+				&& status != BED_ERROR_UNSATISFIED
+				&& !bed_is_system_error(status)
+		);
+	}
+
+	if (status == BED_SUCCESS) {
+		pool->states [index] = BLOCK_IN_USE;
+		*block = bed_block_to_address(&pool->part, index);
+	}
+
+	bed_lock_release(&pool->lock);
+
+	return status;
+}
+
+bed_status bed_erase_pool_work(bed_erase_pool *pool)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+
+	bed_lock_obtain(&pool->lock);
+
+	if (pool->clean.count < pool->clean_block_count) {
+		uint32_t index;
+
+		status = take_discarded_block(pool, &index);
+		if (status == BED_SUCCESS) {
+			push(&pool->clean, pool->block_count, index);
+		} else if (status != BED_ERROR_UNSATISFIED && !bed_is_system_error(status)) {
+			/* The block turned out to be bad */
+			status = BED_SUCCESS;
+		}
+	}
+
+	bed_lock_release(&pool->lock);
+
+	return status;
+}
+
+uint32_t bed_erase_pool_clean_count(bed_erase_pool *pool)
+{
+	uint32_t count;
+
+	bed_lock_obtain(&pool->lock);
+	count = pool->clean.count;
+	bed_lock_release(&pool->lock);
+
+	return count;
+}
+
+uint32_t bed_erase_pool_discarded_count(bed_erase_pool *pool)
+{
+	uint32_t count;
+
+	bed_lock_obtain(&pool->lock);
+	count = pool->discarded.count;
+	bed_lock_release(&pool->lock);
+
+	return count;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file
+ *
+ * @ingroup BEDErasePool
+ *
+ * @brief BED Erase Pool API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_ERASE_POOL_H
+#define BED_ERASE_POOL_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDErasePool BED Erase Pool
+ *
+ * @ingroup BED
+ *
+ * @brief Pool of pre-erased blocks.
+ *
+ * Upper layers return blocks they no longer need with
+ * bed_erase_pool_discard().  A background task calls bed_erase_pool_work()
+ * to erase and blank check the discarded blocks until the configured count
+ * of clean blocks is available.  Writers get clean blocks with
+ * bed_erase_pool_allocate() and do not have to wait for the block erase in
+ * this case.  Blocks which fail the erase or the blank check are marked bad
+ * and leave the pool.
+ *
+ * The erase pool functions may be used concurrently.  No lock is held
+ * during the block erase and blank check.
+ *
+ * @{
+ */
+
+typedef struct bed_erase_pool bed_erase_pool;
+
+/**
+ * @brief Creates an erase pool for a partition.
+ *
+ * Initially all blocks of the partition are in use.
+ *
+ * @param[in] part The partition.
+ * @param[in] clean_block_count The count of clean blocks maintained by the
+ * background erase.
+ *
+ * @retval NULL Not enough resources.
+ * @retval pool The erase pool.
+ */
+bed_erase_pool *bed_erase_pool_create(
+	const bed_partition *part,
+	uint32_t clean_block_count
+);
+
+void bed_erase_pool_destroy(bed_erase_pool *pool);
+
+/**
+ * @brief Returns a block in use to the pool for a lazy erase.
+ *
+ * @param[in] pool The erase pool.
+ * @param[in] block The block address relative to the partition begin.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS The block address is invalid or the
+ * block is not in use.
+ */
+bed_status bed_erase_pool_discard(bed_erase_pool *pool, bed_address block);
+
+/**
+ * @brief Allocates an erased block.
+ *
+ * A clean block is preferred.  Otherwise a discarded block is erased and
+ * blank checked on demand.
+ *
+ * @param[in] pool The erase pool.
+ * @param[out] block The block address relative to the partition begin.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED No erased block is available.
+ * @retval BED_ERROR_SYSTEM Not enough memory for the blank check.
+ * @retval BED_ERROR_READ_ONLY The partition is read-only.
+ */
+bed_status bed_erase_pool_allocate(bed_erase_pool *pool, bed_address *block);
+
+/**
+ * @brief Erases and blank checks one discarded block in case the pool has
+ * not enough clean blocks.
+ *
+ * @param[in] pool The erase pool.
+ *
+ * @retval BED_SUCCESS One discarded block was processed.
+ * @retval BED_ERROR_UNSATISFIED There was nothing to do.
+ * @retval BED_ERROR_SYSTEM Not enough memory for the blank check.
+ * @retval BED_ERROR_READ_ONLY The partition is read-only.
+ */
+bed_status bed_erase_pool_work(bed_erase_pool *pool);
+
+uint32_t bed_erase_pool_clean_count(bed_erase_pool *pool);
+
+uint32_t bed_erase_pool_discarded_count(bed_erase_pool *pool);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_ERASE_POOL_H */
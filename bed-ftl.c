@@ -0,0 +1,1136 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-ftl.h"
+#include "bed-impl.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INVALID_PAGE UINT32_MAX
+
+/*
+ * The metadata consists of the sequence number (four bytes, little endian),
+ * the logical page number (23 bits, little endian), the lost flag (one bit)
+ * and a CRC-8 of the previous seven bytes.  The lost flag marks pages which
+ * were relocated despite an uncorrectable ECC error.
+ */
+#define METADATA_SIZE 8
+
+#define LOGICAL_PAGE_LIMIT 0x7fffff
+
+#define LOST_FLAG 0x800000
+
+#define HOT 0
+
+#define COLD 1
+
+#define HEAD_COUNT 2
+
+typedef enum {
+	BLOCK_FREE,
+	BLOCK_OPEN,
+	BLOCK_CLOSED,
+	BLOCK_RETIRED,
+	BLOCK_BAD
+} block_state;
+
+typedef struct {
+	uint32_t valid;
+	uint32_t sequence;
+	uint8_t state;
+} block_info;
+
+typedef struct {
+	uint32_t block;
+	uint32_t page;
+	bool open;
+} write_head;
+
+struct bed_ftl {
+	bed_lock lock;
+	bed_partition part;
+	bed_ftl_config config;
+	uint16_t page_size;
+	uint32_t pages_per_block;
+	uint32_t block_count;
+	uint32_t page_count;
+	uint32_t logical_page_count;
+	uint32_t free_block_count;
+	uint32_t next_free_block;
+	uint32_t sequence;
+	write_head heads [HEAD_COUNT];
+	uint32_t *map;
+	uint32_t *owners;
+	block_info *blocks;
+	uint8_t *page_buffer;
+	uint8_t *gc_buffer;
+	bed_ftl_statistics statistics;
+};
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static uint8_t crc8(const uint8_t *data, size_t n)
+{
+	uint8_t crc = 0;
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		int j;
+
+		crc ^= data [i];
+
+		for (j = 0; j < 8; ++j) {
+			crc = (uint8_t) ((crc & 0x80) != 0 ? (crc << 1) ^ 0x07 : crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+static void encode_metadata(
+	uint8_t *metadata,
+	uint32_t logical_page,
+	uint32_t sequence,
+	bool lost
+)
+{
+	if (lost) {
+		logical_page |= LOST_FLAG;
+	}
+
+	metadata [0] = (uint8_t) sequence;
+	metadata [1] = (uint8_t) (sequence >> 8);
+	metadata [2] = (uint8_t) (sequence >> 16);
+	metadata [3] = (uint8_t) (sequence >> 24);
+	metadata [4] = (uint8_t) logical_page;
+	metadata [5] = (uint8_t) (logical_page >> 8);
+	metadata [6] = (uint8_t) (logical_page >> 16);
+	metadata [7] = crc8(metadata, METADATA_SIZE - 1);
+}
+
+static bool decode_metadata(
+	const uint8_t *metadata,
+	uint32_t *logical_page,
+	uint32_t *sequence
+)
+{
+	*sequence = (uint32_t) metadata [0]
+		| ((uint32_t) metadata [1] << 8)
+		| ((uint32_t) metadata [2] << 16)
+		| ((uint32_t) metadata [3] << 24);
+	*logical_page = ((uint32_t) metadata [4]
+		| ((uint32_t) metadata [5] << 8)
+		| ((uint32_t) metadata [6] << 16)) & ~(uint32_t) LOST_FLAG;
+
+	return metadata [7] == crc8(metadata, METADATA_SIZE - 1)
+		&& *logical_page < LOGICAL_PAGE_LIMIT;
+}
+
+static bool is_lost(const uint8_t *metadata)
+{
+	return (metadata [6] & (LOST_FLAG >> 16)) != 0;
+}
+
+static bed_address page_to_address(const bed_ftl *ftl, uint32_t page)
+{
+	return (bed_address) page * ftl->page_size;
+}
+
+static void free_block(bed_ftl *ftl, uint32_t block)
+{
+	block_info *info = &ftl->blocks [block];
+
+	if (info->state == BLOCK_RETIRED) {
+		bed_mark_block_bad(
+			&ftl->part,
+			page_to_address(ftl, block * ftl->pages_per_block)
+		);
+		info->state = BLOCK_BAD;
+	} else {
+		info->state = BLOCK_FREE;
+		++ftl->free_block_count;
+
+		if (ftl->config.wear != NULL) {
+			bed_wear_discard(
+				ftl->config.wear,
+				page_to_address(ftl, block * ftl->pages_per_block)
+			);
+		}
+	}
+}
+
+static void invalidate(bed_ftl *ftl, uint32_t page)
+{
+	if (page != INVALID_PAGE) {
+		uint32_t block = page / ftl->pages_per_block;
+		block_info *info = &ftl->blocks [block];
+
+		ftl->owners [page] = INVALID_PAGE;
+		--info->valid;
+
+		if (
+			info->valid == 0
+				&& (info->state == BLOCK_CLOSED || info->state == BLOCK_RETIRED)
+		) {
+			free_block(ftl, block);
+		}
+	}
+}
+
+static void assign(
+	bed_ftl *ftl,
+	uint32_t logical_page,
+	uint32_t page,
+	uint32_t sequence
+)
+{
+	block_info *info = &ftl->blocks [page / ftl->pages_per_block];
+
+	invalidate(ftl, ftl->map [logical_page]);
+	ftl->map [logical_page] = page;
+	ftl->owners [page] = logical_page;
+	++info->valid;
+	info->sequence = sequence;
+}
+
+static void close_block(bed_ftl *ftl, write_head *head, block_state state)
+{
+	block_info *info = &ftl->blocks [head->block];
+
+	head->open = false;
+	info->state = state;
+
+	if (info->valid == 0) {
+		free_block(ftl, head->block);
+	}
+}
+
+/*
+ * Without a wear leveling allocator the free blocks are taken round-robin to
+ * spread the erases.
+ */
+static bed_status allocate_block(bed_ftl *ftl, uint32_t *block)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	bed_wear *wear = ftl->config.wear;
+
+	if (wear != NULL) {
+		bed_address addr;
+
+		status = bed_wear_allocate(wear, &addr);
+
+		if (status == BED_SUCCESS) {
+			*block = (uint32_t) bed_address_to_block(&ftl->part, addr);
+			ftl->free_block_count = bed_wear_discarded_count(wear);
+			++ftl->statistics.block_erases;
+		}
+	} else {
+		while (status != BED_SUCCESS && ftl->free_block_count > 0) {
+			block_info *info = &ftl->blocks [ftl->next_free_block];
+
+			*block = ftl->next_free_block;
+			ftl->next_free_block = (*block + 1) % ftl->block_count;
+
+			if (info->state == BLOCK_FREE) {
+				status = bed_erase(
+					&ftl->part,
+					page_to_address(ftl, *block * ftl->pages_per_block),
+					BED_ERASE_MARK_BAD_ON_ERROR
+				);
+				++ftl->statistics.block_erases;
+
+				if (status == BED_SUCCESS) {
+					--ftl->free_block_count;
+				} else if (bed_is_system_error(status)) {
+					break;
+				} else {
+					--ftl->free_block_count;
+					info->state = BLOCK_BAD;
+					status = BED_ERROR_UNSATISFIED;
+				}
+			}
+		}
+	}
+
+	return status;
+}
+
+static void open_block(bed_ftl *ftl, write_head *head, uint32_t block)
+{
+	block_info *info = &ftl->blocks [block];
+
+	info->state = BLOCK_OPEN;
+	info->valid = 0;
+	head->block = block;
+	head->page = 0;
+	head->open = true;
+}
+
+static bed_status collect(bed_ftl *ftl);
+
+/*
+ * In case of a write error, the block is retired and the page is programmed
+ * to the next block of the head.
+ */
+static bed_status program(
+	bed_ftl *ftl,
+	int head_index,
+	uint32_t logical_page,
+	const void *data,
+	bool lost
+)
+{
+	bed_status status = BED_SUCCESS;
+	write_head *head = &ftl->heads [head_index];
+	bool done = false;
+
+	while (!done && status == BED_SUCCESS) {
+		if (head_index == HOT) {
+			while (
+				!head->open
+					&& ftl->free_block_count <= 1
+					&& status == BED_SUCCESS
+			) {
+				status = collect(ftl);
+			}
+		}
+
+		if (status == BED_SUCCESS && !head->open) {
+			uint32_t block = 0;
+
+			status = allocate_block(ftl, &block);
+
+			if (status == BED_SUCCESS) {
+				open_block(ftl, head, block);
+			}
+		}
+
+		if (status == BED_SUCCESS) {
+			uint32_t page = head->block * ftl->pages_per_block + head->page;
+			uint32_t sequence = ftl->sequence;
+			uint8_t metadata [METADATA_SIZE];
+			const bed_oob_request oob = {
+				.mode = BED_OOB_MODE_AUTO,
+				.offset = 0,
+				.size = METADATA_SIZE,
+				.data = metadata
+			};
+
+			++ftl->sequence;
+			++head->page;
+			encode_metadata(metadata, logical_page, sequence, lost);
+			status = bed_write_oob(
+				&ftl->part,
+				page_to_address(ftl, page),
+				data,
+				ftl->page_size,
+				&oob
+			);
+			++ftl->statistics.page_writes;
+
+			if (status == BED_SUCCESS) {
+				assign(ftl, logical_page, page, sequence);
+				done = true;
+
+				if (head->page == ftl->pages_per_block) {
+					close_block(ftl, head, BLOCK_CLOSED);
+				}
+			} else if (status == BED_ERROR_WRITE) {
+				close_block(ftl, head, BLOCK_RETIRED);
+				status = BED_SUCCESS;
+			}
+		}
+	}
+
+	return status;
+}
+
+static uint64_t benefit(const bed_ftl *ftl, const block_info *info)
+{
+	uint64_t value;
+
+	if (ftl->config.gc_policy == BED_FTL_GC_COST_BENEFIT) {
+		uint64_t age = (uint64_t) (ftl->sequence - info->sequence);
+
+		value = (age * (ftl->pages_per_block - info->valid) << 8)
+			/ (2 * (uint64_t) info->valid);
+	} else {
+		value = ftl->pages_per_block - info->valid;
+	}
+
+	return value;
+}
+
+/*
+ * Retired blocks are collected first.  Blocks with only valid pages are not
+ * worth a collection.
+ */
+static uint32_t select_victim(const bed_ftl *ftl)
+{
+	uint32_t victim = UINT32_MAX;
+	uint64_t best = 0;
+	uint32_t block;
+
+	for (block = 0; block < ftl->block_count; ++block) {
+		const block_info *info = &ftl->blocks [block];
+
+		if (info->state == BLOCK_RETIRED) {
+			victim = block;
+			break;
+		} else if (
+			info->state == BLOCK_CLOSED
+				&& info->valid < ftl->pages_per_block
+		) {
+			uint64_t value = benefit(ftl, info);
+
+			if (victim == UINT32_MAX || value > best) {
+				victim = block;
+				best = value;
+			}
+		}
+	}
+
+	return victim;
+}
+
+/*
+ * Pages marked as lost read as uncorrectable.
+ */
+static bed_status read_page(bed_ftl *ftl, uint32_t page, void *data)
+{
+	uint8_t metadata [METADATA_SIZE];
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = METADATA_SIZE,
+		.data = metadata
+	};
+	bed_status status = bed_read_oob(
+		&ftl->part,
+		page_to_address(ftl, page),
+		data,
+		ftl->page_size,
+		&oob
+	);
+
+	if (
+		(status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED)
+			&& is_lost(metadata)
+	) {
+		status = BED_ERROR_ECC_UNCORRECTABLE;
+	}
+
+	return status;
+}
+
+static bed_status relocate_block(bed_ftl *ftl, uint32_t block)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t page = block * ftl->pages_per_block;
+	uint32_t end = page + ftl->pages_per_block;
+
+	while (page != end && status == BED_SUCCESS) {
+		uint32_t logical_page = ftl->owners [page];
+
+		if (logical_page != INVALID_PAGE) {
+			bool lost = false;
+
+			status = read_page(ftl, page, ftl->gc_buffer);
+
+			/*
+			 * Relocate uncorrectable pages nonetheless, since the block must be
+			 * freed.  They are marked as lost, so that reads fail until the
+			 * logical page is written again.
+			 */
+			if (status == BED_ERROR_ECC_FIXED) {
+				status = BED_SUCCESS;
+			} else if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+				lost = true;
+				status = BED_SUCCESS;
+			}
+
+			if (status == BED_SUCCESS) {
+				status = program(
+					ftl,
+					COLD,
+					logical_page,
+					ftl->gc_buffer,
+					lost
+				);
+				++ftl->statistics.gc_page_writes;
+			}
+		}
+
+		++page;
+	}
+
+	return status;
+}
+
+static bed_status collect(bed_ftl *ftl)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t victim = select_victim(ftl);
+
+	if (victim != UINT32_MAX) {
+		++ftl->statistics.gc_blocks;
+		status = relocate_block(ftl, victim);
+	}
+
+	return status;
+}
+
+static bed_status read_logical_page(
+	bed_ftl *ftl,
+	uint32_t logical_page,
+	void *data
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t page = ftl->map [logical_page];
+
+	if (page != INVALID_PAGE) {
+		status = read_page(ftl, page, data);
+
+		if (status == BED_ERROR_ECC_FIXED) {
+			status = BED_SUCCESS;
+		}
+	} else {
+		memset(data, 0xff, ftl->page_size);
+	}
+
+	return status;
+}
+
+/*
+ * The sequence numbers of the mapped logical pages are stored in the
+ * sequences array.  The ignored page is treated as an unreadable page.  The
+ * unreadable pages are not mapped, however, their sequence numbers are never
+ * used again.
+ */
+static bed_status scan(
+	bed_ftl *ftl,
+	uint32_t *sequences,
+	uint32_t ignored_page,
+	uint32_t *newest_page
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint8_t metadata [METADATA_SIZE];
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = METADATA_SIZE,
+		.data = metadata
+	};
+	uint32_t newest_sequence = 0;
+	uint32_t block;
+
+	*newest_page = INVALID_PAGE;
+	ftl->free_block_count = 0;
+	memset(ftl->map, 0xff, ftl->logical_page_count * sizeof(ftl->map [0]));
+	memset(ftl->owners, 0xff, ftl->page_count * sizeof(ftl->owners [0]));
+	memset(ftl->blocks, 0, ftl->block_count * sizeof(ftl->blocks [0]));
+	memset(ftl->heads, 0, sizeof(ftl->heads));
+
+	for (block = 0; block < ftl->block_count && status == BED_SUCCESS; ++block) {
+		block_info *info = &ftl->blocks [block];
+		uint32_t page = block * ftl->pages_per_block;
+		uint32_t end = page + ftl->pages_per_block;
+
+		info->state = BLOCK_FREE;
+		status = bed_is_block_valid(&ftl->part, page_to_address(ftl, page));
+
+		if (status == BED_ERROR_BLOCK_IS_BAD) {
+			info->state = BLOCK_BAD;
+			status = BED_SUCCESS;
+			page = end;
+		}
+
+		while (page != end && status == BED_SUCCESS) {
+			status = bed_read_oob(
+				&ftl->part,
+				page_to_address(ftl, page),
+				NULL,
+				0,
+				&oob
+			);
+
+			if (
+				(
+					status == BED_SUCCESS
+						|| status == BED_ERROR_ECC_FIXED
+						|| status == BED_ERROR_ECC_UNCORRECTABLE
+				) && !bed_is_erased(metadata, METADATA_SIZE)
+			) {
+				bool readable = status != BED_ERROR_ECC_UNCORRECTABLE
+					&& page != ignored_page;
+				uint32_t logical_page;
+				uint32_t sequence;
+
+				info->state = BLOCK_CLOSED;
+				status = BED_SUCCESS;
+
+				if (
+					decode_metadata(metadata, &logical_page, &sequence)
+						&& logical_page < ftl->logical_page_count
+				) {
+					uint32_t previous = ftl->map [logical_page];
+
+					if (
+						readable
+							&& (
+								previous == INVALID_PAGE
+									|| sequence > sequences [logical_page]
+							)
+					) {
+						if (previous != INVALID_PAGE) {
+							ftl->owners [previous] = INVALID_PAGE;
+							--ftl->blocks [previous / ftl->pages_per_block].valid;
+						}
+
+						ftl->map [logical_page] = page;
+						ftl->owners [page] = logical_page;
+						sequences [logical_page] = sequence;
+						++info->valid;
+					}
+
+					if (sequence >= info->sequence) {
+						info->sequence = sequence;
+					}
+
+					if (*newest_page == INVALID_PAGE || sequence >= newest_sequence) {
+						*newest_page = page;
+						newest_sequence = sequence;
+					}
+				}
+			} else if (
+				status == BED_ERROR_ECC_FIXED
+					|| status == BED_ERROR_ECC_UNCORRECTABLE
+			) {
+				info->state = BLOCK_CLOSED;
+				status = BED_SUCCESS;
+			}
+
+			++page;
+		}
+	}
+
+	if (status == BED_SUCCESS) {
+		for (block = 0; block < ftl->block_count; ++block) {
+			block_info *info = &ftl->blocks [block];
+
+			if (info->state == BLOCK_CLOSED && info->valid == 0) {
+				info->state = BLOCK_FREE;
+			}
+
+			if (info->state == BLOCK_FREE) {
+				++ftl->free_block_count;
+			}
+		}
+
+		ftl->sequence = *newest_page != INVALID_PAGE ? newest_sequence + 1 : 0;
+	}
+
+	return status;
+}
+
+/*
+ * Only the last page programmed before a power cut may be incomplete.  In
+ * this case, scan again and ignore this page.  The incomplete page is
+ * returned in torn_page, otherwise INVALID_PAGE.
+ */
+static bed_status recover(bed_ftl *ftl, uint32_t *torn_page)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t *sequences = malloc(
+		ftl->logical_page_count * sizeof(*sequences)
+	);
+
+	if (sequences != NULL) {
+		uint32_t newest_page;
+
+		*torn_page = INVALID_PAGE;
+		status = scan(ftl, sequences, INVALID_PAGE, &newest_page);
+
+		if (status == BED_SUCCESS && newest_page != INVALID_PAGE) {
+			status = bed_read(
+				&ftl->part,
+				page_to_address(ftl, newest_page),
+				ftl->page_buffer,
+				ftl->page_size
+			);
+
+			if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+				*torn_page = newest_page;
+				status = scan(ftl, sequences, *torn_page, &newest_page);
+			} else if (status == BED_ERROR_ECC_FIXED) {
+				status = BED_SUCCESS;
+			}
+		}
+
+		free(sequences);
+	} else {
+		status = BED_ERROR_SYSTEM;
+	}
+
+	return status;
+}
+
+/*
+ * The metadata of an incomplete page may be intact.  Programming the
+ * current content of its logical page with a newer sequence number ensures
+ * that the incomplete page is never mapped by a later scan, even if its
+ * metadata turns out to be readable.
+ */
+static bed_status supersede(bed_ftl *ftl, uint32_t torn_page)
+{
+	uint8_t metadata [METADATA_SIZE];
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = METADATA_SIZE,
+		.data = metadata
+	};
+	bed_status status = bed_read_oob(
+		&ftl->part,
+		page_to_address(ftl, torn_page),
+		NULL,
+		0,
+		&oob
+	);
+	uint32_t logical_page;
+	uint32_t sequence;
+
+	if (
+		(
+			status == BED_SUCCESS
+				|| status == BED_ERROR_ECC_FIXED
+				|| status == BED_ERROR_ECC_UNCORRECTABLE
+		)
+			&& decode_metadata(metadata, &logical_page, &sequence)
+			&& logical_page < ftl->logical_page_count
+	) {
+		bool lost = false;
+
+		status = read_logical_page(ftl, logical_page, ftl->page_buffer);
+
+		if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+			lost = true;
+			status = BED_SUCCESS;
+		}
+
+		if (status == BED_SUCCESS) {
+			status = program(
+				ftl,
+				HOT,
+				logical_page,
+				ftl->page_buffer,
+				lost
+			);
+		}
+	} else {
+		status = BED_SUCCESS;
+	}
+
+	if (status == BED_ERROR_READ_ONLY) {
+		status = BED_SUCCESS;
+	}
+
+	return status;
+}
+
+/*
+ * The blocks discarded before remain discarded.
+ */
+static void discard_free_blocks(bed_ftl *ftl)
+{
+	bed_wear *wear = ftl->config.wear;
+	uint32_t block;
+
+	for (block = 0; block < ftl->block_count; ++block) {
+		if (ftl->blocks [block].state == BLOCK_FREE) {
+			bed_wear_discard(
+				wear,
+				page_to_address(ftl, block * ftl->pages_per_block)
+			);
+		}
+	}
+
+	ftl->free_block_count = bed_wear_discarded_count(wear);
+}
+
+bed_status bed_ftl_create(
+	const bed_partition *part,
+	const bed_ftl_config *config,
+	bed_ftl **ftl_ptr
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_ftl *ftl = NULL;
+	uint16_t page_size = bed_page_size(part);
+	uint32_t pages_per_block = bed_block_size(part) / page_size;
+	uint32_t block_count = (uint32_t) bed_address_to_block(part, bed_size(part));
+	uint32_t page_count = block_count * pages_per_block;
+	uint32_t logical_page_count = 0;
+
+	if (
+		bed_is_power_of_two(config->sector_size)
+			&& config->spare_blocks >= 3
+			&& config->spare_blocks < block_count
+			&& bed_oob_free_size(part) >= METADATA_SIZE
+	) {
+		logical_page_count = (block_count - config->spare_blocks)
+			* pages_per_block;
+		logical_page_count = bed_align_down(
+			logical_page_count,
+			config->sector_size > page_size ?
+				config->sector_size / page_size - 1 : 0
+		);
+	}
+
+	if (logical_page_count > 0 && logical_page_count < LOGICAL_PAGE_LIMIT) {
+		ftl = malloc(
+			sizeof(*ftl)
+				+ logical_page_count * sizeof(ftl->map [0])
+				+ page_count * sizeof(ftl->owners [0])
+				+ block_count * sizeof(ftl->blocks [0])
+				+ 2 * (size_t) page_size
+		);
+
+		if (ftl != NULL) {
+			uint8_t *chunk = (uint8_t *) (ftl + 1);
+			uint32_t torn_page;
+
+			memset(ftl, 0, sizeof(*ftl));
+			ftl->part = *part;
+			ftl->config = *config;
+			ftl->page_size = page_size;
+			ftl->pages_per_block = pages_per_block;
+			ftl->block_count = block_count;
+			ftl->page_count = page_count;
+			ftl->logical_page_count = logical_page_count;
+			ftl->blocks = (block_info *) chunk;
+			chunk += block_count * sizeof(ftl->blocks [0]);
+			ftl->map = (uint32_t *) chunk;
+			chunk += logical_page_count * sizeof(ftl->map [0]);
+			ftl->owners = (uint32_t *) chunk;
+			chunk += page_count * sizeof(ftl->owners [0]);
+			ftl->page_buffer = chunk;
+			chunk += page_size;
+			ftl->gc_buffer = chunk;
+
+			status = recover(ftl, &torn_page);
+
+			if (status == BED_SUCCESS && config->wear != NULL) {
+				discard_free_blocks(ftl);
+			}
+
+			if (status == BED_SUCCESS && torn_page != INVALID_PAGE) {
+				status = supersede(ftl, torn_page);
+			}
+
+			if (status == BED_SUCCESS) {
+				status = bed_lock_initialize(&ftl->lock);
+			}
+
+			if (status != BED_SUCCESS) {
+				free(ftl);
+				ftl = NULL;
+			}
+		} else {
+			status = BED_ERROR_SYSTEM;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	*ftl_ptr = ftl;
+
+	return status;
+}
+
+void bed_ftl_destroy(bed_ftl *ftl)
+{
+	bed_lock_destroy(&ftl->lock);
+	free(ftl);
+}
+
+static bool is_sector_range_valid(
+	const bed_ftl *ftl,
+	uint32_t sector,
+	uint32_t count
+)
+{
+	uint32_t sector_count = bed_ftl_sector_count(ftl);
+
+	return sector <= sector_count && count <= sector_count - sector;
+}
+
+bed_status bed_ftl_read(
+	bed_ftl *ftl,
+	uint32_t sector,
+	void *data,
+	uint32_t count
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (is_sector_range_valid(ftl, sector, count)) {
+		uint64_t t0 = now();
+		uint16_t page_size = ftl->page_size;
+		uint64_t offset = (uint64_t) sector * ftl->config.sector_size;
+		uint64_t n = (uint64_t) count * ftl->config.sector_size;
+		uint8_t *out = data;
+
+		bed_lock_obtain(&ftl->lock);
+
+		while (n > 0 && status == BED_SUCCESS) {
+			uint32_t logical_page = (uint32_t) (offset / page_size);
+			uint16_t column = (uint16_t) (offset % page_size);
+			uint64_t r = (uint64_t) (page_size - column);
+			size_t m = (size_t) (n < r ? n : r);
+
+			if (m == page_size) {
+				status = read_logical_page(ftl, logical_page, out);
+			} else {
+				status = read_logical_page(ftl, logical_page, ftl->page_buffer);
+				memcpy(out, ftl->page_buffer + column, m);
+			}
+
+			offset += m;
+			out += m;
+			n -= m;
+		}
+
+		if (status == BED_SUCCESS) {
+			ftl->statistics.sectors_read += count;
+		}
+
+		ftl->statistics.read_nanoseconds += now() - t0;
+
+		bed_lock_release(&ftl->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+bed_status bed_ftl_write(
+	bed_ftl *ftl,
+	uint32_t sector,
+	const void *data,
+	uint32_t count
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (is_sector_range_valid(ftl, sector, count)) {
+		uint64_t t0 = now();
+		uint16_t page_size = ftl->page_size;
+		uint64_t offset = (uint64_t) sector * ftl->config.sector_size;
+		uint64_t n = (uint64_t) count * ftl->config.sector_size;
+		const uint8_t *in = data;
+
+		bed_lock_obtain(&ftl->lock);
+
+		while (n > 0 && status == BED_SUCCESS) {
+			uint32_t logical_page = (uint32_t) (offset / page_size);
+			uint16_t column = (uint16_t) (offset % page_size);
+			uint64_t r = (uint64_t) (page_size - column);
+			size_t m = (size_t) (n < r ? n : r);
+
+			if (m == page_size) {
+				status = program(ftl, HOT, logical_page, in, false);
+			} else {
+				status = read_logical_page(ftl, logical_page, ftl->page_buffer);
+
+				/*
+				 * A partial write replaces a lost or unreadable page, otherwise
+				 * the sectors of this page could never be written again.
+				 */
+				if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+					memset(ftl->page_buffer, 0xff, page_size);
+					status = BED_SUCCESS;
+				}
+
+				if (status == BED_SUCCESS) {
+					memcpy(ftl->page_buffer + column, in, m);
+					status = program(
+						ftl,
+						HOT,
+						logical_page,
+						ftl->page_buffer,
+						false
+					);
+				}
+			}
+
+			offset += m;
+			in += m;
+			n -= m;
+		}
+
+		if (status == BED_SUCCESS) {
+			ftl->statistics.sectors_written += count;
+		}
+
+		ftl->statistics.write_nanoseconds += now() - t0;
+
+		bed_lock_release(&ftl->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+/*
+ * The destination block becomes the cold block, so that the relocated pages
+ * fill it.
+ */
+static bed_status relocate_for_wear_leveling(
+	void *arg,
+	bed_address from,
+	bed_address to
+)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	bed_ftl *ftl = arg;
+	uint32_t source = (uint32_t) bed_address_to_block(&ftl->part, from);
+	uint32_t destination = (uint32_t) bed_address_to_block(&ftl->part, to);
+	write_head *head = &ftl->heads [COLD];
+
+	if (
+		ftl->blocks [source].state == BLOCK_CLOSED
+			&& ftl->blocks [destination].state == BLOCK_FREE
+	) {
+		if (head->open) {
+			close_block(ftl, head, BLOCK_CLOSED);
+		}
+
+		--ftl->free_block_count;
+		open_block(ftl, head, destination);
+		status = relocate_block(ftl, source);
+	} else {
+		bed_wear_discard(ftl->config.wear, to);
+	}
+
+	return status;
+}
+
+bed_status bed_ftl_level_wear(bed_ftl *ftl)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+
+	if (ftl->config.wear != NULL) {
+		bed_lock_obtain(&ftl->lock);
+		status = bed_wear_level(
+			ftl->config.wear,
+			relocate_for_wear_leveling,
+			ftl
+		);
+		bed_lock_release(&ftl->lock);
+	}
+
+	return status;
+}
+
+uint32_t bed_ftl_sector_size(const bed_ftl *ftl)
+{
+	return ftl->config.sector_size;
+}
+
+uint32_t bed_ftl_sector_count(const bed_ftl *ftl)
+{
+	return (uint32_t) (
+		(uint64_t) ftl->logical_page_count * ftl->page_size
+			/ ftl->config.sector_size
+	);
+}
+
+void bed_ftl_get_statistics(
+	bed_ftl *ftl,
+	bed_ftl_statistics *statistics,
+	bool reset
+)
+{
+	bed_lock_obtain(&ftl->lock);
+
+	*statistics = ftl->statistics;
+
+	if (reset) {
+		memset(&ftl->statistics, 0, sizeof(ftl->statistics));
+	}
+
+	bed_lock_release(&ftl->lock);
+}
+
+static uint64_t kib_per_second(uint64_t bytes, uint64_t nanoseconds)
+{
+	return nanoseconds > 0 ? (bytes * 1000000000 / 1024) / nanoseconds : 0;
+}
+
+void bed_ftl_print_statistics(
+	bed_ftl *ftl,
+	bed_printer printer,
+	void *printer_arg
+)
+{
+	bed_ftl_statistics statistics;
+	uint64_t host_bytes;
+	uint64_t flash_bytes;
+	uint64_t amplification = 0;
+
+	bed_ftl_get_statistics(ftl, &statistics, false);
+	host_bytes = statistics.sectors_written * ftl->config.sector_size;
+	flash_bytes = statistics.page_writes * ftl->page_size;
+
+	if (host_bytes > 0) {
+		amplification = flash_bytes * 100 / host_bytes;
+	}
+
+	(*printer)(
+		printer_arg,
+		"sectors read = %" PRIu64 ", sectors written = %" PRIu64 "\n"
+		"page writes = %" PRIu64 ", GC page writes = %" PRIu64
+		", GC blocks = %" PRIu64 ", block erases = %" PRIu64 "\n"
+		"write amplification = %" PRIu64 ".%02" PRIu64 "\n"
+		"read throughput = %" PRIu64 " KiB/s, write throughput = %" PRIu64 " KiB/s\n",
+		statistics.sectors_read,
+		statistics.sectors_written,
+		statistics.page_writes,
+		statistics.gc_page_writes,
+		statistics.gc_blocks,
+		statistics.block_erases,
+		amplification / 100,
+		amplification % 100,
+		kib_per_second(
+			statistics.sectors_read * ftl->config.sector_size,
+			statistics.read_nanoseconds
+		),
+		kib_per_second(host_bytes, statistics.write_nanoseconds)
+	);
+}
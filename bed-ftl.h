@@ -0,0 +1,272 @@
+/**
+ * @file
+ *
+ * @ingroup BEDFTL
+ *
+ * @brief BED Flash Translation Layer API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_FTL_H
+#define BED_FTL_H
+
+#include "bed-wear.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDFTL BED Flash Translation Layer
+ *
+ * @ingroup BED
+ *
+ * @brief Presents logical sectors on top of a partition.
+ *
+ * The flash translation layer (FTL) is log-structured.  Each write of a
+ * logical page goes to the next free page of an open block.  The mapping of
+ * logical pages to pages is held in RAM.  The logical page size is the page
+ * size.  Sectors smaller than a page are written with a read-modify-write of
+ * the logical page.  Sectors larger than a page span consecutive logical
+ * pages.  A power cut during the write of such a sector may leave a part of
+ * the logical pages with the new data.
+ *
+ * Each page carries its logical page number and a sequence number in the
+ * free out-of-bounds (OOB) area (#BED_OOB_MODE_AUTO mode, eight bytes
+ * protected by a CRC).  On creation the OOB area of all pages is scanned and
+ * the page with the highest sequence number of each logical page wins.  Only
+ * the last page written before a power cut may be incompletely programmed,
+ * so the data of the page with the highest sequence number is verified by
+ * its ECC.  An incomplete page is superseded by a copy of the previous
+ * content of its logical page.  Blocks written before the creation are not
+ * written further.  A partition must be erased before its first use with the
+ * FTL, e.g. with bed_erase_all().
+ *
+ * Host writes go to the hot block.  Pages relocated by the garbage
+ * collection go to the cold block, since they survived at least one
+ * collection.  The garbage collection runs in the context of a host write
+ * once the count of free blocks drops to one.  Blocks are erased when they
+ * are opened for writing.  An optional wear leveling allocator provides the
+ * free block with the lowest erase count.  Blocks with erase errors are marked bad.  Blocks
+ * with write errors are collected first and marked bad afterwards.  Pages
+ * with uncorrectable ECC errors are relocated as lost pages, reads of them
+ * fail until the logical page is written again.  A write of a part of a lost
+ * or unreadable page replaces the page, its other sectors read as 0xff
+ * afterwards.
+ *
+ * Writes are complete once the write function returns.  The FTL may be used
+ * concurrently.
+ *
+ * @{
+ */
+
+typedef enum {
+	/**
+	 * @brief Collects the block with the least count of valid pages.
+	 */
+	BED_FTL_GC_GREEDY,
+
+	/**
+	 * @brief Collects the block with the best ratio of reclaimed space times
+	 * age to copy cost, see Rosenblum and Ousterhout, "The Design and
+	 * Implementation of a Log-Structured File System".
+	 */
+	BED_FTL_GC_COST_BENEFIT
+} bed_ftl_gc_policy;
+
+typedef struct {
+	/**
+	 * @brief Logical sector size in bytes, e.g. 512 or 4096.
+	 *
+	 * It must be a power of two.
+	 */
+	uint32_t sector_size;
+
+	/**
+	 * @brief Count of blocks not available for logical sectors.
+	 *
+	 * They are used for the open blocks, the garbage collection and bad block
+	 * replacement.  It must be at least three.  The logical capacity depends
+	 * only on the partition size and this value.
+	 */
+	uint32_t spare_blocks;
+
+	bed_ftl_gc_policy gc_policy;
+
+	/**
+	 * @brief Optional wear leveling allocator for the blocks.
+	 *
+	 * In this case the partition of the FTL must be the data partition of the
+	 * allocator (bed_wear_data_partition()) and it must be used exclusively by
+	 * the FTL.  Without an allocator the free blocks are taken round-robin.
+	 */
+	bed_wear *wear;
+} bed_ftl_config;
+
+typedef struct {
+	uint64_t sectors_read;
+	uint64_t sectors_written;
+
+	/**
+	 * @brief Count of page writes including the garbage collection writes.
+	 */
+	uint64_t page_writes;
+
+	/**
+	 * @brief Count of page writes of the garbage collection.
+	 */
+	uint64_t gc_page_writes;
+
+	/**
+	 * @brief Count of blocks collected by the garbage collection.
+	 */
+	uint64_t gc_blocks;
+
+	uint64_t block_erases;
+
+	/**
+	 * @brief Time spent in bed_ftl_read() in nanoseconds.
+	 */
+	uint64_t read_nanoseconds;
+
+	/**
+	 * @brief Time spent in bed_ftl_write() in nanoseconds.
+	 */
+	uint64_t write_nanoseconds;
+} bed_ftl_statistics;
+
+typedef struct bed_ftl bed_ftl;
+
+/**
+ * @brief Creates a flash translation layer for a partition.
+ *
+ * Recovers the mapping from the OOB areas of the partition.
+ *
+ * @param[in] part The partition.
+ * @param[in] config The FTL configuration.
+ * @param[out] ftl The FTL.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid configuration for this
+ * partition.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ * @retval other The scan of the OOB areas failed.
+ */
+bed_status bed_ftl_create(
+	const bed_partition *part,
+	const bed_ftl_config *config,
+	bed_ftl **ftl
+);
+
+/**
+ * @brief Destroys a flash translation layer.
+ *
+ * The data on the partition is not affected.
+ */
+void bed_ftl_destroy(bed_ftl *ftl);
+
+/**
+ * @brief Reads logical sectors.
+ *
+ * Sectors never written read as 0xff.
+ *
+ * @param[in] ftl The FTL.
+ * @param[in] sector The first sector.
+ * @param[out] data The sector data.
+ * @param[in] count The count of sectors.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid sector range.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE Uncorrectable ECC error.
+ */
+bed_status bed_ftl_read(
+	bed_ftl *ftl,
+	uint32_t sector,
+	void *data,
+	uint32_t count
+);
+
+/**
+ * @brief Writes logical sectors.
+ *
+ * @param[in] ftl The FTL.
+ * @param[in] sector The first sector.
+ * @param[in] data The sector data.
+ * @param[in] count The count of sectors.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid sector range.
+ * @retval BED_ERROR_UNSATISFIED No space left due to bad blocks.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE Uncorrectable ECC error in the
+ * read-modify-write of a partial page.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
+bed_status bed_ftl_write(
+	bed_ftl *ftl,
+	uint32_t sector,
+	const void *data,
+	uint32_t count
+);
+
+/**
+ * @brief Performs one static wear leveling step.
+ *
+ * The valid pages of the block with the lowest erase count are moved to the
+ * free block with the highest erase count.  See bed_wear_level().
+ *
+ * @retval BED_SUCCESS One block was moved.
+ * @retval BED_ERROR_UNSATISFIED There was nothing to do or the FTL has no wear
+ * leveling allocator.
+ */
+bed_status bed_ftl_level_wear(bed_ftl *ftl);
+
+uint32_t bed_ftl_sector_size(const bed_ftl *ftl);
+
+uint32_t bed_ftl_sector_count(const bed_ftl *ftl);
+
+/**
+ * @brief Gets the FTL statistics.
+ *
+ * The write amplification is the ratio of page_writes times the page size to
+ * sectors_written times the sector size.
+ *
+ * @param[in] ftl The FTL.
+ * @param[out] statistics The statistics.
+ * @param[in] reset Clear the statistics after the copy.
+ */
+void bed_ftl_get_statistics(
+	bed_ftl *ftl,
+	bed_ftl_statistics *statistics,
+	bool reset
+);
+
+/**
+ * @brief Prints the FTL statistics including the throughput and the write
+ * amplification.
+ */
+void bed_ftl_print_statistics(
+	bed_ftl *ftl,
+	bed_printer printer,
+	void *printer_arg
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_FTL_H */
@@ -27,6 +27,10 @@
 
 #include <assert.h>
 
+#ifndef __rtems__
+#include <pthread.h>
+#endif /* __rtems__ */
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -53,6 +57,56 @@ bed_status bed_device_erase(
 
 void *bed_trash_buffer(size_t n);
 
+/**
+ * @brief Updates a CRC-32 (IEEE 802.3) with data.
+ *
+ * Use zero as the initial CRC value.
+ */
+uint32_t bed_crc32(uint32_t crc, const void *data, size_t n);
+
+static inline void bed_put_le16(uint8_t *p, uint32_t value)
+{
+	p [0] = (uint8_t) value;
+	p [1] = (uint8_t) (value >> 8);
+}
+
+static inline void bed_put_le32(uint8_t *p, uint32_t value)
+{
+	bed_put_le16(p, value);
+	bed_put_le16(p + 2, value >> 16);
+}
+
+static inline uint32_t bed_get_le16(const uint8_t *p)
+{
+	return (uint32_t) p [0] | ((uint32_t) p [1] << 8);
+}
+
+static inline uint32_t bed_get_le32(const uint8_t *p)
+{
+	return bed_get_le16(p) | (bed_get_le16(p + 2) << 16);
+}
+
+static inline bool bed_is_erased(const void *data, size_t n)
+{
+	const uint8_t *p = (const uint8_t *) data;
+	uint8_t all = 0xff;
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		all &= p [i];
+	}
+
+	return all == 0xff;
+}
+
+/**
+ * @brief Returns true if the status does not indicate a bad block.
+ */
+static inline bool bed_is_system_error(bed_status status)
+{
+	return status == BED_ERROR_SYSTEM || status == BED_ERROR_READ_ONLY;
+}
+
 extern const char bed_ones_per_byte_table [];
 
 static inline int bed_ones_per_byte(uint8_t byte)
@@ -195,6 +249,20 @@ void bed_default_select_chip(bed_device *bed, uint16_t chip);
 #define bed_read_oob_not_supported \
 	((bed_read_oob_method) bed_op_not_supported)
 
+/**
+ * @brief Reads the whole page and copies the requested range.
+ *
+ * For devices without column addressing.  The page is read into the trash
+ * buffer, so the caller must own the device.
+ */
+bed_status bed_default_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+);
+
 #define bed_write_not_supported \
 	((bed_write_method) bed_op_not_supported)
 
@@ -262,12 +330,151 @@ bed_status bed_ecc_hamming_256_correct(
 
 bed_status bed_mutex_initialize(bed_device *bed);
 
+void bed_mutex_destroy(bed_device *bed);
+
 void bed_mutex_obtain(bed_device *bed);
 
 void bed_mutex_release(bed_device *bed);
 
+bed_status bed_mutex_enable_statistics(bed_device *bed, bool enable);
+
+bed_status bed_mutex_get_statistics(
+	bed_device *bed,
+	bed_lock_statistics *statistics
+);
+
+/**
+ * @brief Lock with priority inheritance which may be obtained recursively by
+ * its owner.
+ */
+typedef struct {
+#ifdef __rtems__
+	uint32_t id;
+#else /* __rtems__ */
+	pthread_mutex_t mutex;
+	uint32_t nest_level;
+	bool statistics_enabled;
+	uint64_t obtain_time;
+	bed_lock_statistics statistics;
+#endif /* __rtems__ */
+} bed_lock;
+
+bed_status bed_lock_initialize(bed_lock *lock);
+
+void bed_lock_destroy(bed_lock *lock);
+
+void bed_lock_obtain(bed_lock *lock);
+
+void bed_lock_release(bed_lock *lock);
+
+bed_status bed_lock_enable_statistics(bed_lock *lock, bool enable);
+
+bed_status bed_lock_get_statistics(
+	bed_lock *lock,
+	bed_lock_statistics *statistics
+);
+
+/**
+ * @brief Gives other tasks the chance to run while a task polls a device.
+ */
+void bed_lock_yield(void);
+
+/**
+ * @brief Condition to wait for with an owned lock.
+ */
+typedef struct {
+#ifdef __rtems__
+	uint32_t id;
+#else /* __rtems__ */
+	pthread_cond_t cond;
+#endif /* __rtems__ */
+} bed_condition;
+
+bed_status bed_condition_initialize(bed_condition *cond);
+
+void bed_condition_destroy(bed_condition *cond);
+
+/**
+ * @brief Releases the lock, waits for a broadcast and obtains the lock again.
+ *
+ * The lock must be obtained exactly once by the caller.  The wait may end
+ * spuriously, so the caller must check its predicate in a loop.
+ */
+void bed_condition_wait(bed_condition *cond, bed_lock *lock);
+
+void bed_condition_broadcast(bed_condition *cond);
+
 /** @} */ 
 
+/**
+ * @defgroup BEDImplCompress BED Compressed Image Format
+ *
+ * @ingroup BEDImpl
+ *
+ * Image header: magic, image size, payload size, image CRC-32, header CRC-32
+ * of the previous 16 bytes.
+ *
+ * Frame header: uncompressed frame size, stored frame size (16-bit each).
+ * The #BED_COMPRESS_FRAME_RAW flag in the stored size indicates a raw frame.
+ *
+ * Sequence of a compressed frame: token, literal length bytes, literals,
+ * match offset (16-bit), match length bytes.  The upper token nibble is the
+ * literal length, the lower nibble is the match length minus
+ * #BED_COMPRESS_MIN_MATCH.  A nibble value of 15 is continued by length
+ * bytes until a byte less than 255.  The last sequence of a frame ends after
+ * its literals.
+ *
+ * @{
+ */
+
+#define BED_COMPRESS_MAGIC 0x5a444542
+
+#define BED_COMPRESS_FRAME_HEADER_SIZE 4
+
+#define BED_COMPRESS_FRAME_RAW 0x8000
+
+#define BED_COMPRESS_MIN_MATCH 4
+
+/** @} */
+
+/**
+ * @brief Lets other tasks use the device between the blocks of a
+ * long-running operation.
+ */
+static inline void bed_preempt(bed_device *bed)
+{
+	(*bed->release)(bed);
+	bed_lock_yield();
+	(*bed->obtain)(bed);
+}
+
+static inline bool bed_is_cursor_valid(
+	const bed_partition *part,
+	const bed_cursor *cursor
+)
+{
+	return cursor->position <= part->size
+		&& (cursor->position & bed_block_mask(part)) == 0;
+}
+
+/**
+ * @brief Advances the cursor of a long-running operation.
+ *
+ * @retval true The progress function requested a stop.
+ * @retval false Otherwise.
+ */
+static inline bool bed_cursor_advance(
+	bed_cursor *cursor,
+	bed_address position,
+	bed_address size
+)
+{
+	cursor->position = position;
+
+	return cursor->progress != NULL
+		&& (*cursor->progress)(cursor->progress_arg, position, size);
+}
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
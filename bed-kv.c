@@ -0,0 +1,1045 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-kv.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INVALID_PAGE UINT32_MAX
+
+/*
+ * The metadata consists of the sequence number, the key, the value size
+ * (two bytes), the flags, a reserved byte and a CRC-32 of the previous
+ * twelve bytes.  Words are little endian.
+ */
+#define METADATA_SIZE 16
+
+#define FLAG_TOMBSTONE 0x1
+
+/*
+ * The record was relocated despite an uncorrectable ECC error.
+ */
+#define FLAG_LOST 0x2
+
+#define RESERVED 0xff
+
+typedef enum {
+	BLOCK_FREE,
+	BLOCK_OPEN,
+	BLOCK_CLOSED,
+	BLOCK_RETIRED,
+	BLOCK_BAD
+} block_state;
+
+typedef struct {
+	uint32_t live;
+
+	/*
+	 * Sequence number of the first record.  The sequence numbers increase
+	 * within a block.
+	 */
+	uint32_t sequence;
+
+	uint8_t state;
+	bool erased;
+} block_info;
+
+/*
+ * An entry with an invalid page is an empty slot.
+ */
+typedef struct {
+	uint32_t key;
+	uint32_t page;
+	uint32_t sequence;
+	uint16_t size;
+	uint8_t flags;
+} index_entry;
+
+typedef struct {
+	uint32_t key;
+	uint32_t sequence;
+	uint16_t size;
+	uint8_t flags;
+} record;
+
+struct bed_kv {
+	bed_lock lock;
+	bed_partition part;
+	bed_kv_config config;
+	uint16_t page_size;
+	uint32_t pages_per_block;
+	uint32_t block_count;
+	uint32_t free_block_count;
+	uint32_t next_free_block;
+	uint32_t sequence;
+	uint32_t head_block;
+	uint32_t head_page;
+	bool head_open;
+	uint32_t entry_count;
+	uint32_t tombstone_count;
+	uint32_t index_mask;
+	index_entry *index;
+	block_info *blocks;
+	uint8_t *page_buffer;
+	bed_kv_statistics statistics;
+};
+
+static void encode_metadata(uint8_t *metadata, const record *rec)
+{
+	bed_put_le32(metadata, rec->sequence);
+	bed_put_le32(metadata + 4, rec->key);
+	metadata [8] = (uint8_t) rec->size;
+	metadata [9] = (uint8_t) (rec->size >> 8);
+	metadata [10] = rec->flags;
+	metadata [11] = RESERVED;
+	bed_put_le32(metadata + 12, bed_crc32(0, metadata, 12));
+}
+
+static bool decode_metadata(const uint8_t *metadata, record *rec)
+{
+	rec->sequence = bed_get_le32(metadata);
+	rec->key = bed_get_le32(metadata + 4);
+	rec->size = (uint16_t) (metadata [8] | (metadata [9] << 8));
+	rec->flags = metadata [10];
+
+	return bed_get_le32(metadata + 12) == bed_crc32(0, metadata, 12);
+}
+
+static bed_address page_to_address(const bed_kv *kv, uint32_t page)
+{
+	return (bed_address) page * kv->page_size;
+}
+
+static bed_address block_to_address(const bed_kv *kv, uint32_t block)
+{
+	return page_to_address(kv, block * kv->pages_per_block);
+}
+
+static uint32_t hash(const bed_kv *kv, uint32_t key)
+{
+	return (key * UINT32_C(0x9e3779b1)) & kv->index_mask;
+}
+
+/*
+ * Returns the entry of the key or the empty slot for it.  The index has
+ * always empty slots.
+ */
+static index_entry *find_slot(bed_kv *kv, uint32_t key)
+{
+	uint32_t i = hash(kv, key);
+
+	while (kv->index [i].page != INVALID_PAGE && kv->index [i].key != key) {
+		i = (i + 1) & kv->index_mask;
+	}
+
+	return &kv->index [i];
+}
+
+static index_entry *lookup(bed_kv *kv, uint32_t key)
+{
+	index_entry *entry = find_slot(kv, key);
+
+	return entry->page != INVALID_PAGE ? entry : NULL;
+}
+
+static void get_record(const index_entry *entry, record *rec)
+{
+	rec->key = entry->key;
+	rec->sequence = entry->sequence;
+	rec->size = entry->size;
+	rec->flags = entry->flags;
+}
+
+/*
+ * This is a linear search.  Use it only in case the metadata of a record is
+ * unreadable.
+ */
+static index_entry *find_by_page(bed_kv *kv, uint32_t page, record *rec)
+{
+	index_entry *entry = NULL;
+	uint32_t i;
+
+	for (i = 0; i <= kv->index_mask && entry == NULL; ++i) {
+		if (kv->index [i].page == page) {
+			entry = &kv->index [i];
+			get_record(entry, rec);
+		}
+	}
+
+	return entry;
+}
+
+/*
+ * Linear probing with backward shift deletion, so no deleted slot markers
+ * are necessary.
+ */
+static void remove_entry(bed_kv *kv, index_entry *entry)
+{
+	uint32_t hole = (uint32_t) (entry - kv->index);
+	uint32_t i = hole;
+
+	if ((entry->flags & FLAG_TOMBSTONE) != 0) {
+		--kv->tombstone_count;
+	}
+
+	--kv->entry_count;
+
+	while (true) {
+		uint32_t home;
+
+		i = (i + 1) & kv->index_mask;
+
+		if (kv->index [i].page == INVALID_PAGE) {
+			break;
+		}
+
+		home = hash(kv, kv->index [i].key);
+
+		if (((i - home) & kv->index_mask) >= ((i - hole) & kv->index_mask)) {
+			kv->index [hole] = kv->index [i];
+			hole = i;
+		}
+	}
+
+	kv->index [hole].page = INVALID_PAGE;
+}
+
+static void set_entry(
+	bed_kv *kv,
+	index_entry *entry,
+	uint32_t page,
+	const record *rec
+)
+{
+	if (entry->page == INVALID_PAGE) {
+		++kv->entry_count;
+	} else if ((entry->flags & FLAG_TOMBSTONE) != 0) {
+		--kv->tombstone_count;
+	}
+
+	if ((rec->flags & FLAG_TOMBSTONE) != 0) {
+		++kv->tombstone_count;
+	}
+
+	entry->key = rec->key;
+	entry->page = page;
+	entry->sequence = rec->sequence;
+	entry->size = rec->size;
+	entry->flags = rec->flags;
+}
+
+static void free_block(bed_kv *kv, uint32_t block)
+{
+	block_info *info = &kv->blocks [block];
+
+	if (info->state == BLOCK_RETIRED) {
+		bed_mark_block_bad(&kv->part, block_to_address(kv, block));
+		info->state = BLOCK_BAD;
+	} else {
+		info->state = BLOCK_FREE;
+		++kv->free_block_count;
+	}
+}
+
+static void invalidate(bed_kv *kv, uint32_t page)
+{
+	uint32_t block = page / kv->pages_per_block;
+	block_info *info = &kv->blocks [block];
+
+	--info->live;
+
+	if (
+		info->live == 0
+			&& (info->state == BLOCK_CLOSED || info->state == BLOCK_RETIRED)
+	) {
+		free_block(kv, block);
+	}
+}
+
+static void close_head(bed_kv *kv, block_state state)
+{
+	block_info *info = &kv->blocks [kv->head_block];
+
+	kv->head_open = false;
+	info->state = state;
+
+	if (info->live == 0) {
+		free_block(kv, kv->head_block);
+	}
+}
+
+/*
+ * The free blocks are taken round-robin to spread the erases.
+ */
+static bed_status open_head(bed_kv *kv)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+
+	while (status != BED_SUCCESS && kv->free_block_count > 0) {
+		uint32_t block = kv->next_free_block;
+		block_info *info = &kv->blocks [block];
+
+		kv->next_free_block = (block + 1) % kv->block_count;
+
+		if (info->state == BLOCK_FREE) {
+			if (info->erased) {
+				status = BED_SUCCESS;
+			} else {
+				status = bed_erase(
+					&kv->part,
+					block_to_address(kv, block),
+					BED_ERASE_MARK_BAD_ON_ERROR
+				);
+				++kv->statistics.block_erases;
+			}
+
+			if (status == BED_SUCCESS) {
+				--kv->free_block_count;
+				info->state = BLOCK_OPEN;
+				info->live = 0;
+				info->erased = false;
+				kv->head_block = block;
+				kv->head_page = 0;
+				kv->head_open = true;
+			} else if (bed_is_system_error(status)) {
+				break;
+			} else {
+				--kv->free_block_count;
+				info->state = BLOCK_BAD;
+				status = BED_ERROR_UNSATISFIED;
+			}
+		}
+	}
+
+	return status;
+}
+
+static bed_status compact(bed_kv *kv);
+
+/*
+ * In case of a write error, the block is retired and the record is appended
+ * to the next block.  The compaction appends records without a compaction of
+ * its own.
+ */
+static bed_status append(
+	bed_kv *kv,
+	record *rec,
+	const void *data,
+	bool may_compact,
+	uint32_t *page
+)
+{
+	bed_status status = BED_SUCCESS;
+	bool done = false;
+
+	while (!done && status == BED_SUCCESS) {
+		while (
+			may_compact
+				&& !kv->head_open
+				&& kv->free_block_count <= 1
+				&& status == BED_SUCCESS
+		) {
+			status = compact(kv);
+		}
+
+		if (status == BED_SUCCESS && !kv->head_open) {
+			status = open_head(kv);
+		}
+
+		if (status == BED_SUCCESS) {
+			block_info *info = &kv->blocks [kv->head_block];
+			uint8_t metadata [METADATA_SIZE];
+			const bed_oob_request oob = {
+				.mode = BED_OOB_MODE_AUTO,
+				.offset = 0,
+				.size = METADATA_SIZE,
+				.data = metadata
+			};
+
+			*page = kv->head_block * kv->pages_per_block + kv->head_page;
+			rec->sequence = kv->sequence;
+			++kv->sequence;
+
+			if (kv->head_page == 0) {
+				info->sequence = rec->sequence;
+			}
+
+			++kv->head_page;
+			encode_metadata(metadata, rec);
+
+			if (data != kv->page_buffer) {
+				memset(kv->page_buffer, 0xff, kv->page_size);
+
+				if (rec->size > 0) {
+					memcpy(kv->page_buffer, data, rec->size);
+				}
+			}
+
+			status = bed_write_oob(
+				&kv->part,
+				page_to_address(kv, *page),
+				kv->page_buffer,
+				kv->page_size,
+				&oob
+			);
+			++kv->statistics.page_writes;
+
+			if (status == BED_SUCCESS) {
+				++info->live;
+				done = true;
+
+				if (kv->head_page == kv->pages_per_block) {
+					close_head(kv, BLOCK_CLOSED);
+				}
+			} else if (status == BED_ERROR_WRITE) {
+				close_head(kv, BLOCK_RETIRED);
+				status = BED_SUCCESS;
+			}
+		}
+	}
+
+	return status;
+}
+
+/*
+ * Retired blocks are compacted first.  Blocks with only live records are not
+ * worth a compaction.
+ */
+static uint32_t select_victim(const bed_kv *kv)
+{
+	uint32_t victim = UINT32_MAX;
+	uint32_t block;
+
+	for (block = 0; block < kv->block_count; ++block) {
+		const block_info *info = &kv->blocks [block];
+
+		if (info->state == BLOCK_RETIRED) {
+			victim = block;
+			break;
+		} else if (
+			info->state == BLOCK_CLOSED
+				&& info->live < kv->pages_per_block
+				&& (victim == UINT32_MAX || info->live < kv->blocks [victim].live)
+		) {
+			victim = block;
+		}
+	}
+
+	return victim;
+}
+
+/*
+ * Older records of the key may exist in written blocks with an older first
+ * record.  The victim is erased after the compaction.
+ */
+static bool may_drop_tombstone(
+	const bed_kv *kv,
+	uint32_t victim,
+	uint32_t sequence
+)
+{
+	bool drop = true;
+	uint32_t block;
+
+	for (block = 0; block < kv->block_count && drop; ++block) {
+		const block_info *info = &kv->blocks [block];
+
+		drop = block == victim
+			|| info->state == BLOCK_BAD
+			|| info->erased
+			|| info->sequence > sequence;
+	}
+
+	return drop;
+}
+
+static bed_status relocate(bed_kv *kv, uint32_t victim)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t page = victim * kv->pages_per_block;
+	uint32_t end = page + kv->pages_per_block;
+	uint8_t metadata [METADATA_SIZE];
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = METADATA_SIZE,
+		.data = metadata
+	};
+
+	while (
+		page != end
+			&& kv->blocks [victim].live > 0
+			&& status == BED_SUCCESS
+	) {
+		index_entry *entry = NULL;
+		record rec;
+
+		status = bed_read_oob(
+			&kv->part,
+			page_to_address(kv, page),
+			NULL,
+			0,
+			&oob
+		);
+
+		if (status == BED_ERROR_ECC_FIXED) {
+			status = BED_SUCCESS;
+		}
+
+		if (status == BED_SUCCESS && decode_metadata(metadata, &rec)) {
+			entry = lookup(kv, rec.key);
+		} else if (!bed_is_system_error(status)) {
+			entry = find_by_page(kv, page, &rec);
+			status = BED_SUCCESS;
+		}
+
+		if (entry != NULL && entry->page == page) {
+			if (
+				(entry->flags & FLAG_TOMBSTONE) != 0
+					&& may_drop_tombstone(kv, victim, entry->sequence)
+			) {
+				remove_entry(kv, entry);
+				invalidate(kv, page);
+				++kv->statistics.dropped_tombstones;
+			} else {
+				uint32_t new_page;
+
+				status = bed_read(
+					&kv->part,
+					page_to_address(kv, page),
+					kv->page_buffer,
+					kv->page_size
+				);
+
+				/*
+				 * Relocate uncorrectable records nonetheless, since the block
+				 * must be freed.  They are marked as lost, so that reads fail
+				 * until the key is written again.
+				 */
+				if (status == BED_ERROR_ECC_FIXED) {
+					status = BED_SUCCESS;
+				} else if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+					rec.flags |= FLAG_LOST;
+					status = BED_SUCCESS;
+				}
+
+				if (status == BED_SUCCESS) {
+					status = append(kv, &rec, kv->page_buffer, false, &new_page);
+					++kv->statistics.compaction_page_writes;
+				}
+
+				if (status == BED_SUCCESS) {
+					entry = find_slot(kv, rec.key);
+					set_entry(kv, entry, new_page, &rec);
+					invalidate(kv, page);
+				}
+			}
+		}
+
+		++page;
+	}
+
+	return status;
+}
+
+static bed_status compact(bed_kv *kv)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t victim = select_victim(kv);
+
+	if (victim != UINT32_MAX) {
+		block_info *info = &kv->blocks [victim];
+
+		++kv->statistics.compacted_blocks;
+		status = relocate(kv, victim);
+
+		if (status == BED_SUCCESS && info->state == BLOCK_FREE) {
+			status = bed_erase(
+				&kv->part,
+				block_to_address(kv, victim),
+				BED_ERASE_MARK_BAD_ON_ERROR
+			);
+			++kv->statistics.block_erases;
+
+			if (status == BED_SUCCESS) {
+				info->erased = true;
+			} else if (!bed_is_system_error(status)) {
+				--kv->free_block_count;
+				info->state = BLOCK_BAD;
+				status = BED_SUCCESS;
+			}
+		}
+	}
+
+	return status;
+}
+
+static bed_status add_record(bed_kv *kv, uint32_t page, const record *rec)
+{
+	bed_status status = BED_SUCCESS;
+	index_entry *entry = find_slot(kv, rec->key);
+
+	if (entry->page == INVALID_PAGE || rec->sequence > entry->sequence) {
+		if (entry->page != INVALID_PAGE) {
+			--kv->blocks [entry->page / kv->pages_per_block].live;
+		} else if (kv->entry_count == kv->config.max_keys) {
+			status = BED_ERROR_UNSATISFIED;
+		}
+
+		if (status == BED_SUCCESS) {
+			set_entry(kv, entry, page, rec);
+			++kv->blocks [page / kv->pages_per_block].live;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * The ignored page is treated as an unreadable page except for the sequence
+ * numbers.
+ */
+static bed_status scan(bed_kv *kv, uint32_t ignored_page, uint32_t *newest_page)
+{
+	bed_status status = BED_SUCCESS;
+	uint8_t metadata [METADATA_SIZE];
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = METADATA_SIZE,
+		.data = metadata
+	};
+	uint32_t newest_sequence = 0;
+	uint32_t block;
+
+	*newest_page = INVALID_PAGE;
+	kv->free_block_count = 0;
+	kv->entry_count = 0;
+	kv->tombstone_count = 0;
+	kv->head_open = false;
+	memset(kv->index, 0xff, (kv->index_mask + 1) * sizeof(kv->index [0]));
+	memset(kv->blocks, 0, kv->block_count * sizeof(kv->blocks [0]));
+
+	for (block = 0; block < kv->block_count && status == BED_SUCCESS; ++block) {
+		block_info *info = &kv->blocks [block];
+		uint32_t page = block * kv->pages_per_block;
+		uint32_t end = page + kv->pages_per_block;
+
+		info->state = BLOCK_FREE;
+		info->erased = true;
+		status = bed_is_block_valid(&kv->part, page_to_address(kv, page));
+
+		if (status == BED_ERROR_BLOCK_IS_BAD) {
+			info->state = BLOCK_BAD;
+			status = BED_SUCCESS;
+			page = end;
+		}
+
+		while (page != end && status == BED_SUCCESS) {
+			status = bed_read_oob(
+				&kv->part,
+				page_to_address(kv, page),
+				NULL,
+				0,
+				&oob
+			);
+
+			if (status == BED_SUCCESS && bed_is_erased(metadata, METADATA_SIZE)) {
+				break;
+			} else if (
+				status == BED_SUCCESS
+					|| status == BED_ERROR_ECC_FIXED
+					|| status == BED_ERROR_ECC_UNCORRECTABLE
+			) {
+				record rec;
+
+				if (info->erased) {
+					info->erased = false;
+					info->state = BLOCK_CLOSED;
+					info->sequence = UINT32_MAX;
+				}
+
+				if (
+					status != BED_ERROR_ECC_UNCORRECTABLE
+						&& decode_metadata(metadata, &rec)
+						&& rec.size <= kv->page_size
+				) {
+					if (rec.sequence < info->sequence) {
+						info->sequence = rec.sequence;
+					}
+
+					if (*newest_page == INVALID_PAGE || rec.sequence >= newest_sequence) {
+						*newest_page = page;
+						newest_sequence = rec.sequence;
+					}
+
+					if (page != ignored_page) {
+						status = add_record(kv, page, &rec);
+					}
+				}
+
+				if (status != BED_ERROR_UNSATISFIED) {
+					status = BED_SUCCESS;
+				}
+			}
+
+			++page;
+		}
+	}
+
+	if (status == BED_SUCCESS) {
+		for (block = 0; block < kv->block_count; ++block) {
+			block_info *info = &kv->blocks [block];
+
+			if (info->state == BLOCK_CLOSED && info->live == 0) {
+				info->state = BLOCK_FREE;
+			}
+
+			if (info->state == BLOCK_FREE) {
+				++kv->free_block_count;
+			}
+		}
+
+		kv->sequence = *newest_page != INVALID_PAGE ? newest_sequence + 1 : 0;
+	}
+
+	return status;
+}
+
+/*
+ * Appends a copy of the current record of the key or a tombstone, so that
+ * the broken record is not taken at the next creation once it is no longer
+ * the newest record.
+ */
+static bed_status supersede(bed_kv *kv, uint32_t broken_page)
+{
+	uint8_t metadata [METADATA_SIZE];
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = METADATA_SIZE,
+		.data = metadata
+	};
+	bed_status status = bed_read_oob(
+		&kv->part,
+		page_to_address(kv, broken_page),
+		NULL,
+		0,
+		&oob
+	);
+	record rec;
+
+	if (status == BED_ERROR_ECC_FIXED) {
+		status = BED_SUCCESS;
+	}
+
+	if (status == BED_SUCCESS && decode_metadata(metadata, &rec)) {
+		index_entry *entry = lookup(kv, rec.key);
+		uint32_t page;
+
+		memset(kv->page_buffer, 0xff, kv->page_size);
+
+		if (entry != NULL) {
+			get_record(entry, &rec);
+
+			if ((rec.flags & FLAG_TOMBSTONE) == 0) {
+				status = bed_read(
+					&kv->part,
+					page_to_address(kv, entry->page),
+					kv->page_buffer,
+					kv->page_size
+				);
+
+				if (status == BED_ERROR_ECC_FIXED) {
+					status = BED_SUCCESS;
+				} else if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+					rec.flags |= FLAG_LOST;
+					status = BED_SUCCESS;
+				}
+			}
+		} else if (kv->entry_count < kv->config.max_keys) {
+			rec.size = 0;
+			rec.flags = FLAG_TOMBSTONE;
+		} else {
+			status = BED_ERROR_UNSATISFIED;
+		}
+
+		if (status == BED_SUCCESS) {
+			status = append(kv, &rec, kv->page_buffer, false, &page);
+		}
+
+		if (status == BED_SUCCESS) {
+			entry = find_slot(kv, rec.key);
+
+			if (entry->page != INVALID_PAGE) {
+				invalidate(kv, entry->page);
+			}
+
+			set_entry(kv, entry, page, &rec);
+		} else if (status == BED_ERROR_READ_ONLY) {
+			status = BED_SUCCESS;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * Only the last record written before a power cut may be incomplete.  In
+ * this case, scan again and ignore this record.
+ */
+static bed_status recover(bed_kv *kv)
+{
+	uint32_t newest_page;
+	bed_status status = scan(kv, INVALID_PAGE, &newest_page);
+
+	if (status == BED_SUCCESS && newest_page != INVALID_PAGE) {
+		status = bed_read(
+			&kv->part,
+			page_to_address(kv, newest_page),
+			kv->page_buffer,
+			kv->page_size
+		);
+
+		if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+			uint32_t ignored_page = newest_page;
+
+			status = scan(kv, ignored_page, &newest_page);
+
+			if (status == BED_SUCCESS) {
+				status = supersede(kv, ignored_page);
+			}
+		} else if (status == BED_ERROR_ECC_FIXED) {
+			status = BED_SUCCESS;
+		}
+	}
+
+	return status;
+}
+
+bed_status bed_kv_create(
+	const bed_partition *part,
+	const bed_kv_config *config,
+	bed_kv **kv_ptr
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_kv *kv = NULL;
+	uint16_t page_size = bed_page_size(part);
+	uint32_t pages_per_block = bed_block_size(part) / page_size;
+	uint32_t block_count = (uint32_t) bed_address_to_block(part, bed_size(part));
+	uint32_t index_size = 2;
+
+	while (index_size <= config->max_keys && index_size < UINT32_MAX / 4) {
+		index_size *= 2;
+	}
+
+	if (
+		config->max_keys > 0
+			&& block_count > 2
+			&& config->max_keys <= (block_count - 2) * pages_per_block
+			&& bed_oob_free_size(part) >= METADATA_SIZE
+	) {
+		kv = malloc(
+			sizeof(*kv)
+				+ index_size * sizeof(kv->index [0])
+				+ block_count * sizeof(kv->blocks [0])
+				+ page_size
+		);
+
+		if (kv != NULL) {
+			uint8_t *chunk = (uint8_t *) (kv + 1);
+
+			memset(kv, 0, sizeof(*kv));
+			kv->part = *part;
+			kv->config = *config;
+			kv->page_size = page_size;
+			kv->pages_per_block = pages_per_block;
+			kv->block_count = block_count;
+			kv->index_mask = index_size - 1;
+			kv->index = (index_entry *) chunk;
+			chunk += index_size * sizeof(kv->index [0]);
+			kv->blocks = (block_info *) chunk;
+			chunk += block_count * sizeof(kv->blocks [0]);
+			kv->page_buffer = chunk;
+
+			status = recover(kv);
+
+			if (status == BED_SUCCESS) {
+				status = bed_lock_initialize(&kv->lock);
+			}
+
+			if (status != BED_SUCCESS) {
+				free(kv);
+				kv = NULL;
+			}
+		} else {
+			status = BED_ERROR_SYSTEM;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	*kv_ptr = kv;
+
+	return status;
+}
+
+void bed_kv_destroy(bed_kv *kv)
+{
+	bed_lock_destroy(&kv->lock);
+	free(kv);
+}
+
+size_t bed_kv_max_value_size(const bed_kv *kv)
+{
+	return kv->page_size;
+}
+
+static bed_status store(bed_kv *kv, record *rec, const void *data)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t page;
+
+	if (lookup(kv, rec->key) == NULL && kv->entry_count == kv->config.max_keys) {
+		status = BED_ERROR_UNSATISFIED;
+	}
+
+	if (status == BED_SUCCESS) {
+		status = append(kv, rec, data, true, &page);
+	}
+
+	/*
+	 * The compaction may move the entries, so look up the key again.
+	 */
+	if (status == BED_SUCCESS) {
+		index_entry *entry = find_slot(kv, rec->key);
+
+		if (entry->page != INVALID_PAGE) {
+			invalidate(kv, entry->page);
+		}
+
+		set_entry(kv, entry, page, rec);
+	}
+
+	return status;
+}
+
+bed_status bed_kv_put(
+	bed_kv *kv,
+	uint32_t key,
+	const void *data,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (n <= kv->page_size) {
+		record rec = {
+			.key = key,
+			.sequence = 0,
+			.size = (uint16_t) n,
+			.flags = 0
+		};
+
+		bed_lock_obtain(&kv->lock);
+		status = store(kv, &rec, data);
+		bed_lock_release(&kv->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+bed_status bed_kv_get(
+	bed_kv *kv,
+	uint32_t key,
+	void *data,
+	size_t size,
+	size_t *n
+)
+{
+	bed_status status = BED_SUCCESS;
+	index_entry *entry;
+
+	*n = 0;
+
+	bed_lock_obtain(&kv->lock);
+
+	entry = lookup(kv, key);
+
+	if (entry != NULL && (entry->flags & FLAG_LOST) != 0) {
+		status = BED_ERROR_ECC_UNCORRECTABLE;
+	} else if (entry != NULL && (entry->flags & FLAG_TOMBSTONE) == 0) {
+		status = bed_read(
+			&kv->part,
+			page_to_address(kv, entry->page),
+			kv->page_buffer,
+			kv->page_size
+		);
+
+		if (status == BED_ERROR_ECC_FIXED) {
+			status = BED_SUCCESS;
+		}
+
+		if (status == BED_SUCCESS) {
+			*n = entry->size;
+			memcpy(data, kv->page_buffer, size < *n ? size : *n);
+		}
+	} else {
+		status = BED_ERROR_UNSATISFIED;
+	}
+
+	bed_lock_release(&kv->lock);
+
+	return status;
+}
+
+bed_status bed_kv_delete(bed_kv *kv, uint32_t key)
+{
+	bed_status status = BED_SUCCESS;
+	index_entry *entry;
+
+	bed_lock_obtain(&kv->lock);
+
+	entry = lookup(kv, key);
+
+	if (entry != NULL && (entry->flags & FLAG_TOMBSTONE) == 0) {
+		record rec = {
+			.key = key,
+			.sequence = 0,
+			.size = 0,
+			.flags = FLAG_TOMBSTONE
+		};
+
+		status = store(kv, &rec, NULL);
+	}
+
+	bed_lock_release(&kv->lock);
+
+	return status;
+}
+
+void bed_kv_get_statistics(bed_kv *kv, bed_kv_statistics *statistics)
+{
+	bed_lock_obtain(&kv->lock);
+	*statistics = kv->statistics;
+	statistics->key_count = kv->entry_count - kv->tombstone_count;
+	statistics->tombstone_count = kv->tombstone_count;
+	statistics->free_blocks = kv->free_block_count;
+	bed_lock_release(&kv->lock);
+}
@@ -0,0 +1,215 @@
+/**
+ * @file
+ *
+ * @ingroup BEDKV
+ *
+ * @brief BED Key-Value Store API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_KV_H
+#define BED_KV_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDKV BED Key-Value Store
+ *
+ * @ingroup BED
+ *
+ * @brief Stores small values like configuration and calibration data under
+ * numeric keys.
+ *
+ * The store is log-structured.  Each record occupies one page and is
+ * appended to the open block.  The key, the value size, a delete flag and a
+ * sequence number of the record are stored in the free out-of-bounds (OOB)
+ * area (#BED_OOB_MODE_AUTO mode, 16 bytes protected by a CRC).  A hash index
+ * in RAM maps each key to its newest record, so apart from the compaction a
+ * put, get or delete costs one index lookup and at most one page operation.
+ * A delete appends a record with the delete flag (tombstone).
+ *
+ * Once the count of free blocks drops to one, the block with the least count
+ * of live records is compacted.  Its live records are appended again and the
+ * block is erased.  A tombstone is dropped during the compaction in case no
+ * other block with older records exists.  Records with uncorrectable ECC
+ * errors are appended again with a lost flag, gets of them fail until the
+ * key is written again.
+ *
+ * On creation the index is rebuilt from the OOB areas only.  Pages are
+ * written in order, so the scan of a block stops at its first erased page.
+ * Only the record written last before a power cut may be incompletely
+ * programmed, so the data of the record with the highest sequence number is
+ * verified by its ECC.  Blocks written before the creation are not written
+ * further.  A partition must be erased before its first use with the store,
+ * e.g. with bed_erase_all().
+ *
+ * Operations are complete once the function returns.  The store may be used
+ * concurrently.
+ *
+ * @{
+ */
+
+typedef struct {
+	/**
+	 * @brief Maximum count of keys including the deleted keys with a
+	 * tombstone.
+	 *
+	 * The index size depends on this value.  All keys must fit into the
+	 * partition without two of its blocks.
+	 */
+	uint32_t max_keys;
+} bed_kv_config;
+
+typedef struct {
+	/**
+	 * @brief Count of keys with a value.
+	 */
+	uint32_t key_count;
+
+	/**
+	 * @brief Count of deleted keys with a tombstone.
+	 */
+	uint32_t tombstone_count;
+
+	uint32_t free_blocks;
+
+	/**
+	 * @brief Count of page writes including the compaction writes.
+	 */
+	uint64_t page_writes;
+
+	/**
+	 * @brief Count of page writes of the compaction.
+	 */
+	uint64_t compaction_page_writes;
+
+	/**
+	 * @brief Count of blocks compacted.
+	 */
+	uint32_t compacted_blocks;
+
+	uint32_t dropped_tombstones;
+
+	uint32_t block_erases;
+} bed_kv_statistics;
+
+typedef struct bed_kv bed_kv;
+
+/**
+ * @brief Creates a key-value store for a partition.
+ *
+ * Rebuilds the index from the OOB areas of the partition.
+ *
+ * @param[in] part The partition.
+ * @param[in] config The store configuration.
+ * @param[out] kv The store.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid configuration for this
+ * partition.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ * @retval BED_ERROR_UNSATISFIED The partition contains more keys than
+ * configured.
+ * @retval other The scan of the OOB areas failed.
+ */
+bed_status bed_kv_create(
+	const bed_partition *part,
+	const bed_kv_config *config,
+	bed_kv **kv
+);
+
+/**
+ * @brief Destroys a key-value store.
+ *
+ * The data on the partition is not affected.
+ */
+void bed_kv_destroy(bed_kv *kv);
+
+/**
+ * @brief Returns the maximum value size in bytes.
+ *
+ * This is the page size.
+ */
+size_t bed_kv_max_value_size(const bed_kv *kv);
+
+/**
+ * @brief Stores a value.
+ *
+ * @param[in] kv The store.
+ * @param[in] key The key.
+ * @param[in] data The value.
+ * @param[in] n The value size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS The value is too large.
+ * @retval BED_ERROR_UNSATISFIED The index or the partition is full.
+ * @retval other The write failed.
+ */
+bed_status bed_kv_put(
+	bed_kv *kv,
+	uint32_t key,
+	const void *data,
+	size_t n
+);
+
+/**
+ * @brief Gets a value.
+ *
+ * @param[in] kv The store.
+ * @param[in] key The key.
+ * @param[out] data The value.  Only the first @a size bytes are returned.
+ * @param[in] size The size of the value buffer.
+ * @param[out] n The value size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED The key has no value.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE Uncorrectable ECC error.
+ */
+bed_status bed_kv_get(
+	bed_kv *kv,
+	uint32_t key,
+	void *data,
+	size_t size,
+	size_t *n
+);
+
+/**
+ * @brief Deletes a value.
+ *
+ * Deleting a key without a value is no error.
+ *
+ * @param[in] kv The store.
+ * @param[in] key The key.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED The partition is full.
+ * @retval other The write failed.
+ */
+bed_status bed_kv_delete(bed_kv *kv, uint32_t key);
+
+void bed_kv_get_statistics(bed_kv *kv, bed_kv_statistics *statistics);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_KV_H */
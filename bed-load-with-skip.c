@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-impl.h"
+
+static bed_status load_page(
+	bed_device *bed,
+	bed_address page,
+	uint8_t *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (n == bed->page_size) {
+		if (oob->data != NULL) {
+			status = (*bed->read_oob)(bed, page, data, n, oob);
+		} else {
+			status = (*bed->read)(bed, page, data, n);
+		}
+	} else {
+		if (oob->data != NULL) {
+			status = (*bed->read_oob)(bed, page, NULL, 0, oob);
+		}
+
+		if (status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED) {
+			bed_status partial_status =
+				(*bed->read_partial)(bed, page, 0, data, n);
+
+			if (partial_status != BED_SUCCESS) {
+				status = partial_status;
+			}
+		}
+	}
+
+	return status;
+}
+
+static bed_status load_with_skip(
+	bed_device *bed,
+	const bed_partition *part,
+	uint8_t *dest,
+	size_t max_len,
+	size_t *n,
+	bed_read_process process,
+	void *process_arg,
+	void *oob_buffer
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_address area_end = part->begin + part->size;
+	uint32_t block_size = bed->block_size;
+	uint16_t page_size = bed->page_size;
+	uint16_t oob_size = oob_buffer != NULL ? bed->oob_free_size : 0;
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = oob_size,
+		.data = oob_buffer
+	};
+	bed_address block = part->begin;
+	size_t loaded = 0;
+
+	while (status == BED_SUCCESS && block != area_end && loaded != max_len) {
+		bed_address next_block = block + block_size;
+
+		status = (*bed->is_block_valid)(bed, block);
+		if (status == BED_ERROR_OP_NOT_SUPPORTED) {
+			status = BED_SUCCESS;
+		}
+		if (status == BED_SUCCESS) {
+			bed_address page;
+
+			for (
+				page = block;
+				status == BED_SUCCESS && page != next_block && loaded != max_len;
+				page += page_size
+			) {
+				size_t r = max_len - loaded;
+				size_t m = r < page_size ? r : page_size;
+				uint8_t *data = dest + loaded;
+
+				status = load_page(bed, page, data, m, &oob);
+				if (status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED) {
+					bool done = false;
+
+					loaded += m;
+
+					if (process != NULL) {
+						done = (*process)(
+							process_arg,
+							page,
+							data,
+							m,
+							oob_buffer,
+							oob_size
+						);
+					}
+
+					status = done ? BED_ERROR_STOPPED : BED_SUCCESS;
+				}
+			}
+		} else {
+			status = BED_SUCCESS;
+		}
+
+		if (status == BED_SUCCESS) {
+			block = next_block;
+
+			if (block != area_end && loaded != max_len) {
+				bed_preempt(bed);
+			}
+		}
+	}
+
+	*n = loaded;
+
+	return status;
+}
+
+bed_status bed_load_with_skip(
+	const bed_partition *part,
+	void *dest,
+	size_t max_len,
+	size_t *n,
+	bed_read_process process,
+	void *process_arg,
+	void *oob_buffer
+)
+{
+	bed_device *bed = part->bed;
+	bed_status status;
+
+	(*bed->obtain)(bed);
+	status = load_with_skip(
+		bed,
+		part,
+		dest,
+		max_len,
+		n,
+		process,
+		process_arg,
+		oob_buffer
+	);
+	(*bed->release)(bed);
+
+	return status;
+}
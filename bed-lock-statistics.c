@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-impl.h"
+
+bed_status bed_enable_lock_statistics(const bed_partition *part, bool enable)
+{
+	bed_status status = BED_ERROR_OP_NOT_SUPPORTED;
+	bed_device *bed = part->bed;
+
+	if (bed->obtain == bed_mutex_obtain) {
+		status = bed_mutex_enable_statistics(bed, enable);
+	}
+
+	return status;
+}
+
+bed_status bed_get_lock_statistics(
+	const bed_partition *part,
+	bed_lock_statistics *statistics
+)
+{
+	bed_status status = BED_ERROR_OP_NOT_SUPPORTED;
+	bed_device *bed = part->bed;
+
+	if (bed->obtain == bed_mutex_obtain) {
+		status = bed_mutex_get_statistics(bed, statistics);
+	}
+
+	return status;
+}
@@ -411,6 +411,7 @@ bed_status bed_lpc32xx_mlc_init(
 	bed->is_block_valid = bed_is_block_valid_not_supported;
 	bed->read = bed_nand_read;
 	bed->read_oob = bed_nand_read_oob;
+	bed->read_partial = bed_nand_read_partial;
 #ifndef BED_CONFIG_READ_ONLY
 	bed->write = bed_nand_write;
 	bed->write_oob = bed_nand_write_oob;
@@ -432,6 +433,7 @@ bed_status bed_lpc32xx_mlc_init(
 	nand->read_page = mlc_read_page;
 #ifndef BED_CONFIG_READ_ONLY
 	nand->write_page = mlc_write_page;
+	nand->write_oob_only = bed_nand_write_oob_only_not_supported;
 	nand->mark_page_bad = bed_nand_mark_page_bad_not_supported;
 #endif /* BED_CONFIG_READ_ONLY */
 	nand->ecc_correctable_bits_per_512_bytes = 4;
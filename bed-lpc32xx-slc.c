@@ -482,6 +482,7 @@ bed_status bed_lpc32xx_slc_init(
 	bed->is_block_valid = bed_nand_is_block_valid;
 	bed->read = bed_nand_read;
 	bed->read_oob = bed_nand_read_oob;
+	bed->read_partial = bed_nand_read_partial;
 #ifndef BED_CONFIG_READ_ONLY
 	bed->write = bed_nand_write;
 	bed->write_oob = bed_nand_write_oob;
@@ -502,6 +503,7 @@ bed_status bed_lpc32xx_slc_init(
 	nand->read_page = slc_read_page;
 #ifndef BED_CONFIG_READ_ONLY
 	nand->write_page = slc_write_page;
+	nand->write_oob_only = bed_nand_write_oob_only;
 	nand->mark_page_bad = bed_nand_mark_page_bad;
 #endif /* BED_CONFIG_READ_ONLY */
 	nand->ecc_correctable_bits_per_512_bytes = 2;
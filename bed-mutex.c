@@ -32,6 +32,13 @@ bed_status bed_mutex_initialize(bed_device *bed)
 	return sc == RTEMS_SUCCESSFUL ? BED_SUCCESS : BED_ERROR_SYSTEM;
 }
 
+void bed_mutex_destroy(bed_device *bed)
+{
+	rtems_status_code sc = rtems_semaphore_delete(bed->mutex_id);
+	(void) sc;
+	assert(sc == RTEMS_SUCCESSFUL);
+}
+
 void bed_mutex_obtain(bed_device *bed)
 {
 	rtems_status_code sc = rtems_semaphore_obtain(
@@ -50,4 +57,357 @@ void bed_mutex_release(bed_device *bed)
 	assert(sc == RTEMS_SUCCESSFUL);
 }
 
+bed_status bed_lock_initialize(bed_lock *lock)
+{
+	rtems_status_code sc = rtems_semaphore_create(
+		rtems_build_name('B', 'E', 'D', 'L'),
+		1,
+		RTEMS_BINARY_SEMAPHORE | RTEMS_PRIORITY | RTEMS_INHERIT_PRIORITY,
+		0,
+		&lock->id
+	);
+
+	return sc == RTEMS_SUCCESSFUL ? BED_SUCCESS : BED_ERROR_SYSTEM;
+}
+
+void bed_lock_destroy(bed_lock *lock)
+{
+	rtems_status_code sc = rtems_semaphore_delete(lock->id);
+	(void) sc;
+	assert(sc == RTEMS_SUCCESSFUL);
+}
+
+void bed_lock_obtain(bed_lock *lock)
+{
+	rtems_status_code sc = rtems_semaphore_obtain(
+		lock->id,
+		RTEMS_WAIT,
+		RTEMS_NO_TIMEOUT
+	);
+	(void) sc;
+	assert(sc == RTEMS_SUCCESSFUL);
+}
+
+void bed_lock_release(bed_lock *lock)
+{
+	rtems_status_code sc = rtems_semaphore_release(lock->id);
+	(void) sc;
+	assert(sc == RTEMS_SUCCESSFUL);
+}
+
+void bed_lock_yield(void)
+{
+	rtems_task_wake_after(RTEMS_YIELD_PROCESSOR);
+}
+
+bed_status bed_condition_initialize(bed_condition *cond)
+{
+	rtems_status_code sc = rtems_semaphore_create(
+		rtems_build_name('B', 'E', 'D', 'C'),
+		0,
+		RTEMS_SIMPLE_BINARY_SEMAPHORE | RTEMS_FIFO,
+		0,
+		&cond->id
+	);
+
+	return sc == RTEMS_SUCCESSFUL ? BED_SUCCESS : BED_ERROR_SYSTEM;
+}
+
+void bed_condition_destroy(bed_condition *cond)
+{
+	rtems_status_code sc = rtems_semaphore_delete(cond->id);
+	(void) sc;
+	assert(sc == RTEMS_SUCCESSFUL);
+}
+
+/*
+ * The task must not be preempted between the lock release and the start of
+ * the wait, otherwise a broadcast may get lost.  A flush ends the wait with
+ * RTEMS_UNSATISFIED.
+ */
+void bed_condition_wait(bed_condition *cond, bed_lock *lock)
+{
+	rtems_mode mode;
+	rtems_status_code sc;
+
+	rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &mode);
+	bed_lock_release(lock);
+	sc = rtems_semaphore_obtain(cond->id, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+	(void) sc;
+	assert(sc == RTEMS_SUCCESSFUL || sc == RTEMS_UNSATISFIED);
+	rtems_task_mode(mode, RTEMS_PREEMPT_MASK, &mode);
+	bed_lock_obtain(lock);
+}
+
+void bed_condition_broadcast(bed_condition *cond)
+{
+	rtems_status_code sc = rtems_semaphore_flush(cond->id);
+	(void) sc;
+	assert(sc == RTEMS_SUCCESSFUL);
+}
+
+bed_status bed_lock_enable_statistics(bed_lock *lock, bool enable)
+{
+	(void) lock;
+	(void) enable;
+
+	return BED_ERROR_OP_NOT_SUPPORTED;
+}
+
+bed_status bed_lock_get_statistics(
+	bed_lock *lock,
+	bed_lock_statistics *statistics
+)
+{
+	(void) lock;
+	(void) statistics;
+
+	return BED_ERROR_OP_NOT_SUPPORTED;
+}
+
+bed_status bed_mutex_enable_statistics(bed_device *bed, bool enable)
+{
+	(void) bed;
+	(void) enable;
+
+	return BED_ERROR_OP_NOT_SUPPORTED;
+}
+
+bed_status bed_mutex_get_statistics(
+	bed_device *bed,
+	bed_lock_statistics *statistics
+)
+{
+	(void) bed;
+	(void) statistics;
+
+	return BED_ERROR_OP_NOT_SUPPORTED;
+}
+
+#else /* __rtems__ */
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+bed_status bed_lock_initialize(bed_lock *lock)
+{
+	bed_status status = BED_SUCCESS;
+	pthread_mutexattr_t attr;
+	int eno;
+
+	memset(lock, 0, sizeof(*lock));
+
+	eno = pthread_mutexattr_init(&attr);
+	if (eno == 0) {
+		eno = pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		if (eno == 0) {
+			eno = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+		}
+
+		if (eno == 0) {
+			eno = pthread_mutex_init(&lock->mutex, &attr);
+		}
+
+		pthread_mutexattr_destroy(&attr);
+	}
+
+	if (eno != 0) {
+		status = BED_ERROR_SYSTEM;
+	}
+
+	return status;
+}
+
+void bed_lock_destroy(bed_lock *lock)
+{
+	int eno = pthread_mutex_destroy(&lock->mutex);
+	(void) eno;
+	assert(eno == 0);
+}
+
+/*
+ * The statistics are only changed by the lock owner.  A nested obtain
+ * succeeds with the try lock, so the wait path is only taken for an
+ * acquisition from another owner.
+ */
+void bed_lock_obtain(bed_lock *lock)
+{
+	int eno = pthread_mutex_trylock(&lock->mutex);
+
+	if (eno == 0) {
+		if (lock->nest_level == 0 && lock->statistics_enabled) {
+			++lock->statistics.acquisitions;
+			lock->obtain_time = now();
+		}
+	} else {
+		uint64_t t0;
+
+		assert(eno == EBUSY);
+		t0 = now();
+		eno = pthread_mutex_lock(&lock->mutex);
+		assert(eno == 0);
+
+		if (lock->statistics_enabled) {
+			uint64_t t1 = now();
+
+			++lock->statistics.acquisitions;
+			++lock->statistics.contended_acquisitions;
+			lock->statistics.total_wait_nanoseconds += t1 - t0;
+			lock->obtain_time = t1;
+		}
+	}
+
+	++lock->nest_level;
+}
+
+void bed_lock_release(bed_lock *lock)
+{
+	int eno;
+
+	assert(lock->nest_level > 0);
+	--lock->nest_level;
+
+	if (lock->nest_level == 0 && lock->statistics_enabled) {
+		uint64_t hold = now() - lock->obtain_time;
+
+		if (hold > lock->statistics.longest_hold_nanoseconds) {
+			lock->statistics.longest_hold_nanoseconds = hold;
+		}
+	}
+
+	eno = pthread_mutex_unlock(&lock->mutex);
+	(void) eno;
+	assert(eno == 0);
+}
+
+void bed_lock_yield(void)
+{
+	sched_yield();
+}
+
+bed_status bed_condition_initialize(bed_condition *cond)
+{
+	int eno = pthread_cond_init(&cond->cond, NULL);
+
+	return eno == 0 ? BED_SUCCESS : BED_ERROR_SYSTEM;
+}
+
+void bed_condition_destroy(bed_condition *cond)
+{
+	int eno = pthread_cond_destroy(&cond->cond);
+	(void) eno;
+	assert(eno == 0);
+}
+
+/*
+ * The lock is not owned during the wait, so the nest level is restored
+ * afterwards.  The hold time starts again after the wait.
+ */
+void bed_condition_wait(bed_condition *cond, bed_lock *lock)
+{
+	uint32_t nest_level = lock->nest_level;
+	int eno;
+
+	assert(nest_level == 1);
+	lock->nest_level = 0;
+	eno = pthread_cond_wait(&cond->cond, &lock->mutex);
+	(void) eno;
+	assert(eno == 0);
+	lock->nest_level = nest_level;
+
+	if (lock->statistics_enabled) {
+		lock->obtain_time = now();
+	}
+}
+
+void bed_condition_broadcast(bed_condition *cond)
+{
+	int eno = pthread_cond_broadcast(&cond->cond);
+	(void) eno;
+	assert(eno == 0);
+}
+
+bed_status bed_lock_enable_statistics(bed_lock *lock, bool enable)
+{
+	pthread_mutex_lock(&lock->mutex);
+	memset(&lock->statistics, 0, sizeof(lock->statistics));
+	lock->statistics_enabled = enable;
+	lock->obtain_time = now();
+	pthread_mutex_unlock(&lock->mutex);
+
+	return BED_SUCCESS;
+}
+
+bed_status bed_lock_get_statistics(
+	bed_lock *lock,
+	bed_lock_statistics *statistics
+)
+{
+	pthread_mutex_lock(&lock->mutex);
+	*statistics = lock->statistics;
+	pthread_mutex_unlock(&lock->mutex);
+
+	return BED_SUCCESS;
+}
+
+bed_status bed_mutex_initialize(bed_device *bed)
+{
+	bed_status status = BED_ERROR_SYSTEM;
+	bed_lock *lock = malloc(sizeof(*lock));
+
+	if (lock != NULL) {
+		status = bed_lock_initialize(lock);
+		if (status == BED_SUCCESS) {
+			bed->mutex = lock;
+		} else {
+			free(lock);
+		}
+	}
+
+	return status;
+}
+
+void bed_mutex_destroy(bed_device *bed)
+{
+	bed_lock_destroy(bed->mutex);
+	free(bed->mutex);
+	bed->mutex = NULL;
+}
+
+void bed_mutex_obtain(bed_device *bed)
+{
+	bed_lock_obtain(bed->mutex);
+}
+
+void bed_mutex_release(bed_device *bed)
+{
+	bed_lock_release(bed->mutex);
+}
+
+bed_status bed_mutex_enable_statistics(bed_device *bed, bool enable)
+{
+	return bed_lock_enable_statistics(bed->mutex, enable);
+}
+
+bed_status bed_mutex_get_statistics(
+	bed_device *bed,
+	bed_lock_statistics *statistics
+)
+{
+	return bed_lock_get_statistics(bed->mutex, statistics);
+}
+
 #endif /* __rtems__ */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-nand.h"
+
+const bed_nand_simulator_profile bed_nand_simulator_mt29f2g08aacwp = {
+	.name = "MT29F2G08AACWP",
+	.id = { 0x2c, 0xda, 0x80, 0x15, 0x50 },
+	.onfi_revision = 0x02,
+	.page_size = 2048,
+	.oob_size = 64,
+	.pages_per_block = 64,
+	.blocks_per_lun = 2048,
+	.lun_count = 1,
+	.plane_count = 2,
+	.bits_per_cell = 1,
+	.bits_ecc_correctability = 1,
+	.programs_per_page = 4,
+	.t_r = 25,
+	.t_prog = 700,
+	.t_bers = 3000
+};
+
+const bed_nand_simulator_profile bed_nand_simulator_mt29f2g16aacwp = {
+	.name = "MT29F2G16AACWP",
+	.id = { 0x2c, 0xca, 0x80, 0x55, 0x50 },
+	.onfi_revision = 0x02,
+	.page_size = 2048,
+	.oob_size = 64,
+	.pages_per_block = 64,
+	.blocks_per_lun = 2048,
+	.lun_count = 1,
+	.plane_count = 2,
+	.bits_per_cell = 1,
+	.bits_ecc_correctability = 1,
+	.programs_per_page = 4,
+	.bus_width_16 = true,
+	.t_r = 25,
+	.t_prog = 700,
+	.t_bers = 3000
+};
+
+const bed_nand_simulator_profile bed_nand_simulator_mt29f4g08abada = {
+	.name = "MT29F4G08ABADA",
+	.id = { 0x2c, 0xdc, 0x90, 0x95, 0x56 },
+	.onfi_revision = 0x02,
+	.page_size = 2048,
+	.oob_size = 64,
+	.pages_per_block = 64,
+	.blocks_per_lun = 4096,
+	.lun_count = 1,
+	.plane_count = 2,
+	.bits_per_cell = 1,
+	.bits_ecc_correctability = 4,
+	.programs_per_page = 4,
+	.t_r = 70,
+	.t_prog = 600,
+	.t_bers = 3000
+};
+
+const bed_nand_simulator_profile bed_nand_simulator_mt29f8g08adada = {
+	.name = "MT29F8G08ADADA",
+	.id = { 0x2c, 0xd3, 0xd1, 0x95, 0x5a },
+	.onfi_revision = 0x02,
+	.page_size = 2048,
+	.oob_size = 64,
+	.pages_per_block = 64,
+	.blocks_per_lun = 4096,
+	.lun_count = 2,
+	.plane_count = 2,
+	.bits_per_cell = 1,
+	.bits_ecc_correctability = 4,
+	.programs_per_page = 4,
+	.t_r = 70,
+	.t_prog = 600,
+	.t_bers = 3000
+};
+
+const bed_nand_simulator_profile bed_nand_simulator_mt29f16g08cbaca = {
+	.name = "MT29F16G08CBACA",
+	.id = { 0x2c, 0x48, 0x04, 0x4a, 0xa5 },
+	.onfi_revision = 0x0e,
+	.page_size = 4096,
+	.oob_size = 224,
+	.pages_per_block = 256,
+	.blocks_per_lun = 2048,
+	.lun_count = 1,
+	.plane_count = 2,
+	.bits_per_cell = 2,
+	.bits_ecc_correctability = 24,
+	.programs_per_page = 1,
+	.t_r = 75,
+	.t_prog = 2200,
+	.t_bers = 7000
+};
+
+const bed_nand_simulator_profile bed_nand_simulator_k9f1208u0c = {
+	.name = "K9F1208U0C",
+	.id = { 0xec, 0x76, 0x5a, 0x3f },
+	.page_size = 512,
+	.oob_size = 16,
+	.pages_per_block = 32,
+	.blocks_per_lun = 4096,
+	.lun_count = 1,
+	.plane_count = 4,
+	.bits_per_cell = 1,
+	.bits_ecc_correctability = 1,
+	.programs_per_page = 2,
+	.t_r = 12,
+	.t_prog = 500,
+	.t_bers = 3000
+};
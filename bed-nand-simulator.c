@@ -19,10 +19,31 @@
 #include <stdlib.h>
 #include <inttypes.h>
 
+#ifndef __rtems__
+  #include <pthread.h>
+  #include <sched.h>
+  #include <semaphore.h>
+  #include <time.h>
+#endif /* __rtems__ */
+
 #define ECC_CHUNK_SIZE 256
 
 #define OOB_CHUNK_SIZE 8
 
+#define MICRON_FEATURE_ARRAY_OPERATION_MODE 0x90
+
+#define MICRON_ECC_ENABLE 0x08
+
+#define MICRON_ID_ECC_ENABLED 0x80
+
+#define MICRON_ECC_SECTION_SIZE 16
+
+#define MICRON_ECC_SECTION_OFFSET 8
+
+#define OPERATION_QUEUE_SIZE 8
+
+#define ERASE_SLICES 16
+
 typedef enum {
 	IDLE,
 	EXPECT_NONE,
@@ -33,7 +54,10 @@ typedef enum {
 	ADDR_ROW_1,
 	ADDR_ROW_2,
 	READ_ID_CHECK_ADDR,
+	SET_FEATURES,
+	READ_PAGE_SMALL,
 	READ_PAGE_2,
+	RANDOM_DATA_READ_2,
 	PROGRAM_PAGE,
 	PROGRAM_PAGE_2,
 	ERASE_BLOCK_2
@@ -45,22 +69,94 @@ typedef enum {
 	SIM_IO_ID_ONFI,
 	SIM_IO_PARAM,
 	SIM_IO_STATUS,
+	SIM_IO_FEATURES,
 	SIM_IO_UNDEFINED
 } nand_sim_io_mode;
 
 typedef struct {
+	uint32_t refs;
+	uint8_t data [];
+} nand_sim_page;
+
+typedef enum {
+	SIM_OP_LOAD,
+	SIM_OP_TRANSFER,
+	SIM_OP_PROGRAM,
+	SIM_OP_ERASE,
+	SIM_OP_ERASE_RESUME,
+	SIM_OP_STOP
+} nand_sim_op_kind;
+
+typedef struct {
+	nand_sim_op_kind kind;
+	uint32_t page;
+	uint32_t size;
+	uint16_t time;
+} nand_sim_op;
+
+/*
+ * The data and cache registers, and the status of a chip.  In threaded mode
+ * the array operations of a chip are performed by a chip thread.  The
+ * operations are passed through a single producer, single consumer queue.
+ * The register page numbers are maintained by the command issuing thread.
+ */
+typedef struct nand_sim_context nand_sim_context;
+
+typedef struct {
+	nand_sim_context *sim;
+	uint8_t *data_register;
+	uint8_t *cache_register;
+	uint32_t data_register_page;
+	uint32_t cache_register_page;
+	uint8_t status;
+	uint32_t submitted;
+	uint32_t completed;
+	uint32_t cache_register_sequence;
+	uint32_t erase_suspend_sequence;
+	uint64_t erase_remaining;
+	nand_sim_op queue [OPERATION_QUEUE_SIZE];
+#ifndef __rtems__
+	pthread_t thread;
+	sem_t work;
+#endif /* __rtems__ */
+} nand_sim_chip;
+
+struct nand_sim_context {
 	nand_sim_state state;
 	nand_sim_state next_state;
 	nand_sim_io_mode io_mode;
 	uint32_t page;
 	uint16_t column;
+	bool column_only;
+	uint16_t chip_count;
+	nand_sim_chip *chips;
+	bed_nand_chip_lock *chip_locks;
+	bool threads_running;
+	uint32_t time_scale;
+	bed_device *bed;
 	uint16_t page_with_oob_size;
 	size_t pages_per_chip;
 	size_t ecc_chunks;
 	uint8_t id [8];
+	bool onfi_available;
 	bed_nand_onfi onfi;
-	uint8_t *area;
-} nand_sim_context;
+	bool bus_width_16;
+	bool internal_ecc;
+	uint8_t features [4];
+	uint16_t t_r;
+	uint16_t t_prog;
+	uint16_t t_bers;
+	bool erase_suspend;
+	uint64_t busy_time;
+	uint32_t page_count;
+	nand_sim_page **pages;
+	uint8_t *erased_page;
+	uint32_t operation_count;
+	uint32_t power_cut_operation;
+	uint8_t power_cut_percent;
+	bool power_cut_pending;
+	bool powered_off;
+};
 
 #ifndef NDEBUG
 static bool is_cmd(int ctrl)
@@ -82,19 +178,486 @@ static void expect_none_state(nand_sim_context *sim, nand_sim_state next)
 	sim->next_state = next;
 }
 
+static void begin_array_operation(nand_sim_context *sim)
+{
+	uint32_t operation_count =
+		__atomic_add_fetch(&sim->operation_count, 1, __ATOMIC_RELAXED);
+
+	if (operation_count == sim->power_cut_operation) {
+		sim->power_cut_pending = true;
+	}
+}
+
+static size_t limit_array_operation(nand_sim_context *sim, size_t n)
+{
+	if (sim->powered_off) {
+		n = 0;
+	} else if (sim->power_cut_pending) {
+		n = (n * sim->power_cut_percent) / 100;
+		sim->power_cut_pending = false;
+		sim->powered_off = true;
+	}
+
+	return n;
+}
+
+static uint32_t get_page(const bed_device *bed, const nand_sim_context *sim)
+{
+	return bed->current_chip * sim->pages_per_chip + sim->page;
+}
+
+static void release_page(nand_sim_page *p)
+{
+	if (p != NULL && __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(p);
+	}
+}
+
+static nand_sim_page *acquire_page(nand_sim_page *p)
+{
+	if (p != NULL) {
+		__atomic_add_fetch(&p->refs, 1, __ATOMIC_RELAXED);
+	}
+
+	return p;
+}
+
+static const uint8_t *get_page_data(const bed_device *bed, const nand_sim_context *sim, uint32_t page)
+{
+	const nand_sim_page *p = sim->pages [page];
+
+	return p != NULL ? p->data : sim->erased_page;
+}
+
+/*
+ * Pages are shared with snapshots and are copied before the first
+ * modification.  Erased pages have no storage.  Returns NULL in case no
+ * storage is available.
+ */
+static uint8_t *get_page_data_for_write(const bed_device *bed, nand_sim_context *sim, uint32_t page)
+{
+	nand_sim_page *p = sim->pages [page];
+
+	if (p == NULL || __atomic_load_n(&p->refs, __ATOMIC_ACQUIRE) != 1) {
+		nand_sim_page *q = malloc(sizeof(*q) + sim->page_with_oob_size);
+
+		if (q != NULL) {
+			q->refs = 1;
+			memcpy(q->data, get_page_data(bed, sim, page), sim->page_with_oob_size);
+			release_page(p);
+			sim->pages [page] = q;
+		}
+
+		p = q;
+	}
+
+	return p != NULL ? p->data : NULL;
+}
+
+static void erase_pages(nand_sim_context *sim, uint32_t page, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		release_page(sim->pages [page + i]);
+		sim->pages [page + i] = NULL;
+	}
+}
+
+static void nand_sim_memcpy(uint8_t *dst, const uint8_t *src, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		dst [i] &= src [i];
+	}
+}
+
+static void set_internal_ecc(nand_sim_context *sim, bool enable)
+{
+	sim->internal_ecc = enable;
+
+	if (enable) {
+		sim->id [4] = (uint8_t) (sim->id [4] | MICRON_ID_ECC_ENABLED);
+	} else {
+		sim->id [4] = (uint8_t) (sim->id [4] & ~MICRON_ID_ECC_ENABLED);
+	}
+}
+
+/*
+ * The on-die ECC stores the ECC of each 512 bytes section in the upper half
+ * of the corresponding 16 bytes spare area section.
+ */
+static size_t get_internal_ecc_offset(size_t chunk)
+{
+	size_t chunks_per_section = 512 / ECC_CHUNK_SIZE;
+
+	return (chunk / chunks_per_section) * MICRON_ECC_SECTION_SIZE
+		+ MICRON_ECC_SECTION_OFFSET
+		+ (chunk % chunks_per_section) * BED_ECC_HAMMING_256_SIZE;
+}
+
+static nand_sim_chip *get_chip(const bed_device *bed, const nand_sim_context *sim)
+{
+	return &sim->chips [bed->current_chip];
+}
+
+static uint8_t get_status(const nand_sim_chip *chip)
+{
+	return __atomic_load_n(&chip->status, __ATOMIC_RELAXED);
+}
+
+static void set_status(nand_sim_chip *chip, uint8_t status)
+{
+	__atomic_store_n(&chip->status, status, __ATOMIC_RELAXED);
+}
+
+static bool is_chip_ready(const nand_sim_chip *chip)
+{
+	return __atomic_load_n(&chip->completed, __ATOMIC_ACQUIRE) == chip->submitted;
+}
+
+static void wait_for_chip(const nand_sim_chip *chip, uint32_t sequence)
+{
+	while ((int32_t) (__atomic_load_n(&chip->completed, __ATOMIC_ACQUIRE) - sequence) < 0) {
+#ifndef __rtems__
+		sched_yield();
+#endif /* __rtems__ */
+	}
+}
+
+static void wait_for_all_chips(const nand_sim_context *sim)
+{
+	uint16_t i;
+
+	for (i = 0; i < sim->chip_count; ++i) {
+		const nand_sim_chip *chip = &sim->chips [i];
+
+		wait_for_chip(chip, chip->submitted);
+	}
+}
+
+/*
+ * The cache register is used by the data output and input.  In threaded
+ * mode, wait until the last operation using it is complete.
+ */
+static uint8_t *get_cache_register(const nand_sim_chip *chip)
+{
+	wait_for_chip(chip, chip->cache_register_sequence);
+
+	return chip->cache_register;
+}
+
+static void load_data_register(nand_sim_context *sim, nand_sim_chip *chip, uint32_t page)
+{
+	uint8_t *data = chip->data_register;
+	uint8_t status = BED_NAND_STATUS_READY;
+
+	memcpy(data, get_page_data(sim->bed, sim, page), sim->page_with_oob_size);
+
+	if (sim->internal_ecc) {
+		const uint8_t *oob = data + sim->bed->page_size;
+		bed_status internal_status = BED_SUCCESS;
+		size_t i;
+
+		for (i = 0; i < sim->ecc_chunks; ++i) {
+			uint8_t calc_ecc [BED_ECC_HAMMING_256_SIZE];
+			bed_status chunk_status;
+
+			bed_ecc_hamming_256_calculate(data, calc_ecc);
+			chunk_status = bed_ecc_hamming_256_correct(
+				data,
+				oob + get_internal_ecc_offset(i),
+				calc_ecc
+			);
+			if (chunk_status != BED_SUCCESS && internal_status != BED_ERROR_ECC_UNCORRECTABLE) {
+				internal_status = chunk_status;
+			}
+
+			data += ECC_CHUNK_SIZE;
+		}
+
+		if (internal_status == BED_ERROR_ECC_UNCORRECTABLE) {
+			status |= BED_NAND_STATUS_FAIL;
+		} else if (internal_status == BED_ERROR_ECC_FIXED) {
+			status |= BED_NAND_STATUS_MICRON_REWRITE_RECOMMENDED;
+		}
+	}
+
+	set_status(chip, status);
+}
+
+static void program_cache_register(
+	nand_sim_context *sim,
+	nand_sim_chip *chip,
+	uint32_t page,
+	size_t n
+)
+{
+	uint8_t status = BED_NAND_STATUS_READY;
+
+	if (sim->internal_ecc) {
+		const uint8_t *data = chip->cache_register;
+		uint8_t *oob = chip->cache_register + sim->bed->page_size;
+		size_t i;
+
+		for (i = 0; i < sim->ecc_chunks; ++i) {
+			bed_ecc_hamming_256_calculate(data, oob + get_internal_ecc_offset(i));
+
+			data += ECC_CHUNK_SIZE;
+		}
+	}
+
+	if (n > 0) {
+		uint8_t *nand_data = get_page_data_for_write(sim->bed, sim, page);
+
+		if (nand_data != NULL) {
+			nand_sim_memcpy(nand_data, chip->cache_register, n);
+		} else {
+			status |= BED_NAND_STATUS_FAIL;
+		}
+	}
+
+	set_status(chip, status);
+}
+
+static void execute_operation(
+	nand_sim_context *sim,
+	nand_sim_chip *chip,
+	const nand_sim_op *op
+)
+{
+	switch (op->kind) {
+		case SIM_OP_LOAD:
+			load_data_register(sim, chip, op->page);
+			break;
+		case SIM_OP_TRANSFER:
+			memcpy(chip->cache_register, chip->data_register, sim->page_with_oob_size);
+			break;
+		case SIM_OP_PROGRAM:
+			program_cache_register(sim, chip, op->page, op->size);
+			break;
+		case SIM_OP_ERASE:
+			erase_pages(sim, op->page, op->size);
+			set_status(chip, BED_NAND_STATUS_READY);
+			break;
+		case SIM_OP_ERASE_RESUME:
+			break;
+		default:
+			assert(op->kind == SIM_OP_STOP);
+			break;
+	}
+}
+
+#ifndef __rtems__
+static void sleep_nanoseconds(uint64_t ns)
+{
+	if (ns > 0) {
+		struct timespec ts = {
+			.tv_sec = (time_t) (ns / 1000000000),
+			.tv_nsec = (long) (ns % 1000000000)
+		};
+
+		while (nanosleep(&ts, &ts) != 0) {
+			/* Interrupted */
+		}
+	}
+}
+
+/*
+ * An erase sleeps in slices and stops early in case it is suspended.  The
+ * remaining time is used by the resume operation.
+ */
+static void sleep_operation(
+	const nand_sim_context *sim,
+	nand_sim_chip *chip,
+	const nand_sim_op *op,
+	uint32_t sequence
+)
+{
+	uint64_t ns = (uint64_t) op->time * sim->time_scale * 10;
+
+	if (op->kind == SIM_OP_ERASE || op->kind == SIM_OP_ERASE_RESUME) {
+		uint64_t slice;
+
+		if (op->kind == SIM_OP_ERASE_RESUME) {
+			ns = chip->erase_remaining;
+		}
+
+		slice = ns / ERASE_SLICES + 1;
+
+		while (
+			ns > 0
+				&& __atomic_load_n(&chip->erase_suspend_sequence, __ATOMIC_ACQUIRE) != sequence
+		) {
+			uint64_t t = ns < slice ? ns : slice;
+
+			sleep_nanoseconds(t);
+			ns -= t;
+		}
+
+		chip->erase_remaining = ns;
+	} else {
+		sleep_nanoseconds(ns);
+	}
+}
+
+static void *chip_thread(void *arg)
+{
+	nand_sim_chip *chip = arg;
+	nand_sim_context *sim = chip->sim;
+	bool stop = false;
+
+	while (!stop) {
+		uint32_t completed = chip->completed;
+		const nand_sim_op *op = &chip->queue [completed % OPERATION_QUEUE_SIZE];
+
+		while (sem_wait(&chip->work) != 0) {
+			/* Interrupted */
+		}
+
+		stop = op->kind == SIM_OP_STOP;
+		execute_operation(sim, chip, op);
+		sleep_operation(sim, chip, op, completed + 1);
+
+		__atomic_store_n(&chip->completed, completed + 1, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+#endif /* __rtems__ */
+
+/*
+ * In threaded mode, the operation is queued for the chip thread and the
+ * chip is busy until it is complete.  Otherwise it is executed immediately.
+ */
+static void submit_operation(
+	nand_sim_context *sim,
+	nand_sim_chip *chip,
+	nand_sim_op_kind kind,
+	uint32_t page,
+	uint32_t size,
+	uint16_t time
+)
+{
+	nand_sim_op *op;
+	uint32_t sequence = chip->submitted + 1;
+
+	wait_for_chip(chip, sequence - OPERATION_QUEUE_SIZE);
+
+	op = &chip->queue [chip->submitted % OPERATION_QUEUE_SIZE];
+	op->kind = kind;
+	op->page = page;
+	op->size = size;
+	op->time = time;
+
+	if (kind == SIM_OP_TRANSFER || kind == SIM_OP_PROGRAM) {
+		chip->cache_register_sequence = sequence;
+	}
+
+	__atomic_add_fetch(&sim->busy_time, time, __ATOMIC_RELAXED);
+
+	if (sim->threads_running) {
+#ifndef __rtems__
+		__atomic_store_n(&chip->submitted, sequence, __ATOMIC_RELEASE);
+		sem_post(&chip->work);
+#endif /* __rtems__ */
+	} else {
+		execute_operation(sim, chip, op);
+		chip->submitted = sequence;
+		chip->completed = sequence;
+	}
+}
+
+static void load_page(bed_device *bed, nand_sim_context *sim, nand_sim_chip *chip)
+{
+	submit_operation(sim, chip, SIM_OP_LOAD, get_page(bed, sim), 0, sim->t_r);
+	chip->data_register_page = sim->page;
+}
+
+static void transfer_to_cache_register(nand_sim_context *sim, nand_sim_chip *chip)
+{
+	submit_operation(sim, chip, SIM_OP_TRANSFER, 0, 0, 0);
+	chip->cache_register_page = chip->data_register_page;
+}
+
+/*
+ * In case of a power cut, only the beginning of the page is programmed, so
+ * the OOB and ECC at the end of the page are usually lost.
+ */
+static void program_page(bed_device *bed, nand_sim_context *sim, nand_sim_chip *chip)
+{
+	size_t n;
+
+	begin_array_operation(sim);
+	n = limit_array_operation(sim, sim->page_with_oob_size);
+
+	submit_operation(sim, chip, SIM_OP_PROGRAM, get_page(bed, sim), (uint32_t) n, sim->t_prog);
+}
+
+static void erase_block(bed_device *bed, nand_sim_context *sim, nand_sim_chip *chip)
+{
+	uint32_t page = get_page(bed, sim);
+	size_t n;
+
+	assert(page % bed->pages_per_block == 0);
+
+	begin_array_operation(sim);
+	n = limit_array_operation(sim, bed->pages_per_block);
+
+	submit_operation(sim, chip, SIM_OP_ERASE, page, (uint32_t) n, sim->t_bers);
+}
+
+/*
+ * Only an erase or erase resume operation in progress is suspended, see
+ * sleep_operation().
+ */
+static void suspend_erase(nand_sim_chip *chip)
+{
+	__atomic_store_n(&chip->erase_suspend_sequence, chip->submitted, __ATOMIC_RELEASE);
+}
+
+static void resume_erase(nand_sim_context *sim, nand_sim_chip *chip)
+{
+	assert(is_chip_ready(chip));
+
+	if (chip->erase_remaining > 0) {
+		submit_operation(sim, chip, SIM_OP_ERASE_RESUME, 0, 0, 0);
+	}
+}
+
+static void start_column_address(nand_sim_context *sim, nand_sim_state next)
+{
+	sim->column_only = true;
+	sim->state = ADDR_COL_0;
+	sim->next_state = next;
+}
+
 static void start_sequence(bed_device *bed, int data, int ctrl)
 {
 	bed_nand_context *nand = bed->context;
 	nand_sim_context *sim = nand->context;
 
 	if (bed_nand_is_real_data(data)) {
+		uint32_t page = sim->page;
+		uint16_t column = sim->column;
+		nand_sim_chip *chip;
+
 		assert(is_cmd(ctrl));
 
 		sim->io_mode = SIM_IO_UNDEFINED;
 		sim->column = 0;
+		sim->column_only = false;
 		sim->page = 0;
 
 		switch (data) {
+			case BED_NAND_CMD_READ_MODE:
+				/* Return to data output after a status read */
+				sim->page = page;
+				sim->column = column;
+				sim->io_mode = SIM_IO_DATA;
+				expect_none_state(sim, IDLE);
+				break;
 			case BED_NAND_CMD_READ_OOB:
 			case BED_NAND_CMD_READ_PAGE:
 				if (data == BED_NAND_CMD_READ_OOB) {
@@ -105,9 +668,37 @@ static void start_sequence(bed_device *bed, int data, int ctrl)
 				if (bed_nand_has_large_pages(bed)) {
 					sim->next_state = READ_PAGE_2;
 				} else {
-					sim->next_state = IDLE;
+					sim->next_state = READ_PAGE_SMALL;
 				}
 				break;
+			case BED_NAND_CMD_READ_PAGE_CACHE_RANDOM:
+				assert(bed_nand_has_large_pages(bed));
+				sim->io_mode = SIM_IO_DATA;
+				sim->state = ADDR_COL_0;
+				sim->next_state = READ_PAGE_2;
+				break;
+			case BED_NAND_CMD_READ_PAGE_CACHE_SEQUENTIAL:
+				chip = get_chip(bed, sim);
+				sim->page = chip->data_register_page + 1;
+				assert(sim->page < sim->pages_per_chip);
+				transfer_to_cache_register(sim, chip);
+				load_page(bed, sim, chip);
+				sim->io_mode = SIM_IO_DATA;
+				expect_none_state(sim, IDLE);
+				break;
+			case BED_NAND_CMD_READ_PAGE_CACHE_LAST:
+				chip = get_chip(bed, sim);
+				sim->page = chip->data_register_page;
+				transfer_to_cache_register(sim, chip);
+				sim->io_mode = SIM_IO_DATA;
+				expect_none_state(sim, IDLE);
+				break;
+			case BED_NAND_CMD_RANDOM_DATA_READ:
+				assert(bed_nand_has_large_pages(bed));
+				sim->page = page;
+				sim->io_mode = SIM_IO_DATA;
+				start_column_address(sim, RANDOM_DATA_READ_2);
+				break;
 			case BED_NAND_CMD_POINTER_OOB:
 				sim->column = 512;
 				sim->io_mode = SIM_IO_DATA;
@@ -115,6 +706,15 @@ static void start_sequence(bed_device *bed, int data, int ctrl)
 				sim->next_state = PROGRAM_PAGE_2;
 				break;
 			case BED_NAND_CMD_PROGRAM_PAGE:
+				chip = get_chip(bed, sim);
+				memset(get_cache_register(chip), 0xff, sim->page_with_oob_size);
+				sim->io_mode = SIM_IO_DATA;
+				sim->state = ADDR_COL_0;
+				sim->next_state = PROGRAM_PAGE_2;
+				break;
+			case BED_NAND_CMD_PROGRAM_FOR_INTERNAL_DATA_MOVE:
+				/* Program the cache register loaded by the copyback read */
+				assert(bed_nand_has_large_pages(bed));
 				sim->io_mode = SIM_IO_DATA;
 				sim->state = ADDR_COL_0;
 				sim->next_state = PROGRAM_PAGE_2;
@@ -132,10 +732,27 @@ static void start_sequence(bed_device *bed, int data, int ctrl)
 				sim->state = ADDR_BYTE;
 				sim->next_state = IDLE;
 				break;
+			case BED_NAND_CMD_SET_FEATURES:
+				sim->io_mode = SIM_IO_FEATURES;
+				sim->state = ADDR_BYTE;
+				sim->next_state = SET_FEATURES;
+				break;
 			case BED_NAND_CMD_READ_STATUS:
+				sim->page = page;
+				sim->column = column;
 				sim->io_mode = SIM_IO_STATUS;
 				expect_none_state(sim, IDLE);
 				break;
+			case BED_NAND_CMD_ERASE_SUSPEND:
+				assert(sim->erase_suspend);
+				suspend_erase(get_chip(bed, sim));
+				expect_none_state(sim, IDLE);
+				break;
+			case BED_NAND_CMD_ERASE_RESUME:
+				assert(sim->erase_suspend);
+				resume_erase(sim, get_chip(bed, sim));
+				expect_none_state(sim, IDLE);
+				break;
 			case BED_NAND_CMD_RESET:
 				expect_none_state(sim, IDLE);
 				break;
@@ -148,38 +765,12 @@ static void start_sequence(bed_device *bed, int data, int ctrl)
 	}
 }
 
-static uint32_t get_page(const bed_device *bed, const nand_sim_context *sim)
-{
-	return bed->current_chip * sim->pages_per_chip + sim->page;
-}
-
-static uint8_t *get_page_data(const bed_device *bed, const nand_sim_context *sim, uint32_t page)
-{
-	return sim->area + page * sim->page_with_oob_size;
-}
-
-static uint8_t *get_page_oob(const bed_device *bed, const nand_sim_context *sim, uint32_t page)
-{
-	return get_page_data(bed, sim, page) + bed->page_size;
-}
-
-static void erase_block(bed_device *bed)
-{
-	const bed_nand_context *nand = bed->context;
-	const nand_sim_context *sim = nand->context;
-	uint32_t page = get_page(bed, sim);
-	uint8_t *nand_data_and_oob = get_page_data(bed, sim, page);
-
-	assert(page % bed->pages_per_block == 0);
-
-	memset(nand_data_and_oob, 0xff, (size_t) bed->pages_per_block * sim->page_with_oob_size);
-}
-
 static void nand_sim_control(bed_device *bed, int data, int ctrl)
 {
 	bed_nand_context *nand = bed->context;
 	nand_sim_context *sim = nand->context;
 	int value = data & BED_NAND_CMD_MASK;
+	nand_sim_chip *chip;
 
 	switch (sim->state) {
 		case IDLE:
@@ -187,7 +778,15 @@ static void nand_sim_control(bed_device *bed, int data, int ctrl)
 			break;
 		case EXPECT_NONE:
 			assert((unsigned) data == BED_NAND_CMD_NONE);
-			sim->state = sim->next_state;
+			if (sim->next_state == READ_PAGE_SMALL) {
+				/* Small page devices have no read confirm command */
+				chip = get_chip(bed, sim);
+				load_page(bed, sim, chip);
+				transfer_to_cache_register(sim, chip);
+				sim->state = IDLE;
+			} else {
+				sim->state = sim->next_state;
+			}
 			break;
 		case ADDR_BYTE:
 			assert(is_addr(ctrl));
@@ -206,7 +805,14 @@ static void nand_sim_control(bed_device *bed, int data, int ctrl)
 		case ADDR_COL_1:
 			assert(is_addr(ctrl));
 			sim->column = (uint16_t) (sim->column + (value << 8));
-			sim->state = ADDR_ROW_0;
+			if (sim->bus_width_16) {
+				sim->column = (uint16_t) (sim->column << 1);
+			}
+			if (sim->column_only) {
+				expect_none_state(sim, sim->next_state);
+			} else {
+				sim->state = ADDR_ROW_0;
+			}
 			break;
 		case ADDR_ROW_0:
 			assert(is_addr(ctrl));
@@ -243,21 +849,61 @@ static void nand_sim_control(bed_device *bed, int data, int ctrl)
 			sim->column = 0;
 			sim->state = IDLE;
 			break;
+		case SET_FEATURES:
+			assert((unsigned) data == BED_NAND_CMD_NONE);
+			assert(sim->column == MICRON_FEATURE_ARRAY_OPERATION_MODE);
+			sim->column = 0;
+			sim->state = IDLE;
+			break;
 		case READ_PAGE_2:
-			assert(data == BED_NAND_CMD_READ_PAGE_2);
+			switch (data) {
+				case BED_NAND_CMD_READ_PAGE_2:
+				case BED_NAND_CMD_READ_FOR_INTERNAL_DATA_MOVE_2:
+					chip = get_chip(bed, sim);
+					load_page(bed, sim, chip);
+					transfer_to_cache_register(sim, chip);
+					break;
+				case BED_NAND_CMD_READ_PAGE_CACHE_RANDOM_2:
+					chip = get_chip(bed, sim);
+					transfer_to_cache_register(sim, chip);
+					load_page(bed, sim, chip);
+					sim->column = 0;
+					break;
+				default:
+					assert(0);
+					break;
+			}
+			expect_none_state(sim, IDLE);
+			break;
+		case RANDOM_DATA_READ_2:
+			assert(data == BED_NAND_CMD_RANDOM_DATA_READ_2);
 			expect_none_state(sim, IDLE);
 			break;
 		case PROGRAM_PAGE:
 			assert(data == BED_NAND_CMD_PROGRAM_PAGE);
+			chip = get_chip(bed, sim);
+			memset(get_cache_register(chip), 0xff, sim->page_with_oob_size);
 			sim->state = ADDR_COL_0;
 			break;
 		case PROGRAM_PAGE_2:
-			assert(data == BED_NAND_CMD_PROGRAM_PAGE_2);
-			expect_none_state(sim, IDLE);
+			switch (data) {
+				case BED_NAND_CMD_RANDOM_DATA_INPUT:
+					assert(bed_nand_has_large_pages(bed));
+					start_column_address(sim, PROGRAM_PAGE_2);
+					break;
+				case BED_NAND_CMD_PROGRAM_PAGE_2:
+				case BED_NAND_CMD_PROGRAM_PAGE_CACHE_2:
+					program_page(bed, sim, get_chip(bed, sim));
+					expect_none_state(sim, IDLE);
+					break;
+				default:
+					assert(0);
+					break;
+			}
 			break;
 		case ERASE_BLOCK_2:
 			assert(data == BED_NAND_CMD_ERASE_BLOCK_2);
-			erase_block(bed);
+			erase_block(bed, sim, get_chip(bed, sim));
 			expect_none_state(sim, IDLE);
 			break;
 		default:
@@ -268,39 +914,40 @@ static void nand_sim_control(bed_device *bed, int data, int ctrl)
 
 static bool nand_sim_is_ready(bed_device *bed)
 {
-	return true;
+	bed_nand_context *nand = bed->context;
+	const nand_sim_context *sim = nand->context;
+
+	return is_chip_ready(get_chip(bed, sim));
 }
 
 static void nand_sim_read_buffer(bed_device *bed, uint8_t *data, size_t n)
 {
 	static const uint8_t onfi [] = { 'O', 'N', 'F', 'I' };
-	static const uint8_t nand_status [] = { BED_NAND_STATUS_READY };
+	static const uint8_t no_onfi [] = { 0, 0, 0, 0 };
 
 	bed_nand_context *nand = bed->context;
 	nand_sim_context *sim = nand->context;
 	const uint8_t *nand_data;
 	size_t size_max;
+	uint16_t column = sim->column;
+	uint8_t status;
 
 	switch (sim->io_mode) {
-		case SIM_IO_DATA: {
-			uint32_t page = get_page(bed, sim);
-
-			nand_data = get_page_data(bed, sim, page);
+		case SIM_IO_DATA:
+			nand_data = get_cache_register(get_chip(bed, sim));
 			size_max = sim->page_with_oob_size;
-
 			break;
-		}
 		case SIM_IO_ID:
 			nand_data = sim->id;
 			size_max = sizeof(sim->id);
 			break;
 		case SIM_IO_ID_ONFI:
-			nand_data = onfi;
+			nand_data = sim->onfi_available ? onfi : no_onfi;
 			size_max = sizeof(onfi);
 			break;
 		case SIM_IO_PARAM:
-			if (sim->column == sizeof(sim->onfi)) {
-				sim->column = 0;
+			if (column == sizeof(sim->onfi)) {
+				column = 0;
 			}
 			nand_data = (const uint8_t *) &sim->onfi;
 			size_max = sizeof(sim->onfi);
@@ -308,19 +955,28 @@ static void nand_sim_read_buffer(bed_device *bed, uint8_t *data, size_t n)
 		default:
 			assert(sim->io_mode == SIM_IO_STATUS);
 
-			sim->column = 0;
-			nand_data = nand_status;
-			size_max = sizeof(nand_status);
+			/* Keep the column for a return to the data output */
+			column = 0;
+			status = get_status(get_chip(bed, sim));
+			if (sim->powered_off) {
+				status = 0;
+			} else if (!is_chip_ready(get_chip(bed, sim))) {
+				status = (uint8_t) (status & ~BED_NAND_STATUS_READY);
+			}
+			nand_data = &status;
+			size_max = sizeof(status);
 			break;
 	}
 
 	(void) size_max;
-	assert(sim->column < size_max);
-	assert(n <= size_max - sim->column);
+	assert(column < size_max);
+	assert(n <= size_max - column);
 
-	memcpy(data, nand_data + sim->column, n);
+	memcpy(data, nand_data + column, n);
 
-	sim->column = (uint16_t) (sim->column + n);
+	if (sim->io_mode != SIM_IO_STATUS) {
+		sim->column = (uint16_t) (column + n);
+	}
 }
 
 static uint8_t nand_sim_read_8(bed_device *bed)
@@ -346,19 +1002,20 @@ static bed_status nand_sim_read_page(bed_device *bed, uint32_t page, uint8_t *da
 	bed_status status = BED_SUCCESS;
 	bed_nand_context *nand = bed->context;
 	nand_sim_context *sim = nand->context;
-	const uint8_t *nand_data = get_page_data(bed, sim, page);
-	const uint8_t *nand_oob = get_page_oob(bed, sim, page);
-	const uint8_t *nand_ecc = nand_oob + nand->oob_ecc_ranges [0].offset;
-	uint8_t *oob = nand->oob_buffer;
+	const nand_sim_chip *chip = get_chip(bed, sim);
+	const uint8_t *nand_data = get_cache_register(chip);
+	const uint8_t *nand_oob = nand_data + bed->page_size;
 	size_t i;
 
 	assert(sim->io_mode == SIM_IO_DATA);
-	assert(page == get_page(bed, sim));
+	assert(page == chip->cache_register_page);
 
-	memcpy(data, nand_data, ECC_CHUNK_SIZE * sim->ecc_chunks);
-	memcpy(oob, nand_oob, OOB_CHUNK_SIZE * sim->ecc_chunks);
+	memcpy(data, nand_data, bed->page_size);
+	memcpy(nand->oob_buffer, nand_oob, bed->oob_size);
+
+	if (use_ecc && !sim->internal_ecc) {
+		const uint8_t *nand_ecc = nand_oob + nand->oob_ecc_ranges [0].offset;
 
-	if (use_ecc) {
 		for (i = 0; status == BED_SUCCESS && i < sim->ecc_chunks; ++i) {
 			uint8_t calc_ecc [BED_ECC_HAMMING_256_SIZE];
 
@@ -373,30 +1030,94 @@ static bed_status nand_sim_read_page(bed_device *bed, uint32_t page, uint8_t *da
 	return status;
 }
 
-static void nand_sim_memcpy(uint8_t *dst, const uint8_t *src, size_t n)
+/*
+ * Transfers only the ECC chunks covering the column range and their ECC
+ * bytes with RANDOM DATA OUTPUT.
+ */
+static bed_status nand_sim_read_partial(
+	bed_device *bed,
+	uint32_t page,
+	uint16_t column,
+	uint8_t *data,
+	size_t n
+)
 {
+	bed_status status = BED_SUCCESS;
+	bed_nand_context *nand = bed->context;
+	size_t first = column / ECC_CHUNK_SIZE;
+	size_t last = (column + n - 1) / ECC_CHUNK_SIZE;
+	size_t begin = column;
+	size_t end = column + n;
+	uint8_t nand_ecc [BED_NAND_MAX_PAGE_SIZE / ECC_CHUNK_SIZE * BED_ECC_HAMMING_256_SIZE];
+	uint8_t chunk [ECC_CHUNK_SIZE];
 	size_t i;
 
-	for (i = 0; i < n; ++i) {
-		dst [i] &= src [i];
+	(void) page;
+
+	(*nand->command)(
+		bed,
+		BED_NAND_CMD_RANDOM_DATA_READ,
+		0,
+		(uint16_t) (bed->page_size + nand->oob_ecc_ranges [0].offset
+			+ first * BED_ECC_HAMMING_256_SIZE)
+	);
+	(*nand->command)(bed, BED_NAND_CMD_RANDOM_DATA_READ_2, 0, 0);
+	(*nand->read_buffer)(bed, nand_ecc, (last - first + 1) * BED_ECC_HAMMING_256_SIZE);
+
+	(*nand->command)(
+		bed,
+		BED_NAND_CMD_RANDOM_DATA_READ,
+		0,
+		(uint16_t) (first * ECC_CHUNK_SIZE)
+	);
+	(*nand->command)(bed, BED_NAND_CMD_RANDOM_DATA_READ_2, 0, 0);
+
+	for (i = first; status != BED_ERROR_ECC_UNCORRECTABLE && i <= last; ++i) {
+		size_t chunk_begin = i * ECC_CHUNK_SIZE;
+		size_t copy_begin = begin > chunk_begin ? begin : chunk_begin;
+		size_t copy_end = end < chunk_begin + ECC_CHUNK_SIZE ?
+			end : chunk_begin + ECC_CHUNK_SIZE;
+		uint8_t calc_ecc [BED_ECC_HAMMING_256_SIZE];
+		bed_status chunk_status;
+
+		(*nand->read_buffer)(bed, chunk, sizeof(chunk));
+		bed_ecc_hamming_256_calculate(chunk, calc_ecc);
+		chunk_status = bed_ecc_hamming_256_correct(
+			chunk,
+			nand_ecc + (i - first) * BED_ECC_HAMMING_256_SIZE,
+			calc_ecc
+		);
+		if (chunk_status != BED_SUCCESS) {
+			status = chunk_status;
+		}
+
+		memcpy(data + copy_begin - begin, chunk + copy_begin - chunk_begin, copy_end - copy_begin);
 	}
+
+	return status;
 }
 
 static void nand_sim_write_buffer(bed_device *bed, const uint8_t *data, size_t n)
 {
 	bed_nand_context *nand = bed->context;
 	nand_sim_context *sim = nand->context;
-	uint32_t page = get_page(bed, sim);
-	uint8_t *nand_data = get_page_data(bed, sim, page);
-	size_t size_max = sim->page_with_oob_size;
 
-	assert(sim->io_mode == SIM_IO_DATA);
+	if (sim->io_mode == SIM_IO_DATA) {
+		size_t size_max = sim->page_with_oob_size;
 
-	(void) size_max;
-	assert(sim->column < size_max);
-	assert(n <= size_max - sim->column);
+		(void) size_max;
+		assert(sim->column < size_max);
+		assert(n <= size_max - sim->column);
 
-	nand_sim_memcpy(nand_data + sim->column, data, n);
+		memcpy(get_cache_register(get_chip(bed, sim)) + sim->column, data, n);
+	} else {
+		assert(sim->io_mode == SIM_IO_FEATURES);
+		assert(sim->column < sizeof(sim->features));
+		assert(n <= sizeof(sim->features) - sim->column);
+
+		memcpy(&sim->features [sim->column], data, n);
+		set_internal_ecc(sim, (sim->features [0] & MICRON_ECC_ENABLE) != 0);
+	}
 
 	sim->column = (uint16_t) (sim->column + n);
 }
@@ -407,25 +1128,33 @@ static bed_status nand_sim_write_page(bed_device *bed, uint32_t page, const uint
 	bed_status status = BED_SUCCESS;
 	bed_nand_context *nand = bed->context;
 	nand_sim_context *sim = nand->context;
-	uint8_t *nand_data = get_page_data(bed, sim, page);
-	uint8_t *nand_oob = get_page_oob(bed, sim, page);
-	uint8_t *nand_ecc = nand_oob + nand->oob_ecc_ranges [0].offset;
-	uint8_t *oob = nand->oob_buffer;
+	uint8_t *nand_data = get_cache_register(get_chip(bed, sim));
+	uint8_t *nand_oob = nand_data + bed->page_size;
 	size_t i;
 
 	assert(sim->io_mode == SIM_IO_DATA);
-	assert(page == get_page(bed, sim));
+	assert(page == sim->page);
 
-	nand_sim_memcpy(nand_data, data, ECC_CHUNK_SIZE * sim->ecc_chunks);
-	nand_sim_memcpy(nand_oob, oob, OOB_CHUNK_SIZE * sim->ecc_chunks);
+	/*
+	 * Provide the page storage before the program operation, so that an
+	 * allocation failure is not reported as a write error.
+	 */
+	if (get_page_data_for_write(bed, sim, get_page(bed, sim)) != NULL) {
+		memcpy(nand_data, data, bed->page_size);
+		memcpy(nand_oob, nand->oob_buffer, bed->oob_size);
 
-	if (use_ecc) {
-		for (i = 0; status == BED_SUCCESS && i < sim->ecc_chunks; ++i) {
-			bed_ecc_hamming_256_calculate(nand_data, nand_ecc);
+		if (use_ecc && !sim->internal_ecc) {
+			uint8_t *nand_ecc = nand_oob + nand->oob_ecc_ranges [0].offset;
 
-			nand_data += ECC_CHUNK_SIZE;
-			nand_ecc += BED_ECC_HAMMING_256_SIZE;
+			for (i = 0; i < sim->ecc_chunks; ++i) {
+				bed_ecc_hamming_256_calculate(nand_data, nand_ecc);
+
+				nand_data += ECC_CHUNK_SIZE;
+				nand_ecc += BED_ECC_HAMMING_256_SIZE;
+			}
 		}
+	} else {
+		status = BED_ERROR_SYSTEM;
 	}
 
 	return status;
@@ -437,9 +1166,59 @@ static void chip_detected(bed_device *bed)
 	bed_nand_context *nand = bed->context;
 	nand_sim_context *sim = nand->context;
 
-	sim->ecc_chunks = bed->page_size / ECC_CHUNK_SIZE;
-	sim->page_with_oob_size = (uint16_t) (bed->page_size + bed->oob_size);
-	sim->pages_per_chip = bed->blocks_per_chip * bed->pages_per_block;
+	assert(sim->page_with_oob_size == bed->page_size + bed->oob_size);
+	assert(sim->pages_per_chip == bed->blocks_per_chip * bed->pages_per_block);
+	assert(
+		sim->internal_ecc
+			|| BED_ECC_HAMMING_256_SIZE * sim->ecc_chunks
+				<= nand->oob_ecc_ranges [0].size
+	);
+	(void) nand;
+	(void) sim;
+}
+
+static void set_onfi_parameters(
+	bed_nand_onfi *onfi,
+	const bed_nand_simulator_profile *profile
+)
+{
+	static const uint8_t signature [] = { 'O', 'N', 'F', 'I' };
+
+	uint32_t pages_per_lun = profile->pages_per_block * profile->blocks_per_lun;
+	uint8_t row_cycles = pages_per_lun * profile->lun_count > 0x10000 ? 3 : 2;
+	uint8_t column_cycles = profile->page_size > 512 ? 2 : 1;
+
+	memcpy(onfi->signature, signature, sizeof(onfi->signature));
+	onfi->revision = bed_cpu_to_le16(profile->onfi_revision);
+	onfi->features = bed_cpu_to_le16(profile->bus_width_16 ? 0x1 : 0x0);
+	onfi->parameter_pages = 1;
+	memset(onfi->device_manufacturer, ' ', sizeof(onfi->device_manufacturer));
+	memset(onfi->device_model, ' ', sizeof(onfi->device_model));
+	memcpy(
+		onfi->device_model,
+		profile->name,
+		strnlen(profile->name, sizeof(onfi->device_model))
+	);
+	onfi->jedec_manufacturer_id = profile->id [0];
+	onfi->data_bytes_per_page = bed_cpu_to_le32(profile->page_size);
+	onfi->spare_bytes_per_page = bed_cpu_to_le16(profile->oob_size);
+	onfi->data_bytes_per_partial_page = bed_cpu_to_le32(512);
+	onfi->spare_bytes_per_partial_page = bed_cpu_to_le16(
+		(uint16_t) (profile->oob_size / (profile->page_size / 512))
+	);
+	onfi->pages_per_block = bed_cpu_to_le32(profile->pages_per_block);
+	onfi->blocks_per_lun = bed_cpu_to_le32(profile->blocks_per_lun);
+	onfi->lun_count = profile->lun_count;
+	onfi->address_cycles = (uint8_t) ((column_cycles << 4) | row_cycles);
+	onfi->bits_per_cell = profile->bits_per_cell;
+	onfi->programs_per_page = profile->programs_per_page;
+	onfi->bits_ecc_correctability = profile->bits_ecc_correctability;
+	onfi->interleaved_address_bits =
+		(uint8_t) bed_power_of_two(profile->plane_count);
+	onfi->t_prog = bed_cpu_to_le16(profile->t_prog);
+	onfi->t_bers = bed_cpu_to_le16(profile->t_bers);
+	onfi->t_r = bed_cpu_to_le16(profile->t_r);
+	onfi->crc = bed_cpu_to_le16(bed_nand_onfi_crc(onfi));
 }
 
 bed_partition *bed_nand_simulator_create(
@@ -448,12 +1227,32 @@ bed_partition *bed_nand_simulator_create(
 	uint32_t block_size,
 	uint16_t page_size
 )
+{
+	bed_nand_simulator_profile profile = {
+		.name = "simulator",
+		.onfi_revision = 0x3e,
+		.page_size = page_size,
+		.oob_size = (uint16_t) ((page_size / ECC_CHUNK_SIZE) * OOB_CHUNK_SIZE),
+		.pages_per_block = (uint16_t) (block_size / page_size),
+		.blocks_per_lun = blocks_per_chip,
+		.lun_count = 1,
+		.plane_count = 1
+	};
+
+	return bed_nand_simulator_create_with_profile(&profile, chip_count);
+}
+
+bed_partition *bed_nand_simulator_create_with_profile(
+	const bed_nand_simulator_profile *profile,
+	uint16_t chip_count
+)
 {
 	bed_partition *part = NULL;
-	uint32_t pages_per_block = block_size / page_size;
-	uint32_t ecc_chunks = page_size / ECC_CHUNK_SIZE;
-	uint32_t oob_size = ecc_chunks * OOB_CHUNK_SIZE;
-	uint32_t area_size = chip_count * blocks_per_chip * pages_per_block * (page_size + oob_size);
+	uint16_t page_size = profile->page_size;
+	uint32_t blocks_per_chip = profile->blocks_per_lun * profile->lun_count;
+	uint32_t pages_per_chip = blocks_per_chip * profile->pages_per_block;
+	uint32_t page_count = chip_count * pages_per_chip;
+	uint32_t page_with_oob_size = page_size + profile->oob_size;
 	bed_device *bed;
 	bed_nand_context *nand;
 	nand_sim_context *sim;
@@ -462,18 +1261,23 @@ bed_partition *bed_nand_simulator_create(
 	assert(bed_is_power_of_two(blocks_per_chip));
 	assert(bed_is_power_of_two(page_size));
 	assert(page_size % ECC_CHUNK_SIZE == 0);
+	assert(profile->oob_size <= BED_NAND_MAX_OOB_SIZE);
+	assert(!profile->bus_width_16 || page_size > 512);
 
 	chunk = malloc(
 		sizeof(*part)
 			+ sizeof(*bed)
 			+ sizeof(*nand)
 			+ sizeof(*sim)
-			+ area_size
+			+ chip_count * sizeof(sim->chips [0])
+			+ chip_count * sizeof(sim->chip_locks [0])
+			+ page_count * sizeof(sim->pages [0])
+			+ (1 + 2 * chip_count) * page_with_oob_size
 	);
 
 	if (chunk != NULL) {
 		bed_status status = BED_SUCCESS;
-		bed_nand_onfi *onfi;
+		uint16_t i;
 
 		part = (bed_partition *) chunk;
 		memset(part, 0, sizeof(*part));
@@ -493,12 +1297,21 @@ bed_partition *bed_nand_simulator_create(
 		chunk += sizeof(*sim);
 		nand->context = sim;
 
+		sim->bed = bed;
+		sim->chip_count = chip_count;
+		sim->chips = (nand_sim_chip *) chunk;
+		memset(sim->chips, 0, chip_count * sizeof(sim->chips [0]));
+		chunk += chip_count * sizeof(sim->chips [0]);
+		sim->chip_locks = (bed_nand_chip_lock *) chunk;
+		chunk += chip_count * sizeof(sim->chip_locks [0]);
+
 		bed->obtain = bed_mutex_obtain;
 		bed->release = bed_mutex_release;
 		bed->select_chip = bed_default_select_chip;
 		bed->is_block_valid = bed_nand_is_block_valid;
 		bed->read = bed_nand_read;
 		bed->read_oob = bed_nand_read_oob;
+		bed->read_partial = bed_nand_read_partial;
 #ifndef BED_CONFIG_READ_ONLY
 		bed->write = bed_nand_write;
 		bed->write_oob = bed_nand_write_oob;
@@ -509,14 +1322,17 @@ bed_partition *bed_nand_simulator_create(
 
 		bed->chip_count = chip_count;
 
-		onfi = &sim->onfi;
-		onfi->revision = 0x3e;
-		onfi->data_bytes_per_page = bed_cpu_to_le32(page_size);
-		onfi->spare_bytes_per_page = bed_cpu_to_le16((uint16_t) oob_size);
-		onfi->pages_per_block = bed_cpu_to_le32(pages_per_block);
-		onfi->blocks_per_lun = bed_cpu_to_le32(blocks_per_chip);
-		onfi->lun_count = 1;
-		onfi->crc = bed_cpu_to_le16(bed_nand_onfi_crc(onfi));
+		memcpy(sim->id, profile->id, sizeof(sim->id));
+		sim->onfi_available = profile->onfi_revision != 0;
+		set_onfi_parameters(&sim->onfi, profile);
+		sim->bus_width_16 = profile->bus_width_16;
+		sim->t_r = profile->t_r;
+		sim->t_prog = profile->t_prog;
+		sim->t_bers = profile->t_bers;
+		sim->erase_suspend = profile->erase_suspend;
+		sim->ecc_chunks = page_size / ECC_CHUNK_SIZE;
+		sim->page_with_oob_size = (uint16_t) page_with_oob_size;
+		sim->pages_per_chip = pages_per_chip;
 
 		nand->command = bed_nand_command;
 		nand->control = nand_sim_control;
@@ -527,30 +1343,59 @@ bed_partition *bed_nand_simulator_create(
 		nand->write_buffer = nand_sim_write_buffer;
 		nand->read_oob_only = bed_nand_read_oob_only;
 		nand->read_page = nand_sim_read_page;
+		nand->read_partial = nand_sim_read_partial;
 #ifndef BED_CONFIG_READ_ONLY
 		nand->write_page = nand_sim_write_page;
+		nand->write_oob_only = bed_nand_write_oob_only;
 		nand->mark_page_bad = bed_nand_mark_page_bad;
 #endif /* BED_CONFIG_READ_ONLY */
 		nand->ecc_correctable_bits_per_512_bytes = 2;
 
-		sim->area = chunk;
-		memset(sim->area, 0xff, area_size);
+		if (profile->bus_width_16) {
+			nand->flags |= BED_NAND_FLG_BUS_WIDTH_16;
+		}
 
-		if (status == BED_SUCCESS) {
-			status = bed_mutex_initialize(bed);
+		if (profile->erase_suspend) {
+			nand->flags |= BED_NAND_FLG_ERASE_SUSPEND;
 		}
 
-		if (status == BED_SUCCESS) {
-			status = bed_nand_detect(bed, chip_count, bed_nand_device_info_all);
+		sim->page_count = page_count;
+		sim->pages = (nand_sim_page **) chunk;
+		memset(sim->pages, 0, page_count * sizeof(sim->pages [0]));
+		chunk += page_count * sizeof(sim->pages [0]);
+
+		sim->erased_page = chunk;
+		memset(sim->erased_page, 0xff, page_with_oob_size);
+		chunk += page_with_oob_size;
+
+		for (i = 0; i < chip_count; ++i) {
+			nand_sim_chip *chip = &sim->chips [i];
+
+			chip->sim = sim;
+			chip->status = BED_NAND_STATUS_READY;
+			chip->data_register = chunk;
+			chunk += page_with_oob_size;
+			chip->cache_register = chunk;
+			chunk += page_with_oob_size;
 		}
 
+		status = bed_mutex_initialize(bed);
+
 		if (status == BED_SUCCESS) {
-			chip_detected(bed);
+			status = bed_nand_detect(bed, chip_count, bed_nand_device_info_all);
 
-			status = bed_nand_detect_finalize(bed);
+			if (status == BED_SUCCESS) {
+				chip_detected(bed);
 
-			part->bed = bed;
-			part->size = bed->size;
+				status = bed_nand_detect_finalize(bed);
+			}
+
+			if (status == BED_SUCCESS) {
+				part->bed = bed;
+				part->size = bed->size;
+			} else {
+				bed_mutex_destroy(bed);
+			}
 		}
 
 		if (status != BED_SUCCESS) {
@@ -562,7 +1407,229 @@ bed_partition *bed_nand_simulator_create(
 	return part;
 }
 
+static nand_sim_context *get_sim_context(const bed_partition *part)
+{
+	const bed_nand_context *nand = part->bed->context;
+
+	return nand->context;
+}
+
 void bed_nand_simulator_destroy(bed_partition *part)
 {
+	nand_sim_context *sim = get_sim_context(part);
+	bed_nand_context *nand = part->bed->context;
+	uint16_t i;
+
+	bed_nand_simulator_stop_threads(part);
+	erase_pages(sim, 0, sim->page_count);
+
+	if (nand->chip_locks != NULL) {
+		for (i = 0; i < part->bed->chip_count; ++i) {
+			bed_lock_destroy(&nand->chip_locks [i].lock);
+		}
+
+		bed_lock_destroy(&nand->bus_lock);
+	}
+
+	bed_mutex_destroy(part->bed);
 	free(part);
 }
+
+struct bed_nand_simulator_image {
+	uint32_t page_count;
+	uint16_t page_with_oob_size;
+	nand_sim_page *pages [];
+};
+
+bed_nand_simulator_image *bed_nand_simulator_snapshot(const bed_partition *part)
+{
+	const nand_sim_context *sim = get_sim_context(part);
+	uint32_t page_count = sim->page_count;
+	bed_nand_simulator_image *image;
+
+	wait_for_all_chips(sim);
+
+	image = malloc(sizeof(*image) + page_count * sizeof(image->pages [0]));
+	if (image != NULL) {
+		uint32_t i;
+
+		image->page_count = page_count;
+		image->page_with_oob_size = sim->page_with_oob_size;
+
+		for (i = 0; i < page_count; ++i) {
+			image->pages [i] = acquire_page(sim->pages [i]);
+		}
+	}
+
+	return image;
+}
+
+bed_status bed_nand_simulator_restore(
+	const bed_partition *part,
+	const bed_nand_simulator_image *image
+)
+{
+	bed_status status = BED_SUCCESS;
+	nand_sim_context *sim = get_sim_context(part);
+
+	wait_for_all_chips(sim);
+
+	if (
+		image->page_count == sim->page_count
+			&& image->page_with_oob_size == sim->page_with_oob_size
+	) {
+		uint32_t i;
+
+		for (i = 0; i < image->page_count; ++i) {
+			nand_sim_page *p = acquire_page(image->pages [i]);
+
+			release_page(sim->pages [i]);
+			sim->pages [i] = p;
+		}
+	} else {
+		status = BED_ERROR_UNSATISFIED;
+	}
+
+	return status;
+}
+
+void bed_nand_simulator_image_destroy(bed_nand_simulator_image *image)
+{
+	if (image != NULL) {
+		uint32_t i;
+
+		for (i = 0; i < image->page_count; ++i) {
+			release_page(image->pages [i]);
+		}
+
+		free(image);
+	}
+}
+
+void bed_nand_simulator_set_power_cut(
+	const bed_partition *part,
+	uint32_t operation,
+	uint8_t percent
+)
+{
+	nand_sim_context *sim = get_sim_context(part);
+
+	assert(percent <= 100);
+
+	sim->power_cut_operation = operation != 0 ?
+		sim->operation_count + operation : 0;
+	sim->power_cut_percent = percent;
+	sim->power_cut_pending = false;
+}
+
+uint32_t bed_nand_simulator_operation_count(const bed_partition *part)
+{
+	const nand_sim_context *sim = get_sim_context(part);
+
+	return __atomic_load_n(&sim->operation_count, __ATOMIC_RELAXED);
+}
+
+bool bed_nand_simulator_is_powered_off(const bed_partition *part)
+{
+	const nand_sim_context *sim = get_sim_context(part);
+
+	return sim->powered_off;
+}
+
+void bed_nand_simulator_power_on(const bed_partition *part)
+{
+	nand_sim_context *sim = get_sim_context(part);
+
+	wait_for_all_chips(sim);
+
+	sim->state = IDLE;
+	sim->io_mode = SIM_IO_UNDEFINED;
+	sim->power_cut_operation = 0;
+	sim->power_cut_pending = false;
+	sim->powered_off = false;
+}
+
+uint64_t bed_nand_simulator_busy_time(const bed_partition *part)
+{
+	const nand_sim_context *sim = get_sim_context(part);
+
+	return __atomic_load_n(&sim->busy_time, __ATOMIC_RELAXED);
+}
+
+#ifndef __rtems__
+static void stop_chip_threads(nand_sim_context *sim, uint16_t n)
+{
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		nand_sim_chip *chip = &sim->chips [i];
+
+		submit_operation(sim, chip, SIM_OP_STOP, 0, 0, 0);
+		pthread_join(chip->thread, NULL);
+		sem_destroy(&chip->work);
+	}
+
+	sim->threads_running = false;
+}
+#endif /* __rtems__ */
+
+bed_status bed_nand_simulator_start_threads(
+	const bed_partition *part,
+	uint32_t time_scale
+)
+{
+#ifndef __rtems__
+	bed_status status = BED_SUCCESS;
+	nand_sim_context *sim = get_sim_context(part);
+	uint16_t i;
+
+	assert(!sim->threads_running);
+
+	sim->time_scale = time_scale;
+
+	for (i = 0; status == BED_SUCCESS && i < sim->chip_count; ++i) {
+		nand_sim_chip *chip = &sim->chips [i];
+		int eno;
+
+		eno = sem_init(&chip->work, 0, 0);
+		if (eno == 0) {
+			eno = pthread_create(&chip->thread, NULL, chip_thread, chip);
+			if (eno != 0) {
+				sem_destroy(&chip->work);
+			}
+		}
+
+		if (eno != 0) {
+			status = BED_ERROR_SYSTEM;
+		}
+	}
+
+	sim->threads_running = true;
+
+	if (status != BED_SUCCESS) {
+		stop_chip_threads(sim, (uint16_t) (i - 1));
+	}
+
+	return status;
+#else /* __rtems__ */
+	return BED_ERROR_OP_NOT_SUPPORTED;
+#endif /* __rtems__ */
+}
+
+void bed_nand_simulator_stop_threads(const bed_partition *part)
+{
+#ifndef __rtems__
+	nand_sim_context *sim = get_sim_context(part);
+
+	if (sim->threads_running) {
+		stop_chip_threads(sim, sim->chip_count);
+	}
+#endif /* __rtems__ */
+}
+
+bed_status bed_nand_simulator_enable_chip_locking(const bed_partition *part)
+{
+	nand_sim_context *sim = get_sim_context(part);
+
+	return bed_nand_enable_chip_locking(part->bed, sim->chip_locks);
+}
@@ -24,6 +24,149 @@ static const bed_oob_request null_oob = {
 	.data = NULL
 };
 
+#ifndef BED_CONFIG_READ_ONLY
+static void obtain_chip(bed_device *bed, uint16_t chip)
+{
+	bed_nand_context *nand = bed->context;
+
+	if (nand->chip_locks != NULL) {
+		bed_lock_obtain(&nand->chip_locks [chip].lock);
+	}
+}
+#endif /* BED_CONFIG_READ_ONLY */
+
+/*
+ * Announces the read to an erase in progress on this chip, so that it can be
+ * suspended.
+ */
+static void obtain_chip_for_read(bed_device *bed, uint16_t chip)
+{
+	bed_nand_context *nand = bed->context;
+
+	if (nand->chip_locks != NULL) {
+		bed_nand_chip_lock *chip_lock = &nand->chip_locks [chip];
+
+		if ((nand->flags & BED_NAND_FLG_ERASE_SUSPEND) != 0) {
+			__atomic_add_fetch(&chip_lock->pending_reads, 1, __ATOMIC_RELAXED);
+			bed_lock_obtain(&chip_lock->lock);
+			__atomic_sub_fetch(&chip_lock->pending_reads, 1, __ATOMIC_RELAXED);
+			++chip_lock->granted_reads;
+		} else {
+			bed_lock_obtain(&chip_lock->lock);
+		}
+	}
+}
+
+static void release_chip(bed_device *bed, uint16_t chip)
+{
+	bed_nand_context *nand = bed->context;
+
+	if (nand->chip_locks != NULL) {
+		bed_lock_release(&nand->chip_locks [chip].lock);
+	}
+}
+
+static void obtain_bus(bed_device *bed, uint16_t chip)
+{
+	bed_nand_context *nand = bed->context;
+
+	if (nand->chip_locks != NULL) {
+		bed_lock_obtain(&nand->bus_lock);
+	}
+
+	bed_select_chip(bed, chip);
+}
+
+static void release_bus(bed_device *bed)
+{
+	bed_nand_context *nand = bed->context;
+
+	if (nand->chip_locks != NULL) {
+		bed_lock_release(&nand->bus_lock);
+	}
+}
+
+#ifndef BED_CONFIG_READ_ONLY
+/*
+ * Lets other chips use the bus while this chip is busy with a program or
+ * erase operation.  The chip is selected and the bus is owned on return.
+ */
+static void wait_for_chip(bed_device *bed, uint16_t chip)
+{
+	bed_nand_context *nand = bed->context;
+
+	if (nand->chip_locks != NULL) {
+		while (!(*nand->is_ready)(bed)) {
+			release_bus(bed);
+			bed_lock_yield();
+			obtain_bus(bed, chip);
+		}
+	}
+}
+
+static bool has_pending_reads(const bed_nand_chip_lock *chip_lock)
+{
+	return __atomic_load_n(&chip_lock->pending_reads, __ATOMIC_RELAXED) > 0;
+}
+
+/*
+ * Suspends the erase and lets the reads waiting at the suspension use the
+ * chip.  Reads arriving later wait for the next suspension, so that a steady
+ * stream of reads cannot keep the erase suspended.  The chip is selected and
+ * the bus is owned on return.
+ */
+static void suspend_erase_for_reads(bed_device *bed, uint16_t chip)
+{
+	bed_nand_context *nand = bed->context;
+	bed_nand_chip_lock *chip_lock = &nand->chip_locks [chip];
+	uint32_t batch = __atomic_load_n(&chip_lock->pending_reads, __ATOMIC_RELAXED);
+	uint32_t granted = chip_lock->granted_reads;
+
+	(*nand->command)(bed, BED_NAND_CMD_ERASE_SUSPEND, 0, 0);
+	release_bus(bed);
+
+	do {
+		bed_lock_release(&chip_lock->lock);
+		bed_lock_yield();
+		bed_lock_obtain(&chip_lock->lock);
+	} while (
+		has_pending_reads(chip_lock)
+			&& chip_lock->granted_reads - granted < batch
+	);
+
+	obtain_bus(bed, chip);
+	(*nand->command)(bed, BED_NAND_CMD_ERASE_RESUME, 0, 0);
+}
+
+static void wait_for_erase(bed_device *bed, uint16_t chip)
+{
+	bed_nand_context *nand = bed->context;
+
+	if (nand->chip_locks != NULL && (nand->flags & BED_NAND_FLG_ERASE_SUSPEND) != 0) {
+		const bed_nand_chip_lock *chip_lock = &nand->chip_locks [chip];
+		int suspend_count = 0;
+
+		while (!(*nand->is_ready)(bed)) {
+			if (suspend_count < BED_NAND_MAX_ERASE_SUSPENDS && has_pending_reads(chip_lock)) {
+				suspend_erase_for_reads(bed, chip);
+				++suspend_count;
+			} else {
+				release_bus(bed);
+				bed_lock_yield();
+				obtain_bus(bed, chip);
+			}
+		}
+	} else {
+		wait_for_chip(bed, chip);
+	}
+}
+#endif /* BED_CONFIG_READ_ONLY */
+
+static void obtain_nothing(bed_device *bed)
+{
+	(void) bed;
+}
+
 void bed_nand_wait_for_ready(bed_device *bed)
 {
 	bed_nand_context *nand = bed->context;
@@ -146,7 +289,8 @@ bed_status bed_nand_is_block_valid(bed_device *bed, bed_address addr)
 		uint32_t page = ((uint32_t) (addr >> bed->page_shift)) & bed->page_mask;
 		int i = 0;
 
-		bed_select_chip(bed, chip);
+		obtain_chip_for_read(bed, chip);
+		obtain_bus(bed, chip);
 
 		if ((nand->bbc.flags & BED_NAND_BBC_CHECK_LAST_PAGE) != 0) {
 			page = bed->pages_per_block - 1U;
@@ -157,6 +301,9 @@ bed_status bed_nand_is_block_valid(bed_device *bed, bed_address addr)
 			++i;
 			page += bed->pages_per_block;
 		} while ((nand->bbc.flags & BED_NAND_BBC_CHECK_SECOND_PAGE) != 0 && status == BED_SUCCESS && i < 2);
+
+		release_bus(bed);
+		release_chip(bed, chip);
 	} else {
 		status = BED_ERROR_INVALID_ADDRESS;
 	}
@@ -187,13 +334,15 @@ static void copy_oob(
 					size_t s = range->size - offset;
 					size_t k = s < size ? s : size;
 
-					memcpy(data, oob_buffer + range->offset, k);
-					++range;
+					memcpy(data, oob_buffer + range->offset + offset, k);
 					size -= k;
 					data += k;
+					offset = 0;
 				} else {
 					offset -= range->size;
 				}
+
+				++range;
 			}
 
 			memset(data, 0, size);
@@ -253,7 +402,8 @@ bed_status bed_nand_read_oob(
 		uint16_t chip = (uint16_t) (addr >> bed->chip_shift);
 		uint32_t page = ((uint32_t) (addr >> bed->page_shift)) & bed->page_mask;
 
-		bed_select_chip(bed, chip);
+		obtain_chip_for_read(bed, chip);
+		obtain_bus(bed, chip);
 
 		if (n != 0) {
 			(*nand->command)(bed, BED_NAND_CMD_READ_PAGE, page, 0);
@@ -263,6 +413,9 @@ bed_status bed_nand_read_oob(
 		}
 
 		copy_oob(nand, oob);
+
+		release_bus(bed);
+		release_chip(bed, chip);
 	} else {
 		status = BED_ERROR_INVALID_ADDRESS;
 	}
@@ -270,6 +423,39 @@ bed_status bed_nand_read_oob(
 	return status;
 }
 
+bed_status bed_nand_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_nand_context *nand = bed->context;
+	uint16_t chip = (uint16_t) (addr >> bed->chip_shift);
+	uint32_t page = ((uint32_t) (addr >> bed->page_shift)) & bed->page_mask;
+
+	obtain_chip_for_read(bed, chip);
+	obtain_bus(bed, chip);
+	(*nand->command)(bed, BED_NAND_CMD_READ_PAGE, page, 0);
+
+	if (nand->read_partial != NULL && bed_nand_has_large_pages(bed)) {
+		status = (*nand->read_partial)(bed, page, offset, data, n);
+	} else {
+		/* The bus lock protects the trash buffer */
+		uint8_t *page_buffer = bed_trash_buffer(bed->page_size);
+
+		status = (*nand->read_page)(bed, page, page_buffer, true);
+		memcpy(data, page_buffer + offset, n);
+	}
+
+	release_bus(bed);
+	release_chip(bed, chip);
+
+	return status;
+}
+
 static uint8_t read_status(bed_device *bed)
 {
 	bed_nand_context *nand = bed->context;
@@ -315,13 +501,15 @@ static void fill_oob(
 					size_t s = range->size - offset;
 					size_t k = s < size ? s : size;
 
-					memcpy(oob_buffer + range->offset, data, k);
-					++range;
+					memcpy(oob_buffer + range->offset + offset, data, k);
 					size -= k;
 					data += k;
+					offset = 0;
 				} else {
 					offset -= range->size;
 				}
+
+				++range;
 			}
 
 			break;
@@ -352,19 +540,29 @@ bed_status bed_nand_write_oob(
 {
 	bed_status status = BED_SUCCESS;
 
-	if (n == bed->page_size) {
+	if (n == bed->page_size || (n == 0 && oob->size > 0)) {
 		bed_nand_context *nand = bed->context;
 		uint16_t chip = (uint16_t) (addr >> bed->chip_shift);
 		uint32_t page = ((uint32_t) (addr >> bed->page_shift)) & bed->page_mask;
 
+		obtain_chip(bed, chip);
+		obtain_bus(bed, chip);
 		fill_oob(bed, nand, oob);
-		bed_select_chip(bed, chip);
-		(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE, page, 0);
-		status = (*nand->write_page)(bed, page, data, oob->mode == BED_OOB_MODE_AUTO);
-		if (status == BED_SUCCESS) {
-			(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE_2, 0, 0);
-			status = bed_nand_check_status(bed, BED_ERROR_WRITE);
+
+		if (n != 0) {
+			(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE, page, 0);
+			status = (*nand->write_page)(bed, page, data, oob->mode == BED_OOB_MODE_AUTO);
+			if (status == BED_SUCCESS) {
+				(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE_2, 0, 0);
+				wait_for_chip(bed, chip);
+				status = bed_nand_check_status(bed, BED_ERROR_WRITE);
+			}
+		} else {
+			status = (*nand->write_oob_only)(bed, page);
 		}
+
+		release_bus(bed);
+		release_chip(bed, chip);
 	} else {
 		status = BED_ERROR_INVALID_ADDRESS;
 	}
@@ -381,10 +579,14 @@ bed_status bed_nand_erase(bed_device *bed, bed_address addr)
 		uint16_t chip = (uint16_t) (addr >> bed->chip_shift);
 		uint32_t page = ((uint32_t) (addr >> bed->page_shift)) & bed->page_mask;
 
-		bed_select_chip(bed, chip);
+		obtain_chip(bed, chip);
+		obtain_bus(bed, chip);
 		(*nand->command)(bed, BED_NAND_CMD_ERASE_BLOCK, page, 0);
 		(*nand->command)(bed, BED_NAND_CMD_ERASE_BLOCK_2, 0, 0);
+		wait_for_erase(bed, chip);
 		status = bed_nand_check_status(bed, BED_ERROR_ERASE);
+		release_bus(bed);
+		release_chip(bed, chip);
 	} else {
 		status = BED_ERROR_INVALID_ADDRESS;
 	}
@@ -407,7 +609,8 @@ static bed_status write_bad_block_mark(bed_device *bed, bed_address addr)
 	};
 	int i = 0;
 
-	bed_select_chip(bed, chip);
+	obtain_chip(bed, chip);
+	obtain_bus(bed, chip);
 
 	if ((nand->flags & BED_NAND_FLG_BUS_WIDTH_16) != 0) {
 		oob.offset = (uint16_t) (oob.offset & ~0x1);
@@ -427,6 +630,9 @@ static bed_status write_bad_block_mark(bed_device *bed, bed_address addr)
 		page += bed->pages_per_block;
 	} while ((nand->bbc.flags & BED_NAND_BBC_CHECK_SECOND_PAGE) != 0 && status == BED_SUCCESS && i < 2);
 
+	release_bus(bed);
+	release_chip(bed, chip);
+
 	return status;
 }
 
@@ -448,6 +654,38 @@ bed_status bed_nand_mark_block_bad(bed_device *bed, bed_address addr)
 	return status;
 }
 
+bed_status bed_nand_write_oob_only(bed_device *bed, uint32_t page)
+{
+	bed_status status = BED_SUCCESS;
+	bed_nand_context *nand = bed->context;
+	const uint8_t *oob_buffer = nand->oob_buffer;
+	uint16_t begin = 0;
+	uint16_t end = bed->oob_size;
+
+	while (begin < end && oob_buffer [begin] == 0xff) {
+		++begin;
+	}
+
+	while (end > begin && oob_buffer [end - 1] == 0xff) {
+		--end;
+	}
+
+	if ((nand->flags & BED_NAND_FLG_BUS_WIDTH_16) != 0) {
+		begin = (uint16_t) (begin & ~0x1);
+		end = (uint16_t) ((end + 1) & ~0x1);
+	}
+
+	if (begin != end) {
+		(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE, page, (uint16_t) (bed->page_size + begin));
+		(*nand->write_buffer)(bed, oob_buffer + begin, (size_t) (end - begin));
+		(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE_2, 0, 0);
+		wait_for_chip(bed, bed->current_chip);
+		status = bed_nand_check_status(bed, BED_ERROR_WRITE);
+	}
+
+	return status;
+}
+
 bed_status bed_nand_mark_page_bad(bed_device *bed, uint32_t page)
 {
 	bed_nand_context *nand = bed->context;
@@ -455,6 +693,7 @@ bed_status bed_nand_mark_page_bad(bed_device *bed, uint32_t page)
 	(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE, page, bed->page_size);
 	(*nand->write_buffer)(bed, nand->oob_buffer, bed->oob_size);
 	(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE_2, 0, 0);
+	wait_for_chip(bed, bed->current_chip);
 
 	return bed_nand_check_status(bed, BED_ERROR_WRITE);
 }
@@ -632,6 +871,7 @@ static bed_status micron_check_for_internal_ecc(bed_device *bed)
 					nand->oob_ecc_ranges = NULL;
 					nand->boxed_read_page = nand->read_page;
 					nand->read_page = micron_internal_ecc_read_page;
+					nand->read_partial = NULL;
 #ifndef BED_CONFIG_READ_ONLY
 					nand->boxed_write_page = nand->write_page;
 					nand->write_page = micron_internal_ecc_write_page;
@@ -802,7 +1042,7 @@ bed_status bed_nand_detect(
 
 			get_chip_id(bed, other_id, sizeof(other_id));
 
-			if (memcmp(nand->id, other_id, sizeof(nand->id)) != 0) {
+			if (memcmp(nand->id, other_id, sizeof(other_id)) != 0) {
 				break;
 			}
 		}
@@ -819,3 +1059,43 @@ bed_status bed_nand_detect_finalize(bed_device *bed)
 
 	return status;
 }
+
+bed_status bed_nand_enable_chip_locking(
+	bed_device *bed,
+	bed_nand_chip_lock *chip_locks
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_nand_context *nand = bed->context;
+	uint16_t i = 0;
+
+	assert(nand->chip_locks == NULL);
+
+	status = bed_lock_initialize(&nand->bus_lock);
+
+	while (status == BED_SUCCESS && i < bed->chip_count) {
+		chip_locks [i].pending_reads = 0;
+		chip_locks [i].granted_reads = 0;
+		status = bed_lock_initialize(&chip_locks [i].lock);
+		++i;
+	}
+
+	if (status == BED_SUCCESS) {
+		nand->chip_locks = chip_locks;
+		bed->obtain = obtain_nothing;
+		bed->release = obtain_nothing;
+	} else {
+		if (i > 0) {
+			--i;
+
+			while (i > 0) {
+				--i;
+				bed_lock_destroy(&chip_locks [i].lock);
+			}
+
+			bed_lock_destroy(&nand->bus_lock);
+		}
+	}
+
+	return status;
+}
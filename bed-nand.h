@@ -91,6 +91,8 @@ typedef enum {
 	BED_NAND_CMD_PROGRAM_PAGE_CACHE_2 = 0x15,
 	BED_NAND_CMD_ERASE_BLOCK = (0x60 | BED_NAND_CMD_ADDR_ROW),
 	BED_NAND_CMD_ERASE_BLOCK_2 = 0xd0,
+	BED_NAND_CMD_ERASE_SUSPEND = (0x61 | BED_NAND_CMD_WAIT_FOR_READY),
+	BED_NAND_CMD_ERASE_RESUME = 0xd2,
 	BED_NAND_CMD_READ_FOR_INTERNAL_DATA_MOVE = (0x00 | BED_NAND_CMD_ADDR_COLUMN | BED_NAND_CMD_ADDR_ROW),
 	BED_NAND_CMD_READ_FOR_INTERNAL_DATA_MOVE_2 = 0x35,
 	BED_NAND_CMD_PROGRAM_FOR_INTERNAL_DATA_MOVE = (0x85 | BED_NAND_CMD_ADDR_COLUMN | BED_NAND_CMD_ADDR_ROW),
@@ -132,10 +134,14 @@ typedef bed_status (*bed_nand_read_oob_only_method)(bed_device *bed, uint32_t pa
 
 typedef bed_status (*bed_nand_read_page_method)(bed_device *bed, uint32_t page, uint8_t *data, bool use_ecc);
 
+typedef bed_status (*bed_nand_read_partial_method)(bed_device *bed, uint32_t page, uint16_t column, uint8_t *data, size_t n);
+
 typedef void (*bed_nand_write_buffer_method)(bed_device *bed, const uint8_t *data, size_t n);
 
 typedef bed_status (*bed_nand_write_page_method)(bed_device *bed, uint32_t page, const uint8_t *data, bool use_ecc);
 
+typedef bed_status (*bed_nand_write_oob_only_method)(bed_device *bed, uint32_t page);
+
 typedef bed_status (*bed_nand_mark_page_bad_method)(bed_device *bed, uint32_t page);
 
 #define BED_NAND_BBC_CHECK_SECOND_PAGE 0x1
@@ -149,6 +155,10 @@ typedef struct {
 
 #define BED_NAND_FLG_BUS_WIDTH_16 0x1
 
+#define BED_NAND_FLG_ERASE_SUSPEND 0x2
+
+#define BED_NAND_MAX_ERASE_SUSPENDS 8
+
 #define BED_NAND_MAX_OOB_SIZE 576
 
 #define BED_NAND_MAX_PAGE_SIZE 8192
@@ -158,6 +168,17 @@ typedef struct {
 	uint16_t size;
 } bed_nand_range;
 
+/**
+ * @brief Lock of a chip.
+ *
+ * @see bed_nand_enable_chip_locking().
+ */
+typedef struct {
+	bed_lock lock;
+	uint32_t pending_reads;
+	uint32_t granted_reads;
+} bed_nand_chip_lock;
+
 extern const bed_nand_range bed_nand_oob_free_ranges_16 [];
 
 extern const bed_nand_range bed_nand_oob_ecc_ranges_16 [];
@@ -247,8 +268,17 @@ struct bed_nand_context {
 	bed_nand_write_buffer_method write_buffer;
 	bed_nand_read_oob_only_method read_oob_only;
 	bed_nand_read_page_method read_page;
+
+	/**
+	 * @brief Reads a column range of the page in the cache register with
+	 * RANDOM DATA OUTPUT and checks the ECC of the touched chunks.
+	 *
+	 * May be @c NULL.  In this case the whole page is read.
+	 */
+	bed_nand_read_partial_method read_partial;
 #ifndef BED_CONFIG_READ_ONLY
 	bed_nand_write_page_method write_page;
+	bed_nand_write_oob_only_method write_oob_only;
 	bed_nand_mark_page_bad_method mark_page_bad;
 #endif /* BED_CONFIG_READ_ONLY */
         void *context;
@@ -263,6 +293,8 @@ struct bed_nand_context {
 #ifndef BED_CONFIG_READ_ONLY
 	bed_nand_write_page_method boxed_write_page;
 #endif /* BED_CONFIG_READ_ONLY */
+	bed_lock bus_lock;
+	bed_nand_chip_lock *chip_locks;
 };
 
 void bed_nand_set_default_oob_layout(bed_device *bed);
@@ -281,8 +313,60 @@ bed_status bed_nand_read_oob_only(bed_device *bed, uint32_t page);
 
 bed_status bed_nand_read_oob_only_with_trash(bed_device *bed, uint32_t page);
 
+/**
+ * @brief Programs the OOB buffer to the spare area of a page.
+ *
+ * Leading and trailing 0xff bytes of the OOB buffer are not transferred.
+ * The column address selects the first programmed byte.
+ */
+bed_status bed_nand_write_oob_only(bed_device *bed, uint32_t page);
+
 bed_status bed_nand_mark_page_bad(bed_device *bed, uint32_t page);
 
+/**
+ * @brief Replaces the device lock with one lock per chip and a bus lock.
+ *
+ * Each device operation owns the lock of the addressed chip for its
+ * duration.  The chip select state, the command, address and data phases
+ * and the OOB buffer are protected by the bus lock.  A page read owns the bus
+ * until the data transfer is complete.  During a page program or block erase
+ * the bus is released while the chip is busy and the chip is polled with the
+ * ready method under the bus lock.  Thus tasks using different chips overlap
+ * their busy times.  With a ready line shared by all chips this degrades to
+ * serialized busy times.
+ *
+ * In case the BED_NAND_FLG_ERASE_SUSPEND flag is set, then a block erase is
+ * suspended while page reads wait for the chip.  The erase is resumed once
+ * the reads waiting at the suspension are done.  An erase is suspended at
+ * most BED_NAND_MAX_ERASE_SUSPENDS times, so a stream of reads cannot starve
+ * it.
+ *
+ * The device obtain and release methods do nothing afterwards, so
+ * bed_obtain() no longer serializes the users of the device.  Each device
+ * operation remains atomic with respect to its chip, however, a sequence of
+ * operations between bed_obtain() and bed_release() may interleave with the
+ * operations of other tasks.  Layers which need a sequence of operations to
+ * be atomic must use their own lock and must be the only users of their
+ * device area.  The remap partition, the scrubber partition, the volume
+ * manager and the YAFFS glue do so.  Other layers on top of this device must
+ * not rely on bed_obtain() for mutual exclusion.
+ *
+ * Call this function after the chip detection and before the device is used.
+ *
+ * @param[in] bed The NAND device.
+ * @param[in] chip_locks Storage for one lock per chip.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_SYSTEM Lock creation failed.
+ */
+bed_status bed_nand_enable_chip_locking(
+	bed_device *bed,
+	bed_nand_chip_lock *chip_locks
+);
+
+#define bed_nand_write_oob_only_not_supported \
+	((bed_nand_write_oob_only_method) bed_op_not_supported)
+
 #define bed_nand_mark_page_bad_not_supported \
 	((bed_nand_mark_page_bad_method) bed_op_not_supported)
 
@@ -301,6 +385,14 @@ bed_status bed_nand_read_oob(
 	const bed_oob_request *oob
 );
 
+bed_status bed_nand_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+);
+
 bed_status bed_nand_write(
 	bed_device *bed,
 	bed_address addr,
@@ -406,8 +498,237 @@ bed_partition *bed_nand_simulator_create(
 	uint16_t page_size
 );
 
+/**
+ * @brief NAND simulator profile describing a real part.
+ *
+ * The simulator reports the ID bytes and, if the ONFI revision is non-zero,
+ * an ONFI parameter page generated from this profile.  Parts with a zero
+ * ONFI revision must be present in the device information table.  The
+ * timings are used for the busy time accounting.
+ *
+ * @see bed_nand_simulator_create_with_profile().
+ */
+typedef struct {
+	const char *name;
+	uint8_t id [8];
+	uint16_t onfi_revision;
+	uint16_t page_size;
+	uint16_t oob_size;
+	uint16_t pages_per_block;
+	uint32_t blocks_per_lun;
+	uint8_t lun_count;
+	uint8_t plane_count;
+	uint8_t bits_per_cell;
+	uint8_t bits_ecc_correctability;
+	uint8_t programs_per_page;
+	bool bus_width_16;
+
+	/**
+	 * @brief Maximum page read time in microseconds.
+	 */
+	uint16_t t_r;
+
+	/**
+	 * @brief Maximum page program time in microseconds.
+	 */
+	uint16_t t_prog;
+
+	/**
+	 * @brief Maximum block erase time in microseconds.
+	 */
+	uint16_t t_bers;
+
+	/**
+	 * @brief The chips support the erase suspend and resume commands.
+	 */
+	bool erase_suspend;
+} bed_nand_simulator_profile;
+
+/**
+ * @brief Micron MT29F2G08AACWP, 2 Gbit SLC, 8-bit bus, 1-bit ECC.
+ */
+extern const bed_nand_simulator_profile bed_nand_simulator_mt29f2g08aacwp;
+
+/**
+ * @brief Micron MT29F2G16AACWP, 2 Gbit SLC, 16-bit bus, 1-bit ECC.
+ */
+extern const bed_nand_simulator_profile bed_nand_simulator_mt29f2g16aacwp;
+
+/**
+ * @brief Micron MT29F4G08ABADA, 4 Gbit SLC with on-die ECC.
+ */
+extern const bed_nand_simulator_profile bed_nand_simulator_mt29f4g08abada;
+
+/**
+ * @brief Micron MT29F8G08ADADA, 8 Gbit SLC with two LUNs and on-die ECC.
+ */
+extern const bed_nand_simulator_profile bed_nand_simulator_mt29f8g08adada;
+
+/**
+ * @brief Micron MT29F16G08CBACA, 16 Gbit MLC with 4 KiB pages.
+ */
+extern const bed_nand_simulator_profile bed_nand_simulator_mt29f16g08cbaca;
+
+/**
+ * @brief Samsung K9F1208U0C, 512 Mbit SLC with small pages and without ONFI.
+ */
+extern const bed_nand_simulator_profile bed_nand_simulator_k9f1208u0c;
+
+/**
+ * @brief Creates a NAND simulator behaving like the part of the profile.
+ *
+ * The simulator supports the Micron on-die ECC feature if the profile ID
+ * indicates it.  Parts with large pages may have a 16-bit bus.
+ *
+ * @param[in] profile The simulator profile.  It is copied and may be
+ * discarded after the call.
+ * @param[in] chip_count The count of chips.
+ *
+ * @retval NULL Not enough memory or detection failed.
+ * @retval part The simulator partition.
+ */
+bed_partition *bed_nand_simulator_create_with_profile(
+	const bed_nand_simulator_profile *profile,
+	uint16_t chip_count
+);
+
+/**
+ * @brief Returns the accumulated busy time of the NAND simulator.
+ *
+ * Each page read, page program and block erase adds the maximum operation
+ * time of the simulator profile.
+ *
+ * @param[in] part The simulator partition.
+ *
+ * @return The busy time in microseconds.
+ */
+uint64_t bed_nand_simulator_busy_time(const bed_partition *part);
+
+/**
+ * @brief Starts one thread per chip to perform the array operations.
+ *
+ * Page reads, page programs and block erases are queued for the thread of
+ * the selected chip and the chip is busy until they are complete.  The
+ * data output and input wait for the operations using the cache register,
+ * so a cache read transfers data while the next page is loaded.  The status
+ * shows the ready bit only for an idle chip.
+ *
+ * @param[in] part The simulator partition.
+ * @param[in] time_scale The chip threads sleep this percentage of the
+ * profile operation times after each operation.  A value of zero disables
+ * the sleep.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_SYSTEM Thread creation failed.
+ * @retval BED_ERROR_OP_NOT_SUPPORTED Threads are not supported on this
+ * platform.
+ */
+bed_status bed_nand_simulator_start_threads(
+	const bed_partition *part,
+	uint32_t time_scale
+);
+
+/**
+ * @brief Waits for all pending operations and stops the chip threads.
+ *
+ * @param[in] part The simulator partition.
+ */
+void bed_nand_simulator_stop_threads(const bed_partition *part);
+
+/**
+ * @brief Enables the per-chip locking of the simulator.
+ *
+ * For profiles with erase suspend support, a block erase is suspended for
+ * waiting page reads, see bed_nand_enable_chip_locking().  In threaded mode
+ * the erase time of the chip thread is split into slices and a suspend
+ * request takes effect at the end of the current slice.
+ *
+ * @param[in] part The simulator partition.
+ *
+ * @return See bed_nand_enable_chip_locking().
+ */
+bed_status bed_nand_simulator_enable_chip_locking(const bed_partition *part);
+
 void bed_nand_simulator_destroy(bed_partition *part);
 
+/**
+ * @brief NAND simulator flash array image.
+ *
+ * @see bed_nand_simulator_snapshot().
+ */
+typedef struct bed_nand_simulator_image bed_nand_simulator_image;
+
+/**
+ * @brief Takes a snapshot of the NAND simulator flash array.
+ *
+ * The pages are shared copy-on-write between the simulator, its snapshots
+ * and all simulators restored from a snapshot, so no page data is copied.
+ * Only the page table is duplicated.  Erased pages need no storage.
+ *
+ * @param[in] part The simulator partition.
+ *
+ * @retval NULL Not enough memory.
+ * @retval image The snapshot.
+ */
+bed_nand_simulator_image *bed_nand_simulator_snapshot(const bed_partition *part);
+
+/**
+ * @brief Restores the flash array of a NAND simulator from a snapshot.
+ *
+ * The snapshot may stem from another simulator with the same geometry.  It
+ * can be restored any number of times.
+ *
+ * @param[in] part The simulator partition.
+ * @param[in] image The snapshot.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED The geometry of the snapshot differs.
+ */
+bed_status bed_nand_simulator_restore(
+	const bed_partition *part,
+	const bed_nand_simulator_image *image
+);
+
+void bed_nand_simulator_image_destroy(bed_nand_simulator_image *image);
+
+/**
+ * @brief Arms a power cut in the NAND simulator.
+ *
+ * Page program and block erase operations are counted.  The operation with
+ * the specified number (one for the next operation) will be interrupted.
+ * It applies only the specified percentage of its array modifications, e.g.
+ * a program leaves a partially programmed page without OOB and ECC data and
+ * an erase leaves a partially erased block.  Afterwards the simulator is
+ * powered off.  It ignores all array modifications and reports a status
+ * without the ready bit until bed_nand_simulator_power_on() is called.
+ *
+ * @param[in] part The simulator partition.
+ * @param[in] operation The operation number relative to the current
+ * operation count.  A value of zero disarms the power cut.
+ * @param[in] percent The percentage of the interrupted operation which
+ * completes, zero cuts the power at the operation command.
+ */
+void bed_nand_simulator_set_power_cut(
+	const bed_partition *part,
+	uint32_t operation,
+	uint8_t percent
+);
+
+/**
+ * @brief Returns the count of page program and block erase operations
+ * started since simulator creation.
+ */
+uint32_t bed_nand_simulator_operation_count(const bed_partition *part);
+
+bool bed_nand_simulator_is_powered_off(const bed_partition *part);
+
+/**
+ * @brief Powers the NAND simulator on and disarms a pending power cut.
+ *
+ * The flash array contents survive.
+ */
+void bed_nand_simulator_power_on(const bed_partition *part);
+
 static inline bool bed_nand_has_large_pages(const bed_device *bed)
 {
 	return bed->page_size > 512;
@@ -19,17 +19,72 @@
 #include <string.h>
 #include <stdlib.h>
 
+typedef struct {
+	uint32_t refs;
+	uint8_t data[];
+} nor_sim_block;
+
 typedef struct {
 	bed_partition part;
 	bed_device device;
-	uint8_t area[];
+	nor_sim_block *blocks[];
 } nor_sim_context;
 
+struct bed_nor_simulator_image {
+	uint32_t block_count;
+	uint32_t block_size;
+	nor_sim_block *blocks[];
+};
+
 static nor_sim_context *nor_sim_get_context(const bed_device *bed)
 {
 	return bed->context;
 }
 
+static void nor_sim_release_block(nor_sim_block *b)
+{
+	if (b != NULL && __atomic_sub_fetch(&b->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(b);
+	}
+}
+
+static nor_sim_block *nor_sim_acquire_block(nor_sim_block *b)
+{
+	if (b != NULL) {
+		__atomic_add_fetch(&b->refs, 1, __ATOMIC_RELAXED);
+	}
+
+	return b;
+}
+
+/*
+ * Blocks are shared with snapshots and are copied before the first
+ * modification.  Erased blocks have no storage.
+ */
+static uint8_t *nor_sim_get_block_for_write(const bed_device *bed, nor_sim_context *ctx, uint32_t block)
+{
+	nor_sim_block *b = ctx->blocks[block];
+
+	if (b == NULL || __atomic_load_n(&b->refs, __ATOMIC_ACQUIRE) != 1) {
+		nor_sim_block *c = malloc(sizeof(*c) + bed->block_size);
+
+		assert(c != NULL);
+		c->refs = 1;
+
+		if (b != NULL) {
+			memcpy(&c->data[0], &b->data[0], bed->block_size);
+		} else {
+			memset(&c->data[0], 0xff, bed->block_size);
+		}
+
+		nor_sim_release_block(b);
+		ctx->blocks[block] = c;
+		b = c;
+	}
+
+	return &b->data[0];
+}
+
 static bed_status nor_sim_is_block_valid(bed_device *bed, bed_address addr)
 {
 	return BED_SUCCESS;
@@ -38,8 +93,25 @@ static bed_status nor_sim_is_block_valid(bed_device *bed, bed_address addr)
 static bed_status nor_sim_read(bed_device *bed, bed_address addr, void *data, size_t n)
 {
 	nor_sim_context *ctx = nor_sim_get_context(bed);
+	uint8_t *in = data;
+
+	while (n > 0) {
+		uint32_t block = addr >> bed->block_shift;
+		uint32_t offset = addr & (bed->block_size - 1);
+		size_t r = bed->block_size - offset;
+		size_t m = r < n ? r : n;
+		const nor_sim_block *b = ctx->blocks[block];
 
-	memcpy(data, &ctx->area[addr], n);
+		if (b != NULL) {
+			memcpy(in, &b->data[offset], m);
+		} else {
+			memset(in, 0xff, m);
+		}
+
+		addr += m;
+		in += m;
+		n -= m;
+	}
 
 	return BED_SUCCESS;
 }
@@ -49,11 +121,22 @@ static bed_status nor_sim_write(bed_device *bed, bed_address addr, const void *d
 {
 	nor_sim_context *ctx = nor_sim_get_context(bed);
 	const uint8_t *in = data;
-	uint8_t *out = &ctx->area[addr];
-	size_t i;
 
-	for (i = 0; i < n; ++i) {
-		out[i] &= in[i];
+	while (n > 0) {
+		uint32_t block = addr >> bed->block_shift;
+		uint32_t offset = addr & (bed->block_size - 1);
+		size_t r = bed->block_size - offset;
+		size_t m = r < n ? r : n;
+		uint8_t *out = nor_sim_get_block_for_write(bed, ctx, block) + offset;
+		size_t i;
+
+		for (i = 0; i < m; ++i) {
+			out[i] &= in[i];
+		}
+
+		addr += m;
+		in += m;
+		n -= m;
 	}
 
 	return BED_SUCCESS;
@@ -65,8 +148,10 @@ static bed_status nor_sim_erase(bed_device *bed, bed_address addr)
 
 	if (bed_is_block_aligned(bed, addr)) {
 		nor_sim_context *ctx = nor_sim_get_context(bed);
+		uint32_t block = addr >> bed->block_shift;
 
-		memset(&ctx->area[addr], 0xff, bed->block_size);
+		nor_sim_release_block(ctx->blocks[block]);
+		ctx->blocks[block] = NULL;
 	} else {
 		status = BED_ERROR_INVALID_ADDRESS;
 	}
@@ -81,18 +166,17 @@ bed_partition *bed_nor_simulator_create(
 )
 {
 	bed_partition *part = NULL;
-	uint32_t area_size = block_count * block_size;
 	nor_sim_context *sim;
+	size_t blocks_size = block_count * sizeof(sim->blocks[0]);
 
 	assert(bed_is_power_of_two(block_count));
 	assert(bed_is_power_of_two(block_size));
 
-	sim = malloc(sizeof(*sim) + area_size);
+	sim = malloc(sizeof(*sim) + blocks_size);
 	if (sim != NULL) {
 		bed_device *bed;
 
-		memset(sim, 0, sizeof(*sim));
-		memset(&sim->area[0], 0xff, area_size);
+		memset(sim, 0, sizeof(*sim) + blocks_size);
 
 		bed = &sim->device;
 		bed->context = sim;
@@ -102,6 +186,7 @@ bed_partition *bed_nor_simulator_create(
 		bed->is_block_valid = nor_sim_is_block_valid;
 		bed->read = nor_sim_read;
 		bed->read_oob = bed_read_oob_not_supported;
+		bed->read_partial = bed_default_read_partial;
 #ifndef BED_CONFIG_READ_ONLY
 		bed->write = nor_sim_write;
 		bed->write_oob = bed_write_oob_not_supported;
@@ -125,5 +210,75 @@ bed_partition *bed_nor_simulator_create(
 
 void bed_nor_simulator_destroy(bed_partition *part)
 {
+	nor_sim_context *ctx = nor_sim_get_context(part->bed);
+	uint32_t i;
+
+	for (i = 0; i < part->bed->blocks_per_chip; ++i) {
+		nor_sim_release_block(ctx->blocks[i]);
+	}
+
 	free(part);
 }
+
+bed_nor_simulator_image *bed_nor_simulator_snapshot(const bed_partition *part)
+{
+	const bed_device *bed = part->bed;
+	const nor_sim_context *ctx = nor_sim_get_context(bed);
+	uint32_t block_count = bed->blocks_per_chip;
+	bed_nor_simulator_image *image;
+
+	image = malloc(sizeof(*image) + block_count * sizeof(image->blocks[0]));
+	if (image != NULL) {
+		uint32_t i;
+
+		image->block_count = block_count;
+		image->block_size = bed->block_size;
+
+		for (i = 0; i < block_count; ++i) {
+			image->blocks[i] = nor_sim_acquire_block(ctx->blocks[i]);
+		}
+	}
+
+	return image;
+}
+
+bed_status bed_nor_simulator_restore(
+	const bed_partition *part,
+	const bed_nor_simulator_image *image
+)
+{
+	bed_status status = BED_SUCCESS;
+	const bed_device *bed = part->bed;
+	nor_sim_context *ctx = nor_sim_get_context(bed);
+
+	if (
+		image->block_count == bed->blocks_per_chip
+			&& image->block_size == bed->block_size
+	) {
+		uint32_t i;
+
+		for (i = 0; i < image->block_count; ++i) {
+			nor_sim_block *b = nor_sim_acquire_block(image->blocks[i]);
+
+			nor_sim_release_block(ctx->blocks[i]);
+			ctx->blocks[i] = b;
+		}
+	} else {
+		status = BED_ERROR_UNSATISFIED;
+	}
+
+	return status;
+}
+
+void bed_nor_simulator_image_destroy(bed_nor_simulator_image *image)
+{
+	if (image != NULL) {
+		uint32_t i;
+
+		for (i = 0; i < image->block_count; ++i) {
+			nor_sim_release_block(image->blocks[i]);
+		}
+
+		free(image);
+	}
+}
@@ -44,6 +44,36 @@ bed_partition *bed_nor_simulator_create(
 
 void bed_nor_simulator_destroy(bed_partition *part);
 
+/**
+ * @brief NOR simulator flash array image.
+ *
+ * @see bed_nor_simulator_snapshot().
+ */
+typedef struct bed_nor_simulator_image bed_nor_simulator_image;
+
+/**
+ * @brief Takes a snapshot of the NOR simulator flash array.
+ *
+ * The blocks are shared copy-on-write, see bed_nand_simulator_snapshot().
+ *
+ * @retval NULL Not enough memory.
+ * @retval image The snapshot.
+ */
+bed_nor_simulator_image *bed_nor_simulator_snapshot(const bed_partition *part);
+
+/**
+ * @brief Restores the flash array of a NOR simulator from a snapshot.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED The geometry of the snapshot differs.
+ */
+bed_status bed_nor_simulator_restore(
+	const bed_partition *part,
+	const bed_nor_simulator_image *image
+);
+
+void bed_nor_simulator_image_destroy(bed_nor_simulator_image *image);
+
 /** @} */
 
 #ifdef __cplusplus
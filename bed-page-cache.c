@@ -0,0 +1,781 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-page-cache.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_ENTRY UINT32_MAX
+
+/*
+ * An entry is busy while a page is read into its buffer.  Busy entries are
+ * neither in the hash table nor in the LRU list.
+ */
+typedef struct {
+	bed_address page;
+	uint32_t hash_next;
+	uint32_t lru_prev;
+	uint32_t lru_next;
+	bed_status status;
+	bool valid;
+	bool has_oob;
+	bool busy;
+	bool referenced;
+	uint8_t *data;
+} cache_entry;
+
+struct bed_page_cache {
+	bed_lock lock;
+	bed_page_cache_config config;
+	bed_device *lower;
+	bed_device device;
+	bed_partition part;
+	cache_entry *entries;
+	uint32_t *buckets;
+	uint32_t bucket_mask;
+	uint32_t lru_head;
+	uint32_t lru_tail;
+	uint32_t hand;
+	uint32_t generation;
+	bed_address next_sequential_page;
+	bed_page_cache_statistics statistics;
+};
+
+static const bed_oob_request null_oob = {
+	.mode = BED_OOB_MODE_AUTO,
+	.offset = 0,
+	.size = 0,
+	.data = NULL
+};
+
+static bed_page_cache *get_cache(const bed_device *bed)
+{
+	return bed->context;
+}
+
+static uint32_t *get_bucket(bed_page_cache *cache, bed_address page)
+{
+	uint32_t hash = (uint32_t) (page >> cache->lower->page_shift);
+
+	return &cache->buckets [hash & cache->bucket_mask];
+}
+
+static uint32_t find(bed_page_cache *cache, bed_address page)
+{
+	uint32_t i = *get_bucket(cache, page);
+
+	while (i != NO_ENTRY && cache->entries [i].page != page) {
+		i = cache->entries [i].hash_next;
+	}
+
+	return i;
+}
+
+static void hash_insert(bed_page_cache *cache, uint32_t i)
+{
+	cache_entry *entry = &cache->entries [i];
+	uint32_t *bucket = get_bucket(cache, entry->page);
+
+	entry->hash_next = *bucket;
+	*bucket = i;
+}
+
+static void hash_remove(bed_page_cache *cache, uint32_t i)
+{
+	cache_entry *entry = &cache->entries [i];
+	uint32_t *link = get_bucket(cache, entry->page);
+
+	while (*link != i) {
+		link = &cache->entries [*link].hash_next;
+	}
+
+	*link = entry->hash_next;
+}
+
+static void lru_remove(bed_page_cache *cache, uint32_t i)
+{
+	cache_entry *entry = &cache->entries [i];
+
+	if (entry->lru_prev != NO_ENTRY) {
+		cache->entries [entry->lru_prev].lru_next = entry->lru_next;
+	} else {
+		cache->lru_head = entry->lru_next;
+	}
+
+	if (entry->lru_next != NO_ENTRY) {
+		cache->entries [entry->lru_next].lru_prev = entry->lru_prev;
+	} else {
+		cache->lru_tail = entry->lru_prev;
+	}
+}
+
+static void lru_prepend(bed_page_cache *cache, uint32_t i)
+{
+	cache_entry *entry = &cache->entries [i];
+
+	entry->lru_prev = NO_ENTRY;
+	entry->lru_next = cache->lru_head;
+
+	if (cache->lru_head != NO_ENTRY) {
+		cache->entries [cache->lru_head].lru_prev = i;
+	} else {
+		cache->lru_tail = i;
+	}
+
+	cache->lru_head = i;
+}
+
+static void lru_append(bed_page_cache *cache, uint32_t i)
+{
+	cache_entry *entry = &cache->entries [i];
+
+	entry->lru_prev = cache->lru_tail;
+	entry->lru_next = NO_ENTRY;
+
+	if (cache->lru_tail != NO_ENTRY) {
+		cache->entries [cache->lru_tail].lru_next = i;
+	} else {
+		cache->lru_head = i;
+	}
+
+	cache->lru_tail = i;
+}
+
+static void touch(bed_page_cache *cache, uint32_t i)
+{
+	if (cache->config.policy == BED_PAGE_CACHE_LRU) {
+		lru_remove(cache, i);
+		lru_prepend(cache, i);
+	} else {
+		cache->entries [i].referenced = true;
+	}
+}
+
+static void remove_entry(bed_page_cache *cache, uint32_t i)
+{
+	hash_remove(cache, i);
+	cache->entries [i].valid = false;
+
+	if (cache->config.policy == BED_PAGE_CACHE_LRU) {
+		lru_remove(cache, i);
+		lru_append(cache, i);
+	}
+}
+
+static void invalidate_page(bed_page_cache *cache, bed_address page)
+{
+	uint32_t i = find(cache, page);
+
+	if (i != NO_ENTRY) {
+		remove_entry(cache, i);
+		++cache->statistics.invalidations;
+	}
+}
+
+static uint32_t select_victim(bed_page_cache *cache)
+{
+	uint32_t victim = NO_ENTRY;
+
+	if (cache->config.policy == BED_PAGE_CACHE_LRU) {
+		victim = cache->lru_tail;
+	} else {
+		uint32_t capacity = cache->config.capacity;
+		uint32_t steps;
+
+		for (steps = 0; steps < 2 * capacity && victim == NO_ENTRY; ++steps) {
+			cache_entry *entry = &cache->entries [cache->hand];
+
+			if (!entry->busy) {
+				if (entry->valid && entry->referenced) {
+					entry->referenced = false;
+				} else {
+					victim = cache->hand;
+				}
+			}
+
+			cache->hand = (cache->hand + 1) % capacity;
+		}
+	}
+
+	return victim;
+}
+
+/*
+ * Returns NO_ENTRY in case all entries are busy.  The page is then read
+ * without the cache.
+ */
+static uint32_t reserve(bed_page_cache *cache)
+{
+	uint32_t i = select_victim(cache);
+
+	if (i != NO_ENTRY) {
+		cache_entry *entry = &cache->entries [i];
+
+		if (entry->valid) {
+			hash_remove(cache, i);
+			entry->valid = false;
+			++cache->statistics.evictions;
+		}
+
+		if (cache->config.policy == BED_PAGE_CACHE_LRU) {
+			lru_remove(cache, i);
+		}
+
+		entry->busy = true;
+	}
+
+	return i;
+}
+
+/*
+ * The page is dropped if an invalidation happened during the read or another
+ * reader cached it in the meantime.
+ */
+static void finish(
+	bed_page_cache *cache,
+	uint32_t i,
+	bed_address page,
+	bool has_oob,
+	bed_status status,
+	uint32_t generation
+)
+{
+	cache_entry *entry = &cache->entries [i];
+
+	entry->busy = false;
+
+	if (
+		(status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED)
+			&& generation == cache->generation
+			&& find(cache, page) == NO_ENTRY
+	) {
+		entry->page = page;
+		entry->status = status;
+		entry->valid = true;
+		entry->has_oob = has_oob;
+		entry->referenced = true;
+		hash_insert(cache, i);
+
+		if (cache->config.policy == BED_PAGE_CACHE_LRU) {
+			lru_prepend(cache, i);
+		}
+	} else if (cache->config.policy == BED_PAGE_CACHE_LRU) {
+		lru_append(cache, i);
+	}
+}
+
+static bed_status read_page(
+	bed_page_cache *cache,
+	bed_address page,
+	uint8_t *data,
+	uint8_t *oob_data
+)
+{
+	bed_status status;
+	bed_device *lower = cache->lower;
+
+	(*lower->obtain)(lower);
+
+	if (oob_data != NULL) {
+		bed_oob_request oob = {
+			.mode = BED_OOB_MODE_AUTO,
+			.offset = 0,
+			.size = lower->oob_free_size,
+			.data = oob_data
+		};
+
+		status = (*lower->read_oob)(lower, page, data, lower->page_size, &oob);
+	} else {
+		status = (*lower->read)(lower, page, data, lower->page_size);
+	}
+
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static void copy_page(
+	const bed_device *bed,
+	const cache_entry *entry,
+	void *data,
+	const bed_oob_request *oob
+)
+{
+	memcpy(data, entry->data, bed->page_size);
+
+	if (oob->size > 0) {
+		memcpy(oob->data, entry->data + bed->page_size + oob->offset, oob->size);
+	}
+}
+
+static void read_ahead(bed_page_cache *cache, bed_address page, bool with_oob)
+{
+	bed_device *lower = cache->lower;
+	uint32_t count = cache->config.read_ahead;
+
+	page += lower->page_size;
+
+	while (count > 0 && !bed_is_block_aligned(lower, page)) {
+		uint32_t i = NO_ENTRY;
+		uint32_t generation;
+
+		bed_lock_obtain(&cache->lock);
+
+		if (find(cache, page) == NO_ENTRY) {
+			i = reserve(cache);
+		}
+
+		generation = cache->generation;
+		cache->next_sequential_page = page + lower->page_size;
+		bed_lock_release(&cache->lock);
+
+		if (i != NO_ENTRY) {
+			uint8_t *data = cache->entries [i].data;
+			bed_status status = read_page(
+				cache,
+				page,
+				data,
+				with_oob ? data + lower->page_size : NULL
+			);
+
+			bed_lock_obtain(&cache->lock);
+			++cache->statistics.read_aheads;
+			finish(cache, i, page, with_oob, status, generation);
+			bed_lock_release(&cache->lock);
+		}
+
+		page += lower->page_size;
+		--count;
+	}
+}
+
+static bool is_cacheable(
+	const bed_device *bed,
+	bed_address addr,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	return n == bed->page_size
+		&& (addr & (bed->page_size - 1U)) == 0
+		&& oob->mode == BED_OOB_MODE_AUTO;
+}
+
+static bed_status cache_read_oob(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_status status;
+	bed_page_cache *cache = get_cache(bed);
+
+	if (is_cacheable(bed, addr, n, oob)) {
+		bool with_oob = oob->size > 0;
+		uint32_t i;
+
+		bed_lock_obtain(&cache->lock);
+
+		i = find(cache, addr);
+
+		if (i != NO_ENTRY && (!with_oob || cache->entries [i].has_oob)) {
+			const cache_entry *entry = &cache->entries [i];
+
+			++cache->statistics.hits;
+			touch(cache, i);
+			copy_page(bed, entry, data, oob);
+			status = entry->status;
+			bed_lock_release(&cache->lock);
+		} else {
+			uint32_t generation = cache->generation;
+			bool sequential = addr == cache->next_sequential_page;
+
+			++cache->statistics.misses;
+			cache->next_sequential_page = addr + bed->page_size;
+
+			/* Cached without the OOB data */
+			if (i != NO_ENTRY) {
+				remove_entry(cache, i);
+			}
+
+			i = reserve(cache);
+			bed_lock_release(&cache->lock);
+
+			if (i != NO_ENTRY) {
+				cache_entry *entry = &cache->entries [i];
+
+				status = read_page(
+					cache,
+					addr,
+					entry->data,
+					with_oob ? entry->data + bed->page_size : NULL
+				);
+				copy_page(bed, entry, data, oob);
+
+				bed_lock_obtain(&cache->lock);
+				finish(cache, i, addr, with_oob, status, generation);
+				bed_lock_release(&cache->lock);
+			} else {
+				bed_device *lower = cache->lower;
+
+				(*lower->obtain)(lower);
+				status = (*lower->read_oob)(lower, addr, data, n, oob);
+				(*lower->release)(lower);
+			}
+
+			if (sequential && cache->config.read_ahead > 0) {
+				read_ahead(cache, addr, with_oob);
+			}
+		}
+	} else {
+		bed_device *lower = cache->lower;
+
+		(*lower->obtain)(lower);
+		status = (*lower->read_oob)(lower, addr, data, n, oob);
+		(*lower->release)(lower);
+	}
+
+	return status;
+}
+
+static bed_status cache_read(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n
+)
+{
+	bed_status status;
+
+	if (n == bed->page_size) {
+		status = cache_read_oob(bed, addr, data, n, &null_oob);
+	} else {
+		bed_device *lower = get_cache(bed)->lower;
+
+		(*lower->obtain)(lower);
+		status = (*lower->read)(lower, addr, data, n);
+		(*lower->release)(lower);
+	}
+
+	return status;
+}
+
+/*
+ * Partial reads do not fill the cache.
+ */
+static bed_status cache_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+)
+{
+	bed_status status;
+	bed_page_cache *cache = get_cache(bed);
+	uint32_t i;
+
+	bed_lock_obtain(&cache->lock);
+
+	i = find(cache, addr);
+
+	if (i != NO_ENTRY) {
+		const cache_entry *entry = &cache->entries [i];
+
+		++cache->statistics.hits;
+		touch(cache, i);
+		memcpy(data, entry->data + offset, n);
+		status = entry->status;
+		bed_lock_release(&cache->lock);
+	} else {
+		bed_device *lower = cache->lower;
+
+		++cache->statistics.misses;
+		bed_lock_release(&cache->lock);
+
+		(*lower->obtain)(lower);
+		status = (*lower->read_partial)(lower, addr, offset, data, n);
+		(*lower->release)(lower);
+	}
+
+	return status;
+}
+
+static bed_status cache_is_block_valid(bed_device *bed, bed_address addr)
+{
+	bed_device *lower = get_cache(bed)->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->is_block_valid)(lower, addr);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static void obtain_nothing(bed_device *bed)
+{
+	(void) bed;
+}
+
+#ifndef BED_CONFIG_READ_ONLY
+/*
+ * An empty range invalidates the page of its begin, since an OOB-only write
+ * modifies this page.
+ */
+static void invalidate_range(
+	bed_page_cache *cache,
+	bed_address begin,
+	bed_address size
+)
+{
+	bed_address page_size = cache->lower->page_size;
+	bed_address end = begin + (size > 0 ? size : 1);
+	bed_address page;
+
+	bed_lock_obtain(&cache->lock);
+	++cache->generation;
+
+	for (page = bed_align_down(begin, page_size - 1); page < end; page += page_size) {
+		invalidate_page(cache, page);
+	}
+
+	bed_lock_release(&cache->lock);
+}
+
+static void invalidate_block(bed_page_cache *cache, bed_address addr)
+{
+	bed_address block_size = cache->lower->block_size;
+	bed_address begin = bed_align_down(addr, block_size - 1);
+
+	invalidate_range(cache, begin, block_size);
+}
+
+static bed_status cache_write(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n
+)
+{
+	bed_page_cache *cache = get_cache(bed);
+	bed_device *lower = cache->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->write)(lower, addr, data, n);
+	(*lower->release)(lower);
+
+	invalidate_range(cache, addr, (bed_address) n);
+
+	return status;
+}
+
+static bed_status cache_write_oob(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_page_cache *cache = get_cache(bed);
+	bed_device *lower = cache->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->write_oob)(lower, addr, data, n, oob);
+	(*lower->release)(lower);
+
+	invalidate_range(cache, addr, (bed_address) n);
+
+	return status;
+}
+
+static bed_status cache_erase(bed_device *bed, bed_address addr)
+{
+	bed_page_cache *cache = get_cache(bed);
+	bed_device *lower = cache->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->erase)(lower, addr);
+	(*lower->release)(lower);
+
+	invalidate_block(cache, addr);
+
+	return status;
+}
+
+static bed_status cache_mark_block_bad(bed_device *bed, bed_address addr)
+{
+	bed_page_cache *cache = get_cache(bed);
+	bed_device *lower = cache->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->mark_block_bad)(lower, addr);
+	(*lower->release)(lower);
+
+	invalidate_block(cache, addr);
+
+	return status;
+}
+#endif /* BED_CONFIG_READ_ONLY */
+
+static void initialize_entries(bed_page_cache *cache)
+{
+	uint32_t capacity = cache->config.capacity;
+	uint32_t i;
+
+	for (i = 0; i <= cache->bucket_mask; ++i) {
+		cache->buckets [i] = NO_ENTRY;
+	}
+
+	cache->lru_head = NO_ENTRY;
+	cache->lru_tail = NO_ENTRY;
+
+	for (i = 0; i < capacity; ++i) {
+		cache_entry *entry = &cache->entries [i];
+
+		entry->valid = false;
+		entry->busy = false;
+		entry->referenced = false;
+		lru_append(cache, i);
+	}
+}
+
+bed_page_cache *bed_page_cache_create(
+	const bed_partition *parent,
+	const bed_page_cache_config *config
+)
+{
+	bed_page_cache *cache = NULL;
+	bed_device *lower = parent->bed;
+	size_t entry_size = (size_t) lower->page_size + lower->oob_free_size;
+	uint32_t capacity = config->capacity;
+	uint32_t bucket_count = 1;
+
+	while (bucket_count < capacity) {
+		bucket_count <<= 1;
+	}
+
+	if (capacity > 0) {
+		cache = malloc(
+			sizeof(*cache)
+				+ capacity * sizeof(*cache->entries)
+				+ bucket_count * sizeof(*cache->buckets)
+				+ capacity * entry_size
+		);
+	}
+
+	if (cache != NULL) {
+		bed_device *bed = &cache->device;
+		uint8_t *buffer;
+		uint32_t i;
+
+		memset(cache, 0, sizeof(*cache));
+		cache->config = *config;
+		cache->lower = lower;
+		cache->entries = (cache_entry *) (cache + 1);
+		cache->buckets = (uint32_t *) (cache->entries + capacity);
+		cache->bucket_mask = bucket_count - 1;
+		cache->next_sequential_page = UINT32_MAX;
+
+		buffer = (uint8_t *) (cache->buckets + bucket_count);
+
+		for (i = 0; i < capacity; ++i) {
+			cache->entries [i].data = buffer;
+			buffer += entry_size;
+		}
+
+		initialize_entries(cache);
+
+		*bed = *lower;
+		bed->obtain = obtain_nothing;
+		bed->release = obtain_nothing;
+		bed->select_chip = bed_default_select_chip;
+		bed->is_block_valid = cache_is_block_valid;
+		bed->read = cache_read;
+		bed->read_oob = cache_read_oob;
+		bed->read_partial = cache_read_partial;
+#ifndef BED_CONFIG_READ_ONLY
+		bed->write = cache_write;
+		bed->write_oob = cache_write_oob;
+		bed->erase = cache_erase;
+		bed->mark_block_bad = cache_mark_block_bad;
+#endif /* BED_CONFIG_READ_ONLY */
+		bed->context = cache;
+
+		cache->part.bed = bed;
+		cache->part.begin = parent->begin;
+		cache->part.size = parent->size;
+
+		if (bed_lock_initialize(&cache->lock) != BED_SUCCESS) {
+			free(cache);
+			cache = NULL;
+		}
+	}
+
+	return cache;
+}
+
+void bed_page_cache_destroy(bed_page_cache *cache)
+{
+	bed_lock_destroy(&cache->lock);
+	free(cache);
+}
+
+const bed_partition *bed_page_cache_partition(const bed_page_cache *cache)
+{
+	return &cache->part;
+}
+
+void bed_page_cache_invalidate(bed_page_cache *cache)
+{
+	uint32_t i;
+
+	bed_lock_obtain(&cache->lock);
+	++cache->generation;
+
+	for (i = 0; i < cache->config.capacity; ++i) {
+		cache_entry *entry = &cache->entries [i];
+
+		if (entry->valid) {
+			invalidate_page(cache, entry->page);
+		}
+	}
+
+	bed_lock_release(&cache->lock);
+}
+
+void bed_page_cache_get_statistics(
+	bed_page_cache *cache,
+	bed_page_cache_statistics *statistics,
+	bool reset
+)
+{
+	bed_lock_obtain(&cache->lock);
+	*statistics = cache->statistics;
+
+	if (reset) {
+		memset(&cache->statistics, 0, sizeof(cache->statistics));
+	}
+
+	bed_lock_release(&cache->lock);
+}
@@ -0,0 +1,167 @@
+/**
+ * @file
+ *
+ * @ingroup BEDPageCache
+ *
+ * @brief BED Page Cache API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_PAGE_CACHE_H
+#define BED_PAGE_CACHE_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDPageCache BED Page Cache
+ *
+ * @ingroup BED
+ *
+ * @brief Caches pages read from the device.
+ *
+ * The page cache provides a partition which covers the same area as its
+ * parent partition.  Reads of whole pages through this partition are served
+ * from the cache if possible.  The cached pages contain the page data and
+ * the free out-of-bounds (OOB) area in the #BED_OOB_MODE_AUTO mode.  Partial
+ * page reads (bed_read_partial()) are served from cached pages but do not
+ * fill the cache.  All other reads are passed to the parent device.  Writes
+ * are passed to the parent device and invalidate the affected page.  Block
+ * erases and bad block marks invalidate all pages of the block.  The ECC
+ * status of a page read (e.g. #BED_ERROR_ECC_FIXED) is cached with the page.
+ * Pages with read errors are not cached.
+ *
+ * A miss which continues the previous miss with the next page triggers a
+ * read-ahead of the following pages of the same block.  The read-ahead is
+ * carried out in the context of the reader.
+ *
+ * The page cache may be used concurrently.  No lock of the cache is held
+ * during the device access.
+ *
+ * @{
+ */
+
+typedef enum {
+	/**
+	 * @brief Evicts the least recently used page.
+	 */
+	BED_PAGE_CACHE_LRU,
+
+	/**
+	 * @brief Evicts the next page of the clock which was not referenced since
+	 * the last pass of the clock hand.
+	 */
+	BED_PAGE_CACHE_CLOCK
+} bed_page_cache_policy;
+
+typedef struct {
+	/**
+	 * @brief Count of cached pages.
+	 */
+	uint32_t capacity;
+
+	bed_page_cache_policy policy;
+
+	/**
+	 * @brief Count of pages read ahead on a sequential miss.
+	 *
+	 * A value of zero disables the read-ahead.
+	 */
+	uint32_t read_ahead;
+} bed_page_cache_config;
+
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+
+	/**
+	 * @brief Count of cached pages replaced by other pages.
+	 */
+	uint64_t evictions;
+
+	/**
+	 * @brief Count of cached pages invalidated by writes, erases, bad block
+	 * marks or bed_page_cache_invalidate().
+	 */
+	uint64_t invalidations;
+
+	/**
+	 * @brief Count of pages read ahead.
+	 */
+	uint64_t read_aheads;
+} bed_page_cache_statistics;
+
+typedef struct bed_page_cache bed_page_cache;
+
+/**
+ * @brief Creates a page cache for a partition.
+ *
+ * @param[in] parent The partition used by the page cache.
+ * @param[in] config The page cache configuration.
+ *
+ * @retval NULL Not enough resources or invalid configuration.
+ * @retval cache The page cache.
+ */
+bed_page_cache *bed_page_cache_create(
+	const bed_partition *parent,
+	const bed_page_cache_config *config
+);
+
+/**
+ * @brief Destroys a page cache.
+ *
+ * The page cache partition must not be in use.
+ */
+void bed_page_cache_destroy(bed_page_cache *cache);
+
+/**
+ * @brief Returns the partition of the page cache.
+ *
+ * It covers the same area as the parent partition.
+ */
+const bed_partition *bed_page_cache_partition(const bed_page_cache *cache);
+
+/**
+ * @brief Invalidates all cached pages.
+ *
+ * Use this function after modifications of the device which bypassed the
+ * page cache.
+ */
+void bed_page_cache_invalidate(bed_page_cache *cache);
+
+/**
+ * @brief Gets the page cache statistics.
+ *
+ * @param[in] cache The page cache.
+ * @param[out] statistics The statistics.
+ * @param[in] reset Clear the statistics after the copy.
+ */
+void bed_page_cache_get_statistics(
+	bed_page_cache *cache,
+	bed_page_cache_statistics *statistics,
+	bool reset
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_PAGE_CACHE_H */
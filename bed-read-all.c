@@ -18,17 +18,17 @@
 
 static bed_status read_all(
 	bed_device *bed,
-	bed_address area_begin,
-	bed_address area_size,
+	const bed_partition *part,
 	bed_oob_mode oob_mode,
 	bed_read_all_process process,
 	void *process_arg,
 	void *page_buffer,
-	void *oob_buffer
+	void *oob_buffer,
+	bed_cursor *cursor
 )
 {
 	bed_status status = BED_SUCCESS;
-	bed_address area_end = area_begin + area_size;
+	bed_address area_end = part->begin + part->size;
 	uint32_t block_size = bed->block_size;
 	uint16_t page_size = bed->page_size;
 	uint16_t oob_size = (uint16_t) (oob_mode == BED_OOB_MODE_AUTO ? bed->oob_free_size : bed->oob_size);
@@ -38,7 +38,7 @@ static bed_status read_all(
 		.size = oob_size,
 		.data = oob_buffer
 	};
-	bed_address block = area_begin;
+	bed_address block = part->begin + cursor->position;
 
 	while (status == BED_SUCCESS && block != area_end) {
 		bed_address next_block = block + block_size;
@@ -63,7 +63,17 @@ static bed_status read_all(
 			status = done ? BED_ERROR_STOPPED : BED_SUCCESS;
 		}
 
-		block = next_block;
+		if (status == BED_SUCCESS) {
+			block = next_block;
+
+			if (bed_cursor_advance(cursor, block - part->begin, part->size)) {
+				if (block != area_end) {
+					status = BED_ERROR_STOPPED;
+				}
+			} else if (block != area_end) {
+				bed_preempt(bed);
+			}
+		}
 	}
 
 	return status;
@@ -78,21 +88,51 @@ bed_status bed_read_all(
 	void *oob_buffer
 )
 {
-	bed_status status = BED_SUCCESS;
-	bed_device *bed = part->bed;
+	bed_cursor cursor;
 
-	(*bed->obtain)(bed);
-	status = read_all(
-		bed,
-		part->begin,
-		part->size,
+	bed_cursor_initialize(&cursor, NULL, NULL);
+
+	return bed_read_all_with_cursor(
+		part,
 		oob_mode,
 		process,
 		process_arg,
 		page_buffer,
-		oob_buffer
+		oob_buffer,
+		&cursor
 	);
-	(*bed->release)(bed);
+}
+
+bed_status bed_read_all_with_cursor(
+	const bed_partition *part,
+	bed_oob_mode oob_mode,
+	bed_read_all_process process,
+	void *process_arg,
+	void *page_buffer,
+	void *oob_buffer,
+	bed_cursor *cursor
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (bed_is_cursor_valid(part, cursor)) {
+		bed_device *bed = part->bed;
+
+		(*bed->obtain)(bed);
+		status = read_all(
+			bed,
+			part,
+			oob_mode,
+			process,
+			process_arg,
+			page_buffer,
+			oob_buffer,
+			cursor
+		);
+		(*bed->release)(bed);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
 
 	return status;
 }
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-impl.h"
+
+#include <string.h>
+
+/*
+ * The page is read into the trash buffer, so the caller must own the device.
+ */
+bed_status bed_default_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+)
+{
+	uint8_t *page_buffer = bed_trash_buffer(bed->page_size);
+	bed_status status = (*bed->read)(bed, addr, page_buffer, bed->page_size);
+
+	memcpy(data, page_buffer + offset, n);
+
+	return status;
+}
+
+bed_status bed_read_partial(
+	const bed_partition *part,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_device *bed = part->bed;
+
+	if (
+		bed_is_range_valid(part, addr, bed->page_size)
+			&& (addr & (bed->page_size - 1U)) == 0
+			&& offset <= bed->page_size
+			&& n <= (size_t) (bed->page_size - offset)
+	) {
+		if (n > 0) {
+			(*bed->obtain)(bed);
+			status = (*bed->read_partial)(bed, part->begin + addr, offset, data, n);
+			(*bed->release)(bed);
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
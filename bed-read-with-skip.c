@@ -18,16 +18,16 @@
 
 static bed_status read_with_skip(
 	bed_device *bed,
-	bed_address area_begin,
-	bed_address area_size,
+	const bed_partition *part,
 	bed_read_process process,
 	void *process_arg,
 	void *page_buffer,
-	void *oob_buffer
+	void *oob_buffer,
+	bed_cursor *cursor
 )
 {
 	bed_status status = BED_SUCCESS;
-	bed_address area_end = area_begin + area_size;
+	bed_address area_end = part->begin + part->size;
 	uint32_t block_size = bed->block_size;
 	uint16_t page_size = bed->page_size;
 	uint16_t oob_size = bed->oob_free_size;
@@ -37,7 +37,7 @@ static bed_status read_with_skip(
 		.size = oob_size,
 		.data = oob_buffer
 	};
-	bed_address block = area_begin;
+	bed_address block = part->begin + cursor->position;
 
 	while (status == BED_SUCCESS && block != area_end) {
 		bed_address next_block = block + block_size;
@@ -69,7 +69,17 @@ static bed_status read_with_skip(
 			status = BED_SUCCESS;
 		}
 
-		block = next_block;
+		if (status == BED_SUCCESS) {
+			block = next_block;
+
+			if (bed_cursor_advance(cursor, block - part->begin, part->size)) {
+				if (block != area_end) {
+					status = BED_ERROR_STOPPED;
+				}
+			} else if (block != area_end) {
+				bed_preempt(bed);
+			}
+		}
 	}
 
 	return status;
@@ -83,20 +93,48 @@ bed_status bed_read_with_skip(
 	void *oob_buffer
 )
 {
-	bed_status status = BED_SUCCESS;
-	bed_device *bed = part->bed;
+	bed_cursor cursor;
+
+	bed_cursor_initialize(&cursor, NULL, NULL);
 
-	(*bed->obtain)(bed);
-	status = read_with_skip(
-		bed,
-		part->begin,
-		part->size,
+	return bed_read_with_skip_with_cursor(
+		part,
 		process,
 		process_arg,
 		page_buffer,
-		oob_buffer
+		oob_buffer,
+		&cursor
 	);
-	(*bed->release)(bed);
+}
+
+bed_status bed_read_with_skip_with_cursor(
+	const bed_partition *part,
+	bed_read_process process,
+	void *process_arg,
+	void *page_buffer,
+	void *oob_buffer,
+	bed_cursor *cursor
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (bed_is_cursor_valid(part, cursor)) {
+		bed_device *bed = part->bed;
+
+		(*bed->obtain)(bed);
+		status = read_with_skip(
+			bed,
+			part,
+			process,
+			process_arg,
+			page_buffer,
+			oob_buffer,
+			cursor
+		);
+		(*bed->release)(bed);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
 
 	return status;
 }
@@ -0,0 +1,702 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-remap.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The remap table consists of the magic, the sequence number, the reserve
+ * block count, the owner of each reserve block and a CRC-32 of the previous
+ * words.  All words are little endian.  Each table write starts at a page
+ * boundary.
+ */
+#define TABLE_MAGIC 0x52444542
+
+#define TABLE_HEADER_SIZE 12
+
+#define OWNER_FREE UINT32_MAX
+
+#define OWNER_BAD (UINT32_MAX - 1)
+
+/*
+ * This flag in the map indicates a logical block located at a bad block
+ * without a replacement.
+ */
+#define UNREPLACED 0x80000000U
+
+struct bed_remap {
+	bed_lock lock;
+	bed_partition parent;
+	bed_remap_config config;
+	bed_device *lower;
+	bed_device device;
+	bed_partition part;
+	uint32_t logical_blocks;
+	uint32_t pages_per_block;
+	uint32_t table_pages;
+	uint32_t table_block;
+	uint32_t table_page;
+	uint32_t sequence;
+	uint32_t table_writes;
+	uint32_t *map;
+	uint32_t *owners;
+	uint8_t *table;
+};
+
+static size_t table_size(uint32_t reserve_blocks)
+{
+	return TABLE_HEADER_SIZE + (reserve_blocks + 1) * sizeof(uint32_t);
+}
+
+static bed_remap *get_remap(const bed_device *bed)
+{
+	return bed->context;
+}
+
+static uint32_t reserve_begin(const bed_remap *remap)
+{
+	return remap->logical_blocks;
+}
+
+static uint32_t table_begin(const bed_remap *remap)
+{
+	return remap->logical_blocks + remap->config.reserve_blocks;
+}
+
+static bed_address table_page_address(
+	const bed_remap *remap,
+	uint32_t block,
+	uint32_t page
+)
+{
+	return bed_block_to_address(&remap->parent, table_begin(remap) + block)
+		+ page * (bed_address) bed_page_size(&remap->parent);
+}
+
+static bool load_table(bed_remap *remap, bed_address addr, uint32_t *sequence)
+{
+	uint16_t page_size = bed_page_size(&remap->parent);
+	size_t size = table_size(remap->config.reserve_blocks);
+	uint32_t i;
+	bool ok = true;
+
+	for (i = 0; i < remap->table_pages && ok; ++i) {
+		bed_status status = bed_read(
+			&remap->parent,
+			addr + i * (bed_address) page_size,
+			remap->table + i * (size_t) page_size,
+			page_size
+		);
+
+		ok = status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED;
+	}
+
+	ok = ok
+		&& bed_get_le32(remap->table) == TABLE_MAGIC
+		&& bed_get_le32(remap->table + 8) == remap->config.reserve_blocks
+		&& bed_get_le32(remap->table + size - 4)
+			== bed_crc32(0, remap->table, size - 4);
+
+	if (ok) {
+		*sequence = bed_get_le32(remap->table + 4);
+	}
+
+	return ok;
+}
+
+static void recover_table(bed_remap *remap)
+{
+	uint32_t best_sequence = 0;
+	bed_address best = 0;
+	bool found = false;
+	uint32_t block;
+
+	for (block = 0; block < remap->config.table_blocks; ++block) {
+		uint32_t page = 0;
+
+		if (
+			bed_is_block_valid(
+				&remap->parent,
+				table_page_address(remap, block, 0)
+			) != BED_SUCCESS
+		) {
+			page = remap->pages_per_block;
+		}
+
+		while (page + remap->table_pages <= remap->pages_per_block) {
+			bed_address addr = table_page_address(remap, block, page);
+			uint32_t sequence;
+
+			if (
+				load_table(remap, addr, &sequence)
+					&& (!found || sequence > best_sequence)
+			) {
+				best = addr;
+				best_sequence = sequence;
+				remap->table_block = block;
+				found = true;
+			}
+
+			page += remap->table_pages;
+		}
+	}
+
+	if (found && load_table(remap, best, &best_sequence)) {
+		uint32_t i;
+
+		for (i = 0; i < remap->config.reserve_blocks; ++i) {
+			uint32_t owner = bed_get_le32(
+				remap->table + TABLE_HEADER_SIZE + i * sizeof(uint32_t)
+			);
+
+			if (
+				owner < remap->logical_blocks
+					&& remap->map [owner] == owner
+			) {
+				remap->map [owner] = reserve_begin(remap) + i;
+				remap->owners [i] = owner;
+			} else if (owner == OWNER_BAD) {
+				remap->owners [i] = OWNER_BAD;
+			}
+		}
+
+		remap->sequence = best_sequence + 1;
+	}
+}
+
+/*
+ * The first table write after the creation goes to the table block after the
+ * one with the newest table, since the remaining pages of this table block
+ * may be partially programmed.
+ */
+static bed_status write_table(bed_remap *remap)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint16_t page_size = bed_page_size(&remap->parent);
+	size_t size = table_size(remap->config.reserve_blocks);
+	uint32_t attempts = 0;
+	uint32_t i;
+
+	memset(remap->table, 0xff, remap->table_pages * (size_t) page_size);
+	bed_put_le32(remap->table, TABLE_MAGIC);
+	bed_put_le32(remap->table + 4, remap->sequence);
+	bed_put_le32(remap->table + 8, remap->config.reserve_blocks);
+
+	for (i = 0; i < remap->config.reserve_blocks; ++i) {
+		bed_put_le32(
+			remap->table + TABLE_HEADER_SIZE + i * sizeof(uint32_t),
+			remap->owners [i]
+		);
+	}
+
+	bed_put_le32(remap->table + size - 4, bed_crc32(0, remap->table, size - 4));
+
+	while (status != BED_SUCCESS && attempts <= remap->config.table_blocks) {
+		if (remap->table_page + remap->table_pages > remap->pages_per_block) {
+			remap->table_block = (remap->table_block + 1)
+				% remap->config.table_blocks;
+			remap->table_page = 0;
+			++attempts;
+			status = bed_erase(
+				&remap->parent,
+				table_page_address(remap, remap->table_block, 0),
+				BED_ERASE_MARK_BAD_ON_ERROR
+			);
+		} else {
+			status = BED_SUCCESS;
+		}
+
+		for (i = 0; i < remap->table_pages && status == BED_SUCCESS; ++i) {
+			status = bed_write(
+				&remap->parent,
+				table_page_address(
+					remap,
+					remap->table_block,
+					remap->table_page + i
+				),
+				remap->table + i * (size_t) page_size,
+				page_size
+			);
+		}
+
+		if (bed_is_system_error(status)) {
+			break;
+		} else if (status == BED_SUCCESS) {
+			remap->table_page += remap->table_pages;
+			++remap->sequence;
+			++remap->table_writes;
+		} else {
+			remap->table_page = remap->pages_per_block;
+			status = BED_ERROR_UNSATISFIED;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * Replaces the block of a logical block with an erased reserve block.  The
+ * previous block must be marked bad before.  A failed table write is retried
+ * with the next change.
+ */
+static bed_status replace_block(bed_remap *remap, uint32_t logical)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t i;
+
+	for (i = 0; i < remap->config.reserve_blocks; ++i) {
+		if (remap->owners [i] == OWNER_FREE) {
+			uint32_t block = reserve_begin(remap) + i;
+
+			status = bed_erase(
+				&remap->parent,
+				bed_block_to_address(&remap->parent, block),
+				BED_ERASE_MARK_BAD_ON_ERROR
+			);
+
+			if (status == BED_SUCCESS) {
+				uint32_t previous = remap->map [logical] & ~UNREPLACED;
+
+				if (previous >= reserve_begin(remap)) {
+					remap->owners [previous - reserve_begin(remap)] = OWNER_BAD;
+				}
+
+				remap->owners [i] = logical;
+				remap->map [logical] = block;
+				write_table(remap);
+				break;
+			} else if (bed_is_system_error(status)) {
+				break;
+			} else {
+				remap->owners [i] = OWNER_BAD;
+				status = BED_ERROR_UNSATISFIED;
+			}
+		}
+	}
+
+	if (status == BED_ERROR_UNSATISFIED) {
+		remap->map [logical] |= UNREPLACED;
+	}
+
+	return status;
+}
+
+/*
+ * Home blocks which went bad since the last table write and reserve blocks
+ * which went bad after their assignment are replaced.
+ */
+static void replace_bad_blocks(bed_remap *remap)
+{
+	uint32_t i;
+
+	for (i = 0; i < remap->config.reserve_blocks; ++i) {
+		if (
+			remap->owners [i] != OWNER_BAD
+				&& bed_is_block_valid(
+					&remap->parent,
+					bed_block_to_address(&remap->parent, reserve_begin(remap) + i)
+				) == BED_ERROR_BLOCK_IS_BAD
+		) {
+			uint32_t owner = remap->owners [i];
+
+			remap->owners [i] = OWNER_BAD;
+
+			if (owner != OWNER_FREE) {
+				remap->map [owner] = owner;
+			}
+		}
+	}
+
+	for (i = 0; i < remap->logical_blocks; ++i) {
+		if (
+			remap->map [i] == i
+				&& bed_is_block_valid(
+					&remap->parent,
+					bed_block_to_address(&remap->parent, i)
+				) == BED_ERROR_BLOCK_IS_BAD
+		) {
+			replace_block(remap, i);
+		}
+	}
+}
+
+static bed_address translate(const bed_remap *remap, bed_address addr)
+{
+	uint32_t block_mask = bed_block_mask(&remap->parent);
+	uint32_t logical = (uint32_t) bed_address_to_block(&remap->parent, addr);
+
+	return remap->parent.begin
+		+ bed_block_to_address(
+			&remap->parent,
+			remap->map [logical] & ~UNREPLACED
+		)
+		+ (addr & block_mask);
+}
+
+static bed_address lock_and_translate(bed_remap *remap, bed_address addr)
+{
+	bed_address physical;
+
+	bed_lock_obtain(&remap->lock);
+	physical = translate(remap, addr);
+	bed_lock_release(&remap->lock);
+
+	return physical;
+}
+
+static bed_status remap_is_block_valid(bed_device *bed, bed_address addr)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_device *lower = remap->lower;
+	bed_address physical = lock_and_translate(remap, addr);
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->is_block_valid)(lower, physical);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static bed_status remap_read(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n
+)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_device *lower = remap->lower;
+	bed_address physical = lock_and_translate(remap, addr);
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->read)(lower, physical, data, n);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static bed_status remap_read_oob(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_device *lower = remap->lower;
+	bed_address physical = lock_and_translate(remap, addr);
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->read_oob)(lower, physical, data, n, oob);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static bed_status remap_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_device *lower = remap->lower;
+	bed_address physical = lock_and_translate(remap, addr);
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->read_partial)(lower, physical, offset, data, n);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+/*
+ * The remap partition is owned through the remap lock, so that bed_obtain()
+ * of the remap partition keeps the translation and the operations together
+ * independent of the locking of the lower device.
+ */
+static void obtain_remap(bed_device *bed)
+{
+	bed_lock_obtain(&get_remap(bed)->lock);
+}
+
+static void release_remap(bed_device *bed)
+{
+	bed_lock_release(&get_remap(bed)->lock);
+}
+
+#ifndef BED_CONFIG_READ_ONLY
+static bed_status remap_write(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n
+)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_device *lower = remap->lower;
+	bed_address physical = lock_and_translate(remap, addr);
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->write)(lower, physical, data, n);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static bed_status remap_write_oob(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_device *lower = remap->lower;
+	bed_address physical = lock_and_translate(remap, addr);
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->write_oob)(lower, physical, data, n, oob);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+/*
+ * Marks the block of a logical block bad and replaces it.  The lock must be
+ * owned by the caller.
+ */
+static bed_status mark_and_replace(bed_remap *remap, bed_address addr)
+{
+	bed_device *lower = remap->lower;
+	uint32_t logical = (uint32_t) bed_address_to_block(&remap->parent, addr);
+	bed_status status = BED_SUCCESS;
+
+	if ((remap->map [logical] & UNREPLACED) == 0) {
+		(*lower->obtain)(lower);
+		status = (*lower->mark_block_bad)(lower, translate(remap, addr));
+		(*lower->release)(lower);
+
+		replace_block(remap, logical);
+	}
+
+	return status;
+}
+
+/*
+ * In case of an erase error the block is replaced by an erased reserve
+ * block.  The erase error is reported only if no reserve block is available.
+ */
+static bed_status remap_erase(bed_device *bed, bed_address addr)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_device *lower = remap->lower;
+	bed_status status;
+
+	bed_lock_obtain(&remap->lock);
+
+	(*lower->obtain)(lower);
+	status = (*lower->erase)(lower, translate(remap, addr));
+	(*lower->release)(lower);
+
+	if (status == BED_ERROR_ERASE) {
+		mark_and_replace(remap, addr);
+
+		if (
+			(remap->map [bed_address_to_block(&remap->parent, addr)]
+				& UNREPLACED) == 0
+		) {
+			status = BED_SUCCESS;
+		}
+	}
+
+	bed_lock_release(&remap->lock);
+
+	return status;
+}
+
+static bed_status remap_mark_block_bad(bed_device *bed, bed_address addr)
+{
+	bed_remap *remap = get_remap(bed);
+	bed_status status;
+
+	bed_lock_obtain(&remap->lock);
+	status = mark_and_replace(remap, addr);
+	bed_lock_release(&remap->lock);
+
+	return status;
+}
+#endif /* BED_CONFIG_READ_ONLY */
+
+bed_status bed_remap_create(
+	const bed_partition *parent,
+	const bed_remap_config *config,
+	bed_remap **remap_ptr
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_remap *remap = NULL;
+	uint16_t page_size = bed_page_size(parent);
+	uint32_t pages_per_block = bed_block_size(parent) / page_size;
+	uint32_t total = (uint32_t) bed_address_to_block(parent, bed_size(parent));
+	uint32_t table_pages = (uint32_t) (
+		(table_size(config->reserve_blocks) + page_size - 1) / page_size
+	);
+
+	if (
+		config->reserve_blocks > 0
+			&& config->table_blocks >= 2
+			&& config->reserve_blocks + config->table_blocks < total
+			&& table_pages <= pages_per_block
+	) {
+		uint32_t logical_blocks = total - config->reserve_blocks
+			- config->table_blocks;
+
+		remap = malloc(
+			sizeof(*remap)
+				+ (logical_blocks + config->reserve_blocks) * sizeof(uint32_t)
+				+ table_pages * (size_t) page_size
+		);
+
+		if (remap != NULL) {
+			bed_device *bed = &remap->device;
+			uint8_t *chunk = (uint8_t *) (remap + 1);
+			uint32_t i;
+
+			memset(remap, 0, sizeof(*remap));
+			remap->parent = *parent;
+			remap->config = *config;
+			remap->lower = parent->bed;
+			remap->logical_blocks = logical_blocks;
+			remap->pages_per_block = pages_per_block;
+			remap->table_pages = table_pages;
+			remap->table_page = pages_per_block;
+			remap->map = (uint32_t *) chunk;
+			chunk += logical_blocks * sizeof(uint32_t);
+			remap->owners = (uint32_t *) chunk;
+			chunk += config->reserve_blocks * sizeof(uint32_t);
+			remap->table = chunk;
+
+			for (i = 0; i < logical_blocks; ++i) {
+				remap->map [i] = i;
+			}
+
+			for (i = 0; i < config->reserve_blocks; ++i) {
+				remap->owners [i] = OWNER_FREE;
+			}
+
+			recover_table(remap);
+			replace_bad_blocks(remap);
+
+			*bed = *remap->lower;
+			bed->obtain = obtain_remap;
+			bed->release = release_remap;
+			bed->select_chip = bed_default_select_chip;
+			bed->is_block_valid = remap_is_block_valid;
+			bed->read = remap_read;
+			bed->read_oob = remap_read_oob;
+			bed->read_partial = remap_read_partial;
+#ifndef BED_CONFIG_READ_ONLY
+			bed->write = remap_write;
+			bed->write_oob = remap_write_oob;
+			bed->erase = remap_erase;
+			bed->mark_block_bad = remap_mark_block_bad;
+#endif /* BED_CONFIG_READ_ONLY */
+			bed->context = remap;
+			bed->size = bed_block_to_address(parent, logical_blocks);
+
+			remap->part.bed = bed;
+			remap->part.begin = 0;
+			remap->part.size = bed->size;
+
+			status = bed_lock_initialize(&remap->lock);
+
+			if (status != BED_SUCCESS) {
+				free(remap);
+				remap = NULL;
+			}
+		} else {
+			status = BED_ERROR_SYSTEM;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	*remap_ptr = remap;
+
+	return status;
+}
+
+void bed_remap_destroy(bed_remap *remap)
+{
+	bed_lock_destroy(&remap->lock);
+	free(remap);
+}
+
+const bed_partition *bed_remap_partition(const bed_remap *remap)
+{
+	return &remap->part;
+}
+
+bed_address bed_remap_parent_address(bed_remap *remap, bed_address addr)
+{
+	bed_address physical = lock_and_translate(remap, addr);
+
+	return physical - remap->parent.begin;
+}
+
+void bed_remap_get_statistics(
+	bed_remap *remap,
+	bed_remap_statistics *statistics
+)
+{
+	uint32_t i;
+
+	memset(statistics, 0, sizeof(*statistics));
+
+	bed_lock_obtain(&remap->lock);
+
+	statistics->logical_blocks = remap->logical_blocks;
+
+	for (i = 0; i < remap->logical_blocks; ++i) {
+		uint32_t block = remap->map [i];
+
+		if ((block & UNREPLACED) != 0) {
+			++statistics->unreplaced_blocks;
+		} else if (block != i) {
+			++statistics->remapped_blocks;
+		}
+	}
+
+	for (i = 0; i < remap->config.reserve_blocks; ++i) {
+		statistics->free_reserve_blocks += remap->owners [i] == OWNER_FREE;
+	}
+
+	statistics->table_writes = remap->table_writes;
+
+	bed_lock_release(&remap->lock);
+}
@@ -0,0 +1,156 @@
+/**
+ * @file
+ *
+ * @ingroup BEDRemap
+ *
+ * @brief BED Bad Block Remapping API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_REMAP_H
+#define BED_REMAP_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDRemap BED Bad Block Remapping
+ *
+ * @ingroup BED
+ *
+ * @brief Presents a partition without bad blocks.
+ *
+ * The parent partition is divided into the logical blocks, the reserve pool
+ * and the remap table blocks in this order.  The remap partition
+ * (bed_remap_partition()) contains the logical blocks.  Each logical block is
+ * located at its home block in the parent partition or at a block of the
+ * reserve pool which replaces the bad home block.  The address translation is
+ * a table lookup, so blocks of the remap partition may be addressed directly
+ * without a bad block scan.
+ *
+ * The remap table contains the replaced logical block of each reserve block.
+ * It is written to the table blocks in turn after each change and carries a
+ * sequence number and a CRC.  On creation the newest valid table is loaded
+ * and bad home blocks without a replacement are replaced.
+ *
+ * A logical block is replaced by an erased reserve block in case its erase
+ * fails or it is marked bad.  So an erase through the remap partition
+ * succeeds as long as reserve blocks are available.  The content of a
+ * replaced block is lost.  A write error is reported to the caller, which
+ * should move the data and mark the block bad.  In case the reserve pool is
+ * exhausted, then the bad blocks remain visible through the remap partition.
+ *
+ * Device operations must not cross block boundaries.  The remap partition may
+ * be used concurrently.  Its operations and bed_obtain() of the remap
+ * partition own the remap lock, which serializes them independent of the
+ * locking of the parent device.
+ *
+ * @{
+ */
+
+typedef struct {
+	/**
+	 * @brief Count of blocks in the reserve pool.
+	 */
+	uint32_t reserve_blocks;
+
+	/**
+	 * @brief Count of blocks at the partition end for the remap table.
+	 *
+	 * It must be at least two.
+	 */
+	uint32_t table_blocks;
+} bed_remap_config;
+
+typedef struct {
+	uint32_t logical_blocks;
+
+	/**
+	 * @brief Count of logical blocks located in the reserve pool.
+	 */
+	uint32_t remapped_blocks;
+
+	/**
+	 * @brief Count of reserve blocks available for replacements.
+	 */
+	uint32_t free_reserve_blocks;
+
+	/**
+	 * @brief Count of logical blocks located at bad blocks due to an exhausted
+	 * reserve pool.
+	 */
+	uint32_t unreplaced_blocks;
+
+	uint32_t table_writes;
+} bed_remap_statistics;
+
+typedef struct bed_remap bed_remap;
+
+/**
+ * @brief Creates a bad block remapping for a partition.
+ *
+ * @param[in] parent The partition.
+ * @param[in] config The remapping configuration.
+ * @param[out] remap The remapping.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid configuration for this
+ * partition.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ */
+bed_status bed_remap_create(
+	const bed_partition *parent,
+	const bed_remap_config *config,
+	bed_remap **remap
+);
+
+/**
+ * @brief Destroys a bad block remapping.
+ *
+ * The remap partition must not be in use.
+ */
+void bed_remap_destroy(bed_remap *remap);
+
+/**
+ * @brief Returns the partition of the logical blocks.
+ */
+const bed_partition *bed_remap_partition(const bed_remap *remap);
+
+/**
+ * @brief Translates an address of the remap partition.
+ *
+ * @param[in] remap The remapping.
+ * @param[in] addr The address relative to the remap partition begin.
+ *
+ * @return The address relative to the parent partition begin.
+ */
+bed_address bed_remap_parent_address(bed_remap *remap, bed_address addr);
+
+void bed_remap_get_statistics(
+	bed_remap *remap,
+	bed_remap_statistics *statistics
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_REMAP_H */
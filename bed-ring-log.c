@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-ring-log.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_BLOCK UINT32_MAX
+
+/*
+ * The metadata consists of the sequence number, the record size (two bytes),
+ * two reserved bytes and a CRC-32 of the previous eight bytes.  Words are
+ * little endian.
+ */
+#define METADATA_SIZE 12
+
+#define RESERVED 0xff
+
+typedef struct {
+	uint32_t sequence;
+	uint16_t size;
+} record;
+
+struct bed_ring_log {
+	bed_lock lock;
+	bed_partition part;
+	uint16_t page_size;
+	uint32_t pages_per_block;
+	uint32_t block_count;
+	uint32_t head_block;
+	uint32_t head_page;
+	uint32_t tail_block;
+	uint32_t tail_sequence;
+	uint32_t sequence;
+	uint32_t metadata_reads;
+	uint8_t *page_buffer;
+	bed_ring_log_info info;
+};
+
+static void encode_metadata(uint8_t *metadata, const record *rec)
+{
+	bed_put_le32(metadata, rec->sequence);
+	metadata [4] = (uint8_t) rec->size;
+	metadata [5] = (uint8_t) (rec->size >> 8);
+	metadata [6] = RESERVED;
+	metadata [7] = RESERVED;
+	bed_put_le32(metadata + 8, bed_crc32(0, metadata, 8));
+}
+
+static bool decode_metadata(const uint8_t *metadata, record *rec)
+{
+	rec->sequence = bed_get_le32(metadata);
+	rec->size = (uint16_t) (metadata [4] | (metadata [5] << 8));
+
+	return bed_get_le32(metadata + 8) == bed_crc32(0, metadata, 8);
+}
+
+/*
+ * Sequence number comparison with wrap around.
+ */
+static bool is_before(uint32_t a, uint32_t b)
+{
+	return (int32_t) (a - b) < 0;
+}
+
+static bed_address page_to_address(
+	const bed_ring_log *log,
+	uint32_t block,
+	uint32_t page
+)
+{
+	return ((bed_address) block * log->pages_per_block + page) * log->page_size;
+}
+
+static bool is_good_block(const bed_ring_log *log, uint32_t block)
+{
+	return bed_is_block_valid(&log->part, page_to_address(log, block, 0))
+		== BED_SUCCESS;
+}
+
+/*
+ * Returns the next good block after the block in turn.  This may be the
+ * block itself.
+ */
+static uint32_t next_good_block(const bed_ring_log *log, uint32_t block)
+{
+	uint32_t next = NO_BLOCK;
+	uint32_t i;
+
+	for (i = 1; i <= log->block_count && next == NO_BLOCK; ++i) {
+		uint32_t candidate = (block + i) % log->block_count;
+
+		if (is_good_block(log, candidate)) {
+			next = candidate;
+		}
+	}
+
+	return next;
+}
+
+/*
+ * Returns BED_ERROR_UNSATISFIED in case the page contains no valid metadata,
+ * e.g. it is erased.
+ */
+static bed_status read_metadata(
+	bed_ring_log *log,
+	uint32_t block,
+	uint32_t page,
+	record *rec
+)
+{
+	uint8_t metadata [METADATA_SIZE];
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = METADATA_SIZE,
+		.data = metadata
+	};
+	bed_status status = bed_read_oob(
+		&log->part,
+		page_to_address(log, block, page),
+		NULL,
+		0,
+		&oob
+	);
+
+	++log->metadata_reads;
+
+	if (status == BED_ERROR_ECC_FIXED) {
+		status = BED_SUCCESS;
+	}
+
+	if (
+		status == BED_SUCCESS
+			&& (!decode_metadata(metadata, rec) || rec->size > log->page_size)
+	) {
+		status = BED_ERROR_UNSATISFIED;
+	} else if (status != BED_SUCCESS && !bed_is_system_error(status)) {
+		status = BED_ERROR_UNSATISFIED;
+	}
+
+	return status;
+}
+
+/*
+ * The good blocks from the first good block up to the newest block start
+ * with a sequence number not before the one of the first good block.  The
+ * following good blocks are erased or contain older records.  Returns the
+ * last block of the first part.
+ */
+static bed_status find_newest_block(
+	bed_ring_log *log,
+	uint32_t first,
+	uint32_t first_sequence,
+	uint32_t *newest
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t lo = first;
+	uint32_t hi = log->block_count - 1;
+
+	while (lo < hi && status == BED_SUCCESS) {
+		uint32_t mid = lo + (hi - lo + 1) / 2;
+		uint32_t good = mid;
+
+		while (good <= hi && !is_good_block(log, good)) {
+			++good;
+		}
+
+		if (good <= hi) {
+			record rec;
+
+			status = read_metadata(log, good, 0, &rec);
+
+			if (status == BED_SUCCESS && !is_before(rec.sequence, first_sequence)) {
+				lo = good;
+			} else if (status == BED_SUCCESS || status == BED_ERROR_UNSATISFIED) {
+				hi = mid - 1;
+				status = BED_SUCCESS;
+			}
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	*newest = lo;
+
+	return status;
+}
+
+/*
+ * The pages are written in order, so the valid pages form a prefix of the
+ * block.  The first page is valid.
+ */
+static bed_status find_newest_record(
+	bed_ring_log *log,
+	uint32_t block,
+	record *newest
+)
+{
+	bed_status status = read_metadata(log, block, 0, newest);
+	uint32_t lo = 0;
+	uint32_t hi = log->pages_per_block - 1;
+
+	while (lo < hi && status == BED_SUCCESS) {
+		uint32_t mid = lo + (hi - lo + 1) / 2;
+		record rec;
+
+		status = read_metadata(log, block, mid, &rec);
+
+		if (status == BED_SUCCESS) {
+			lo = mid;
+			*newest = rec;
+		} else if (status == BED_ERROR_UNSATISFIED) {
+			hi = mid - 1;
+			status = BED_SUCCESS;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * The oldest block follows the newest block.  This block may be erased, in
+ * case a power cut happened after its erase, and the next good block
+ * contains the oldest records.  Without a wrap around the oldest block is
+ * the first good block.
+ */
+static bed_status find_oldest_block(
+	bed_ring_log *log,
+	uint32_t first,
+	uint32_t first_sequence,
+	uint32_t newest
+)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t block = newest;
+	int i;
+
+	for (i = 0; i < 2 && status == BED_ERROR_UNSATISFIED; ++i) {
+		record rec;
+
+		block = next_good_block(log, block);
+		status = read_metadata(log, block, 0, &rec);
+
+		if (status == BED_SUCCESS) {
+			log->tail_block = block;
+			log->tail_sequence = rec.sequence;
+		}
+	}
+
+	if (status == BED_ERROR_UNSATISFIED) {
+		log->tail_block = first;
+		log->tail_sequence = first_sequence;
+		status = BED_SUCCESS;
+	}
+
+	return status;
+}
+
+static bed_status mount(bed_ring_log *log)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t first = NO_BLOCK;
+	uint32_t newest = NO_BLOCK;
+	uint32_t block;
+	record rec;
+
+	log->head_block = NO_BLOCK;
+	log->tail_block = NO_BLOCK;
+	log->sequence = 0;
+
+	for (block = 0; block < log->block_count && first == NO_BLOCK; ++block) {
+		if (is_good_block(log, block)) {
+			first = block;
+		}
+	}
+
+	if (first != NO_BLOCK) {
+		status = read_metadata(log, first, 0, &rec);
+
+		if (status == BED_SUCCESS) {
+			status = find_newest_block(log, first, rec.sequence, &newest);
+		} else if (status == BED_ERROR_UNSATISFIED) {
+			uint32_t last = log->block_count - 1;
+
+			/*
+			 * Either the log is empty or the first good block was erased for the
+			 * next record after a wrap around.
+			 */
+			while (!is_good_block(log, last)) {
+				--last;
+			}
+
+			status = read_metadata(log, last, 0, &rec);
+
+			if (status == BED_SUCCESS) {
+				newest = last;
+			} else if (status == BED_ERROR_UNSATISFIED) {
+				status = BED_SUCCESS;
+			}
+		}
+	}
+
+	if (status == BED_SUCCESS && newest != NO_BLOCK) {
+		uint32_t first_sequence = rec.sequence;
+
+		status = find_newest_record(log, newest, &rec);
+
+		if (status == BED_SUCCESS) {
+			log->head_block = newest;
+			log->head_page = log->pages_per_block;
+			log->sequence = rec.sequence + 1;
+			status = find_oldest_block(log, first, first_sequence, newest);
+		}
+	}
+
+	return status;
+}
+
+bed_status bed_ring_log_create(const bed_partition *part, bed_ring_log **log_ptr)
+{
+	bed_status status = BED_SUCCESS;
+	bed_ring_log *log = NULL;
+	uint16_t page_size = bed_page_size(part);
+	uint32_t block_count = (uint32_t) bed_address_to_block(part, bed_size(part));
+
+	if (block_count > 0 && bed_oob_free_size(part) >= METADATA_SIZE) {
+		log = malloc(sizeof(*log) + page_size);
+
+		if (log != NULL) {
+			memset(log, 0, sizeof(*log));
+			log->part = *part;
+			log->page_size = page_size;
+			log->pages_per_block = bed_block_size(part) / page_size;
+			log->block_count = block_count;
+			log->page_buffer = (uint8_t *) (log + 1);
+
+			status = mount(log);
+			log->info.mount_reads = log->metadata_reads;
+
+			if (status == BED_SUCCESS) {
+				status = bed_lock_initialize(&log->lock);
+			}
+
+			if (status != BED_SUCCESS) {
+				free(log);
+				log = NULL;
+			}
+		} else {
+			status = BED_ERROR_SYSTEM;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	*log_ptr = log;
+
+	return status;
+}
+
+void bed_ring_log_destroy(bed_ring_log *log)
+{
+	bed_lock_destroy(&log->lock);
+	free(log);
+}
+
+size_t bed_ring_log_max_record_size(const bed_ring_log *log)
+{
+	return log->page_size;
+}
+
+/*
+ * Discards the records of the oldest block.  The next good block with records
+ * becomes the oldest block.
+ */
+static bed_status discard_tail(bed_ring_log *log)
+{
+	uint32_t block = log->tail_block;
+	uint32_t tail = next_good_block(log, block);
+	record rec;
+	bed_status status = tail != block && tail != NO_BLOCK ?
+		read_metadata(log, tail, 0, &rec) : BED_ERROR_UNSATISFIED;
+
+	if (status == BED_SUCCESS) {
+		log->tail_block = tail;
+		log->tail_sequence = rec.sequence;
+	} else if (status == BED_ERROR_UNSATISFIED) {
+		log->tail_block = NO_BLOCK;
+		status = BED_SUCCESS;
+	}
+
+	return status;
+}
+
+/*
+ * In case the next block is the oldest block, then its records are
+ * discarded and the following block becomes the oldest block.
+ */
+static bed_status advance_head(bed_ring_log *log)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t block = log->head_block != NO_BLOCK ?
+		log->head_block : log->block_count - 1;
+	uint32_t i;
+
+	for (
+		i = 0;
+		i < log->block_count && status == BED_ERROR_UNSATISFIED;
+		++i
+	) {
+		block = next_good_block(log, block);
+
+		if (block == NO_BLOCK) {
+			break;
+		}
+
+		if (block == log->tail_block) {
+			status = discard_tail(log);
+
+			if (status != BED_SUCCESS) {
+				break;
+			}
+		}
+
+		status = bed_erase(
+			&log->part,
+			page_to_address(log, block, 0),
+			BED_ERASE_MARK_BAD_ON_ERROR
+		);
+		++log->info.block_erases;
+
+		if (status == BED_SUCCESS) {
+			log->head_block = block;
+			log->head_page = 0;
+		} else if (!bed_is_system_error(status)) {
+			status = BED_ERROR_UNSATISFIED;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * Returns BED_ERROR_WRITE to retry the append in the next block.
+ */
+static bed_status retire_head(bed_ring_log *log)
+{
+	uint32_t block = log->head_block;
+	bed_status status = BED_SUCCESS;
+
+	++log->info.write_errors;
+	log->head_page = log->pages_per_block;
+	bed_mark_block_bad(&log->part, page_to_address(log, block, 0));
+
+	if (block == log->tail_block) {
+		status = discard_tail(log);
+	}
+
+	if (status == BED_SUCCESS) {
+		status = BED_ERROR_WRITE;
+	}
+
+	return status;
+}
+
+/*
+ * In case of a write error, the block is marked bad and the record is
+ * appended to the next block.  The records written to the block before are
+ * lost.
+ */
+static bed_status append(bed_ring_log *log, const void *data, size_t n)
+{
+	bed_status status = BED_ERROR_WRITE;
+	uint32_t i;
+
+	for (
+		i = 0;
+		i < log->block_count && status == BED_ERROR_WRITE;
+		++i
+	) {
+		status = BED_SUCCESS;
+
+		if (
+			log->head_block == NO_BLOCK
+				|| log->head_page == log->pages_per_block
+		) {
+			status = advance_head(log);
+		}
+
+		if (status == BED_SUCCESS) {
+			uint8_t metadata [METADATA_SIZE];
+			const bed_oob_request oob = {
+				.mode = BED_OOB_MODE_AUTO,
+				.offset = 0,
+				.size = METADATA_SIZE,
+				.data = metadata
+			};
+			record rec = {
+				.sequence = log->sequence,
+				.size = (uint16_t) n
+			};
+
+			encode_metadata(metadata, &rec);
+			memset(log->page_buffer, 0xff, log->page_size);
+
+			if (n > 0) {
+				memcpy(log->page_buffer, data, n);
+			}
+
+			status = bed_write_oob(
+				&log->part,
+				page_to_address(log, log->head_block, log->head_page),
+				log->page_buffer,
+				log->page_size,
+				&oob
+			);
+			++log->sequence;
+
+			if (status == BED_SUCCESS) {
+				++log->head_page;
+
+				if (log->tail_block == NO_BLOCK) {
+					log->tail_block = log->head_block;
+					log->tail_sequence = rec.sequence;
+				}
+			} else if (status == BED_ERROR_WRITE) {
+				status = retire_head(log);
+			}
+		}
+	}
+
+	return status;
+}
+
+bed_status bed_ring_log_append(bed_ring_log *log, const void *data, size_t n)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (n <= log->page_size) {
+		bed_lock_obtain(&log->lock);
+		status = append(log, data, n);
+		bed_lock_release(&log->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+/*
+ * The lock must be owned by the caller.
+ */
+static void move_to_oldest(bed_ring_log *log, bed_ring_log_cursor *cursor)
+{
+	if (log->tail_block != NO_BLOCK) {
+		cursor->block = log->tail_block;
+		cursor->sequence = log->tail_sequence;
+	} else {
+		cursor->block = NO_BLOCK;
+		cursor->sequence = log->sequence;
+	}
+
+	cursor->page = 0;
+}
+
+void bed_ring_log_open_cursor(bed_ring_log *log, bed_ring_log_cursor *cursor)
+{
+	bed_lock_obtain(&log->lock);
+	move_to_oldest(log, cursor);
+	cursor->lost = 0;
+	bed_lock_release(&log->lock);
+}
+
+/*
+ * Reads the record at the cursor or the next record.  Pages without valid
+ * metadata end the records of a block.
+ */
+static bed_status read_next(
+	bed_ring_log *log,
+	bed_ring_log_cursor *cursor,
+	record *rec
+)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t page_count = log->block_count * log->pages_per_block;
+	uint32_t i;
+
+	for (i = 0; i < page_count && status == BED_ERROR_UNSATISFIED; ++i) {
+		if (cursor->page == log->pages_per_block) {
+			cursor->block = next_good_block(log, cursor->block);
+			cursor->page = 0;
+
+			if (cursor->block == NO_BLOCK) {
+				break;
+			}
+		}
+
+		{
+			uint8_t metadata [METADATA_SIZE];
+			const bed_oob_request oob = {
+				.mode = BED_OOB_MODE_AUTO,
+				.offset = 0,
+				.size = METADATA_SIZE,
+				.data = metadata
+			};
+
+			status = bed_read_oob(
+				&log->part,
+				page_to_address(log, cursor->block, cursor->page),
+				log->page_buffer,
+				log->page_size,
+				&oob
+			);
+
+			if (status == BED_ERROR_ECC_FIXED) {
+				status = BED_SUCCESS;
+			}
+
+			if (status == BED_SUCCESS) {
+				if (!decode_metadata(metadata, rec) || rec->size > log->page_size) {
+					status = BED_ERROR_UNSATISFIED;
+				}
+			} else if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+				bed_status meta_status = read_metadata(
+					log,
+					cursor->block,
+					cursor->page,
+					rec
+				);
+
+				if (meta_status != BED_SUCCESS) {
+					status = meta_status;
+				}
+			}
+		}
+
+		if (status == BED_ERROR_UNSATISFIED) {
+			cursor->page = log->pages_per_block;
+		} else if (
+			(status == BED_SUCCESS || status == BED_ERROR_ECC_UNCORRECTABLE)
+				&& is_before(rec->sequence, cursor->sequence)
+		) {
+			++cursor->page;
+			status = BED_ERROR_UNSATISFIED;
+		}
+	}
+
+	return status;
+}
+
+bed_status bed_ring_log_read(
+	bed_ring_log *log,
+	bed_ring_log_cursor *cursor,
+	void *data,
+	size_t size,
+	size_t *n
+)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+
+	*n = 0;
+
+	bed_lock_obtain(&log->lock);
+
+	if (
+		log->tail_block != NO_BLOCK
+			&& (
+				cursor->block == NO_BLOCK
+					|| is_before(cursor->sequence, log->tail_sequence)
+			)
+	) {
+		uint32_t sequence = cursor->sequence;
+
+		move_to_oldest(log, cursor);
+
+		if (is_before(sequence, cursor->sequence)) {
+			cursor->lost += cursor->sequence - sequence;
+		}
+	}
+
+	if (
+		cursor->block != NO_BLOCK
+			&& is_before(cursor->sequence, log->sequence)
+	) {
+		record rec;
+
+		status = read_next(log, cursor, &rec);
+
+		if (status == BED_SUCCESS || status == BED_ERROR_ECC_UNCORRECTABLE) {
+			cursor->lost += rec.sequence - cursor->sequence;
+			cursor->sequence = rec.sequence + 1;
+			++cursor->page;
+		}
+
+		if (status == BED_SUCCESS) {
+			*n = rec.size;
+			memcpy(data, log->page_buffer, size < *n ? size : *n);
+		}
+	}
+
+	bed_lock_release(&log->lock);
+
+	return status;
+}
+
+void bed_ring_log_get_info(bed_ring_log *log, bed_ring_log_info *info)
+{
+	bed_lock_obtain(&log->lock);
+	*info = log->info;
+	info->oldest_sequence = log->tail_block != NO_BLOCK ?
+		log->tail_sequence : log->sequence;
+	info->next_sequence = log->sequence;
+	bed_lock_release(&log->lock);
+}
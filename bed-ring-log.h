@@ -0,0 +1,179 @@
+/**
+ * @file
+ *
+ * @ingroup BEDRingLog
+ *
+ * @brief BED Ring Log API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_RING_LOG_H
+#define BED_RING_LOG_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDRingLog BED Ring Log
+ *
+ * @ingroup BED
+ *
+ * @brief Stores records like events round-robin in a partition.
+ *
+ * Each record occupies one page.  The record size and a sequence number
+ * which increases by one for each record are stored in the free
+ * out-of-bounds (OOB) area (#BED_OOB_MODE_AUTO mode, 12 bytes protected by a
+ * CRC).  The records are appended to the blocks in turn.  Bad blocks are
+ * skipped.  A block with a write error is marked bad, the records written to
+ * it before are lost.  Before a record is appended to the next block, this block is
+ * erased, so the oldest records are discarded once the partition is full.
+ *
+ * The sequence numbers of the first pages of the good blocks form a rotated
+ * ascending sequence.  On creation a binary search over these first pages
+ * finds the newest block and a binary search over its pages finds the newest
+ * record.  So the creation reads about log2(block count) + log2(pages per
+ * block) OOB areas and checks the bad block markers of the probed blocks
+ * only.  The block written last before the creation is not written further,
+ * since its last page may be incompletely programmed.  A partition must be
+ * erased before its first use with the log, e.g. with bed_erase_all().
+ *
+ * Reader cursors deliver the records from the oldest to the newest.  A
+ * cursor overtaken by the writer continues with the oldest record and
+ * counts the lost records.
+ *
+ * The log may be used concurrently.
+ *
+ * @{
+ */
+
+typedef struct {
+	uint32_t block;
+	uint32_t page;
+
+	/**
+	 * @brief Sequence number of the next record to read.
+	 */
+	uint32_t sequence;
+
+	/**
+	 * @brief Count of records discarded by the writer before they were read.
+	 */
+	uint32_t lost;
+} bed_ring_log_cursor;
+
+typedef struct {
+	/**
+	 * @brief Sequence number of the oldest record.
+	 */
+	uint32_t oldest_sequence;
+
+	/**
+	 * @brief Sequence number of the next record to append.
+	 */
+	uint32_t next_sequence;
+
+	/**
+	 * @brief Count of OOB area reads during the creation.
+	 */
+	uint32_t mount_reads;
+
+	uint32_t block_erases;
+	uint32_t write_errors;
+} bed_ring_log_info;
+
+typedef struct bed_ring_log bed_ring_log;
+
+/**
+ * @brief Creates a ring log for a partition.
+ *
+ * @param[in] part The partition.
+ * @param[out] log The ring log.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS The partition is not suitable.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ * @retval other The read of an OOB area failed.
+ */
+bed_status bed_ring_log_create(const bed_partition *part, bed_ring_log **log);
+
+/**
+ * @brief Destroys a ring log.
+ *
+ * The data on the partition is not affected.
+ */
+void bed_ring_log_destroy(bed_ring_log *log);
+
+/**
+ * @brief Returns the maximum record size in bytes.
+ *
+ * This is the page size.
+ */
+size_t bed_ring_log_max_record_size(const bed_ring_log *log);
+
+/**
+ * @brief Appends a record.
+ *
+ * @param[in] log The ring log.
+ * @param[in] data The record.
+ * @param[in] n The record size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS The record is too large.
+ * @retval BED_ERROR_UNSATISFIED No good blocks are available.
+ * @retval other The write failed.
+ */
+bed_status bed_ring_log_append(bed_ring_log *log, const void *data, size_t n);
+
+/**
+ * @brief Positions a cursor at the oldest record.
+ */
+void bed_ring_log_open_cursor(bed_ring_log *log, bed_ring_log_cursor *cursor);
+
+/**
+ * @brief Reads the record at a cursor and advances the cursor.
+ *
+ * @param[in] log The ring log.
+ * @param[in, out] cursor The cursor.
+ * @param[out] data The record.  Only the first @a size bytes are returned.
+ * @param[in] size The size of the record buffer.
+ * @param[out] n The record size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED No more records.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE Uncorrectable ECC error.  The cursor
+ * advanced to the next record.
+ * @retval other The read failed.
+ */
+bed_status bed_ring_log_read(
+	bed_ring_log *log,
+	bed_ring_log_cursor *cursor,
+	void *data,
+	size_t size,
+	size_t *n
+);
+
+void bed_ring_log_get_info(bed_ring_log *log, bed_ring_log_info *info);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_RING_LOG_H */
@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-scheduler.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct bed_scheduler {
+	bed_lock lock;
+	bed_condition ready [BED_SCHEDULER_CLASS_COUNT];
+	bool busy;
+	bool handed_over;
+	bed_scheduler_class handed_over_class;
+	uint32_t waiting [BED_SCHEDULER_CLASS_COUNT];
+	uint32_t next_ticket [BED_SCHEDULER_CLASS_COUNT];
+	uint32_t serving_ticket [BED_SCHEDULER_CLASS_COUNT];
+	uint32_t bypassed [BED_SCHEDULER_CLASS_COUNT];
+	bed_scheduler_config config;
+	bed_device *lower;
+	bed_device devices [BED_SCHEDULER_CLASS_COUNT];
+	bed_partition partitions [BED_SCHEDULER_CLASS_COUNT];
+};
+
+static const bed_scheduler_config default_config = {
+	.max_bypass = { 0, 16, 4 }
+};
+
+static bed_scheduler *get_scheduler(const bed_device *bed)
+{
+	return bed->context;
+}
+
+static bed_scheduler_class get_class(const bed_device *bed)
+{
+	const bed_scheduler *sched = get_scheduler(bed);
+
+	return (bed_scheduler_class) (bed - &sched->devices [0]);
+}
+
+/*
+ * A class which reached its bypass limit is served first, the lowest
+ * priority class at first.  Otherwise the highest priority class with waiting
+ * operations is served.  All other waiting classes are bypassed once.
+ */
+static bed_scheduler_class select_class(bed_scheduler *sched)
+{
+	int selected = -1;
+	int cls;
+
+	for (cls = BED_SCHEDULER_CLASS_COUNT - 1; cls >= 0 && selected < 0; --cls) {
+		uint32_t max_bypass = sched->config.max_bypass [cls];
+
+		if (
+			sched->waiting [cls] > 0
+				&& max_bypass > 0
+				&& sched->bypassed [cls] >= max_bypass
+		) {
+			selected = cls;
+		}
+	}
+
+	for (cls = 0; cls < BED_SCHEDULER_CLASS_COUNT && selected < 0; ++cls) {
+		if (sched->waiting [cls] > 0) {
+			selected = cls;
+		}
+	}
+
+	for (cls = 0; cls < BED_SCHEDULER_CLASS_COUNT; ++cls) {
+		if (cls == selected) {
+			sched->bypassed [cls] = 0;
+		} else if (sched->waiting [cls] > 0) {
+			++sched->bypassed [cls];
+		}
+	}
+
+	return (bed_scheduler_class) selected;
+}
+
+static bool has_waiting_operations(const bed_scheduler *sched)
+{
+	bool waiting = false;
+	int cls;
+
+	for (cls = 0; cls < BED_SCHEDULER_CLASS_COUNT; ++cls) {
+		waiting = waiting || sched->waiting [cls] > 0;
+	}
+
+	return waiting;
+}
+
+static void enter(bed_device *bed)
+{
+	bed_scheduler *sched = get_scheduler(bed);
+	bed_scheduler_class cls = get_class(bed);
+
+	bed_lock_obtain(&sched->lock);
+
+	if (sched->busy) {
+		uint32_t ticket = sched->next_ticket [cls];
+
+		++sched->next_ticket [cls];
+		++sched->waiting [cls];
+
+		while (
+			!sched->handed_over
+				|| sched->handed_over_class != cls
+				|| sched->serving_ticket [cls] != ticket
+		) {
+			bed_condition_wait(&sched->ready [cls], &sched->lock);
+		}
+
+		sched->handed_over = false;
+		++sched->serving_ticket [cls];
+		--sched->waiting [cls];
+	} else {
+		sched->busy = true;
+	}
+
+	bed_lock_release(&sched->lock);
+
+	(*sched->lower->obtain)(sched->lower);
+}
+
+/*
+ * The device stays busy during the hand over, so the selected operation
+ * cannot be overtaken by a newly arriving one.
+ */
+static void leave(bed_device *bed)
+{
+	bed_scheduler *sched = get_scheduler(bed);
+
+	(*sched->lower->release)(sched->lower);
+
+	bed_lock_obtain(&sched->lock);
+
+	if (has_waiting_operations(sched)) {
+		bed_scheduler_class cls = select_class(sched);
+
+		sched->handed_over = true;
+		sched->handed_over_class = cls;
+		bed_condition_broadcast(&sched->ready [cls]);
+	} else {
+		sched->busy = false;
+	}
+
+	bed_lock_release(&sched->lock);
+}
+
+static void obtain_nothing(bed_device *bed)
+{
+	(void) bed;
+}
+
+static bed_status sched_is_block_valid(bed_device *bed, bed_address addr)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->is_block_valid)(lower, addr);
+	leave(bed);
+
+	return status;
+}
+
+static bed_status sched_read(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n
+)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->read)(lower, addr, data, n);
+	leave(bed);
+
+	return status;
+}
+
+static bed_status sched_read_oob(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->read_oob)(lower, addr, data, n, oob);
+	leave(bed);
+
+	return status;
+}
+
+static bed_status sched_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->read_partial)(lower, addr, offset, data, n);
+	leave(bed);
+
+	return status;
+}
+
+#ifndef BED_CONFIG_READ_ONLY
+static bed_status sched_write(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n
+)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->write)(lower, addr, data, n);
+	leave(bed);
+
+	return status;
+}
+
+static bed_status sched_write_oob(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->write_oob)(lower, addr, data, n, oob);
+	leave(bed);
+
+	return status;
+}
+
+static bed_status sched_erase(bed_device *bed, bed_address addr)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->erase)(lower, addr);
+	leave(bed);
+
+	return status;
+}
+
+static bed_status sched_mark_block_bad(bed_device *bed, bed_address addr)
+{
+	bed_device *lower = get_scheduler(bed)->lower;
+	bed_status status;
+
+	enter(bed);
+	status = (*lower->mark_block_bad)(lower, addr);
+	leave(bed);
+
+	return status;
+}
+#endif /* BED_CONFIG_READ_ONLY */
+
+static void destroy_conditions(bed_scheduler *sched, int count)
+{
+	int cls;
+
+	for (cls = 0; cls < count; ++cls) {
+		bed_condition_destroy(&sched->ready [cls]);
+	}
+}
+
+static bed_status initialize_synchronization(bed_scheduler *sched)
+{
+	bed_status status = bed_lock_initialize(&sched->lock);
+
+	if (status == BED_SUCCESS) {
+		int cls;
+
+		for (
+			cls = 0;
+			status == BED_SUCCESS && cls < BED_SCHEDULER_CLASS_COUNT;
+			++cls
+		) {
+			status = bed_condition_initialize(&sched->ready [cls]);
+		}
+
+		if (status != BED_SUCCESS) {
+			destroy_conditions(sched, cls - 1);
+			bed_lock_destroy(&sched->lock);
+		}
+	}
+
+	return status;
+}
+
+bed_scheduler *bed_scheduler_create(
+	const bed_partition *parent,
+	const bed_scheduler_config *config
+)
+{
+	bed_scheduler *sched = malloc(sizeof(*sched));
+
+	if (sched != NULL) {
+		bed_status status;
+		int cls;
+
+		memset(sched, 0, sizeof(*sched));
+		sched->config = config != NULL ? *config : default_config;
+		sched->lower = parent->bed;
+
+		status = initialize_synchronization(sched);
+
+		for (cls = 0; cls < BED_SCHEDULER_CLASS_COUNT && status == BED_SUCCESS; ++cls) {
+			bed_device *bed = &sched->devices [cls];
+			bed_partition *part = &sched->partitions [cls];
+
+			*bed = *sched->lower;
+			bed->obtain = obtain_nothing;
+			bed->release = obtain_nothing;
+			bed->select_chip = bed_default_select_chip;
+			bed->is_block_valid = sched_is_block_valid;
+			bed->read = sched_read;
+			bed->read_oob = sched_read_oob;
+			bed->read_partial = sched_read_partial;
+#ifndef BED_CONFIG_READ_ONLY
+			bed->write = sched_write;
+			bed->write_oob = sched_write_oob;
+			bed->erase = sched_erase;
+			bed->mark_block_bad = sched_mark_block_bad;
+#endif /* BED_CONFIG_READ_ONLY */
+			bed->context = sched;
+
+			part->bed = bed;
+			part->begin = parent->begin;
+			part->size = parent->size;
+		}
+
+		if (status != BED_SUCCESS) {
+			free(sched);
+			sched = NULL;
+		}
+	}
+
+	return sched;
+}
+
+void bed_scheduler_destroy(bed_scheduler *sched)
+{
+	destroy_conditions(sched, BED_SCHEDULER_CLASS_COUNT);
+	bed_lock_destroy(&sched->lock);
+	free(sched);
+}
+
+const bed_partition *bed_scheduler_partition(
+	const bed_scheduler *sched,
+	bed_scheduler_class cls
+)
+{
+	return &sched->partitions [cls];
+}
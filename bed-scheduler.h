@@ -0,0 +1,113 @@
+/**
+ * @file
+ *
+ * @ingroup BEDScheduler
+ *
+ * @brief BED I/O Scheduler API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_SCHEDULER_H
+#define BED_SCHEDULER_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDScheduler BED I/O Scheduler
+ *
+ * @ingroup BED
+ *
+ * @brief Grants the device to requests by priority class.
+ *
+ * The scheduler provides one partition per priority class.  Each device
+ * operation of these partitions (page read, page write, block erase, etc.)
+ * waits in the queue of its class until the device is free.  The queues are
+ * served by priority and in FIFO order within a class.  A class which was
+ * bypassed by the configured count of operations of other classes is served
+ * next.  This limits the starvation of the lower classes and reserves them a
+ * share of the device bandwidth.
+ *
+ * The obtain and release methods of the scheduler partitions do nothing.  So
+ * long operations like bed_erase_all() or bed_read_with_skip() let other
+ * requests in between their pages and blocks.  The worst case latency of an
+ * interactive read is one operation of each class which is due to be served
+ * plus the current operation.
+ *
+ * @{
+ */
+
+typedef enum {
+	BED_SCHEDULER_CLASS_READ,
+	BED_SCHEDULER_CLASS_WRITE,
+	BED_SCHEDULER_CLASS_BACKGROUND,
+	BED_SCHEDULER_CLASS_COUNT
+} bed_scheduler_class;
+
+typedef struct {
+	/**
+	 * @brief Count of operations of other classes which may bypass a waiting
+	 * operation of this class.
+	 *
+	 * A value of zero disables the limit.
+	 */
+	uint32_t max_bypass [BED_SCHEDULER_CLASS_COUNT];
+} bed_scheduler_config;
+
+typedef struct bed_scheduler bed_scheduler;
+
+/**
+ * @brief Creates a scheduler for a partition.
+ *
+ * @param[in] parent The partition used by the scheduler.
+ * @param[in] config The scheduler configuration.  In case it is @c NULL,
+ * then writes may be bypassed 16 times and background operations 4 times.
+ *
+ * @retval NULL Not enough resources.
+ * @retval sched The scheduler.
+ */
+bed_scheduler *bed_scheduler_create(
+	const bed_partition *parent,
+	const bed_scheduler_config *config
+);
+
+/**
+ * @brief Destroys a scheduler.
+ *
+ * The scheduler partitions must not be in use.
+ */
+void bed_scheduler_destroy(bed_scheduler *sched);
+
+/**
+ * @brief Returns the partition of a priority class.
+ *
+ * It covers the same area as the parent partition.
+ */
+const bed_partition *bed_scheduler_partition(
+	const bed_scheduler *sched,
+	bed_scheduler_class cls
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_SCHEDULER_H */
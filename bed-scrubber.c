@@ -0,0 +1,840 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-scrubber.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DUE_READ_DISTURB 0x1
+
+#define DUE_ECC 0x2
+
+#define JOURNAL_MAGIC 0x4a534542
+
+#define NO_BLOCK UINT32_MAX
+
+struct bed_scrubber {
+	bed_lock lock;
+	bed_lock device_lock;
+	bed_partition parent;
+	bed_partition patrol;
+	bed_partition spare;
+	bed_scrubber_config config;
+	bed_device *lower;
+	bed_device device;
+	bed_partition part;
+	uint32_t block_count;
+	uint32_t pages_per_block;
+	uint32_t position;
+	uint32_t next_due;
+	uint32_t pending;
+	bool spare_clean;
+	bed_scrubber_statistics statistics;
+	uint32_t *read_counts;
+	uint32_t *fixed_counts;
+	uint8_t *due;
+	uint8_t *page_buffer;
+};
+
+static bed_scrubber *get_scrubber(const bed_device *bed)
+{
+	return bed->context;
+}
+
+static uint32_t block_of_device_address(
+	const bed_scrubber *scrubber,
+	bed_address addr
+)
+{
+	return (uint32_t) bed_address_to_block(
+		&scrubber->parent,
+		addr - scrubber->parent.begin
+	);
+}
+
+/*
+ * The lock must be owned by the caller.
+ */
+static void update_due(bed_scrubber *scrubber, uint32_t block)
+{
+	const bed_scrubber_config *config = &scrubber->config;
+
+	if (
+		config->read_threshold > 0
+			&& scrubber->read_counts [block] >= config->read_threshold
+	) {
+		scrubber->due [block] |= DUE_READ_DISTURB;
+	}
+
+	if (
+		config->ecc_threshold > 0
+			&& scrubber->fixed_counts [block] >= config->ecc_threshold
+	) {
+		scrubber->due [block] |= DUE_ECC;
+	}
+}
+
+/*
+ * The lock must be owned by the caller.
+ */
+static void account_read(
+	bed_scrubber *scrubber,
+	uint32_t block,
+	bed_status status,
+	bool patrol
+)
+{
+	if (!patrol) {
+		++scrubber->read_counts [block];
+	}
+
+	if (status == BED_ERROR_ECC_FIXED) {
+		++scrubber->fixed_counts [block];
+		++scrubber->statistics.fixed_reads;
+	} else if (status == BED_ERROR_ECC_UNCORRECTABLE) {
+		++scrubber->statistics.uncorrectable_reads;
+	}
+
+	update_due(scrubber, block);
+}
+
+static void account_device_read(
+	bed_scrubber *scrubber,
+	bed_address addr,
+	bed_status status
+)
+{
+	bed_lock_obtain(&scrubber->lock);
+	account_read(scrubber, block_of_device_address(scrubber, addr), status, false);
+	bed_lock_release(&scrubber->lock);
+}
+
+/*
+ * The lock must be owned by the caller.
+ */
+static void reset_block(bed_scrubber *scrubber, uint32_t block)
+{
+	scrubber->read_counts [block] = 0;
+	scrubber->fixed_counts [block] = 0;
+	scrubber->due [block] = 0;
+}
+
+static bed_status scrubber_is_block_valid(bed_device *bed, bed_address addr)
+{
+	bed_device *lower = get_scrubber(bed)->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->is_block_valid)(lower, addr);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static bed_status scrubber_read(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n
+)
+{
+	bed_scrubber *scrubber = get_scrubber(bed);
+	bed_device *lower = scrubber->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->read)(lower, addr, data, n);
+	(*lower->release)(lower);
+
+	account_device_read(scrubber, addr, status);
+
+	return status;
+}
+
+static bed_status scrubber_read_oob(
+	bed_device *bed,
+	bed_address addr,
+	void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_scrubber *scrubber = get_scrubber(bed);
+	bed_device *lower = scrubber->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->read_oob)(lower, addr, data, n, oob);
+	(*lower->release)(lower);
+
+	account_device_read(scrubber, addr, status);
+
+	return status;
+}
+
+static bed_status scrubber_read_partial(
+	bed_device *bed,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+)
+{
+	bed_scrubber *scrubber = get_scrubber(bed);
+	bed_device *lower = scrubber->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->read_partial)(lower, addr, offset, data, n);
+	(*lower->release)(lower);
+
+	account_device_read(scrubber, addr, status);
+
+	return status;
+}
+
+/*
+ * The scrubber partition is owned through the device lock, which the refresh
+ * in place holds as well.
+ */
+static void obtain_scrubber(bed_device *bed)
+{
+	bed_lock_obtain(&get_scrubber(bed)->device_lock);
+}
+
+static void release_scrubber(bed_device *bed)
+{
+	bed_lock_release(&get_scrubber(bed)->device_lock);
+}
+
+#ifndef BED_CONFIG_READ_ONLY
+static bed_status scrubber_write(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n
+)
+{
+	bed_device *lower = get_scrubber(bed)->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->write)(lower, addr, data, n);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static bed_status scrubber_write_oob(
+	bed_device *bed,
+	bed_address addr,
+	const void *data,
+	size_t n,
+	const bed_oob_request *oob
+)
+{
+	bed_device *lower = get_scrubber(bed)->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->write_oob)(lower, addr, data, n, oob);
+	(*lower->release)(lower);
+
+	return status;
+}
+
+static bed_status scrubber_erase(bed_device *bed, bed_address addr)
+{
+	bed_scrubber *scrubber = get_scrubber(bed);
+	bed_device *lower = scrubber->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->erase)(lower, addr);
+	(*lower->release)(lower);
+
+	bed_lock_obtain(&scrubber->lock);
+	reset_block(scrubber, block_of_device_address(scrubber, addr));
+	bed_lock_release(&scrubber->lock);
+
+	return status;
+}
+
+static bed_status scrubber_mark_block_bad(bed_device *bed, bed_address addr)
+{
+	bed_scrubber *scrubber = get_scrubber(bed);
+	bed_device *lower = scrubber->lower;
+	bed_status status;
+
+	(*lower->obtain)(lower);
+	status = (*lower->mark_block_bad)(lower, addr);
+	(*lower->release)(lower);
+
+	bed_lock_obtain(&scrubber->lock);
+	reset_block(scrubber, block_of_device_address(scrubber, addr));
+	bed_lock_release(&scrubber->lock);
+
+	return status;
+}
+#endif /* BED_CONFIG_READ_ONLY */
+
+/*
+ * Copies the pages and their free OOB areas of a block.  Erased pages are not
+ * written.
+ */
+static bed_status copy_block(
+	bed_scrubber *scrubber,
+	const bed_partition *from_part,
+	bed_address from,
+	const bed_partition *to_part,
+	bed_address to
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint16_t page_size = bed_page_size(from_part);
+	uint16_t oob_free_size = bed_oob_free_size(from_part);
+	uint8_t *page_buffer = scrubber->page_buffer;
+	const bed_oob_request oob = {
+		.mode = BED_OOB_MODE_AUTO,
+		.offset = 0,
+		.size = oob_free_size,
+		.data = page_buffer + page_size
+	};
+	bed_address offset;
+
+	for (
+		offset = 0;
+		offset < bed_block_size(from_part) && status == BED_SUCCESS;
+		offset += page_size
+	) {
+		status = bed_read_oob(from_part, from + offset, page_buffer, page_size, &oob);
+
+		if (status == BED_ERROR_ECC_FIXED) {
+			status = BED_SUCCESS;
+		}
+
+		if (
+			status == BED_SUCCESS
+				&& !bed_is_erased(page_buffer, page_size + (size_t) oob_free_size)
+		) {
+			status = bed_write_oob(to_part, to + offset, page_buffer, page_size, &oob);
+		}
+	}
+
+	return status;
+}
+
+static bed_address journal_address(const bed_scrubber *scrubber)
+{
+	return bed_block_size(&scrubber->spare);
+}
+
+static bed_status write_journal(bed_scrubber *scrubber, uint32_t block)
+{
+	uint16_t page_size = bed_page_size(&scrubber->spare);
+	uint8_t *page_buffer = scrubber->page_buffer;
+
+	memset(page_buffer, 0xff, page_size);
+	bed_put_le32(page_buffer, JOURNAL_MAGIC);
+	bed_put_le32(page_buffer + 4, block);
+	bed_put_le32(page_buffer + 8, bed_crc32(0, page_buffer, 8));
+
+	return bed_write(
+		&scrubber->spare,
+		journal_address(scrubber),
+		page_buffer,
+		page_size
+	);
+}
+
+/*
+ * Returns the block of a complete copy in the spare block or NO_BLOCK.
+ */
+static uint32_t read_journal(bed_scrubber *scrubber)
+{
+	uint32_t block = NO_BLOCK;
+	uint8_t *page_buffer = scrubber->page_buffer;
+	bed_status status = bed_read(
+		&scrubber->spare,
+		journal_address(scrubber),
+		page_buffer,
+		bed_page_size(&scrubber->spare)
+	);
+
+	if (
+		(status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED)
+			&& bed_get_le32(page_buffer) == JOURNAL_MAGIC
+			&& bed_get_le32(page_buffer + 8) == bed_crc32(0, page_buffer, 8)
+			&& bed_get_le32(page_buffer + 4) < scrubber->block_count
+	) {
+		block = bed_get_le32(page_buffer + 4);
+	}
+
+	return block;
+}
+
+/*
+ * Erases the journal block before the copy block, so that an interrupted
+ * erase leaves no journal entry for an incomplete copy behind.
+ */
+static bed_status clean_spare(bed_scrubber *scrubber)
+{
+	bed_status status = bed_erase(
+		&scrubber->spare,
+		journal_address(scrubber),
+		BED_ERASE_MARK_BAD_ON_ERROR
+	);
+
+	if (status == BED_SUCCESS) {
+		status = bed_erase(&scrubber->spare, 0, BED_ERASE_MARK_BAD_ON_ERROR);
+	}
+
+	scrubber->spare_clean = status == BED_SUCCESS;
+
+	return status;
+}
+
+/*
+ * Restores the pending block from the spare block.  The source block is not
+ * marked bad on an erase error, since the journal entry still refers to it.
+ * The restore is retried until it succeeds.  The device must be owned by the
+ * caller.
+ */
+static bed_status restore_block(bed_scrubber *scrubber)
+{
+	const bed_partition *parent = &scrubber->parent;
+	bed_address block = bed_block_to_address(parent, scrubber->pending);
+	bed_status status = bed_erase(parent, block, BED_ERASE_NORMAL);
+
+	if (status == BED_SUCCESS) {
+		status = copy_block(scrubber, &scrubber->spare, 0, parent, block);
+	}
+
+	if (status == BED_SUCCESS) {
+		scrubber->pending = NO_BLOCK;
+		status = clean_spare(scrubber);
+	}
+
+	return status;
+}
+
+/*
+ * Copies the block to the spare block, records the copy in the journal block
+ * and restores the block from the spare block.  A block with an uncorrectable
+ * page is not touched.  Up to the journal write the block is unchanged,
+ * afterwards a power cut is recovered by bed_scrubber_create().  The device
+ * must be owned by the caller.
+ */
+static bed_status refresh_via_spare(bed_scrubber *scrubber, uint32_t block)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (!scrubber->spare_clean) {
+		status = clean_spare(scrubber);
+	}
+
+	if (status == BED_SUCCESS) {
+		scrubber->spare_clean = false;
+		status = copy_block(
+			scrubber,
+			&scrubber->parent,
+			bed_block_to_address(&scrubber->parent, block),
+			&scrubber->spare,
+			0
+		);
+	}
+
+	if (status == BED_SUCCESS) {
+		status = write_journal(scrubber, block);
+	}
+
+	if (status == BED_SUCCESS) {
+		scrubber->pending = block;
+		status = restore_block(scrubber);
+	}
+
+	return status;
+}
+
+/*
+ * The device lock excludes the users of the scrubber partition also in case
+ * bed_obtain() of the parent device does not provide exclusive access, e.g.
+ * with chip locking of the NAND core.
+ */
+static void obtain_devices(bed_scrubber *scrubber)
+{
+	bed_lock_obtain(&scrubber->device_lock);
+	bed_obtain(&scrubber->parent);
+	bed_obtain(&scrubber->spare);
+}
+
+static void release_devices(bed_scrubber *scrubber)
+{
+	bed_release(&scrubber->spare);
+	bed_release(&scrubber->parent);
+	bed_lock_release(&scrubber->device_lock);
+}
+
+static void advance_patrol(bed_scrubber *scrubber, uint32_t pages)
+{
+	scrubber->position += pages;
+
+	if (scrubber->position >= scrubber->block_count * scrubber->pages_per_block) {
+		scrubber->position = 0;
+
+		bed_lock_obtain(&scrubber->lock);
+		++scrubber->statistics.patrol_passes;
+		bed_lock_release(&scrubber->lock);
+	}
+}
+
+/*
+ * Bad blocks do not count against the pages of a step.
+ */
+static void patrol(bed_scrubber *scrubber)
+{
+	uint16_t page_size = bed_page_size(&scrubber->parent);
+	uint32_t i;
+
+	for (i = 0; i < scrubber->config.pages_per_step; ++i) {
+		uint32_t skipped = 0;
+
+		while (
+			skipped < scrubber->block_count
+				&& scrubber->position % scrubber->pages_per_block == 0
+				&& bed_is_block_valid(
+					&scrubber->patrol,
+					scrubber->position * (bed_address) page_size
+				) != BED_SUCCESS
+		) {
+			advance_patrol(scrubber, scrubber->pages_per_block);
+			++skipped;
+		}
+
+		if (skipped < scrubber->block_count) {
+			uint32_t block = scrubber->position / scrubber->pages_per_block;
+			bed_status status = bed_read(
+				&scrubber->patrol,
+				scrubber->position * (bed_address) page_size,
+				scrubber->page_buffer,
+				page_size
+			);
+
+			bed_lock_obtain(&scrubber->lock);
+			account_read(scrubber, block, status, true);
+			++scrubber->statistics.patrol_reads;
+			bed_lock_release(&scrubber->lock);
+
+			advance_patrol(scrubber, 1);
+		}
+	}
+}
+
+/*
+ * The due blocks are served round robin.  A pending restore takes precedence
+ * over the due blocks.
+ */
+static bed_status refresh_next_due_block(bed_scrubber *scrubber)
+{
+	bed_status status = BED_SUCCESS;
+	bed_scrubber_refresh_handler refresh = scrubber->config.refresh;
+	uint32_t block = NO_BLOCK;
+	uint8_t due = 0;
+	uint32_t i;
+
+	if (refresh == NULL) {
+		obtain_devices(scrubber);
+
+		if (scrubber->pending != NO_BLOCK) {
+			status = restore_block(scrubber);
+		}
+	}
+
+	bed_lock_obtain(&scrubber->lock);
+
+	if (status != BED_SUCCESS) {
+		++scrubber->statistics.refresh_errors;
+	}
+
+	for (
+		i = 0;
+		i < scrubber->block_count && block == NO_BLOCK && status == BED_SUCCESS;
+		++i
+	) {
+		uint32_t candidate = (scrubber->next_due + i) % scrubber->block_count;
+
+		if (scrubber->due [candidate] != 0) {
+			block = candidate;
+			due = scrubber->due [candidate];
+			scrubber->due [candidate] = 0;
+			scrubber->next_due = (candidate + 1) % scrubber->block_count;
+		}
+	}
+
+	bed_lock_release(&scrubber->lock);
+
+	if (block != NO_BLOCK) {
+		if (refresh != NULL) {
+			status = (*refresh)(
+				scrubber->config.refresh_arg,
+				bed_block_to_address(&scrubber->parent, block)
+			);
+		} else {
+			status = refresh_via_spare(scrubber, block);
+		}
+
+		bed_lock_obtain(&scrubber->lock);
+
+		if (status == BED_SUCCESS) {
+			reset_block(scrubber, block);
+
+			if ((due & DUE_ECC) != 0) {
+				++scrubber->statistics.ecc_refreshes;
+			} else {
+				++scrubber->statistics.read_disturb_refreshes;
+			}
+		} else {
+			++scrubber->statistics.refresh_errors;
+		}
+
+		bed_lock_release(&scrubber->lock);
+	}
+
+	if (refresh == NULL) {
+		release_devices(scrubber);
+	}
+
+	return status;
+}
+
+bed_status bed_scrubber_step(bed_scrubber *scrubber)
+{
+	patrol(scrubber);
+
+	return refresh_next_due_block(scrubber);
+}
+
+static bool is_spare_valid(
+	const bed_partition *parent,
+	const bed_scrubber_config *config
+)
+{
+	const bed_partition *spare = config->spare;
+	bool valid = config->refresh != NULL && spare == NULL;
+
+	if (spare != NULL) {
+		valid = bed_page_size(spare) == bed_page_size(parent)
+			&& bed_block_size(spare) == bed_block_size(parent)
+			&& bed_oob_free_size(spare) == bed_oob_free_size(parent)
+			&& bed_size(spare) == 2 * (bed_address) bed_block_size(spare)
+			&& (
+				spare->bed != parent->bed
+					|| spare->begin >= parent->begin + parent->size
+					|| spare->begin + spare->size <= parent->begin
+			);
+	}
+
+	return valid;
+}
+
+bed_status bed_scrubber_create(
+	const bed_partition *parent,
+	const bed_scrubber_config *config,
+	bed_scrubber **scrubber_ptr
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_scrubber *scrubber = NULL;
+	uint16_t page_size = bed_page_size(parent);
+	size_t page_with_oob_size = page_size + (size_t) bed_oob_free_size(parent);
+	uint32_t block_count = (uint32_t) bed_address_to_block(parent, bed_size(parent));
+
+	if (
+		block_count > 0
+			&& config->pages_per_step > 0
+			&& (
+				config->patrol == NULL
+					|| (
+						config->patrol->begin == parent->begin
+							&& config->patrol->size == parent->size
+					)
+			)
+			&& is_spare_valid(parent, config)
+	) {
+		scrubber = malloc(
+			sizeof(*scrubber)
+				+ block_count * (2 * sizeof(uint32_t) + 1)
+				+ page_with_oob_size
+		);
+
+		if (scrubber != NULL) {
+			bed_device *bed = &scrubber->device;
+			uint8_t *chunk = (uint8_t *) (scrubber + 1);
+
+			memset(scrubber, 0, sizeof(*scrubber));
+			scrubber->parent = *parent;
+			scrubber->patrol = config->patrol != NULL ? *config->patrol : *parent;
+			scrubber->spare = config->spare != NULL ? *config->spare : *parent;
+			scrubber->config = *config;
+			scrubber->lower = parent->bed;
+			scrubber->block_count = block_count;
+			scrubber->pages_per_block = bed_block_size(parent) / page_size;
+			scrubber->pending = NO_BLOCK;
+			scrubber->read_counts = (uint32_t *) chunk;
+			chunk += block_count * sizeof(uint32_t);
+			scrubber->fixed_counts = (uint32_t *) chunk;
+			chunk += block_count * sizeof(uint32_t);
+			scrubber->page_buffer = chunk;
+			chunk += page_with_oob_size;
+			scrubber->due = chunk;
+			memset(scrubber->read_counts, 0, 2 * block_count * sizeof(uint32_t));
+			memset(scrubber->due, 0, block_count);
+
+			*bed = *scrubber->lower;
+			bed->obtain = obtain_scrubber;
+			bed->release = release_scrubber;
+			bed->select_chip = bed_default_select_chip;
+			bed->is_block_valid = scrubber_is_block_valid;
+			bed->read = scrubber_read;
+			bed->read_oob = scrubber_read_oob;
+			bed->read_partial = scrubber_read_partial;
+#ifndef BED_CONFIG_READ_ONLY
+			bed->write = scrubber_write;
+			bed->write_oob = scrubber_write_oob;
+			bed->erase = scrubber_erase;
+			bed->mark_block_bad = scrubber_mark_block_bad;
+#endif /* BED_CONFIG_READ_ONLY */
+			bed->context = scrubber;
+
+			scrubber->part.bed = bed;
+			scrubber->part.begin = parent->begin;
+			scrubber->part.size = parent->size;
+
+			status = bed_lock_initialize(&scrubber->lock);
+
+			if (status == BED_SUCCESS) {
+				status = bed_lock_initialize(&scrubber->device_lock);
+
+				if (status != BED_SUCCESS) {
+					bed_lock_destroy(&scrubber->lock);
+				}
+			}
+
+			if (status == BED_SUCCESS) {
+				if (config->refresh == NULL) {
+					obtain_devices(scrubber);
+					scrubber->pending = read_journal(scrubber);
+
+					if (scrubber->pending != NO_BLOCK) {
+						restore_block(scrubber);
+					}
+
+					release_devices(scrubber);
+				}
+			} else {
+				free(scrubber);
+				scrubber = NULL;
+			}
+		} else {
+			status = BED_ERROR_SYSTEM;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	*scrubber_ptr = scrubber;
+
+	return status;
+}
+
+void bed_scrubber_destroy(bed_scrubber *scrubber)
+{
+	bed_lock_destroy(&scrubber->device_lock);
+	bed_lock_destroy(&scrubber->lock);
+	free(scrubber);
+}
+
+const bed_partition *bed_scrubber_partition(const bed_scrubber *scrubber)
+{
+	return &scrubber->part;
+}
+
+uint32_t bed_scrubber_read_count(bed_scrubber *scrubber, bed_address block)
+{
+	uint32_t count = 0;
+	uint32_t index = (uint32_t) bed_address_to_block(&scrubber->parent, block);
+
+	if (index < scrubber->block_count) {
+		bed_lock_obtain(&scrubber->lock);
+		count = scrubber->read_counts [index];
+		bed_lock_release(&scrubber->lock);
+	}
+
+	return count;
+}
+
+uint32_t bed_scrubber_fixed_count(bed_scrubber *scrubber, bed_address block)
+{
+	uint32_t count = 0;
+	uint32_t index = (uint32_t) bed_address_to_block(&scrubber->parent, block);
+
+	if (index < scrubber->block_count) {
+		bed_lock_obtain(&scrubber->lock);
+		count = scrubber->fixed_counts [index];
+		bed_lock_release(&scrubber->lock);
+	}
+
+	return count;
+}
+
+bed_status bed_scrubber_set_counts(
+	bed_scrubber *scrubber,
+	bed_address block,
+	uint32_t read_count,
+	uint32_t fixed_count
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t index = (uint32_t) bed_address_to_block(&scrubber->parent, block);
+
+	if (index < scrubber->block_count) {
+		bed_lock_obtain(&scrubber->lock);
+		scrubber->read_counts [index] = read_count;
+		scrubber->fixed_counts [index] = fixed_count;
+		update_due(scrubber, index);
+		bed_lock_release(&scrubber->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+void bed_scrubber_get_statistics(
+	bed_scrubber *scrubber,
+	bed_scrubber_statistics *statistics,
+	bool reset
+)
+{
+	bed_lock_obtain(&scrubber->lock);
+	*statistics = scrubber->statistics;
+
+	if (reset) {
+		memset(&scrubber->statistics, 0, sizeof(scrubber->statistics));
+	}
+
+	bed_lock_release(&scrubber->lock);
+}
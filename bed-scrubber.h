@@ -0,0 +1,255 @@
+/**
+ * @file
+ *
+ * @ingroup BEDScrubber
+ *
+ * @brief BED Scrubber API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_SCRUBBER_H
+#define BED_SCRUBBER_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDScrubber BED Scrubber
+ *
+ * @ingroup BED
+ *
+ * @brief Refreshes blocks before read disturb and retention errors become
+ * uncorrectable.
+ *
+ * The scrubber provides a partition which covers the same area as its parent
+ * partition.  It counts the reads of each block through this partition and
+ * the reads with corrected ECC errors (#BED_ERROR_ECC_FIXED).  A block
+ * erase resets the counters of the block.  The counters live in RAM.  To
+ * account for reads across reboots, the application may save them (see
+ * bed_scrubber_read_count() and bed_scrubber_fixed_count()) and seed them
+ * after the creation (see bed_scrubber_set_counts()).
+ *
+ * Each bed_scrubber_step() reads the next pages of the partition in turn
+ * (patrol read).  The patrol reads may use a partition of a low priority
+ * scheduler class (see bed_scheduler_partition()).  Corrected ECC errors of
+ * patrol reads are counted like the other reads.  A block which exceeds the
+ * read threshold or the corrected read threshold is due for a refresh.  Each
+ * step refreshes at most one block.
+ *
+ * Upper layers with a block mapping should provide a refresh handler which
+ * relocates the block content to a new block.  Without a handler, the block
+ * is refreshed in place through two spare blocks.  The block is copied to
+ * the first spare block, a journal entry is written to the second spare
+ * block, the block is erased and the copy is written back.  At last the
+ * spare blocks are erased.  The device is owned for the whole refresh.  A
+ * power cut or erase or write error after the journal write leaves a
+ * pending restore behind, which bed_scrubber_create() and the following
+ * steps complete.  The refresh in place excludes the users of the scrubber
+ * partition through its own lock.  With chip locking of the NAND core (see
+ * bed_nand_enable_chip_locking()) bed_obtain() does not exclude other users of
+ * the parent device, so the parent area must then be accessed only through
+ * the scrubber partition.  Each refresh erases the spare blocks, so they wear out
+ * much faster than the other blocks.
+ *
+ * The scrubber partition may be used concurrently.
+ *
+ * @{
+ */
+
+/**
+ * @brief Refreshes the content of a block.
+ *
+ * @param[in] arg The handler argument.
+ * @param[in] block The block address relative to the parent partition begin.
+ */
+typedef bed_status (*bed_scrubber_refresh_handler)(
+	void *arg,
+	bed_address block
+);
+
+typedef struct {
+	/**
+	 * @brief Count of reads of a block after which the block is refreshed.
+	 *
+	 * A value of zero disables the read disturb refresh.
+	 */
+	uint32_t read_threshold;
+
+	/**
+	 * @brief Count of reads with corrected ECC errors of a block after which
+	 * the block is refreshed.
+	 *
+	 * A value of zero disables the ECC refresh.
+	 */
+	uint32_t ecc_threshold;
+
+	/**
+	 * @brief Count of pages read by the patrol in one step.
+	 */
+	uint32_t pages_per_step;
+
+	/**
+	 * @brief Partition used for patrol reads.
+	 *
+	 * It must cover the same area as the parent partition.  In case it is
+	 * @c NULL, then the parent partition is used.
+	 */
+	const bed_partition *patrol;
+
+	/**
+	 * @brief Refresh handler.
+	 *
+	 * In case it is @c NULL, then the blocks are refreshed in place through
+	 * the spare blocks.
+	 */
+	bed_scrubber_refresh_handler refresh;
+
+	void *refresh_arg;
+
+	/**
+	 * @brief Partition of exactly two spare blocks for the refresh in place.
+	 *
+	 * It is required in case no refresh handler is provided.  It must have the
+	 * geometry of the parent partition and must not overlap it.  Its content
+	 * is owned by the scrubber.
+	 */
+	const bed_partition *spare;
+} bed_scrubber_config;
+
+typedef struct {
+	uint64_t patrol_reads;
+
+	/**
+	 * @brief Count of completed patrol passes across the partition.
+	 */
+	uint32_t patrol_passes;
+
+	uint64_t fixed_reads;
+	uint64_t uncorrectable_reads;
+	uint32_t read_disturb_refreshes;
+	uint32_t ecc_refreshes;
+	uint32_t refresh_errors;
+} bed_scrubber_statistics;
+
+typedef struct bed_scrubber bed_scrubber;
+
+/**
+ * @brief Creates a scrubber for a partition.
+ *
+ * Without a refresh handler, a pending restore of an interrupted refresh is
+ * performed.  In case it fails, the following steps retry it.
+ *
+ * @param[in] parent The partition.
+ * @param[in] config The scrubber configuration.
+ * @param[out] scrubber The scrubber.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid configuration for this
+ * partition.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ */
+bed_status bed_scrubber_create(
+	const bed_partition *parent,
+	const bed_scrubber_config *config,
+	bed_scrubber **scrubber
+);
+
+/**
+ * @brief Destroys a scrubber.
+ *
+ * The scrubber partition must not be in use.
+ */
+void bed_scrubber_destroy(bed_scrubber *scrubber);
+
+/**
+ * @brief Returns the partition of the scrubber.
+ *
+ * It covers the same area as the parent partition.
+ */
+const bed_partition *bed_scrubber_partition(const bed_scrubber *scrubber);
+
+/**
+ * @brief Performs one patrol and refresh step.
+ *
+ * Call this function periodically, e.g. from a low priority task.  The
+ * configured count of pages per step and the call period determine the
+ * patrol rate.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval other The refresh of a block or a pending restore failed.
+ */
+bed_status bed_scrubber_step(bed_scrubber *scrubber);
+
+/**
+ * @brief Gets the read count of a block since its last erase or refresh.
+ *
+ * @param[in] scrubber The scrubber.
+ * @param[in] block The block address relative to the partition begin.
+ */
+uint32_t bed_scrubber_read_count(bed_scrubber *scrubber, bed_address block);
+
+/**
+ * @brief Gets the count of reads with corrected ECC errors of a block since
+ * its last erase or refresh.
+ *
+ * @param[in] scrubber The scrubber.
+ * @param[in] block The block address relative to the partition begin.
+ */
+uint32_t bed_scrubber_fixed_count(bed_scrubber *scrubber, bed_address block);
+
+/**
+ * @brief Sets the counters of a block, e.g. to values saved before a reboot.
+ *
+ * A block which reaches a threshold with these counts is due for a refresh.
+ *
+ * @param[in] scrubber The scrubber.
+ * @param[in] block The block address relative to the partition begin.
+ * @param[in] read_count The read count.
+ * @param[in] fixed_count The count of reads with corrected ECC errors.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid block address.
+ */
+bed_status bed_scrubber_set_counts(
+	bed_scrubber *scrubber,
+	bed_address block,
+	uint32_t read_count,
+	uint32_t fixed_count
+);
+
+/**
+ * @brief Gets the scrubber statistics.
+ *
+ * @param[in] scrubber The scrubber.
+ * @param[out] statistics The statistics.
+ * @param[in] reset Clear the statistics after the copy.
+ */
+void bed_scrubber_get_statistics(
+	bed_scrubber *scrubber,
+	bed_scrubber_statistics *statistics,
+	bool reset
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_SCRUBBER_H */
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-skip-writer.h"
+
+#include <string.h>
+
+/*
+ * No block was erased ahead so far.
+ */
+#define NO_BLOCK UINT32_MAX
+
+/*
+ * Erases the first valid block at or after the block.  Returns
+ * BED_ERROR_UNSATISFIED in case no such block exists.
+ */
+static bed_status prepare_block(
+	bed_skip_writer *writer,
+	bed_address block,
+	bed_address *prepared
+)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+
+	while (status == BED_ERROR_UNSATISFIED && block < writer->part.size) {
+		status = bed_erase(&writer->part, block, BED_ERASE_MARK_BAD_ON_ERROR);
+
+		if (status == BED_SUCCESS) {
+			*prepared = block;
+		} else {
+			if (status == BED_ERROR_BLOCK_IS_BAD) {
+				++writer->layout.skipped_blocks;
+				status = BED_ERROR_UNSATISFIED;
+			} else if (status == BED_ERROR_ERASE) {
+				++writer->layout.failed_blocks;
+				status = BED_ERROR_UNSATISFIED;
+			}
+
+			block += writer->block_size;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * Uses the block erased ahead if available.
+ */
+static bed_status take_next_block(
+	bed_skip_writer *writer,
+	bed_address current,
+	bed_address *next
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (writer->ahead == writer->part.size) {
+		status = BED_ERROR_UNSATISFIED;
+	} else if (writer->ahead != NO_BLOCK) {
+		*next = writer->ahead;
+		writer->ahead = NO_BLOCK;
+	} else {
+		status = prepare_block(writer, current + writer->block_size, next);
+	}
+
+	return status;
+}
+
+static bed_status erase_ahead(bed_skip_writer *writer)
+{
+	bed_status status = prepare_block(
+		writer,
+		writer->block + writer->block_size,
+		&writer->ahead
+	);
+
+	if (status == BED_ERROR_UNSATISFIED) {
+		writer->ahead = writer->part.size;
+		status = BED_SUCCESS;
+	}
+
+	return status;
+}
+
+/*
+ * Copies the pages written so far and the current page of the block with the
+ * write error to the next valid block.
+ */
+static bed_status replace_block(bed_skip_writer *writer)
+{
+	bed_status status = BED_ERROR_WRITE;
+	bed_address failed = writer->block;
+	bed_address count = writer->page;
+	bed_address from = failed;
+	bed_address block = failed;
+
+	while (status == BED_ERROR_WRITE) {
+		bed_address offset;
+
+		status = take_next_block(writer, from, &block);
+
+		for (
+			offset = 0;
+			status == BED_SUCCESS && offset != count;
+			offset += writer->page_size
+		) {
+			status = bed_read(
+				&writer->part,
+				failed + offset,
+				writer->copy_buffer,
+				writer->page_size
+			);
+
+			if (status == BED_ERROR_ECC_FIXED) {
+				status = BED_SUCCESS;
+			}
+
+			if (status == BED_SUCCESS) {
+				status = bed_write(
+					&writer->part,
+					block + offset,
+					writer->copy_buffer,
+					writer->page_size
+				);
+			}
+		}
+
+		if (status == BED_SUCCESS) {
+			status = bed_write(
+				&writer->part,
+				block + count,
+				writer->page_buffer,
+				writer->page_size
+			);
+		}
+
+		if (status == BED_ERROR_WRITE) {
+			bed_mark_block_bad(&writer->part, block);
+			++writer->layout.failed_blocks;
+			from = block;
+		}
+	}
+
+	if (status == BED_SUCCESS) {
+		bed_mark_block_bad(&writer->part, failed);
+		++writer->layout.failed_blocks;
+		writer->layout.copied_pages += count / writer->page_size;
+		writer->block = block;
+
+		if (writer->layout.begin == failed) {
+			writer->layout.begin = block;
+		}
+	}
+
+	return status;
+}
+
+static bed_status write_page(bed_skip_writer *writer)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (writer->page == writer->block_size) {
+		status = take_next_block(writer, writer->block, &writer->block);
+		writer->page = 0;
+	}
+
+	if (status == BED_SUCCESS) {
+		bool first = writer->page == 0;
+
+		status = bed_write(
+			&writer->part,
+			writer->block + writer->page,
+			writer->page_buffer,
+			writer->page_size
+		);
+
+		if (status == BED_ERROR_WRITE) {
+			status = replace_block(writer);
+		}
+
+		if (status == BED_SUCCESS) {
+			if (first) {
+				if (writer->layout.block_count == 0) {
+					writer->layout.begin = writer->block;
+				}
+
+				++writer->layout.block_count;
+			}
+
+			writer->layout.end = writer->block + writer->block_size;
+			writer->page += writer->page_size;
+			writer->fill = 0;
+		}
+	}
+
+	return status;
+}
+
+size_t bed_skip_writer_buffer_size(const bed_partition *part)
+{
+	return 2 * (size_t) bed_page_size(part);
+}
+
+bed_status bed_skip_writer_open(
+	bed_skip_writer *writer,
+	const bed_partition *part,
+	bed_address begin,
+	void *buffer
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint16_t page_size = bed_page_size(part);
+	uint32_t block_size = bed_block_size(part);
+
+	memset(writer, 0, sizeof(*writer));
+	writer->part = *part;
+	writer->page_buffer = buffer;
+	writer->copy_buffer = writer->page_buffer + page_size;
+	writer->block_size = block_size;
+	writer->page_size = page_size;
+	writer->ahead = NO_BLOCK;
+
+	if ((begin & (block_size - 1)) == 0 && begin < part->size) {
+		status = prepare_block(writer, begin, &writer->block);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	writer->layout.begin = writer->block;
+	writer->layout.end = writer->block;
+	writer->status = status;
+
+	return status;
+}
+
+bed_status bed_skip_writer_append(
+	bed_skip_writer *writer,
+	const void *data,
+	size_t n
+)
+{
+	bed_status status = writer->status;
+	const uint8_t *in = data;
+
+	/*
+	 * The data continues in the next block, so erase it while its first page
+	 * is received.  A block after the image is never erased.
+	 */
+	if (
+		status == BED_SUCCESS
+			&& n > 0
+			&& writer->page == writer->block_size
+			&& writer->ahead == NO_BLOCK
+	) {
+		status = erase_ahead(writer);
+	}
+
+	while (status == BED_SUCCESS && n > 0) {
+		size_t r = (size_t) (writer->page_size - writer->fill);
+		size_t m = n < r ? n : r;
+
+		memcpy(writer->page_buffer + writer->fill, in, m);
+		writer->fill = (uint16_t) (writer->fill + m);
+		writer->layout.size += m;
+		in += m;
+		n -= m;
+
+		if (writer->fill == writer->page_size) {
+			status = write_page(writer);
+		}
+	}
+
+	writer->status = status;
+
+	return status;
+}
+
+bed_status bed_skip_writer_close(
+	bed_skip_writer *writer,
+	bed_skip_writer_layout *layout
+)
+{
+	bed_status status = writer->status;
+
+	if (status == BED_SUCCESS && writer->fill > 0) {
+		memset(
+			writer->page_buffer + writer->fill,
+			0xff,
+			(size_t) (writer->page_size - writer->fill)
+		);
+		status = write_page(writer);
+	}
+
+	if (layout != NULL) {
+		*layout = writer->layout;
+	}
+
+	return status;
+}
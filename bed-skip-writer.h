@@ -0,0 +1,192 @@
+/**
+ * @file
+ *
+ * @ingroup BEDSkipWriter
+ *
+ * @brief BED Skip Writer API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_SKIP_WRITER_H
+#define BED_SKIP_WRITER_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDSkipWriter BED Skip Writer
+ *
+ * @ingroup BED
+ *
+ * @brief Writes an image incrementally to the valid blocks of a partition.
+ *
+ * The result is the same as with bed_write_with_skip(), so the image can be
+ * read with bed_read_with_skip().  The image need not be in memory as a
+ * whole, e.g. it may be written while it is received.  The writer keeps the
+ * current page in a buffer and writes it once it is full.  Once data is
+ * appended after the last page of a block, the next valid block is erased
+ * ahead while its first page is received.  So no block after the image is
+ * erased.  Blocks
+ * with an erase error are marked bad and skipped.  In case of a write error
+ * the pages of the block written so far are read back and copied together
+ * with the current page to the next valid block.  Afterwards the block is
+ * marked bad.
+ *
+ * @{
+ */
+
+/**
+ * @brief Layout of a written image.
+ *
+ * Addresses are relative to the partition begin.
+ */
+typedef struct {
+	/**
+	 * @brief Count of image bytes.
+	 */
+	size_t size;
+
+	/**
+	 * @brief Address of the first block.
+	 */
+	bed_address begin;
+
+	/**
+	 * @brief End address of the last block with image data.
+	 *
+	 * The next image may start here.
+	 */
+	bed_address end;
+
+	/**
+	 * @brief Count of blocks with image data.
+	 */
+	uint32_t block_count;
+
+	/**
+	 * @brief Count of bad blocks skipped.
+	 */
+	uint32_t skipped_blocks;
+
+	/**
+	 * @brief Count of blocks marked bad due to erase or write errors.
+	 */
+	uint32_t failed_blocks;
+
+	/**
+	 * @brief Count of pages copied due to write errors.
+	 */
+	uint32_t copied_pages;
+} bed_skip_writer_layout;
+
+/**
+ * @brief Skip writer state.
+ *
+ * The members are private.
+ *
+ * @see bed_skip_writer_open().
+ */
+typedef struct {
+	bed_partition part;
+	uint8_t *page_buffer;
+	uint8_t *copy_buffer;
+	uint32_t block_size;
+	uint16_t page_size;
+	uint16_t fill;
+	bed_address block;
+	bed_address page;
+	bed_address ahead;
+	bed_status status;
+	bed_skip_writer_layout layout;
+} bed_skip_writer;
+
+/**
+ * @brief Returns the size of the buffer needed by a skip writer.
+ *
+ * This is twice the page size.
+ */
+size_t bed_skip_writer_buffer_size(const bed_partition *part);
+
+/**
+ * @brief Opens a skip writer.
+ *
+ * Erases the first valid block at or after the begin address.
+ *
+ * @param[out] writer The skip writer.
+ * @param[in] part The partition.
+ * @param[in] begin The begin address relative to the partition begin.  It
+ * must be block aligned.
+ * @param[in] buffer The buffer of bed_skip_writer_buffer_size() bytes.  It
+ * must be available until the writer is closed.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid begin address.
+ * @retval BED_ERROR_UNSATISFIED Not enough valid blocks.
+ * @retval other The erase failed.
+ */
+bed_status bed_skip_writer_open(
+	bed_skip_writer *writer,
+	const bed_partition *part,
+	bed_address begin,
+	void *buffer
+);
+
+/**
+ * @brief Appends data to the image.
+ *
+ * After an error the writer is unusable and all further appends return this
+ * error.
+ *
+ * @param[in, out] writer The skip writer.
+ * @param[in] data The data.
+ * @param[in] n The data size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED Not enough valid blocks.
+ * @retval other A page read during a copy or an erase failed.
+ */
+bed_status bed_skip_writer_append(
+	bed_skip_writer *writer,
+	const void *data,
+	size_t n
+);
+
+/**
+ * @brief Closes a skip writer.
+ *
+ * Writes the current page padded with 0xff bytes.
+ *
+ * @param[in, out] writer The skip writer.
+ * @param[out] layout The layout of the image.  May be @c NULL.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval other See bed_skip_writer_append().
+ */
+bed_status bed_skip_writer_close(
+	bed_skip_writer *writer,
+	bed_skip_writer_layout *layout
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_SKIP_WRITER_H */
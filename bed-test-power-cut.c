@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-test.h"
+#include "bed-nand.h"
+
+#include <string.h>
+#include <time.h>
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static void run_workload(
+	const bed_partition *part,
+	const bed_test_power_cut_workload *workload,
+	uint32_t operation,
+	uint8_t percent,
+	bed_test_power_cut_result *result
+)
+{
+	void *arg = workload->arg;
+	uint32_t operation_count;
+	uint64_t t0;
+
+	memset(result, 0, sizeof(*result));
+	result->operation = operation;
+
+	bed_nand_simulator_power_on(part);
+
+	if (workload->prepare != NULL) {
+		(*workload->prepare)(arg, part);
+	}
+
+	operation_count = bed_nand_simulator_operation_count(part);
+	bed_nand_simulator_set_power_cut(part, operation, percent);
+	result->run_status = (*workload->run)(arg, part);
+	result->operation_count = bed_nand_simulator_operation_count(part)
+		- operation_count;
+	bed_nand_simulator_power_on(part);
+
+	t0 = now();
+
+	if (workload->recover != NULL) {
+		result->recover_status = (*workload->recover)(arg, part);
+	}
+
+	result->recover_nanoseconds = now() - t0;
+	result->check_status = (*workload->check)(arg, part, &result->lost);
+}
+
+uint32_t bed_test_power_cut(
+	const bed_partition *part,
+	const bed_test_power_cut_workload *workload,
+	uint8_t percent,
+	bed_test_power_cut_report report,
+	void *report_arg
+)
+{
+	bed_test_power_cut_result result;
+	uint32_t cut_points;
+	uint32_t operation;
+
+	run_workload(part, workload, 0, percent, &result);
+	(*report)(report_arg, &result);
+	cut_points = result.operation_count;
+
+	for (operation = 1; operation <= cut_points; ++operation) {
+		run_workload(part, workload, operation, percent, &result);
+		(*report)(report_arg, &result);
+	}
+
+	return cut_points;
+}
@@ -78,6 +78,81 @@ void bed_test_make_block_bad(
 	bed_test_mark_block_bad_stats *stats
 );
 
+/**
+ * @brief Power cut workload.
+ *
+ * @see bed_test_power_cut().
+ */
+typedef struct {
+	/**
+	 * @brief Establishes the initial flash state before each workload run.
+	 */
+	bed_status (*prepare)(void *arg, const bed_partition *part);
+
+	/**
+	 * @brief Performs the workload which will be interrupted by a power cut.
+	 */
+	bed_status (*run)(void *arg, const bed_partition *part);
+
+	/**
+	 * @brief Recovers after the power cut, e.g. mounts the file system.
+	 *
+	 * The recovery time is measured.  May be NULL.
+	 */
+	bed_status (*recover)(void *arg, const bed_partition *part);
+
+	/**
+	 * @brief Checks the integrity after the recovery.
+	 *
+	 * The count of lost bytes shall be returned via the @a lost parameter.
+	 */
+	bed_status (*check)(void *arg, const bed_partition *part, size_t *lost);
+
+	void *arg;
+} bed_test_power_cut_workload;
+
+typedef struct {
+	uint32_t operation;
+	uint32_t operation_count;
+	bed_status run_status;
+	bed_status recover_status;
+	bed_status check_status;
+	uint64_t recover_nanoseconds;
+	size_t lost;
+} bed_test_power_cut_result;
+
+typedef void (*bed_test_power_cut_report)(
+	void *report_arg,
+	const bed_test_power_cut_result *result
+);
+
+/**
+ * @brief Sweeps power cuts across a workload on a NAND simulator partition.
+ *
+ * A reference run without a power cut determines the count of page program
+ * and block erase operations of the workload.  Afterwards the workload is
+ * run once for each of these operations with a power cut at this operation.
+ * After each power cut the simulator is powered on again and the recovery
+ * time and integrity are reported.
+ *
+ * @param[in] part The NAND simulator partition.
+ * @param[in] workload The workload.
+ * @param[in] percent The percentage of the interrupted operation which
+ * completes.
+ * @param[in] report The report function called for the reference run
+ * (operation zero) and each power cut.
+ * @param[in] report_arg The argument for the report function.
+ *
+ * @return The count of power cut points.
+ */
+uint32_t bed_test_power_cut(
+	const bed_partition *part,
+	const bed_test_power_cut_workload *workload,
+	uint8_t percent,
+	bed_test_power_cut_report report,
+	void *report_arg
+);
+
 /** @} */
 
 #ifdef __cplusplus
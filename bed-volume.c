@@ -0,0 +1,1093 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-volume.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The erase count (EC) header consists of the magic, the version, the erase
+ * count and a CRC-32 of the previous words.  The volume identifier (VID)
+ * header consists of the magic, the volume, the LEB number, the data size,
+ * the data CRC-32, the sequence number (low and high word) and a CRC-32 of
+ * the previous words.  The data CRC-32 covers the whole pages of the data
+ * including the padding, so that partially programmed pages are detected.  A
+ * data size of zero indicates a LEB written with bed_volume_write() which has
+ * no data CRC.  All words are little endian.
+ */
+#define EC_MAGIC 0x43454542
+
+#define VID_MAGIC 0x56454542
+
+#define VERSION 1
+
+#define EC_HEADER_SIZE 16
+
+#define VID_HEADER_SIZE 32
+
+#define EC_PAGE 0
+
+#define VID_PAGE 1
+
+#define DATA_PAGE 2
+
+#define UNMAPPED UINT32_MAX
+
+typedef enum {
+	PEB_FREE,
+	PEB_DIRTY,
+	PEB_USED,
+	PEB_BAD
+} peb_state;
+
+typedef struct {
+	uint32_t volume;
+	uint32_t leb;
+	uint32_t data_size;
+	uint32_t data_crc;
+	uint64_t sequence;
+} vid_header;
+
+struct bed_volume_manager {
+	bed_lock lock;
+	bed_partition part;
+	bed_volume_config config;
+	uint16_t page_size;
+	uint32_t leb_size;
+	uint32_t peb_count;
+	uint32_t leb_count;
+	uint64_t sequence;
+	uint32_t wear_moves;
+	uint32_t *volume_begins;
+	uint32_t *map;
+	uint32_t *owners;
+	uint32_t *erase_counts;
+	uint8_t *states;
+	uint8_t *page_buffer;
+};
+
+static bool is_read_ok(bed_status status)
+{
+	return status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED;
+}
+
+static bed_address page_address(
+	const bed_volume_manager *vm,
+	uint32_t peb,
+	uint32_t page
+)
+{
+	return bed_block_to_address(&vm->part, peb)
+		+ page * (bed_address) vm->page_size;
+}
+
+static uint32_t volume_of_leb(const bed_volume_manager *vm, uint32_t global)
+{
+	uint32_t volume = 0;
+
+	while (global >= vm->volume_begins [volume + 1]) {
+		++volume;
+	}
+
+	return volume;
+}
+
+static void mark_bad(bed_volume_manager *vm, uint32_t peb)
+{
+	bed_mark_block_bad(&vm->part, bed_block_to_address(&vm->part, peb));
+	vm->states [peb] = PEB_BAD;
+	vm->owners [peb] = UNMAPPED;
+}
+
+static bed_status write_header_page(
+	bed_volume_manager *vm,
+	uint32_t peb,
+	uint32_t page
+)
+{
+	bed_status status = bed_write(
+		&vm->part,
+		page_address(vm, peb, page),
+		vm->page_buffer,
+		vm->page_size
+	);
+
+	if (status != BED_SUCCESS && !bed_is_system_error(status)) {
+		mark_bad(vm, peb);
+	}
+
+	return status;
+}
+
+static bed_status write_ec_header(bed_volume_manager *vm, uint32_t peb)
+{
+	uint8_t *p = vm->page_buffer;
+
+	memset(p, 0xff, vm->page_size);
+	bed_put_le32(p, EC_MAGIC);
+	bed_put_le32(p + 4, VERSION);
+	bed_put_le32(p + 8, vm->erase_counts [peb]);
+	bed_put_le32(p + 12, bed_crc32(0, p, 12));
+
+	return write_header_page(vm, peb, EC_PAGE);
+}
+
+static bed_status write_vid_header(
+	bed_volume_manager *vm,
+	uint32_t peb,
+	const vid_header *vid
+)
+{
+	uint8_t *p = vm->page_buffer;
+
+	memset(p, 0xff, vm->page_size);
+	bed_put_le32(p, VID_MAGIC);
+	bed_put_le32(p + 4, vid->volume);
+	bed_put_le32(p + 8, vid->leb);
+	bed_put_le32(p + 12, vid->data_size);
+	bed_put_le32(p + 16, vid->data_crc);
+	bed_put_le32(p + 20, (uint32_t) vid->sequence);
+	bed_put_le32(p + 24, (uint32_t) (vid->sequence >> 32));
+	bed_put_le32(p + 28, bed_crc32(0, p, 28));
+
+	return write_header_page(vm, peb, VID_PAGE);
+}
+
+/*
+ * In case of an erase or EC header write error the PEB is bad.
+ */
+static bed_status erase_peb(bed_volume_manager *vm, uint32_t peb)
+{
+	bed_status status = bed_erase(
+		&vm->part,
+		bed_block_to_address(&vm->part, peb),
+		BED_ERASE_MARK_BAD_ON_ERROR
+	);
+
+	if (status == BED_SUCCESS) {
+		++vm->erase_counts [peb];
+		vm->states [peb] = PEB_DIRTY;
+		vm->owners [peb] = UNMAPPED;
+		status = write_ec_header(vm, peb);
+
+		if (status == BED_SUCCESS) {
+			vm->states [peb] = PEB_FREE;
+		}
+	} else if (!bed_is_system_error(status)) {
+		vm->states [peb] = PEB_BAD;
+		vm->owners [peb] = UNMAPPED;
+	}
+
+	return status;
+}
+
+static bool is_available(const bed_volume_manager *vm, uint32_t peb)
+{
+	return vm->states [peb] == PEB_FREE || vm->states [peb] == PEB_DIRTY;
+}
+
+/*
+ * Selects the free or dirty PEB with the lowest or highest erase count.
+ */
+static uint32_t select_available(const bed_volume_manager *vm, bool lowest)
+{
+	uint32_t selected = UNMAPPED;
+	uint32_t i;
+
+	for (i = 0; i < vm->peb_count; ++i) {
+		if (is_available(vm, i)) {
+			uint32_t erase_count = vm->erase_counts [i];
+
+			if (
+				selected == UNMAPPED
+					|| (lowest && erase_count < vm->erase_counts [selected])
+					|| (!lowest && erase_count > vm->erase_counts [selected])
+			) {
+				selected = i;
+			}
+		}
+	}
+
+	return selected;
+}
+
+/*
+ * Returns a free PEB with a valid EC header.  Dirty PEBs are erased on
+ * demand.
+ */
+static bed_status allocate_peb(bed_volume_manager *vm, bool lowest, uint32_t *peb)
+{
+	bed_status status;
+
+	do {
+		uint32_t selected = select_available(vm, lowest);
+
+		if (selected != UNMAPPED) {
+			if (vm->states [selected] == PEB_DIRTY) {
+				status = erase_peb(vm, selected);
+			} else {
+				status = BED_SUCCESS;
+			}
+
+			*peb = selected;
+		} else {
+			status = BED_ERROR_UNSATISFIED;
+		}
+	} while (
+		status != BED_SUCCESS
+			&& status != BED_ERROR_UNSATISFIED
+			&& !bed_is_system_error(status)
+	);
+
+	return status;
+}
+
+static bed_status read_data_page(
+	bed_volume_manager *vm,
+	uint32_t peb,
+	uint32_t page,
+	uint8_t *data
+)
+{
+	bed_status status = bed_read(
+		&vm->part,
+		page_address(vm, peb, DATA_PAGE + page),
+		data,
+		vm->page_size
+	);
+
+	if (status == BED_ERROR_ECC_FIXED) {
+		status = BED_SUCCESS;
+	}
+
+	return status;
+}
+
+/*
+ * Produces a page of the new LEB content.  The pages in the range of the new
+ * data are taken from it, the other pages from the old PEB.  Without an old
+ * PEB these pages are erased.
+ */
+static bed_status get_content_page(
+	bed_volume_manager *vm,
+	uint32_t old,
+	uint32_t page,
+	const uint8_t *data,
+	uint32_t offset,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t begin = page * (uint32_t) vm->page_size;
+
+	if (begin >= offset && begin < offset + n) {
+		size_t m = offset + n - begin;
+
+		if (m > vm->page_size) {
+			m = vm->page_size;
+		}
+
+		memset(vm->page_buffer, 0xff, vm->page_size);
+		memcpy(vm->page_buffer, data + begin - offset, m);
+	} else if (old != UNMAPPED) {
+		status = read_data_page(vm, old, page, vm->page_buffer);
+	} else {
+		memset(vm->page_buffer, 0xff, vm->page_size);
+	}
+
+	return status;
+}
+
+/*
+ * Writes the new content of a LEB to a free PEB and maps the LEB to it.  The
+ * data size is n (replacement) or the LEB size (overlay of the old content).
+ * The pages are produced twice, first for the CRC which must be part of the
+ * VID header, then for the page writes.  PEBs with write errors are marked bad
+ * and the next free PEB is tried.  The old PEB is not changed.
+ */
+static bed_status relocate(
+	bed_volume_manager *vm,
+	uint32_t global,
+	uint32_t old,
+	const uint8_t *data,
+	uint32_t offset,
+	size_t n,
+	uint32_t data_size,
+	bool lowest
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint32_t pages = (data_size + vm->page_size - 1) / vm->page_size;
+	uint32_t peb = UNMAPPED;
+	vid_header vid;
+	uint32_t page;
+	bool done = false;
+
+	vid.volume = volume_of_leb(vm, global);
+	vid.leb = global - vm->volume_begins [vid.volume];
+	vid.data_size = data_size;
+	vid.data_crc = 0;
+
+	for (page = 0; page < pages && status == BED_SUCCESS; ++page) {
+		status = get_content_page(vm, old, page, data, offset, n);
+
+		if (status == BED_SUCCESS) {
+			vid.data_crc = bed_crc32(vid.data_crc, vm->page_buffer, vm->page_size);
+		}
+	}
+
+	pages = vm->leb_size / vm->page_size;
+
+	while (status == BED_SUCCESS && !done) {
+		status = allocate_peb(vm, lowest, &peb);
+
+		if (status == BED_SUCCESS) {
+			vid.sequence = vm->sequence;
+			++vm->sequence;
+			vm->states [peb] = PEB_USED;
+			status = write_vid_header(vm, peb, &vid);
+		}
+
+		for (page = 0; page < pages && status == BED_SUCCESS; ++page) {
+			status = get_content_page(vm, old, page, data, offset, n);
+
+			if (
+				status == BED_SUCCESS
+					&& !bed_is_erased(vm->page_buffer, vm->page_size)
+			) {
+				status = bed_write(
+					&vm->part,
+					page_address(vm, peb, DATA_PAGE + page),
+					vm->page_buffer,
+					vm->page_size
+				);
+
+				if (status != BED_SUCCESS && !bed_is_system_error(status)) {
+					mark_bad(vm, peb);
+					status = BED_ERROR_WRITE;
+				}
+			}
+		}
+
+		if (status == BED_SUCCESS) {
+			done = true;
+		} else if (status == BED_ERROR_WRITE) {
+			status = BED_SUCCESS;
+		} else if (peb != UNMAPPED && vm->states [peb] == PEB_USED) {
+			vm->states [peb] = PEB_DIRTY;
+		}
+	}
+
+	if (status == BED_SUCCESS) {
+		vm->owners [peb] = global;
+		vm->map [global] = peb;
+	}
+
+	return status;
+}
+
+static bool read_ec_header(
+	bed_volume_manager *vm,
+	uint32_t peb,
+	uint32_t *erase_count
+)
+{
+	uint8_t *p = vm->page_buffer;
+	bed_status status = bed_read_partial(
+		&vm->part,
+		page_address(vm, peb, EC_PAGE),
+		0,
+		p,
+		EC_HEADER_SIZE
+	);
+	bool ok = is_read_ok(status)
+		&& bed_get_le32(p) == EC_MAGIC
+		&& bed_get_le32(p + 4) == VERSION
+		&& bed_get_le32(p + 12) == bed_crc32(0, p, 12);
+
+	if (ok) {
+		*erase_count = bed_get_le32(p + 8);
+	}
+
+	return ok;
+}
+
+typedef enum {
+	VID_VALID,
+	VID_EMPTY,
+	VID_INVALID
+} vid_result;
+
+static vid_result read_vid_header(
+	bed_volume_manager *vm,
+	uint32_t peb,
+	vid_header *vid
+)
+{
+	uint8_t *p = vm->page_buffer;
+	bed_status status = bed_read_partial(
+		&vm->part,
+		page_address(vm, peb, VID_PAGE),
+		0,
+		p,
+		VID_HEADER_SIZE
+	);
+	vid_result result = VID_INVALID;
+
+	if (is_read_ok(status)) {
+		if (
+			bed_get_le32(p) == VID_MAGIC
+				&& bed_get_le32(p + 28) == bed_crc32(0, p, 28)
+		) {
+			vid->volume = bed_get_le32(p + 4);
+			vid->leb = bed_get_le32(p + 8);
+			vid->data_size = bed_get_le32(p + 12);
+			vid->data_crc = bed_get_le32(p + 16);
+			vid->sequence = bed_get_le32(p + 20)
+				| ((uint64_t) bed_get_le32(p + 24) << 32);
+			result = VID_VALID;
+		} else if (bed_is_erased(p, VID_HEADER_SIZE)) {
+			result = VID_EMPTY;
+		}
+	}
+
+	return result;
+}
+
+static bool is_data_valid(
+	bed_volume_manager *vm,
+	uint32_t peb,
+	const vid_header *vid
+)
+{
+	uint32_t crc = 0;
+	uint32_t pages = (vid->data_size + vm->page_size - 1) / vm->page_size;
+	uint32_t page;
+	bool ok = vid->data_size <= vm->leb_size;
+
+	for (page = 0; page < pages && ok; ++page) {
+		ok = read_data_page(vm, peb, page, vm->page_buffer) == BED_SUCCESS;
+		crc = bed_crc32(crc, vm->page_buffer, vm->page_size);
+	}
+
+	return ok && crc == vid->data_crc;
+}
+
+/*
+ * Of two PEBs of a LEB the newer one wins in case its data is complete.  This
+ * resolves LEB changes interrupted by a power cut.  The loser is erased.
+ */
+static void add_mapping(
+	bed_volume_manager *vm,
+	uint32_t peb,
+	const vid_header *vid,
+	uint64_t *sequences
+)
+{
+	uint32_t global = vm->volume_begins [vid->volume] + vid->leb;
+	uint32_t other = vm->map [global];
+
+	sequences [peb] = vid->sequence;
+	vm->states [peb] = PEB_USED;
+	vm->owners [peb] = global;
+
+	if (other == UNMAPPED) {
+		vm->map [global] = peb;
+	} else {
+		uint32_t newer = peb;
+		uint32_t older = other;
+		vid_header newer_vid = *vid;
+		uint32_t loser;
+
+		if (sequences [other] > vid->sequence) {
+			newer = other;
+			older = peb;
+			read_vid_header(vm, other, &newer_vid);
+		}
+
+		if (newer_vid.data_size == 0 || is_data_valid(vm, newer, &newer_vid)) {
+			loser = older;
+		} else {
+			loser = newer;
+		}
+
+		vm->map [global] = loser == newer ? older : newer;
+		vm->states [loser] = PEB_DIRTY;
+		vm->owners [loser] = UNMAPPED;
+		erase_peb(vm, loser);
+	}
+}
+
+static bed_status attach(bed_volume_manager *vm)
+{
+	bed_status status = BED_SUCCESS;
+	uint64_t *sequences = malloc(vm->peb_count * sizeof(*sequences));
+	uint64_t total = 0;
+	uint32_t known = 0;
+	uint32_t good = 0;
+	uint32_t orphans = 0;
+	uint32_t peb;
+
+	if (sequences != NULL) {
+		for (peb = 0; peb < vm->peb_count; ++peb) {
+			uint32_t erase_count;
+
+			vm->owners [peb] = UNMAPPED;
+			vm->erase_counts [peb] = UINT32_MAX;
+
+			if (
+				bed_is_block_valid(
+					&vm->part,
+					bed_block_to_address(&vm->part, peb)
+				) != BED_SUCCESS
+			) {
+				vm->states [peb] = PEB_BAD;
+			} else if (read_ec_header(vm, peb, &erase_count)) {
+				vm->erase_counts [peb] = erase_count;
+				total += erase_count;
+				++known;
+				vm->states [peb] = PEB_DIRTY;
+			} else {
+				vm->states [peb] = PEB_DIRTY;
+			}
+		}
+
+		/*
+		 * A broken EC header only loses the erase count, so the VID header is
+		 * read nonetheless.  An erased PEB without an EC header stays dirty
+		 * to get a new EC header with its erase.
+		 */
+		for (peb = 0; peb < vm->peb_count; ++peb) {
+			bool ec_known = vm->erase_counts [peb] != UINT32_MAX;
+
+			if (!ec_known) {
+				vm->erase_counts [peb] = known > 0 ? (uint32_t) (total / known) : 0;
+			}
+
+			if (vm->states [peb] == PEB_DIRTY) {
+				vid_header vid;
+
+				switch (read_vid_header(vm, peb, &vid)) {
+					case VID_VALID:
+						if (vid.sequence >= vm->sequence) {
+							vm->sequence = vid.sequence + 1;
+						}
+
+						if (
+							vid.volume < vm->config.volume_count
+								&& vid.leb < vm->config.leb_counts [vid.volume]
+						) {
+							add_mapping(vm, peb, &vid, sequences);
+						} else {
+							vm->states [peb] = PEB_USED;
+						}
+						break;
+					case VID_EMPTY:
+						if (ec_known) {
+							vm->states [peb] = PEB_FREE;
+						}
+						break;
+					default:
+						break;
+				}
+			}
+		}
+
+		for (peb = 0; peb < vm->peb_count; ++peb) {
+			if (vm->states [peb] != PEB_BAD) {
+				++good;
+
+				if (vm->states [peb] == PEB_USED && vm->owners [peb] == UNMAPPED) {
+					++orphans;
+				}
+			}
+		}
+
+		if (vm->leb_count + 1 > good - orphans) {
+			status = BED_ERROR_INVALID_ADDRESS;
+		}
+
+		free(sequences);
+	} else {
+		status = BED_ERROR_SYSTEM;
+	}
+
+	return status;
+}
+
+bed_status bed_volume_attach(
+	const bed_partition *part,
+	const bed_volume_config *config,
+	bed_volume_manager **vm_ptr
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_volume_manager *vm = NULL;
+	uint16_t page_size = bed_page_size(part);
+	uint32_t pages_per_block = bed_block_size(part) / page_size;
+	uint32_t peb_count = (uint32_t) bed_address_to_block(part, bed_size(part));
+	uint32_t leb_count = 0;
+	uint32_t i;
+
+	for (i = 0; i < config->volume_count; ++i) {
+		leb_count += config->leb_counts [i];
+	}
+
+	if (pages_per_block > DATA_PAGE && leb_count < peb_count) {
+		vm = malloc(
+			sizeof(*vm)
+				+ (config->volume_count + 1) * sizeof(uint32_t)
+				+ leb_count * sizeof(uint32_t)
+				+ peb_count * (2 * sizeof(uint32_t) + 1)
+				+ page_size
+		);
+
+		if (vm != NULL) {
+			uint32_t *words = (uint32_t *) (vm + 1);
+
+			memset(vm, 0, sizeof(*vm));
+			vm->part = *part;
+			vm->config = *config;
+			vm->page_size = page_size;
+			vm->leb_size = (pages_per_block - DATA_PAGE) * (uint32_t) page_size;
+			vm->peb_count = peb_count;
+			vm->leb_count = leb_count;
+			vm->volume_begins = words;
+			words += config->volume_count + 1;
+			vm->map = words;
+			words += leb_count;
+			vm->owners = words;
+			words += peb_count;
+			vm->erase_counts = words;
+			words += peb_count;
+			vm->states = (uint8_t *) words;
+			vm->page_buffer = vm->states + peb_count;
+
+			vm->volume_begins [0] = 0;
+			for (i = 0; i < config->volume_count; ++i) {
+				vm->volume_begins [i + 1] = vm->volume_begins [i]
+					+ config->leb_counts [i];
+			}
+
+			for (i = 0; i < leb_count; ++i) {
+				vm->map [i] = UNMAPPED;
+			}
+
+			status = attach(vm);
+
+			if (status == BED_SUCCESS) {
+				status = bed_lock_initialize(&vm->lock);
+			}
+
+			if (status != BED_SUCCESS) {
+				free(vm);
+				vm = NULL;
+			}
+		} else {
+			status = BED_ERROR_SYSTEM;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	*vm_ptr = vm;
+
+	return status;
+}
+
+void bed_volume_detach(bed_volume_manager *vm)
+{
+	bed_lock_destroy(&vm->lock);
+	free(vm);
+}
+
+uint32_t bed_volume_leb_size(const bed_volume_manager *vm)
+{
+	return vm->leb_size;
+}
+
+static bool is_leb_valid(
+	const bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb
+)
+{
+	return volume < vm->config.volume_count
+		&& leb < vm->config.leb_counts [volume];
+}
+
+static bool is_range_valid(
+	const bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb,
+	uint32_t offset,
+	size_t n
+)
+{
+	return is_leb_valid(vm, volume, leb)
+		&& offset <= vm->leb_size
+		&& n <= vm->leb_size - offset;
+}
+
+bed_status bed_volume_read(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb,
+	uint32_t offset,
+	void *data,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (is_range_valid(vm, volume, leb, offset, n)) {
+		uint32_t peb;
+		uint8_t *out = data;
+
+		bed_lock_obtain(&vm->lock);
+
+		peb = vm->map [vm->volume_begins [volume] + leb];
+
+		if (peb != UNMAPPED) {
+			while (n > 0 && status == BED_SUCCESS) {
+				uint16_t column = (uint16_t) (offset % vm->page_size);
+				size_t r = (size_t) (vm->page_size - column);
+				size_t m = n < r ? n : r;
+				bed_address addr = page_address(
+					vm,
+					peb,
+					DATA_PAGE + offset / vm->page_size
+				);
+
+				if (m == vm->page_size) {
+					status = bed_read(&vm->part, addr, out, m);
+				} else {
+					status = bed_read_partial(&vm->part, addr, column, out, m);
+				}
+
+				if (status == BED_ERROR_ECC_FIXED) {
+					status = BED_SUCCESS;
+				}
+
+				offset += (uint32_t) m;
+				out += m;
+				n -= m;
+			}
+		} else {
+			memset(out, 0xff, n);
+		}
+
+		bed_lock_release(&vm->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+/*
+ * In case of a write error the LEB moves to a new PEB with the old content
+ * and the new data.  The PEB with the write error is marked bad.
+ */
+bed_status bed_volume_write(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb,
+	uint32_t offset,
+	const void *data,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (
+		is_range_valid(vm, volume, leb, offset, n)
+			&& offset % vm->page_size == 0
+	) {
+		uint32_t global = vm->volume_begins [volume] + leb;
+		uint32_t peb;
+		uint32_t pages = (uint32_t) ((n + vm->page_size - 1) / vm->page_size);
+		uint32_t page;
+
+		bed_lock_obtain(&vm->lock);
+
+		peb = vm->map [global];
+
+		while (peb == UNMAPPED && status == BED_SUCCESS) {
+			status = allocate_peb(vm, true, &peb);
+
+			if (status == BED_SUCCESS) {
+				vid_header vid = {
+					.volume = volume,
+					.leb = leb,
+					.data_size = 0,
+					.data_crc = 0,
+					.sequence = vm->sequence
+				};
+
+				++vm->sequence;
+				vm->states [peb] = PEB_USED;
+				status = write_vid_header(vm, peb, &vid);
+
+				if (status == BED_SUCCESS) {
+					vm->owners [peb] = global;
+					vm->map [global] = peb;
+				} else if (!bed_is_system_error(status)) {
+					peb = UNMAPPED;
+					status = BED_SUCCESS;
+				} else {
+					vm->states [peb] = PEB_DIRTY;
+				}
+			}
+		}
+
+		for (page = 0; page < pages && status == BED_SUCCESS; ++page) {
+			uint32_t pos = page * (uint32_t) vm->page_size;
+			const uint8_t *p = (const uint8_t *) data + pos;
+
+			if (n - pos < vm->page_size) {
+				memset(vm->page_buffer, 0xff, vm->page_size);
+				memcpy(vm->page_buffer, p, n - pos);
+				p = vm->page_buffer;
+			}
+
+			status = bed_write(
+				&vm->part,
+				page_address(vm, peb, DATA_PAGE + (offset + pos) / vm->page_size),
+				p,
+				vm->page_size
+			);
+
+			if (status != BED_SUCCESS && !bed_is_system_error(status)) {
+				status = relocate(
+					vm,
+					global,
+					peb,
+					data,
+					offset,
+					n,
+					vm->leb_size,
+					true
+				);
+
+				if (status == BED_SUCCESS) {
+					mark_bad(vm, peb);
+				}
+
+				break;
+			}
+		}
+
+		bed_lock_release(&vm->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+bed_status bed_volume_change(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb,
+	const void *data,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (is_range_valid(vm, volume, leb, 0, n)) {
+		uint32_t global = vm->volume_begins [volume] + leb;
+		uint32_t old;
+
+		bed_lock_obtain(&vm->lock);
+
+		old = vm->map [global];
+		status = relocate(
+			vm,
+			global,
+			UNMAPPED,
+			data,
+			0,
+			n,
+			(uint32_t) n,
+			true
+		);
+
+		if (status == BED_SUCCESS && old != UNMAPPED) {
+			erase_peb(vm, old);
+		}
+
+		bed_lock_release(&vm->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+bed_status bed_volume_unmap(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (is_leb_valid(vm, volume, leb)) {
+		uint32_t global = vm->volume_begins [volume] + leb;
+		uint32_t peb;
+
+		bed_lock_obtain(&vm->lock);
+
+		peb = vm->map [global];
+
+		if (peb != UNMAPPED) {
+			status = erase_peb(vm, peb);
+
+			if (!bed_is_system_error(status)) {
+				vm->map [global] = UNMAPPED;
+				status = BED_SUCCESS;
+			}
+		}
+
+		bed_lock_release(&vm->lock);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	return status;
+}
+
+bool bed_volume_is_mapped(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb
+)
+{
+	bool mapped = false;
+
+	if (is_leb_valid(vm, volume, leb)) {
+		bed_lock_obtain(&vm->lock);
+		mapped = vm->map [vm->volume_begins [volume] + leb] != UNMAPPED;
+		bed_lock_release(&vm->lock);
+	}
+
+	return mapped;
+}
+
+bed_status bed_volume_level_wear(bed_volume_manager *vm)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t from = UNMAPPED;
+	uint32_t to;
+	uint32_t i;
+
+	bed_lock_obtain(&vm->lock);
+
+	for (i = 0; i < vm->peb_count; ++i) {
+		if (
+			vm->owners [i] != UNMAPPED
+				&& (from == UNMAPPED || vm->erase_counts [i] < vm->erase_counts [from])
+		) {
+			from = i;
+		}
+	}
+
+	to = select_available(vm, false);
+
+	if (
+		from != UNMAPPED
+			&& to != UNMAPPED
+			&& vm->erase_counts [to] > vm->erase_counts [from]
+			&& vm->erase_counts [to] - vm->erase_counts [from]
+				> vm->config.wear_threshold
+	) {
+		status = relocate(
+			vm,
+			vm->owners [from],
+			from,
+			NULL,
+			0,
+			0,
+			vm->leb_size,
+			false
+		);
+
+		if (status == BED_SUCCESS) {
+			erase_peb(vm, from);
+			++vm->wear_moves;
+		}
+	}
+
+	bed_lock_release(&vm->lock);
+
+	return status;
+}
+
+void bed_volume_get_statistics(
+	bed_volume_manager *vm,
+	bed_volume_statistics *statistics
+)
+{
+	uint32_t good = 0;
+	uint32_t orphans = 0;
+	uint32_t i;
+
+	memset(statistics, 0, sizeof(*statistics));
+	statistics->min_erase_count = UINT32_MAX;
+
+	bed_lock_obtain(&vm->lock);
+
+	statistics->peb_count = vm->peb_count;
+
+	for (i = 0; i < vm->peb_count; ++i) {
+		if (vm->states [i] == PEB_BAD) {
+			++statistics->bad_pebs;
+		} else {
+			uint32_t erase_count = vm->erase_counts [i];
+
+			++good;
+
+			if (vm->states [i] == PEB_USED) {
+				++statistics->used_pebs;
+				orphans += vm->owners [i] == UNMAPPED;
+			} else {
+				++statistics->free_pebs;
+			}
+
+			if (erase_count < statistics->min_erase_count) {
+				statistics->min_erase_count = erase_count;
+			}
+
+			if (erase_count > statistics->max_erase_count) {
+				statistics->max_erase_count = erase_count;
+			}
+		}
+	}
+
+	if (good > vm->leb_count + orphans) {
+		statistics->reserved_pebs = good - vm->leb_count - orphans - 1;
+	}
+
+	statistics->wear_moves = vm->wear_moves;
+
+	bed_lock_release(&vm->lock);
+
+	if (statistics->min_erase_count == UINT32_MAX) {
+		statistics->min_erase_count = 0;
+	}
+}
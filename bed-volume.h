@@ -0,0 +1,254 @@
+/**
+ * @file
+ *
+ * @ingroup BEDVolume
+ *
+ * @brief BED Volume Manager API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_VOLUME_H
+#define BED_VOLUME_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDVolume BED Volume Manager
+ *
+ * @ingroup BED
+ *
+ * @brief Logical volumes of logical erase blocks on top of a partition.
+ *
+ * The volume manager maps the logical erase blocks (LEB) of several volumes
+ * to the physical erase blocks (PEB) of one partition in the spirit of UBI.
+ * All volumes share the free blocks, the wear leveling and the bad block
+ * reserve.  The volume layout is not stored on the device, it is defined by
+ * the configuration.
+ *
+ * The first page of each PEB contains an erase count header.  It is written
+ * after each erase.  The second page contains a volume identifier header
+ * with the volume, the LEB number and a sequence number.  It is written once
+ * the PEB is mapped to a LEB.  The remaining pages contain the LEB data.
+ * The attach reads only the headers with column-limited reads
+ * (bed_read_partial()).
+ *
+ * A LEB change (bed_volume_change()) writes the new data to a free PEB with
+ * a higher sequence number and a CRC of the data before the old PEB is
+ * erased.  In case the attach finds two PEBs for one LEB, then the newer PEB
+ * wins if its data matches the CRC, otherwise the older PEB wins.  So the LEB
+ * change is atomic with respect to power cuts.
+ *
+ * Free PEBs are allocated in the order of their erase counts.
+ * bed_volume_level_wear() moves the LEB with the lowest erase count to the
+ * free PEB with the highest erase count in case the difference exceeds a
+ * threshold.  A PEB with a write error is replaced by a free PEB and marked
+ * bad.  The PEBs not needed for the LEBs of the volumes and one spare PEB
+ * form the bad block reserve.
+ *
+ * The volume manager may be used concurrently.
+ *
+ * @{
+ */
+
+typedef struct {
+	/**
+	 * @brief LEB count of each volume.
+	 */
+	const uint32_t *leb_counts;
+
+	uint32_t volume_count;
+
+	/**
+	 * @brief Erase count difference which triggers the static wear leveling.
+	 */
+	uint32_t wear_threshold;
+} bed_volume_config;
+
+typedef struct {
+	uint32_t peb_count;
+	uint32_t bad_pebs;
+	uint32_t free_pebs;
+	uint32_t used_pebs;
+
+	/**
+	 * @brief Count of PEBs available to replace bad blocks.
+	 */
+	uint32_t reserved_pebs;
+
+	uint32_t min_erase_count;
+	uint32_t max_erase_count;
+
+	/**
+	 * @brief Count of LEBs moved by the wear leveling.
+	 */
+	uint32_t wear_moves;
+} bed_volume_statistics;
+
+typedef struct bed_volume_manager bed_volume_manager;
+
+/**
+ * @brief Attaches a volume manager to a partition.
+ *
+ * The mapping is recovered from the headers.  Stale PEBs of interrupted LEB
+ * changes are erased.  PEBs of LEBs outside the configured volumes are kept
+ * and not used.  An erased partition contains empty volumes.
+ *
+ * @param[in] part The partition.
+ * @param[in] config The volume configuration.
+ * @param[out] vm The volume manager.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS The volumes do not fit into the
+ * partition.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ */
+bed_status bed_volume_attach(
+	const bed_partition *part,
+	const bed_volume_config *config,
+	bed_volume_manager **vm
+);
+
+void bed_volume_detach(bed_volume_manager *vm);
+
+/**
+ * @brief Returns the size of a LEB in bytes.
+ *
+ * It is the block size minus two pages.
+ */
+uint32_t bed_volume_leb_size(const bed_volume_manager *vm);
+
+/**
+ * @brief Reads data of a LEB.
+ *
+ * Unmapped LEBs read as 0xff.  Ranges which do not cover whole pages are
+ * read with column-limited reads.
+ *
+ * @param[in] vm The volume manager.
+ * @param[in] volume The volume index.
+ * @param[in] leb The LEB number.
+ * @param[in] offset The byte offset in the LEB.
+ * @param[out] data The data.
+ * @param[in] n The data size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid volume, LEB or range.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE Uncorrectable ECC error.
+ */
+bed_status bed_volume_read(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb,
+	uint32_t offset,
+	void *data,
+	size_t n
+);
+
+/**
+ * @brief Writes data to a LEB.
+ *
+ * An unmapped LEB is mapped to a free PEB.  The offset must be page aligned.
+ * A partial last page is padded with 0xff.  Each page of a LEB may be
+ * written once after the LEB was unmapped.
+ *
+ * @param[in] vm The volume manager.
+ * @param[in] volume The volume index.
+ * @param[in] leb The LEB number.
+ * @param[in] offset The byte offset in the LEB.
+ * @param[in] data The data.
+ * @param[in] n The data size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid volume, LEB or range.
+ * @retval BED_ERROR_UNSATISFIED No free PEB is available.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
+bed_status bed_volume_write(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb,
+	uint32_t offset,
+	const void *data,
+	size_t n
+);
+
+/**
+ * @brief Replaces the content of a LEB atomically.
+ *
+ * After a power cut the LEB contains either the old or the new data.
+ *
+ * @param[in] vm The volume manager.
+ * @param[in] volume The volume index.
+ * @param[in] leb The LEB number.
+ * @param[in] data The new data.
+ * @param[in] n The new data size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid volume, LEB or size.
+ * @retval BED_ERROR_UNSATISFIED No free PEB is available.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
+bed_status bed_volume_change(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb,
+	const void *data,
+	size_t n
+);
+
+/**
+ * @brief Unmaps a LEB and erases its PEB.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid volume or LEB.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
+bed_status bed_volume_unmap(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb
+);
+
+bool bed_volume_is_mapped(
+	bed_volume_manager *vm,
+	uint32_t volume,
+	uint32_t leb
+);
+
+/**
+ * @brief Performs one static wear leveling step.
+ *
+ * @retval BED_SUCCESS One LEB was moved.
+ * @retval BED_ERROR_UNSATISFIED There was nothing to do.
+ * @retval other The move failed.
+ */
+bed_status bed_volume_level_wear(bed_volume_manager *vm);
+
+void bed_volume_get_statistics(
+	bed_volume_manager *vm,
+	bed_volume_statistics *statistics
+);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_VOLUME_H */
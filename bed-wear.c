@@ -0,0 +1,567 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-wear.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The erase count table consists of the magic, the sequence number, the
+ * data block count, the erase counts and a CRC-32 of the previous words.  All
+ * words are little endian.  Each table write starts at a page boundary.
+ */
+#define TABLE_MAGIC 0x57444542
+
+#define TABLE_HEADER_SIZE 12
+
+typedef enum {
+	BLOCK_IN_USE,
+	BLOCK_DISCARDED,
+	BLOCK_BAD
+} block_state;
+
+struct bed_wear {
+	bed_lock lock;
+	bed_partition part;
+	bed_partition data;
+	bed_wear_config config;
+	uint32_t block_count;
+	uint32_t pages_per_block;
+	uint32_t table_pages;
+	uint32_t table_block;
+	uint32_t table_page;
+	uint32_t sequence;
+	uint32_t unsynced;
+	uint32_t static_moves;
+	uint32_t table_writes;
+	uint32_t *erase_counts;
+	uint8_t *states;
+	uint8_t *table;
+};
+
+static size_t table_size(uint32_t block_count)
+{
+	return TABLE_HEADER_SIZE + (block_count + 1) * sizeof(uint32_t);
+}
+
+static bed_address table_page_address(
+	const bed_wear *wear,
+	uint32_t block,
+	uint32_t page
+)
+{
+	return bed_block_to_address(&wear->part, block)
+		+ page * (bed_address) bed_page_size(&wear->part);
+}
+
+static bool load_table(bed_wear *wear, bed_address addr, uint32_t *sequence)
+{
+	uint16_t page_size = bed_page_size(&wear->part);
+	size_t size = table_size(wear->block_count);
+	uint32_t i;
+	bool ok = true;
+
+	for (i = 0; i < wear->table_pages && ok; ++i) {
+		bed_status status = bed_read(
+			&wear->part,
+			addr + i * (bed_address) page_size,
+			wear->table + i * (size_t) page_size,
+			page_size
+		);
+
+		ok = status == BED_SUCCESS || status == BED_ERROR_ECC_FIXED;
+	}
+
+	ok = ok
+		&& bed_get_le32(wear->table) == TABLE_MAGIC
+		&& bed_get_le32(wear->table + 8) == wear->block_count
+		&& bed_get_le32(wear->table + size - 4) == bed_crc32(0, wear->table, size - 4);
+
+	if (ok) {
+		*sequence = bed_get_le32(wear->table + 4);
+	}
+
+	return ok;
+}
+
+static void recover(bed_wear *wear)
+{
+	uint32_t best_sequence = 0;
+	bed_address best = 0;
+	bool found = false;
+	uint32_t block;
+
+	for (block = 0; block < wear->config.table_blocks; ++block) {
+		uint32_t page = 0;
+
+		if (
+			bed_is_block_valid(
+				&wear->part,
+				bed_block_to_address(&wear->part, block)
+			) != BED_SUCCESS
+		) {
+			page = wear->pages_per_block;
+		}
+
+		while (page + wear->table_pages <= wear->pages_per_block) {
+			bed_address addr = table_page_address(wear, block, page);
+			uint32_t sequence;
+
+			if (
+				load_table(wear, addr, &sequence)
+					&& (!found || sequence > best_sequence)
+			) {
+				best = addr;
+				best_sequence = sequence;
+				wear->table_block = block;
+				found = true;
+			}
+
+			page += wear->table_pages;
+		}
+	}
+
+	if (found && load_table(wear, best, &best_sequence)) {
+		uint32_t i;
+
+		for (i = 0; i < wear->block_count; ++i) {
+			wear->erase_counts [i] = bed_get_le32(
+				wear->table + TABLE_HEADER_SIZE + i * sizeof(uint32_t)
+			);
+		}
+
+		wear->sequence = best_sequence + 1;
+	}
+}
+
+/*
+ * The first table write after the creation goes to the table block after the
+ * one with the newest table, since the remaining pages of this table block
+ * may be partially programmed.
+ */
+static bed_status write_table(bed_wear *wear)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint16_t page_size = bed_page_size(&wear->part);
+	size_t size = table_size(wear->block_count);
+	uint32_t attempts = 0;
+	uint32_t i;
+
+	memset(wear->table, 0xff, wear->table_pages * (size_t) page_size);
+	bed_put_le32(wear->table, TABLE_MAGIC);
+	bed_put_le32(wear->table + 4, wear->sequence);
+	bed_put_le32(wear->table + 8, wear->block_count);
+
+	for (i = 0; i < wear->block_count; ++i) {
+		bed_put_le32(
+			wear->table + TABLE_HEADER_SIZE + i * sizeof(uint32_t),
+			wear->erase_counts [i]
+		);
+	}
+
+	bed_put_le32(wear->table + size - 4, bed_crc32(0, wear->table, size - 4));
+
+	while (status != BED_SUCCESS && attempts <= wear->config.table_blocks) {
+		if (wear->table_page + wear->table_pages > wear->pages_per_block) {
+			wear->table_block = (wear->table_block + 1) % wear->config.table_blocks;
+			wear->table_page = 0;
+			++attempts;
+			status = bed_erase(
+				&wear->part,
+				table_page_address(wear, wear->table_block, 0),
+				BED_ERASE_MARK_BAD_ON_ERROR
+			);
+		} else {
+			status = BED_SUCCESS;
+		}
+
+		for (i = 0; i < wear->table_pages && status == BED_SUCCESS; ++i) {
+			status = bed_write(
+				&wear->part,
+				table_page_address(
+					wear,
+					wear->table_block,
+					wear->table_page + i
+				),
+				wear->table + i * (size_t) page_size,
+				page_size
+			);
+		}
+
+		if (bed_is_system_error(status)) {
+			break;
+		} else if (status == BED_SUCCESS) {
+			wear->table_page += wear->table_pages;
+			++wear->sequence;
+			++wear->table_writes;
+			wear->unsynced = 0;
+		} else {
+			wear->table_page = wear->pages_per_block;
+			status = BED_ERROR_UNSATISFIED;
+		}
+	}
+
+	return status;
+}
+
+bed_status bed_wear_create(
+	const bed_partition *part,
+	const bed_wear_config *config,
+	bed_wear **wear_ptr
+)
+{
+	bed_status status = BED_SUCCESS;
+	bed_wear *wear = NULL;
+	uint16_t page_size = bed_page_size(part);
+	uint32_t pages_per_block = bed_block_size(part) / page_size;
+	uint32_t total = (uint32_t) bed_address_to_block(part, bed_size(part));
+	uint32_t block_count = 0;
+	uint32_t table_pages = 0;
+
+	if (config->table_blocks >= 2 && config->table_blocks < total) {
+		block_count = total - config->table_blocks;
+		table_pages = (uint32_t) (
+			(table_size(block_count) + page_size - 1) / page_size
+		);
+	}
+
+	if (block_count > 0 && table_pages <= pages_per_block) {
+		wear = malloc(
+			sizeof(*wear)
+				+ block_count * (sizeof(uint32_t) + 1)
+				+ table_pages * (size_t) page_size
+		);
+
+		if (wear != NULL) {
+			uint8_t *chunk = (uint8_t *) (wear + 1);
+			uint32_t i;
+
+			memset(wear, 0, sizeof(*wear));
+			wear->part = *part;
+			wear->config = *config;
+			wear->block_count = block_count;
+			wear->pages_per_block = pages_per_block;
+			wear->table_pages = table_pages;
+			wear->table_page = pages_per_block;
+			wear->erase_counts = (uint32_t *) chunk;
+			chunk += block_count * sizeof(uint32_t);
+			wear->table = chunk;
+			chunk += table_pages * (size_t) page_size;
+			wear->states = chunk;
+			memset(wear->erase_counts, 0, block_count * sizeof(uint32_t));
+
+			bed_partition_create(
+				&wear->data,
+				part,
+				bed_block_to_address(part, config->table_blocks),
+				bed_block_to_address(part, block_count)
+			);
+
+			recover(wear);
+
+			for (i = 0; i < block_count; ++i) {
+				wear->states [i] = bed_is_block_valid(
+					&wear->data,
+					bed_block_to_address(part, i)
+				) == BED_ERROR_BLOCK_IS_BAD ? BLOCK_BAD : BLOCK_IN_USE;
+			}
+
+			status = bed_lock_initialize(&wear->lock);
+
+			if (status != BED_SUCCESS) {
+				free(wear);
+				wear = NULL;
+			}
+		} else {
+			status = BED_ERROR_SYSTEM;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	*wear_ptr = wear;
+
+	return status;
+}
+
+void bed_wear_destroy(bed_wear *wear)
+{
+	bed_lock_destroy(&wear->lock);
+	free(wear);
+}
+
+const bed_partition *bed_wear_data_partition(const bed_wear *wear)
+{
+	return &wear->data;
+}
+
+static bool is_block_address_valid(const bed_wear *wear, bed_address block)
+{
+	return (block & bed_block_mask(&wear->data)) == 0
+		&& bed_address_to_block(&wear->data, block) < wear->block_count;
+}
+
+bed_status bed_wear_discard(bed_wear *wear, bed_address block)
+{
+	bed_status status = BED_SUCCESS;
+
+	bed_lock_obtain(&wear->lock);
+
+	if (is_block_address_valid(wear, block)) {
+		uint32_t index = (uint32_t) bed_address_to_block(&wear->data, block);
+
+		if (wear->states [index] == BLOCK_IN_USE) {
+			wear->states [index] = BLOCK_DISCARDED;
+		} else {
+			status = BED_ERROR_INVALID_ADDRESS;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	bed_lock_release(&wear->lock);
+
+	return status;
+}
+
+/*
+ * Selects the block of the state with the lowest or highest erase count.
+ */
+static uint32_t select_block(const bed_wear *wear, block_state state, bool lowest)
+{
+	uint32_t selected = UINT32_MAX;
+	uint32_t i;
+
+	for (i = 0; i < wear->block_count; ++i) {
+		if (wear->states [i] == state) {
+			uint32_t erase_count = wear->erase_counts [i];
+
+			if (
+				selected == UINT32_MAX
+					|| (lowest && erase_count < wear->erase_counts [selected])
+					|| (!lowest && erase_count > wear->erase_counts [selected])
+			) {
+				selected = i;
+			}
+		}
+	}
+
+	return selected;
+}
+
+/*
+ * In case of an erase error the block is bad.
+ */
+static bed_status erase_block(bed_wear *wear, uint32_t index)
+{
+	bed_status status = bed_erase(
+		&wear->data,
+		bed_block_to_address(&wear->data, index),
+		BED_ERASE_MARK_BAD_ON_ERROR
+	);
+
+	if (!bed_is_system_error(status)) {
+		++wear->erase_counts [index];
+		++wear->unsynced;
+
+		if (status != BED_SUCCESS) {
+			wear->states [index] = BLOCK_BAD;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * A failed table write is retried after the next erase or reported by
+ * bed_wear_sync().
+ */
+static void sync_if_necessary(bed_wear *wear)
+{
+	if (
+		wear->config.sync_interval > 0
+			&& wear->unsynced >= wear->config.sync_interval
+	) {
+		write_table(wear);
+	}
+}
+
+bed_status bed_wear_allocate(bed_wear *wear, bed_address *block)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t index = UINT32_MAX;
+
+	bed_lock_obtain(&wear->lock);
+
+	do {
+		index = select_block(wear, BLOCK_DISCARDED, true);
+
+		if (index != UINT32_MAX) {
+			status = erase_block(wear, index);
+		} else {
+			status = BED_ERROR_UNSATISFIED;
+		}
+	} while (
+		status != BED_SUCCESS
+			&& status != BED_ERROR_UNSATISFIED
+			&& !bed_is_system_error(status)
+	);
+
+	if (status == BED_SUCCESS) {
+		wear->states [index] = BLOCK_IN_USE;
+		*block = bed_block_to_address(&wear->data, index);
+		sync_if_necessary(wear);
+	}
+
+	bed_lock_release(&wear->lock);
+
+	return status;
+}
+
+bed_status bed_wear_level(
+	bed_wear *wear,
+	bed_wear_relocate_handler relocate,
+	void *arg
+)
+{
+	bed_status status = BED_ERROR_UNSATISFIED;
+	uint32_t from;
+	uint32_t to;
+
+	if (relocate == NULL) {
+		status = BED_ERROR_INVALID_ADDRESS;
+	} else {
+		bed_lock_obtain(&wear->lock);
+
+		from = select_block(wear, BLOCK_IN_USE, true);
+		to = select_block(wear, BLOCK_DISCARDED, false);
+
+		if (
+			from != UINT32_MAX
+				&& to != UINT32_MAX
+				&& wear->erase_counts [to] > wear->erase_counts [from]
+				&& wear->erase_counts [to] - wear->erase_counts [from]
+					> wear->config.static_threshold
+		) {
+			status = erase_block(wear, to);
+
+			if (status == BED_SUCCESS) {
+				wear->states [to] = BLOCK_IN_USE;
+				status = (*relocate)(
+					arg,
+					bed_block_to_address(&wear->data, from),
+					bed_block_to_address(&wear->data, to)
+				);
+
+				if (status == BED_SUCCESS) {
+					wear->states [from] = BLOCK_DISCARDED;
+					++wear->static_moves;
+				}
+			}
+
+			sync_if_necessary(wear);
+		}
+
+		bed_lock_release(&wear->lock);
+	}
+
+	return status;
+}
+
+bed_status bed_wear_sync(bed_wear *wear)
+{
+	bed_status status;
+
+	bed_lock_obtain(&wear->lock);
+	status = write_table(wear);
+	bed_lock_release(&wear->lock);
+
+	return status;
+}
+
+bed_status bed_wear_erase_count(
+	bed_wear *wear,
+	bed_address block,
+	uint32_t *erase_count
+)
+{
+	bed_status status = BED_SUCCESS;
+
+	bed_lock_obtain(&wear->lock);
+
+	if (is_block_address_valid(wear, block)) {
+		*erase_count = wear->erase_counts [
+			bed_address_to_block(&wear->data, block)
+		];
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
+
+	bed_lock_release(&wear->lock);
+
+	return status;
+}
+
+uint32_t bed_wear_discarded_count(bed_wear *wear)
+{
+	uint32_t count = 0;
+	uint32_t i;
+
+	bed_lock_obtain(&wear->lock);
+
+	for (i = 0; i < wear->block_count; ++i) {
+		count += wear->states [i] == BLOCK_DISCARDED;
+	}
+
+	bed_lock_release(&wear->lock);
+
+	return count;
+}
+
+void bed_wear_get_statistics(bed_wear *wear, bed_wear_statistics *statistics)
+{
+	uint32_t i;
+
+	memset(statistics, 0, sizeof(*statistics));
+	statistics->min_erase_count = UINT32_MAX;
+
+	bed_lock_obtain(&wear->lock);
+
+	for (i = 0; i < wear->block_count; ++i) {
+		if (wear->states [i] != BLOCK_BAD) {
+			uint32_t erase_count = wear->erase_counts [i];
+
+			if (erase_count < statistics->min_erase_count) {
+				statistics->min_erase_count = erase_count;
+			}
+
+			if (erase_count > statistics->max_erase_count) {
+				statistics->max_erase_count = erase_count;
+			}
+
+			statistics->total_erase_count += erase_count;
+		}
+	}
+
+	statistics->static_moves = wear->static_moves;
+	statistics->table_writes = wear->table_writes;
+
+	bed_lock_release(&wear->lock);
+
+	if (statistics->min_erase_count == UINT32_MAX) {
+		statistics->min_erase_count = 0;
+	}
+}
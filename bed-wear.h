@@ -0,0 +1,240 @@
+/**
+ * @file
+ *
+ * @ingroup BEDWear
+ *
+ * @brief BED Wear Leveling API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_WEAR_H
+#define BED_WEAR_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDWear BED Wear Leveling
+ *
+ * @ingroup BED
+ *
+ * @brief Block allocator which levels the block erase counts.
+ *
+ * The first blocks of the partition are reserved for the erase count table.
+ * The other blocks form the data partition (bed_wear_data_partition()).
+ * Upper layers return blocks they no longer need with bed_wear_discard().
+ * bed_wear_allocate() erases and returns the discarded block with the lowest
+ * erase count (dynamic wear leveling).  Blocks which were not discarded
+ * since the creation hold data which is rarely changed.  bed_wear_level()
+ * moves the data of the block in use with the lowest erase count to the
+ * discarded block with the highest erase count, once the difference exceeds
+ * a threshold (static wear leveling).
+ *
+ * The erase count table is written to the table blocks in turn after a
+ * configurable count of erases and on bed_wear_sync().  Each table write
+ * carries a sequence number and a CRC.  On creation the newest valid table
+ * is loaded.  The erases since the last table write are lost in case of a
+ * power cut.  The erases of the table blocks are not counted.
+ *
+ * The wear leveling functions may be used concurrently.
+ *
+ * @{
+ */
+
+typedef struct {
+	/**
+	 * @brief Count of blocks at the partition begin reserved for the erase
+	 * count table.
+	 *
+	 * It must be at least two.
+	 */
+	uint32_t table_blocks;
+
+	/**
+	 * @brief Count of erases after which the erase count table is written.
+	 *
+	 * A value of zero writes the table only on bed_wear_sync().
+	 */
+	uint32_t sync_interval;
+
+	/**
+	 * @brief Erase count difference which triggers the static wear leveling.
+	 */
+	uint32_t static_threshold;
+} bed_wear_config;
+
+typedef struct {
+	uint32_t min_erase_count;
+	uint32_t max_erase_count;
+
+	/**
+	 * @brief Sum of the erase counts of all good data blocks.
+	 */
+	uint64_t total_erase_count;
+
+	/**
+	 * @brief Count of blocks moved by bed_wear_level().
+	 */
+	uint32_t static_moves;
+
+	uint32_t table_writes;
+} bed_wear_statistics;
+
+typedef struct bed_wear bed_wear;
+
+/**
+ * @brief Moves the content of a block in use to an erased block.
+ *
+ * The upper layer must no longer use the source block afterwards.
+ *
+ * @param[in] arg The handler argument.
+ * @param[in] from The source block address relative to the data partition
+ * begin.
+ * @param[in] to The erased destination block address relative to the data
+ * partition begin.
+ */
+typedef bed_status (*bed_wear_relocate_handler)(
+	void *arg,
+	bed_address from,
+	bed_address to
+);
+
+/**
+ * @brief Creates a wear leveling allocator for a partition.
+ *
+ * Initially all data blocks are in use.  The erase counts are loaded from
+ * the newest valid erase count table.  Without a table all erase counts are
+ * zero.
+ *
+ * @param[in] part The partition.
+ * @param[in] config The wear leveling configuration.
+ * @param[out] wear The wear leveling allocator.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid configuration for this
+ * partition.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ */
+bed_status bed_wear_create(
+	const bed_partition *part,
+	const bed_wear_config *config,
+	bed_wear **wear
+);
+
+/**
+ * @brief Destroys a wear leveling allocator.
+ *
+ * The erase counts are not written, use bed_wear_sync() before.
+ */
+void bed_wear_destroy(bed_wear *wear);
+
+/**
+ * @brief Returns the partition of the data blocks.
+ */
+const bed_partition *bed_wear_data_partition(const bed_wear *wear);
+
+/**
+ * @brief Returns a block in use to the allocator.
+ *
+ * @param[in] wear The wear leveling allocator.
+ * @param[in] block The block address relative to the data partition begin.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS The block address is invalid or the
+ * block is not in use.
+ */
+bed_status bed_wear_discard(bed_wear *wear, bed_address block);
+
+/**
+ * @brief Erases and allocates the discarded block with the lowest erase
+ * count.
+ *
+ * Blocks with erase errors are marked bad and leave the allocator.
+ *
+ * @param[in] wear The wear leveling allocator.
+ * @param[out] block The block address relative to the data partition begin.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED No discarded block is available.
+ * @retval BED_ERROR_READ_ONLY The partition is read-only.
+ */
+bed_status bed_wear_allocate(bed_wear *wear, bed_address *block);
+
+/**
+ * @brief Performs one static wear leveling step.
+ *
+ * In case the erase count of the discarded block with the highest erase
+ * count exceeds the erase count of the block in use with the lowest erase
+ * count by more than the static threshold, then the discarded block is
+ * erased and the relocate handler moves the content of the block in use to
+ * it.  On success the source block is discarded and the destination block is
+ * in use.  In case the relocate handler fails, both blocks remain in use.
+ *
+ * @param[in] wear The wear leveling allocator.
+ * @param[in] relocate The relocate handler.  It is mandatory, since only the
+ * upper layer knows the new location of the moved content.
+ * @param[in] arg The relocate handler argument.
+ *
+ * @retval BED_SUCCESS One block was moved.
+ * @retval BED_ERROR_UNSATISFIED There was nothing to do.
+ * @retval BED_ERROR_INVALID_ADDRESS The relocate handler is NULL.
+ * @retval other The erase or the relocate handler failed.
+ */
+bed_status bed_wear_level(
+	bed_wear *wear,
+	bed_wear_relocate_handler relocate,
+	void *arg
+);
+
+/**
+ * @brief Writes the erase count table.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_UNSATISFIED No table block could be written.
+ * @retval BED_ERROR_READ_ONLY The partition is read-only.
+ */
+bed_status bed_wear_sync(bed_wear *wear);
+
+/**
+ * @brief Gets the erase count of a data block.
+ *
+ * @param[in] wear The wear leveling allocator.
+ * @param[in] block The block address relative to the data partition begin.
+ * @param[out] erase_count The erase count.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_INVALID_ADDRESS The block address is invalid.
+ */
+bed_status bed_wear_erase_count(
+	bed_wear *wear,
+	bed_address block,
+	uint32_t *erase_count
+);
+
+uint32_t bed_wear_discarded_count(bed_wear *wear);
+
+void bed_wear_get_statistics(bed_wear *wear, bed_wear_statistics *statistics);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_WEAR_H */
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-write-buffer.h"
+#include "bed-impl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * The buffer contains the current page up to fill and 0xff afterwards.  The
+ * copy buffer is used to program the page without the already programmed
+ * range and to copy pages in case of a write error.
+ */
+struct bed_write_buffer {
+	bed_partition part;
+	bed_write_buffer_config config;
+	bed_address page;
+	bool block_ready;
+	uint8_t programs;
+	uint16_t programmed;
+	uint16_t fill;
+	uint64_t oldest;
+	uint8_t *buffer;
+	uint8_t *copy_buffer;
+};
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+#ifndef BED_CONFIG_READ_ONLY
+static bed_status prepare_block(bed_write_buffer *wb, bed_device *bed)
+{
+	bed_status status = BED_SUCCESS;
+
+	while (!wb->block_ready && status == BED_SUCCESS) {
+		if (wb->page < wb->part.size) {
+			status = bed_device_erase(
+				bed,
+				wb->part.begin + wb->page,
+				BED_ERASE_MARK_BAD_ON_ERROR
+			);
+
+			if (status == BED_SUCCESS) {
+				wb->block_ready = true;
+			} else {
+				wb->page += bed->block_size;
+				status = BED_SUCCESS;
+			}
+		} else {
+			status = BED_ERROR_UNSATISFIED;
+		}
+	}
+
+	return status;
+}
+
+static void advance(bed_write_buffer *wb, const bed_device *bed)
+{
+	uint16_t page_size = bed->page_size;
+	uint16_t end = page_size;
+
+	if (wb->config.programs_per_page > 1) {
+		end = (uint16_t) bed_align_up(wb->fill, wb->config.program_unit - 1U);
+	}
+
+	if (wb->programs < wb->config.programs_per_page && end < page_size) {
+		wb->programmed = end;
+		wb->fill = end;
+	} else {
+		memset(wb->buffer, 0xff, page_size);
+		wb->programs = 0;
+		wb->programmed = 0;
+		wb->fill = 0;
+		wb->page += page_size;
+		wb->block_ready = !bed_is_block_aligned(bed, wb->page);
+	}
+}
+
+/*
+ * Copies the pages programmed before the current page of the block with the
+ * write error to the next good block.  The block with the write error is
+ * marked bad after a successful copy.  The caller programs the current page
+ * again.
+ */
+static bed_status relocate_block(bed_write_buffer *wb, bed_device *bed)
+{
+	bed_status status = BED_ERROR_WRITE;
+	uint32_t block_size = bed->block_size;
+	uint16_t page_size = bed->page_size;
+	bed_address begin = wb->part.begin;
+	bed_address failed = bed_align_down(wb->page, block_size - 1);
+	bed_address count = wb->page - failed;
+	bed_address block = failed;
+
+	while (status == BED_ERROR_WRITE) {
+		bed_address offset;
+
+		wb->page = block + block_size;
+		wb->block_ready = false;
+		status = prepare_block(wb, bed);
+		block = wb->page;
+
+		for (
+			offset = 0;
+			status == BED_SUCCESS && offset != count;
+			offset += page_size
+		) {
+			status = (*bed->read)(
+				bed,
+				begin + failed + offset,
+				wb->copy_buffer,
+				page_size
+			);
+
+			if (status == BED_ERROR_ECC_FIXED) {
+				status = BED_SUCCESS;
+			}
+
+			if (status == BED_SUCCESS) {
+				status = (*bed->write)(
+					bed,
+					begin + block + offset,
+					wb->copy_buffer,
+					page_size
+				);
+			}
+		}
+
+		if (status == BED_ERROR_WRITE) {
+			(*bed->mark_block_bad)(bed, begin + block);
+		}
+	}
+
+	if (status == BED_SUCCESS) {
+		(*bed->mark_block_bad)(bed, begin + failed);
+		wb->page = block + count;
+		wb->programs = 0;
+		wb->programmed = 0;
+	}
+
+	return status;
+}
+
+/*
+ * In case of a write error, the block is relocated and the page is
+ * programmed to the new block.
+ */
+static bed_status program(bed_write_buffer *wb)
+{
+	bed_status status = BED_SUCCESS;
+	bed_device *bed = wb->part.bed;
+	uint16_t page_size = bed->page_size;
+	bool done = false;
+
+	(*bed->obtain)(bed);
+
+	while (!done && status == BED_SUCCESS) {
+		status = prepare_block(wb, bed);
+
+		if (status == BED_SUCCESS) {
+			const uint8_t *data = wb->buffer;
+
+			if (wb->programmed > 0) {
+				memset(wb->copy_buffer, 0xff, wb->programmed);
+				memcpy(
+					wb->copy_buffer + wb->programmed,
+					wb->buffer + wb->programmed,
+					(size_t) (page_size - wb->programmed)
+				);
+				data = wb->copy_buffer;
+			}
+
+			status = (*bed->write)(
+				bed,
+				wb->part.begin + wb->page,
+				data,
+				page_size
+			);
+
+			if (status == BED_SUCCESS) {
+				++wb->programs;
+				advance(wb, bed);
+				done = true;
+			} else if (status == BED_ERROR_WRITE) {
+				status = relocate_block(wb, bed);
+			}
+		}
+	}
+
+	(*bed->release)(bed);
+
+	return status;
+}
+#else /* BED_CONFIG_READ_ONLY */
+static bed_status program(bed_write_buffer *wb)
+{
+	(void) wb;
+
+	return BED_ERROR_READ_ONLY;
+}
+#endif /* BED_CONFIG_READ_ONLY */
+
+bed_write_buffer *bed_write_buffer_create(
+	const bed_partition *part,
+	const bed_write_buffer_config *config
+)
+{
+	bed_write_buffer *wb = NULL;
+	uint16_t page_size = bed_page_size(part);
+
+	if (
+		config->programs_per_page < 2
+			|| (bed_is_power_of_two(config->program_unit)
+				&& config->program_unit <= page_size)
+	) {
+		wb = malloc(sizeof(*wb) + 2 * (size_t) page_size);
+	}
+
+	if (wb != NULL) {
+		memset(wb, 0, sizeof(*wb));
+		wb->part = *part;
+		wb->config = *config;
+		wb->buffer = (uint8_t *) (wb + 1);
+		wb->copy_buffer = wb->buffer + page_size;
+		memset(wb->buffer, 0xff, page_size);
+	}
+
+	return wb;
+}
+
+void bed_write_buffer_destroy(bed_write_buffer *wb)
+{
+	free(wb);
+}
+
+bed_status bed_write_buffer_append(
+	bed_write_buffer *wb,
+	const void *data,
+	size_t n
+)
+{
+	bed_status status = BED_SUCCESS;
+	uint16_t page_size = bed_page_size(&wb->part);
+	const uint8_t *in = data;
+
+	while (n > 0 && status == BED_SUCCESS) {
+		size_t r = (size_t) (page_size - wb->fill);
+		size_t m = n < r ? n : r;
+
+		if (wb->fill == wb->programmed) {
+			wb->oldest = now();
+		}
+
+		memcpy(wb->buffer + wb->fill, in, m);
+		wb->fill = (uint16_t) (wb->fill + m);
+		in += m;
+		n -= m;
+
+		if (wb->fill == page_size) {
+			status = program(wb);
+		}
+	}
+
+	return status;
+}
+
+bed_status bed_write_buffer_sync(bed_write_buffer *wb)
+{
+	bed_status status = BED_SUCCESS;
+
+	if (wb->fill > wb->programmed) {
+		status = program(wb);
+	}
+
+	return status;
+}
+
+bed_status bed_write_buffer_poll(bed_write_buffer *wb)
+{
+	bed_status status = BED_SUCCESS;
+	uint64_t timeout = (uint64_t) wb->config.flush_timeout * 1000000;
+
+	if (
+		wb->fill > wb->programmed
+			&& timeout > 0
+			&& now() - wb->oldest >= timeout
+	) {
+		status = program(wb);
+	}
+
+	return status;
+}
+
+bed_address bed_write_buffer_position(const bed_write_buffer *wb)
+{
+	return wb->page + wb->fill;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file
+ *
+ * @ingroup BEDWriteBuffer
+ *
+ * @brief BED Write Buffer API.
+ */
+
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#ifndef BED_WRITE_BUFFER_H
+#define BED_WRITE_BUFFER_H
+
+#include "bed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup BEDWriteBuffer BED Write Buffer
+ *
+ * @ingroup BED
+ *
+ * @brief Coalesces byte-granular appends into page writes.
+ *
+ * The write buffer appends data sequentially to a partition starting at its
+ * begin.  Appended data is collected in a page buffer.  A page is written
+ * once it is full, on bed_write_buffer_sync() or in
+ * bed_write_buffer_poll() once the oldest buffered data exceeds the flush
+ * timeout.  Blocks are erased before the first page write to them.  Bad
+ * blocks are skipped.  Blocks with erase errors are marked bad and skipped.
+ * In case of a write error, the pages written so far to the block are copied
+ * to the next good block, the page is written there and the block with the
+ * write error is marked bad afterwards.
+ *
+ * Without partial page programming a flush of a partially filled page pads
+ * the page with 0xff and continues with the next page.  With partial page
+ * programming the flush programs the page up to the next program unit
+ * boundary and the following appends continue in the same page until the
+ * page is full or the count of programs per page is exhausted.  Each partial
+ * program writes 0xff to the previously programmed units.  The page buffer
+ * keeps the programmed units, so that a write error does not lose them.  This requires an
+ * ECC which covers each program unit separately and which yields all ones
+ * for all ones data, e.g. the 256 bytes Hamming ECC of the NAND core.
+ *
+ * The write buffer must not be used concurrently.
+ *
+ * @{
+ */
+
+typedef struct {
+	/**
+	 * @brief Count of program operations per page supported by the device
+	 * (ONFI parameter page).
+	 *
+	 * Values less than two disable the partial page programming.
+	 */
+	uint8_t programs_per_page;
+
+	/**
+	 * @brief Size of a partial program unit in bytes.
+	 *
+	 * It must be a power of two not greater than the page size.  Used only in
+	 * case partial page programming is enabled.
+	 */
+	uint16_t program_unit;
+
+	/**
+	 * @brief Flush timeout in milliseconds.
+	 *
+	 * A value of zero disables the timeout.
+	 */
+	uint32_t flush_timeout;
+} bed_write_buffer_config;
+
+typedef struct bed_write_buffer bed_write_buffer;
+
+/**
+ * @brief Creates a write buffer for a partition.
+ *
+ * @param[in] part The partition.
+ * @param[in] config The write buffer configuration.
+ *
+ * @retval NULL Not enough resources or invalid configuration.
+ * @retval wb The write buffer.
+ */
+bed_write_buffer *bed_write_buffer_create(
+	const bed_partition *part,
+	const bed_write_buffer_config *config
+);
+
+/**
+ * @brief Destroys a write buffer.
+ *
+ * Data not flushed by bed_write_buffer_sync() is lost.
+ */
+void bed_write_buffer_destroy(bed_write_buffer *wb);
+
+/**
+ * @brief Appends data.
+ *
+ * Full pages are written immediately.
+ *
+ * @param[in] wb The write buffer.
+ * @param[in] data The data.
+ * @param[in] n The data size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE A page of a block with a write error
+ * could not be copied.
+ * @retval BED_ERROR_UNSATISFIED The end of partition is reached.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
+bed_status bed_write_buffer_append(
+	bed_write_buffer *wb,
+	const void *data,
+	size_t n
+);
+
+/**
+ * @brief Writes the buffered data.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE See bed_write_buffer_append().
+ * @retval BED_ERROR_UNSATISFIED The end of partition is reached.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
+bed_status bed_write_buffer_sync(bed_write_buffer *wb);
+
+/**
+ * @brief Writes the buffered data in case the oldest buffered data exceeds
+ * the flush timeout.
+ *
+ * Call this function periodically, e.g. from a low priority task.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE See bed_write_buffer_append().
+ * @retval BED_ERROR_UNSATISFIED The end of partition is reached.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
+bed_status bed_write_buffer_poll(bed_write_buffer *wb);
+
+/**
+ * @brief Returns the address of the next appended byte relative to the
+ * partition begin.
+ */
+bed_address bed_write_buffer_position(const bed_write_buffer *wb);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BED_WRITE_BUFFER_H */
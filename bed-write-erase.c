@@ -51,8 +51,12 @@ bed_status bed_write_oob(
 	bed_status status = BED_SUCCESS;
 	bed_device *bed = part->bed;
 
-	if (bed_is_range_valid(part, addr, n) && bed_is_oob_request_valid(bed, oob)) {
-		if (n > 0) {
+	if (
+		bed_is_range_valid(part, addr, n)
+			&& (n > 0 || (addr & (bed->page_size - 1)) == 0)
+			&& bed_is_oob_request_valid(bed, oob)
+	) {
+		if (n > 0 || oob->size > 0) {
 			(*bed->obtain)(bed);
 			status = (*bed->write_oob)(bed, part->begin + addr, data, n, oob);
 			(*bed->release)(bed);
@@ -117,33 +121,61 @@ bed_status bed_erase(
 }
 
 bed_status bed_erase_all(const bed_partition *part, bed_erase_mode mode)
+{
+	bed_cursor cursor;
+
+	bed_cursor_initialize(&cursor, NULL, NULL);
+
+	return bed_erase_all_with_cursor(part, mode, &cursor);
+}
+
+bed_status bed_erase_all_with_cursor(
+	const bed_partition *part,
+	bed_erase_mode mode,
+	bed_cursor *cursor
+)
 {
 #ifdef BED_CONFIG_READ_ONLY
 	return BED_ERROR_READ_ONLY;
 #else
 	bed_status status = BED_SUCCESS;
-	bed_device *bed = part->bed;
-	bed_address block = part->begin;
-	bed_address end = part->begin + part->size;
-	uint32_t block_size = bed->block_size;
 
-	(*bed->obtain)(bed);
+	if (bed_is_cursor_valid(part, cursor)) {
+		bed_device *bed = part->bed;
+		bed_address block = part->begin + cursor->position;
+		bed_address end = part->begin + part->size;
+		uint32_t block_size = bed->block_size;
+		bool stop = false;
 
-	while (block != end) {
-		bed_status erase_status = bed_device_erase(bed, block, mode);
+		(*bed->obtain)(bed);
 
-		if (
-			status == BED_SUCCESS
-				&& erase_status != BED_SUCCESS
-				&& erase_status != BED_ERROR_BLOCK_IS_BAD
-		) {
-			status = erase_status;
+		while (!stop && block != end) {
+			bed_status erase_status = bed_device_erase(bed, block, mode);
+
+			if (
+				status == BED_SUCCESS
+					&& erase_status != BED_SUCCESS
+					&& erase_status != BED_ERROR_BLOCK_IS_BAD
+			) {
+				status = erase_status;
+			}
+
+			block += block_size;
+			stop = bed_cursor_advance(cursor, block - part->begin, part->size);
+
+			if (!stop && block != end) {
+				bed_preempt(bed);
+			}
 		}
 
-		block += block_size;
-	}
+		(*bed->release)(bed);
 
-	(*bed->release)(bed);
+		if (block != end) {
+			status = BED_ERROR_STOPPED;
+		}
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
 
 	return status;
 #endif
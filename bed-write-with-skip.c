@@ -19,22 +19,23 @@
 #ifndef BED_CONFIG_READ_ONLY
 static bed_status write_with_skip(
 	bed_device *bed,
-	bed_address area_begin,
-	bed_address area_size,
+	const bed_partition *part,
 	const void *data,
 	size_t n,
-	void *page_buffer
+	void *page_buffer,
+	bed_cursor *cursor
 )
 {
 	bed_status status = BED_SUCCESS;
-	bed_address area_end = area_begin + area_size;
+	bed_address area_end = part->begin + part->size;
 	uint32_t block_size = bed->block_size;
 	uint16_t page_size = bed->page_size;
-	bed_address block = area_begin;
-	const uint8_t *out = data;
-	const uint8_t *end = out + n;
+	bed_address block = part->begin + cursor->position;
+	const uint8_t *out = (const uint8_t *) data + cursor->offset;
+	const uint8_t *end = (const uint8_t *) data + n;
+	bool stop = false;
 
-	while (out != end && block != area_end) {
+	while (!stop && out != end && block != area_end) {
 		bed_address next_block = block + block_size;;
 		const uint8_t *out_at_block_begin = out;
 
@@ -68,10 +69,18 @@ static bed_status write_with_skip(
 		}
 
 		block = next_block;
+		cursor->offset = (size_t) (out - (const uint8_t *) data);
+		stop = bed_cursor_advance(cursor, block - part->begin, part->size);
+
+		if (!stop && out != end && block != area_end) {
+			bed_preempt(bed);
+		}
 	}
 
 	if (out == end) {
 		status = BED_SUCCESS;
+	} else if (stop) {
+		status = BED_ERROR_STOPPED;
 	} else {
 		status = BED_ERROR_UNSATISFIED;
 	}
@@ -86,14 +95,34 @@ bed_status bed_write_with_skip(
 	size_t n,
 	void *page_buffer
 )
+{
+	bed_cursor cursor;
+
+	bed_cursor_initialize(&cursor, NULL, NULL);
+
+	return bed_write_with_skip_with_cursor(part, data, n, page_buffer, &cursor);
+}
+
+bed_status bed_write_with_skip_with_cursor(
+	const bed_partition *part,
+	const void *data,
+	size_t n,
+	void *page_buffer,
+	bed_cursor *cursor
+)
 {
 #ifndef BED_CONFIG_READ_ONLY
 	bed_status status = BED_SUCCESS;
-	bed_device *bed = part->bed;
 
-	(*bed->obtain)(bed);
-	status = write_with_skip(bed, part->begin, part->size, data, n, page_buffer);
-	(*bed->release)(bed);
+	if (bed_is_cursor_valid(part, cursor) && cursor->offset <= n) {
+		bed_device *bed = part->bed;
+
+		(*bed->obtain)(bed);
+		status = write_with_skip(bed, part, data, n, page_buffer, cursor);
+		(*bed->release)(bed);
+	} else {
+		status = BED_ERROR_INVALID_ADDRESS;
+	}
 
 	return status;
 #else /* BED_CONFIG_READ_ONLY */
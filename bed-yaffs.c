@@ -38,6 +38,7 @@
  */
 
 #include "bed-yaffs.h"
+#include "bed-impl.h"
 
 #include <yaffs/rtems_yaffs.h>
 #include <yaffs/yaffs_guts.h>
@@ -64,6 +65,7 @@ BED_YAFFS_STATIC_ASSERT(
 );
 
 typedef struct {
+	bed_lock lock;
 	const bed_partition *part;
 	int pages_per_chunk;
 	int nand_chunk_shift;
@@ -71,24 +73,29 @@ typedef struct {
 	rtems_yaffs_os_context os_context;
 } bed_yaffs_context;
 
+/*
+ * The file system has its own lock, since bed_obtain() does not provide
+ * exclusive access to a NAND device with chip locking.
+ */
 static void bed_yaffs_lock(struct yaffs_dev *dev, void *arg)
 {
-        const bed_yaffs_context *self = dev->driver_context;
+        bed_yaffs_context *self = dev->driver_context;
 
-        bed_obtain(self->part);
+        bed_lock_obtain(&self->lock);
 }
 
 static void bed_yaffs_unlock(struct yaffs_dev *dev, void *arg)
 {
-        const bed_yaffs_context *self = dev->driver_context;
+        bed_yaffs_context *self = dev->driver_context;
 
-        bed_release(self->part);
+        bed_lock_release(&self->lock);
 }
 
 static void bed_yaffs_unmount(struct yaffs_dev *dev, void *arg)
 {
         bed_yaffs_context *self = dev->driver_context;
 
+	bed_lock_destroy(&self->lock);
 	free(self);
 }
 
@@ -282,6 +289,11 @@ bed_status bed_yaffs_initialize_device(
 	bed_yaffs_context *self = NULL;
 
 	self = malloc(sizeof(*self));
+	if (self != NULL && bed_lock_initialize(&self->lock) != BED_SUCCESS) {
+		free(self);
+		self = NULL;
+	}
+
 	if (self != NULL) {
 		struct yaffs_param *param = &dev->param;
 		int oob_size = bed_ecc_covers_oob(part) ?
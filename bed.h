@@ -211,8 +211,58 @@ bed_status bed_read(const bed_partition *part, bed_address addr, void *data, siz
 
 bed_status bed_read_oob(const bed_partition *part, bed_address addr, void *data, size_t n, const bed_oob_request *oob);
 
+/**
+ * @brief Reads a column range of a page.
+ *
+ * Devices with column addressing transfer only the requested range and the
+ * ECC chunks covering it.  The ECC is checked only for these chunks.  Other
+ * devices read the whole page.
+ *
+ * @param[in] part The partition.
+ * @param[in] addr The page address relative to the partition begin.
+ * @param[in] offset The byte offset of the range in the page.
+ * @param[out] data The data of the range.
+ * @param[in] n The range size in bytes.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_ECC_FIXED Successful operation with ECC correction.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE Uncorrectable ECC error.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid page address or range.
+ * @retval BED_ERROR_SYSTEM Not enough resources.
+ */
+bed_status bed_read_partial(
+	const bed_partition *part,
+	bed_address addr,
+	uint16_t offset,
+	void *data,
+	size_t n
+);
+
 bed_status bed_write(const bed_partition *part, bed_address addr, const void *data, size_t n);
 
+/**
+ * @brief Writes a page and its out-of-bounds (OOB) data.
+ *
+ * In case the data size is zero, then only the OOB data is programmed to the
+ * spare area of the page.  Only the spare area bytes which differ from 0xff
+ * are transferred to the device.  No ECC is generated.  The page data must
+ * be erased.  The spare area may be programmed again within the partial
+ * program limit of the device, e.g. to append flags or sequence numbers.
+ * Devices with an ECC which covers the OOB area allow only one program.
+ *
+ * @param[in] part The partition.
+ * @param[in] addr The page address relative to the partition begin.
+ * @param[in] data The page data.
+ * @param[in] n The page data size.  It must be zero or the page size.
+ * @param[in] oob The OOB request.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_WRITE Write error.
+ * @retval BED_ERROR_INVALID_ADDRESS Invalid page address or data size.
+ * @retval BED_ERROR_OP_NOT_SUPPORTED The device cannot program the spare area
+ * alone or has no spare area.
+ * @retval BED_ERROR_READ_ONLY Read-only configuration.
+ */
 bed_status bed_write_oob(const bed_partition *part, bed_address addr, const void *data, size_t n, const bed_oob_request *oob);
 
 bed_status bed_erase(
@@ -221,12 +271,138 @@ bed_status bed_erase(
 	bed_erase_mode mode
 );
 
+/**
+ * @brief Progress function of long-running operations.
+ *
+ * @param[in] progress_arg The argument for the progress function.
+ * @param[in] position The address of the next block relative to the
+ * partition begin.
+ * @param[in] size The partition size.
+ *
+ * @retval false Continue processing.
+ * @retval true Stop processing.
+ */
+typedef bool (*bed_progress)(
+	void *progress_arg,
+	bed_address position,
+	bed_address size
+);
+
+/**
+ * @brief Position of a long-running operation.
+ *
+ * The long-running operations process the partition block by block.  They
+ * let other tasks use the device between the blocks.  The cursor is
+ * advanced after each complete block and the progress function is called.
+ * An operation stopped by its progress or process function continues at the
+ * cursor position in case it is called again with the same cursor.
+ *
+ * @see bed_cursor_initialize().
+ */
+typedef struct {
+	/**
+	 * @brief Address of the next block relative to the partition begin.
+	 */
+	bed_address position;
+
+	/**
+	 * @brief Count of data bytes processed by a write operation.
+	 */
+	size_t offset;
+
+	/**
+	 * @brief Progress function, may be @c NULL.
+	 */
+	bed_progress progress;
+
+	void *progress_arg;
+} bed_cursor;
+
+static inline void bed_cursor_initialize(
+	bed_cursor *cursor,
+	bed_progress progress,
+	void *progress_arg
+)
+{
+	cursor->position = 0;
+	cursor->offset = 0;
+	cursor->progress = progress;
+	cursor->progress_arg = progress_arg;
+}
+
 bed_status bed_erase_all(const bed_partition *part, bed_erase_mode mode);
 
+/**
+ * @brief Erases all blocks of a partition starting at the cursor position.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_STOPPED The progress function requested a stop.
+ * @retval other The first erase error, bad blocks excluded.
+ */
+bed_status bed_erase_all_with_cursor(
+	const bed_partition *part,
+	bed_erase_mode mode,
+	bed_cursor *cursor
+);
+
 bed_status bed_is_block_valid(const bed_partition *part, bed_address addr);
 
 bed_status bed_mark_block_bad(const bed_partition *part, bed_address addr);
 
+/**
+ * @brief Lock contention statistics.
+ */
+typedef struct {
+	/**
+	 * @brief Count of lock acquisitions, nested acquisitions excluded.
+	 */
+	uint64_t acquisitions;
+
+	/**
+	 * @brief Count of acquisitions which had to wait for another owner.
+	 */
+	uint64_t contended_acquisitions;
+
+	/**
+	 * @brief Sum of the waiting times in nanoseconds.
+	 */
+	uint64_t total_wait_nanoseconds;
+
+	/**
+	 * @brief Longest time in nanoseconds the lock was owned.
+	 */
+	uint64_t longest_hold_nanoseconds;
+} bed_lock_statistics;
+
+/**
+ * @brief Enables or disables the contention statistics of the device mutex.
+ *
+ * The statistics are cleared in both cases.
+ *
+ * @param[in] part The partition.
+ * @param[in] enable Enable or disable the statistics.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_OP_NOT_SUPPORTED The device has no device mutex or the
+ * platform provides no statistics.
+ */
+bed_status bed_enable_lock_statistics(const bed_partition *part, bool enable);
+
+/**
+ * @brief Gets the contention statistics of the device mutex.
+ *
+ * @param[in] part The partition.
+ * @param[out] statistics The statistics.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_OP_NOT_SUPPORTED The device has no device mutex or the
+ * platform provides no statistics.
+ */
+bed_status bed_get_lock_statistics(
+	const bed_partition *part,
+	bed_lock_statistics *statistics
+);
+
 bed_status bed_write_with_skip(
 	const bed_partition *part,
 	const void *data,
@@ -234,6 +410,24 @@ bed_status bed_write_with_skip(
 	void *page_buffer
 );
 
+/**
+ * @brief Writes data to the valid blocks of a partition starting at the
+ * cursor position.
+ *
+ * The cursor offset is the count of data bytes already written.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_STOPPED The progress function requested a stop.
+ * @retval BED_ERROR_UNSATISFIED Not enough valid blocks.
+ */
+bed_status bed_write_with_skip_with_cursor(
+	const bed_partition *part,
+	const void *data,
+	size_t n,
+	void *page_buffer,
+	bed_cursor *cursor
+);
+
 /**
  * @brief Read with skip process function.
  *
@@ -278,6 +472,63 @@ bed_status bed_read_with_skip(
 	void *oob_buffer
 );
 
+/**
+ * @brief Reads the valid pages of a partition starting at the cursor
+ * position.
+ *
+ * In case the process function requests a stop, then the cursor references
+ * the block of this page.
+ *
+ * @see bed_read_with_skip().
+ */
+bed_status bed_read_with_skip_with_cursor(
+	const bed_partition *part,
+	bed_read_process process,
+	void *process_arg,
+	void *page_buffer,
+	void *oob_buffer,
+	bed_cursor *cursor
+);
+
+/**
+ * @brief Loads the valid pages of a partition directly into consecutive
+ * destination memory and skips bad blocks.
+ *
+ * The pages are read with ECC correction turned on (BED_OOB_MODE_AUTO) into
+ * the destination memory without an intermediate page buffer.  A final page
+ * which does not fit completely into the destination memory is read with
+ * bed_read_partial().  In case the destination memory is cache line aligned,
+ * then drivers with DMA support (e.g. the LPC32xx SLC driver) may transfer
+ * the pages directly.  The OOB areas are only read if an OOB buffer is
+ * provided.
+ *
+ * @param[in] part The partition.
+ * @param[out] dest The destination memory.
+ * @param[in] max_len The maximum count of bytes to load.
+ * @param[out] n The count of loaded bytes.
+ * @param[in] process The page process function called after each loaded
+ * page.  The data references the destination memory.  May be @c NULL.
+ * @param[in] process_arg The argument for the page process function.
+ * @param[in] oob_buffer Buffer to store the OOB content.  It must be large
+ * enough for the OOB areas of this partition.  May be @c NULL, in this case
+ * the page process function gets no OOB content.
+ *
+ * @retval BED_SUCCESS Successful operation.
+ * @retval BED_ERROR_STOPPED The process function requested a stop.
+ * @retval BED_ERROR_ECC_UNCORRECTABLE Uncorrectable ECC error during a page
+ * read.
+ * @retval other Other error status codes depending on the driver.
+ */
+bed_status bed_load_with_skip(
+	const bed_partition *part,
+	void *dest,
+	size_t max_len,
+	size_t *n,
+	bed_read_process process,
+	void *process_arg,
+	void *oob_buffer
+);
+
 /**
  * @brief Read all process function.
  *
@@ -321,6 +572,21 @@ bed_status bed_read_all(
 	void *oob_buffer
 );
 
+/**
+ * @brief Reads all pages of a partition starting at the cursor position.
+ *
+ * @see bed_read_all() and bed_read_with_skip_with_cursor().
+ */
+bed_status bed_read_all_with_cursor(
+	const bed_partition *part,
+	bed_oob_mode oob_mode,
+	bed_read_all_process process,
+	void *process_arg,
+	void *page_buffer,
+	void *oob_buffer,
+	bed_cursor *cursor
+);
+
 extern const bed_partition bed_null_partition;
 
 typedef int (*bed_printer)(void *arg, const char *fmt, ...)
@@ -338,6 +604,7 @@ typedef void (*bed_select_chip_method)(bed_device *bed, uint16_t chip);
 typedef bed_status (*bed_is_block_valid_method)(bed_device *bed, bed_address addr);
 typedef bed_status (*bed_read_method)(bed_device *bed, bed_address addr, void *data, size_t n);
 typedef bed_status (*bed_read_oob_method)(bed_device *bed, bed_address addr, void *data, size_t n, const bed_oob_request *oob);
+typedef bed_status (*bed_read_partial_method)(bed_device *bed, bed_address addr, uint16_t offset, void *data, size_t n);
 typedef bed_status (*bed_write_method)(bed_device *bed, bed_address addr, const void *data, size_t n);
 typedef bed_status (*bed_write_oob_method)(bed_device *bed, bed_address addr, const void *data, size_t n, const bed_oob_request *oob);
 typedef bed_status (*bed_erase_method)(bed_device *bed, bed_address addr);
@@ -355,6 +622,7 @@ struct bed_device {
 	bed_is_block_valid_method is_block_valid;
 	bed_read_method read;
 	bed_read_oob_method read_oob;
+	bed_read_partial_method read_partial;
 #ifdef BED_CONFIG_READ_ONLY
 	/* Keep structure layout */
 	void *reserved[4];
@@ -381,7 +649,9 @@ struct bed_device {
 	bed_address size;
 #ifdef __rtems__
 	uint32_t mutex_id;
-#endif
+#else /* __rtems__ */
+	void *mutex;
+#endif /* __rtems__ */
 };
 
 /** @} */
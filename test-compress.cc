@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-compress.h"
+#include "bed-nand.h"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 16;
+
+static const uint16_t PAGE_SIZE = 2048;
+
+static const uint32_t BLOCK_SIZE = 4 * PAGE_SIZE;
+
+static const size_t IMAGE_SIZE = 50000;
+
+static const size_t BUFFER_SIZE = IMAGE_SIZE + 1024;
+
+/*
+ * Repeated strings, runs and noise like in a firmware image.
+ */
+static void createImage(uint8_t *image, size_t n)
+{
+	static const char text [] = "bed_status bed_read_with_skip(const bed_partition *part)";
+	uint32_t x = 1;
+	size_t i = 0;
+
+	while (i < n) {
+		size_t kind = i / 1000 % 3;
+		size_t m = n - i < 1000 ? n - i : 1000;
+
+		for (size_t j = 0; j < m; ++j) {
+			x = x * 1103515245 + 12345;
+
+			if (kind == 0) {
+				image [i + j] = (uint8_t) text [(j + i / 1000) % (sizeof(text) - 1)];
+			} else if (kind == 1) {
+				image [i + j] = (uint8_t) (j / 100);
+			} else {
+				image [i + j] = (uint8_t) (x >> 16);
+			}
+		}
+
+		i += m;
+	}
+}
+
+static void createNoise(uint8_t *image, size_t n)
+{
+	uint32_t x = 7;
+
+	for (size_t i = 0; i < n; ++i) {
+		x = x * 1103515245 + 12345;
+		image [i] = (uint8_t) (x >> 16);
+	}
+}
+
+static uint8_t image [IMAGE_SIZE];
+
+static uint8_t compressed [BUFFER_SIZE];
+
+static uint8_t decompressed [BUFFER_SIZE];
+
+static bed_status decompress(const uint8_t *data, size_t n, size_t chunkSize, size_t *m)
+{
+	bed_decompressor dec;
+	bed_status status = BED_SUCCESS;
+
+	bed_decompressor_initialize(&dec, decompressed, sizeof(decompressed));
+
+	for (size_t i = 0; i < n && status == BED_SUCCESS; i += chunkSize) {
+		status = bed_decompress(&dec, data + i, n - i < chunkSize ? n - i : chunkSize);
+	}
+
+	if (status == BED_SUCCESS) {
+		status = bed_decompressor_finish(&dec, m);
+	}
+
+	return status;
+}
+
+TEST(BED, Compress)
+{
+	createImage(image, IMAGE_SIZE);
+
+	size_t n;
+	bed_status status = bed_compress(image, IMAGE_SIZE, compressed, sizeof(compressed), &n);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_LT(n, IMAGE_SIZE / 2);
+	EXPECT_GT(n, IMAGE_SIZE / 3);
+
+	static const size_t chunkSizes [] = { 1, 7, PAGE_SIZE, BUFFER_SIZE };
+
+	for (size_t i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes [0]); ++i) {
+		size_t m;
+
+		memset(decompressed, 0, sizeof(decompressed));
+		status = decompress(compressed, n, chunkSizes [i], &m);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(IMAGE_SIZE, m);
+		EXPECT_EQ(0, memcmp(image, decompressed, IMAGE_SIZE));
+	}
+
+	createNoise(image, IMAGE_SIZE);
+	status = bed_compress(image, IMAGE_SIZE, compressed, IMAGE_SIZE, &n);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, n);
+
+	status = bed_compress(image, IMAGE_SIZE, compressed, bed_compress_bound(IMAGE_SIZE), &n);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(bed_compress_bound(IMAGE_SIZE), n);
+
+	size_t m;
+	status = decompress(compressed, n, PAGE_SIZE, &m);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(IMAGE_SIZE, m);
+	EXPECT_EQ(0, memcmp(image, decompressed, IMAGE_SIZE));
+
+	status = bed_compress(image, 0, compressed, sizeof(compressed), &n);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(size_t(BED_COMPRESS_HEADER_SIZE), n);
+
+	status = decompress(compressed, n, PAGE_SIZE, &m);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, m);
+
+	memset(image, 0, 100);
+	status = bed_compress(image, 100, compressed, sizeof(compressed), &n);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_LT(n, size_t(BED_COMPRESS_HEADER_SIZE + 20));
+
+	status = decompress(compressed, n, 1, &m);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(100U, m);
+	EXPECT_EQ(0, memcmp(image, decompressed, 100));
+}
+
+TEST(BED, CompressInvalid)
+{
+	createImage(image, IMAGE_SIZE);
+
+	size_t n;
+	bed_status status = bed_compress(image, IMAGE_SIZE, compressed, sizeof(compressed), &n);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	size_t m;
+	status = decompress(compressed, n - 1, PAGE_SIZE, &m);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, m);
+
+	bed_decompressor dec;
+	bed_decompressor_initialize(&dec, decompressed, IMAGE_SIZE - 1);
+	status = bed_decompress(&dec, compressed, n);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	EXPECT_TRUE(bed_decompressor_is_done(&dec));
+
+	for (size_t i = 0; i < n; i += 97) {
+		compressed [i] ^= 0x10;
+		status = decompress(compressed, n, PAGE_SIZE, &m);
+		EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+		compressed [i] ^= 0x10;
+	}
+
+	status = decompress(compressed, n, PAGE_SIZE, &m);
+	EXPECT_EQ(BED_SUCCESS, status);
+}
+
+class CountingProcess {
+	public:
+		CountingProcess(bed_decompressor *dec)
+			: mDec(dec), mPages(0)
+		{
+			// Nothing to do
+		}
+
+		static bool process(void *arg, bed_address addr, void *data, size_t n, void *oob, size_t m)
+		{
+			CountingProcess *self = static_cast<CountingProcess *>(arg);
+
+			++self->mPages;
+
+			return bed_decompress_process(self->mDec, addr, data, n, oob, m);
+		}
+
+		bed_decompressor *mDec;
+
+		size_t mPages;
+};
+
+TEST(BED, CompressWithSkip)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	createImage(image, IMAGE_SIZE);
+
+	uint8_t pageBuffer [PAGE_SIZE];
+	status = bed_write_compressed_with_skip(
+		part,
+		image,
+		IMAGE_SIZE,
+		compressed,
+		sizeof(compressed),
+		pageBuffer
+	);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	uint8_t oobBuffer [64];
+	size_t n;
+	status = bed_read_compressed_with_skip(
+		part,
+		decompressed,
+		sizeof(decompressed),
+		&n,
+		pageBuffer,
+		oobBuffer
+	);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(IMAGE_SIZE, n);
+	EXPECT_EQ(0, memcmp(image, decompressed, IMAGE_SIZE));
+
+	bed_decompressor dec;
+	bed_decompressor_initialize(&dec, decompressed, sizeof(decompressed));
+	CountingProcess counting(&dec);
+	status = bed_read_with_skip(
+		part,
+		CountingProcess::process,
+		&counting,
+		pageBuffer,
+		oobBuffer
+	);
+	EXPECT_EQ(BED_ERROR_STOPPED, status);
+	EXPECT_LT(counting.mPages, IMAGE_SIZE / PAGE_SIZE);
+
+	status = bed_decompressor_finish(&dec, &n);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(IMAGE_SIZE, n);
+
+	status = bed_erase_all(part, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_read_compressed_with_skip(
+		part,
+		decompressed,
+		sizeof(decompressed),
+		&n,
+		pageBuffer,
+		oobBuffer
+	);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, n);
+
+	bed_nand_simulator_destroy(part);
+}
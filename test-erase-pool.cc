@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-erase-pool.h"
+#include "bed-nand.h"
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 8;
+
+static const uint32_t BLOCK_SIZE = 1024;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static bool isBlank(const bed_partition *part, bed_address block)
+{
+	uint8_t data [PAGE_SIZE];
+	bool blank = true;
+
+	for (bed_address page = block; page < block + BLOCK_SIZE; page += PAGE_SIZE) {
+		bed_status status = bed_read(part, page, data, sizeof(data));
+		blank = blank && status == BED_SUCCESS;
+
+		for (size_t i = 0; i < sizeof(data); ++i) {
+			blank = blank && data [i] == 0xff;
+		}
+	}
+
+	return blank;
+}
+
+TEST(BED, ErasePool)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	uint8_t data [PAGE_SIZE];
+	memset(data, 0, sizeof(data));
+
+	for (uint32_t i = 0; i < BLOCK_COUNT; ++i) {
+		bed_status status = bed_write(part, i * BLOCK_SIZE, data, sizeof(data));
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_erase_pool *pool = bed_erase_pool_create(part, 2);
+	ASSERT_TRUE(pool != NULL);
+
+	bed_address block;
+	bed_status status = bed_erase_pool_allocate(pool, &block);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	status = bed_erase_pool_work(pool);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	for (uint32_t i = 0; i < 6; ++i) {
+		status = bed_erase_pool_discard(pool, i * BLOCK_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	status = bed_erase_pool_discard(pool, 0);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_erase_pool_discard(pool, PAGE_SIZE);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_erase_pool_discard(pool, BLOCK_COUNT * BLOCK_SIZE);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	status = bed_mark_block_bad(part, 3 * BLOCK_SIZE);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	int work = 0;
+	while (bed_erase_pool_work(pool) == BED_SUCCESS) {
+		++work;
+	}
+	EXPECT_EQ(2, work);
+	EXPECT_EQ(2U, bed_erase_pool_clean_count(pool));
+	EXPECT_EQ(4U, bed_erase_pool_discarded_count(pool));
+	EXPECT_FALSE(isBlank(part, 2 * BLOCK_SIZE));
+
+	static const bed_address expected [] = { 0, 1, 2, 4, 5 };
+	for (size_t i = 0; i < sizeof(expected) / sizeof(expected [0]); ++i) {
+		status = bed_erase_pool_allocate(pool, &block);
+		ASSERT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(expected [i] * BLOCK_SIZE, block);
+		EXPECT_TRUE(isBlank(part, block));
+	}
+
+	status = bed_erase_pool_allocate(pool, &block);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, bed_erase_pool_clean_count(pool));
+	EXPECT_EQ(0U, bed_erase_pool_discarded_count(pool));
+
+	status = bed_erase_pool_discard(pool, 3 * BLOCK_SIZE);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_erase_pool_discard(pool, 1 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_erase_pool_destroy(pool);
+	bed_nand_simulator_destroy(part);
+}
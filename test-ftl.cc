@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-ftl.h"
+#include "bed-nand.h"
+#include "bed-test.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 16;
+
+static const uint32_t PAGES_PER_BLOCK = 8;
+
+static const uint32_t SPARE_BLOCKS = 4;
+
+/*
+ * The cubic term ensures that an erased Hamming ECC does not match the data.
+ */
+static void createSector(uint32_t *data, uint32_t sectorSize, uint32_t sector, uint32_t generation)
+{
+	for (uint32_t i = 0; i < sectorSize / sizeof(uint32_t); ++i) {
+		data [i] = (generation << 24) ^ (sector << 12) ^ (i * i * i);
+	}
+}
+
+static bool isSector(const uint32_t *data, uint32_t sectorSize, uint32_t sector, uint32_t generation)
+{
+	std::vector<uint32_t> expected(sectorSize / sizeof(uint32_t));
+
+	createSector(&expected [0], sectorSize, sector, generation);
+
+	return memcmp(&expected [0], data, sectorSize) == 0;
+}
+
+static int stringPrinter(void *arg, const char *fmt, ...)
+{
+	std::string *s = static_cast<std::string *>(arg);
+	char buf [256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	*s += buf;
+
+	return n;
+}
+
+static void testFTL(uint16_t pageSize, uint32_t sectorSize, bed_ftl_gc_policy policy)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, PAGES_PER_BLOCK * pageSize, pageSize);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_mark_block_bad(part, 5 * PAGES_PER_BLOCK * pageSize);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_ftl_config config = { sectorSize, SPARE_BLOCKS, policy, NULL };
+	bed_ftl *ftl;
+	status = bed_ftl_create(part, &config, &ftl);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint32_t sectorCount = bed_ftl_sector_count(ftl);
+	EXPECT_EQ((BLOCK_COUNT - SPARE_BLOCKS) * PAGES_PER_BLOCK * pageSize / sectorSize, sectorCount);
+	EXPECT_EQ(sectorSize, bed_ftl_sector_size(ftl));
+
+	std::vector<uint32_t> data(sectorSize / sizeof(uint32_t));
+	std::vector<uint32_t> generations(sectorCount, 0);
+
+	status = bed_ftl_read(ftl, 0, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0xffffffff, data [0]);
+	status = bed_ftl_read(ftl, sectorCount, &data [0], 1);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_ftl_write(ftl, sectorCount - 1, &data [0], 2);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	// Fill the device and overwrite mostly a hot subset to force garbage
+	// collections
+	for (uint32_t sector = 0; sector < sectorCount; ++sector) {
+		createSector(&data [0], sectorSize, sector, 0);
+		status = bed_ftl_write(ftl, sector, &data [0], 1);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	uint32_t random = 1;
+
+	for (uint32_t i = 0; i < 8 * sectorCount; ++i) {
+		random = random * 1103515245 + 12345;
+		uint32_t sector = (random >> 8) % sectorCount;
+
+		if (i % 4 != 0) {
+			sector %= sectorCount / 4;
+		}
+
+		++generations [sector];
+		createSector(&data [0], sectorSize, sector, generations [sector]);
+		status = bed_ftl_write(ftl, sector, &data [0], 1);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	std::vector<uint32_t> all(sectorCount * sectorSize / sizeof(uint32_t));
+	status = bed_ftl_read(ftl, 0, &all [0], sectorCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t sector = 0; sector < sectorCount; ++sector) {
+		EXPECT_TRUE(isSector(&all [sector * sectorSize / sizeof(uint32_t)], sectorSize, sector, generations [sector]));
+	}
+
+	bed_ftl_statistics statistics;
+	bed_ftl_get_statistics(ftl, &statistics, false);
+	EXPECT_EQ(sectorCount + 1, statistics.sectors_read);
+	EXPECT_GT(statistics.gc_blocks, 0U);
+	EXPECT_GT(statistics.gc_page_writes, 0U);
+	EXPECT_GT(statistics.page_writes * pageSize, statistics.sectors_written * sectorSize);
+
+	std::string report;
+	bed_ftl_print_statistics(ftl, stringPrinter, &report);
+	EXPECT_NE(std::string::npos, report.find("write amplification = "));
+
+	bed_ftl_destroy(ftl);
+
+	// The mapping is recovered from the OOB areas
+	status = bed_ftl_create(part, &config, &ftl);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(sectorCount, bed_ftl_sector_count(ftl));
+
+	memset(&all [0], 0, all.size() * sizeof(all [0]));
+	status = bed_ftl_read(ftl, 0, &all [0], sectorCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t sector = 0; sector < sectorCount; ++sector) {
+		EXPECT_TRUE(isSector(&all [sector * sectorSize / sizeof(uint32_t)], sectorSize, sector, generations [sector]));
+	}
+
+	createSector(&data [0], sectorSize, 1, 255);
+	status = bed_ftl_write(ftl, 1, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_ftl_read(ftl, 1, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isSector(&data [0], sectorSize, 1, 255));
+
+	bed_ftl_get_statistics(ftl, &statistics, true);
+	EXPECT_EQ(1U, statistics.sectors_written);
+	bed_ftl_get_statistics(ftl, &statistics, false);
+	EXPECT_EQ(0U, statistics.sectors_written);
+
+	bed_ftl_destroy(ftl);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, FTL)
+{
+	testFTL(512, 512, BED_FTL_GC_GREEDY);
+	testFTL(2048, 512, BED_FTL_GC_COST_BENEFIT);
+	testFTL(2048, 4096, BED_FTL_GC_GREEDY);
+}
+
+TEST(BED, FTLInvalidConfig)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, PAGES_PER_BLOCK * 512, 512);
+	ASSERT_TRUE(part != NULL);
+
+	bed_ftl *ftl;
+	bed_ftl_config config = { 500, SPARE_BLOCKS, BED_FTL_GC_GREEDY, NULL };
+	bed_status status = bed_ftl_create(part, &config, &ftl);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	EXPECT_TRUE(ftl == NULL);
+
+	config.sector_size = 512;
+	config.spare_blocks = 2;
+	status = bed_ftl_create(part, &config, &ftl);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	config.spare_blocks = BLOCK_COUNT;
+	status = bed_ftl_create(part, &config, &ftl);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * The sectors are written in ascending order and then overwritten twice in a
+ * scattered order to trigger garbage collections.  After a power cut the sectors must reflect a prefix of these
+ * writes.
+ */
+class PowerCutFTL {
+	public:
+		static const uint32_t SECTOR_SIZE = 512;
+
+		PowerCutFTL()
+			: mCutPoints(0), mFTL(NULL)
+		{
+			mConfig.sector_size = SECTOR_SIZE;
+			mConfig.spare_blocks = 3;
+			mConfig.gc_policy = BED_FTL_GC_GREEDY;
+			mConfig.wear = NULL;
+		}
+
+		static bed_status prepare(void *arg, const bed_partition *part)
+		{
+			PowerCutFTL *self = static_cast<PowerCutFTL *>(arg);
+			bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+
+			if (status == BED_SUCCESS) {
+				status = self->writeAll(part, 0, 1);
+			}
+
+			return status;
+		}
+
+		static bed_status run(void *arg, const bed_partition *part)
+		{
+			PowerCutFTL *self = static_cast<PowerCutFTL *>(arg);
+			bed_status status = self->writeAll(part, 1, 7);
+
+			if (status == BED_SUCCESS) {
+				status = self->writeAll(part, 2, 7);
+			}
+
+			return status;
+		}
+
+		static bed_status recover(void *arg, const bed_partition *part)
+		{
+			PowerCutFTL *self = static_cast<PowerCutFTL *>(arg);
+
+			return bed_ftl_create(part, &self->mConfig, &self->mFTL);
+		}
+
+		static bed_status check(void *arg, const bed_partition *part, size_t *lost)
+		{
+			PowerCutFTL *self = static_cast<PowerCutFTL *>(arg);
+			bed_status status = BED_ERROR_SYSTEM;
+
+			*lost = 0;
+
+			if (self->mFTL != NULL) {
+				uint32_t sectorCount = bed_ftl_sector_count(self->mFTL);
+				uint32_t data [SECTOR_SIZE / sizeof(uint32_t)];
+				uint32_t first = 0;
+				uint32_t previous = 0;
+				std::vector<uint32_t> generations(sectorCount);
+
+				for (uint32_t i = 0; i < sectorCount; ++i) {
+					uint32_t sector = scatter(i, sectorCount, 7);
+
+					status = bed_ftl_read(self->mFTL, sector, data, 1);
+					uint32_t generation = data [0] >> 24;
+					generations [sector] = generation;
+
+					if (i == 0) {
+						first = generation;
+						previous = generation;
+					}
+
+					if (
+						status != BED_SUCCESS
+							|| !isSector(data, SECTOR_SIZE, sector, generation)
+							|| generation > previous
+							|| generation + 1 < first
+					) {
+						*lost += SECTOR_SIZE;
+					}
+
+					previous = generation;
+				}
+
+				if (status == BED_SUCCESS) {
+					status = self->checkAfterRemount(part, generations, lost);
+				}
+
+				bed_ftl_destroy(self->mFTL);
+				self->mFTL = NULL;
+			}
+
+			return status;
+		}
+
+		static void report(void *arg, const bed_test_power_cut_result *result)
+		{
+			PowerCutFTL *self = static_cast<PowerCutFTL *>(arg);
+
+			if (result->operation == 0) {
+				EXPECT_EQ(BED_SUCCESS, result->run_status);
+				self->mCutPoints = result->operation_count;
+			}
+
+			EXPECT_EQ(BED_SUCCESS, result->recover_status);
+			EXPECT_EQ(BED_SUCCESS, result->check_status);
+			EXPECT_EQ(0U, result->lost);
+		}
+
+		uint32_t mCutPoints;
+
+	private:
+		static uint32_t scatter(uint32_t i, uint32_t sectorCount, uint32_t stride)
+		{
+			return (i * stride) % sectorCount;
+		}
+
+		bed_status writeAll(const bed_partition *part, uint32_t generation, uint32_t stride)
+		{
+			bed_ftl *ftl;
+			bed_status status = bed_ftl_create(part, &mConfig, &ftl);
+
+			if (status == BED_SUCCESS) {
+				uint32_t sectorCount = bed_ftl_sector_count(ftl);
+				uint32_t data [SECTOR_SIZE / sizeof(uint32_t)];
+
+				for (uint32_t i = 0; i < sectorCount && status == BED_SUCCESS; ++i) {
+					uint32_t sector = scatter(i, sectorCount, stride);
+
+					createSector(data, SECTOR_SIZE, sector, generation);
+					status = bed_ftl_write(ftl, sector, data, 1);
+				}
+
+				bed_ftl_destroy(ftl);
+			}
+
+			return status;
+		}
+
+		/*
+		 * Writes to other sectors after the recovery must not bring back an
+		 * incomplete page at the next creation.
+		 */
+		bed_status checkAfterRemount(const bed_partition *part, std::vector<uint32_t> &generations, size_t *lost)
+		{
+			uint32_t sectorCount = bed_ftl_sector_count(mFTL);
+			uint32_t data [SECTOR_SIZE / sizeof(uint32_t)];
+			bed_status status = BED_SUCCESS;
+
+			for (uint32_t sector = 0; sector < sectorCount && status == BED_SUCCESS; sector += 5) {
+				generations [sector] = 3;
+				createSector(data, SECTOR_SIZE, sector, 3);
+				status = bed_ftl_write(mFTL, sector, data, 1);
+			}
+
+			bed_ftl_destroy(mFTL);
+			mFTL = NULL;
+
+			if (status == BED_SUCCESS) {
+				status = bed_ftl_create(part, &mConfig, &mFTL);
+			}
+
+			for (uint32_t sector = 0; sector < sectorCount && status == BED_SUCCESS; ++sector) {
+				status = bed_ftl_read(mFTL, sector, data, 1);
+
+				if (status != BED_SUCCESS || !isSector(data, SECTOR_SIZE, sector, generations [sector])) {
+					*lost += SECTOR_SIZE;
+				}
+			}
+
+			return status;
+		}
+
+		bed_ftl_config mConfig;
+
+		bed_ftl *mFTL;
+};
+
+/*
+ * Device which reports no uncorrectable ECC errors for reads of the OOB area
+ * only, e.g. a controller which protects the OOB free area separately.
+ */
+static bed_device oobOnlyDevice;
+
+static bed_read_oob_method parentReadOOB;
+
+static bed_status readOOBOnly(bed_device *bed, bed_address addr, void *data, size_t n, const bed_oob_request *oob)
+{
+	bed_status status = (*parentReadOOB)(bed, addr, data, n, oob);
+
+	if (n == 0 && status == BED_ERROR_ECC_UNCORRECTABLE) {
+		status = BED_SUCCESS;
+	}
+
+	return status;
+}
+
+static bed_partition createOOBOnlyPartition(const bed_partition *part)
+{
+	bed_partition oobOnly = *part;
+
+	oobOnlyDevice = *part->bed;
+	parentReadOOB = oobOnlyDevice.read_oob;
+	oobOnlyDevice.read_oob = readOOBOnly;
+	oobOnly.bed = &oobOnlyDevice;
+
+	return oobOnly;
+}
+
+TEST(BED, PowerCutFTL)
+{
+	bed_partition *part = bed_nand_simulator_create(1, 8, 4 * PowerCutFTL::SECTOR_SIZE, PowerCutFTL::SECTOR_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	PowerCutFTL workload;
+	const bed_test_power_cut_workload w = {
+		PowerCutFTL::prepare,
+		PowerCutFTL::run,
+		PowerCutFTL::recover,
+		PowerCutFTL::check,
+		&workload
+	};
+
+	uint32_t cutPoints = bed_test_power_cut(part, &w, 50, PowerCutFTL::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+	EXPECT_GT(cutPoints, 40U);
+
+	// The metadata of the interrupted page is complete and readable, but not
+	// its ECC
+	bed_partition oobOnly = createOOBOnlyPartition(part);
+	cutPoints = bed_test_power_cut(&oobOnly, &w, 99, PowerCutFTL::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * Device which reports an uncorrectable ECC error for reads of the data of
+ * one page.
+ */
+static bed_device uncorrectableDevice;
+
+static bed_read_oob_method uncorrectableParentReadOOB;
+
+static bed_address uncorrectableAddress;
+
+static bed_status readUncorrectable(bed_device *bed, bed_address addr, void *data, size_t n, const bed_oob_request *oob)
+{
+	bed_status status = (*uncorrectableParentReadOOB)(bed, addr, data, n, oob);
+
+	if (n > 0 && addr == uncorrectableAddress) {
+		status = BED_ERROR_ECC_UNCORRECTABLE;
+	}
+
+	return status;
+}
+
+TEST(BED, FTLUncorrectable)
+{
+	const uint16_t pageSize = 512;
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, PAGES_PER_BLOCK * pageSize, pageSize);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_partition uncorrectable = *part;
+	uncorrectableDevice = *part->bed;
+	uncorrectableParentReadOOB = uncorrectableDevice.read_oob;
+	uncorrectableDevice.read_oob = readUncorrectable;
+	uncorrectable.bed = &uncorrectableDevice;
+
+	bed_ftl_config config = { pageSize, SPARE_BLOCKS, BED_FTL_GC_GREEDY, NULL };
+	bed_ftl *ftl;
+	status = bed_ftl_create(&uncorrectable, &config, &ftl);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint32_t sectorCount = bed_ftl_sector_count(ftl);
+	std::vector<uint32_t> data(pageSize / sizeof(uint32_t));
+
+	// The first write goes to the first page of the first block
+	for (uint32_t sector = 0; sector < sectorCount; ++sector) {
+		createSector(&data [0], pageSize, sector, 0);
+		status = bed_ftl_write(ftl, sector, &data [0], 1);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	uncorrectableAddress = 0;
+	status = bed_ftl_read(ftl, 0, &data [0], 1);
+	EXPECT_EQ(BED_ERROR_ECC_UNCORRECTABLE, status);
+
+	// Overwrite all sectors except the first of each block, so that the
+	// first block is the first victim of the garbage collection
+	for (uint32_t generation = 1; generation < 4; ++generation) {
+		for (uint32_t sector = 0; sector < sectorCount; ++sector) {
+			if (sector % PAGES_PER_BLOCK != 0) {
+				createSector(&data [0], pageSize, sector, generation);
+				status = bed_ftl_write(ftl, sector, &data [0], 1);
+				ASSERT_EQ(BED_SUCCESS, status);
+			}
+		}
+	}
+
+	// The relocated page is lost and not laundered by a fresh ECC
+	uncorrectableAddress = ~(bed_address) 0;
+	status = bed_ftl_read(ftl, 0, &data [0], 1);
+	EXPECT_EQ(BED_ERROR_ECC_UNCORRECTABLE, status);
+
+	bed_ftl_destroy(ftl);
+
+	status = bed_ftl_create(&uncorrectable, &config, &ftl);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_ftl_read(ftl, 0, &data [0], 1);
+	EXPECT_EQ(BED_ERROR_ECC_UNCORRECTABLE, status);
+
+	for (uint32_t sector = 1; sector < sectorCount; ++sector) {
+		status = bed_ftl_read(ftl, sector, &data [0], 1);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isSector(&data [0], pageSize, sector, sector % PAGES_PER_BLOCK != 0 ? 3 : 0));
+	}
+
+	createSector(&data [0], pageSize, 0, 4);
+	status = bed_ftl_write(ftl, 0, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_ftl_read(ftl, 0, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isSector(&data [0], pageSize, 0, 4));
+
+	bed_ftl_destroy(ftl);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, FTLUncorrectablePartialWrite)
+{
+	const uint16_t pageSize = 512;
+	const uint32_t sectorSize = pageSize / 2;
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, PAGES_PER_BLOCK * pageSize, pageSize);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_partition uncorrectable = *part;
+	uncorrectableDevice = *part->bed;
+	uncorrectableParentReadOOB = uncorrectableDevice.read_oob;
+	uncorrectableDevice.read_oob = readUncorrectable;
+	uncorrectable.bed = &uncorrectableDevice;
+	uncorrectableAddress = ~(bed_address) 0;
+
+	bed_ftl_config config = { sectorSize, SPARE_BLOCKS, BED_FTL_GC_GREEDY, NULL };
+	bed_ftl *ftl;
+	status = bed_ftl_create(&uncorrectable, &config, &ftl);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint32_t pageCount = bed_ftl_sector_count(ftl) / 2;
+	std::vector<uint32_t> data(pageSize / sizeof(uint32_t));
+
+	// Whole page writes, so that the first logical page is the first page of
+	// the first block
+	for (uint32_t page = 0; page < pageCount; ++page) {
+		createSector(&data [0], pageSize, page, 0);
+		status = bed_ftl_write(ftl, 2 * page, &data [0], 2);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	uncorrectableAddress = 0;
+
+	for (uint32_t generation = 1; generation < 4; ++generation) {
+		for (uint32_t page = 0; page < pageCount; ++page) {
+			if (page % PAGES_PER_BLOCK != 0) {
+				createSector(&data [0], pageSize, page, generation);
+				status = bed_ftl_write(ftl, 2 * page, &data [0], 2);
+				ASSERT_EQ(BED_SUCCESS, status);
+			}
+		}
+	}
+
+	uncorrectableAddress = ~(bed_address) 0;
+	status = bed_ftl_read(ftl, 1, &data [0], 1);
+	EXPECT_EQ(BED_ERROR_ECC_UNCORRECTABLE, status);
+
+	// A sector write replaces the lost page
+	createSector(&data [0], sectorSize, 1, 4);
+	status = bed_ftl_write(ftl, 1, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_ftl_read(ftl, 1, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isSector(&data [0], sectorSize, 1, 4));
+
+	std::vector<uint8_t> blank(sectorSize, 0xff);
+	status = bed_ftl_read(ftl, 0, &data [0], 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(&blank [0], &data [0], sectorSize));
+
+	bed_ftl_destroy(ftl);
+	bed_nand_simulator_destroy(part);
+}
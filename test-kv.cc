@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-kv.h"
+#include "bed-nand.h"
+#include "bed-test.h"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 8;
+
+static const uint16_t PAGE_SIZE = 2048;
+
+static const uint32_t BLOCK_SIZE = 4 * PAGE_SIZE;
+
+static void createValue(uint8_t *value, size_t n, uint32_t key, uint32_t generation)
+{
+	for (size_t i = 0; i < n; ++i) {
+		value [i] = (uint8_t) (key + generation + i);
+	}
+}
+
+static bool isValue(const uint8_t *value, size_t n, uint32_t key, uint32_t generation)
+{
+	uint8_t expected [PAGE_SIZE];
+
+	createValue(expected, n, key, generation);
+
+	return memcmp(expected, value, n) == 0;
+}
+
+static size_t valueSize(uint32_t key)
+{
+	return 1 + (key * 97) % PAGE_SIZE;
+}
+
+TEST(BED, KV)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_kv_config config = { 0 };
+	bed_kv *kv;
+	status = bed_kv_create(part, &config, &kv);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	EXPECT_TRUE(kv == NULL);
+
+	config.max_keys = (BLOCK_COUNT - 1) * 4;
+	status = bed_kv_create(part, &config, &kv);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	config.max_keys = 10;
+	status = bed_kv_create(part, &config, &kv);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(PAGE_SIZE, bed_kv_max_value_size(kv));
+
+	uint8_t value [PAGE_SIZE + 1];
+	size_t n;
+	status = bed_kv_get(kv, 1, value, sizeof(value), &n);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, n);
+
+	status = bed_kv_put(kv, 1, value, sizeof(value));
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	for (uint32_t key = 0; key < 10; ++key) {
+		createValue(value, valueSize(key), key, 0);
+		status = bed_kv_put(kv, key * 1000, value, valueSize(key));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	// The index is full
+	status = bed_kv_put(kv, 12345, value, 1);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	// Overwrite and delete
+	createValue(value, 17, 3, 1);
+	status = bed_kv_put(kv, 3000, value, 17);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_kv_delete(kv, 4000);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_kv_delete(kv, 4000);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_kv_delete(kv, 54321);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_kv_get(kv, 4000, value, sizeof(value), &n);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	// Empty values and short buffers
+	status = bed_kv_put(kv, 5000, NULL, 0);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_kv_get(kv, 5000, value, sizeof(value), &n);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, n);
+
+	memset(value, 0, sizeof(value));
+	status = bed_kv_get(kv, 3000, value, 5, &n);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(17U, n);
+	EXPECT_TRUE(isValue(value, 5, 3, 1));
+	EXPECT_EQ(0, value [5]);
+
+	bed_kv_statistics statistics;
+	bed_kv_get_statistics(kv, &statistics);
+	EXPECT_EQ(9U, statistics.key_count);
+	EXPECT_EQ(1U, statistics.tombstone_count);
+	EXPECT_EQ(13U, statistics.page_writes);
+	EXPECT_EQ(0U, statistics.compacted_blocks);
+
+	// The index is rebuilt from the OOB areas
+	bed_kv_destroy(kv);
+	status = bed_kv_create(part, &config, &kv);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_kv_get_statistics(kv, &statistics);
+	EXPECT_EQ(9U, statistics.key_count);
+	EXPECT_EQ(1U, statistics.tombstone_count);
+	EXPECT_EQ(BLOCK_COUNT - 4, statistics.free_blocks);
+
+	for (uint32_t key = 0; key < 10; ++key) {
+		status = bed_kv_get(kv, key * 1000, value, sizeof(value), &n);
+
+		if (key == 4) {
+			EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+		} else if (key == 3) {
+			EXPECT_EQ(BED_SUCCESS, status);
+			EXPECT_EQ(17U, n);
+			EXPECT_TRUE(isValue(value, n, key, 1));
+		} else if (key == 5) {
+			EXPECT_EQ(BED_SUCCESS, status);
+			EXPECT_EQ(0U, n);
+		} else {
+			EXPECT_EQ(BED_SUCCESS, status);
+			EXPECT_EQ(valueSize(key), n);
+			EXPECT_TRUE(isValue(value, n, key, 0));
+		}
+	}
+
+	// A deleted key may get a value again
+	createValue(value, 3, 4, 2);
+	status = bed_kv_put(kv, 4000, value, 3);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_kv_get(kv, 4000, value, sizeof(value), &n);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(3U, n);
+	EXPECT_TRUE(isValue(value, n, 4, 2));
+
+	bed_kv_destroy(kv);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, KVCompaction)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, 5 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_kv_config config = { 16 };
+	bed_kv *kv;
+	status = bed_kv_create(part, &config, &kv);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint8_t value [PAGE_SIZE];
+	size_t n;
+
+	// Cold keys spread across the blocks and frequently updated hot keys
+	createValue(value, 100, 7, 0);
+	status = bed_kv_put(kv, 7, value, 100);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t generation = 0; generation < 50; ++generation) {
+		if (generation < 6) {
+			createValue(value, 20, 10 + generation, 0);
+			status = bed_kv_put(kv, 10 + generation, value, 20);
+			ASSERT_EQ(BED_SUCCESS, status);
+		} else if (generation < 9) {
+			status = bed_kv_delete(kv, 4 + generation);
+			ASSERT_EQ(BED_SUCCESS, status);
+		}
+
+		for (uint32_t key = 0; key < 4; ++key) {
+			createValue(value, valueSize(key), key, generation);
+			status = bed_kv_put(kv, key, value, valueSize(key));
+			ASSERT_EQ(BED_SUCCESS, status);
+		}
+
+		status = bed_kv_delete(kv, 4 + generation % 2);
+		ASSERT_EQ(BED_SUCCESS, status);
+		createValue(value, 10, 5, generation);
+		status = bed_kv_put(kv, 5 - generation % 2, value, 10);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_kv_statistics statistics;
+	bed_kv_get_statistics(kv, &statistics);
+	EXPECT_EQ(9U, statistics.key_count);
+	EXPECT_EQ(4U, statistics.tombstone_count);
+	EXPECT_GT(statistics.compacted_blocks, 0U);
+	EXPECT_GT(statistics.compaction_page_writes, 0U);
+	EXPECT_EQ(statistics.page_writes, 309 + statistics.compaction_page_writes);
+
+	// Tombstones are dropped once the blocks with older records are erased
+	for (uint32_t key = 13; key < 16; ++key) {
+		status = bed_kv_delete(kv, key);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	for (uint32_t generation = 50; generation < 100; ++generation) {
+		for (uint32_t key = 0; key < 4; ++key) {
+			createValue(value, valueSize(key), key, generation);
+			status = bed_kv_put(kv, key, value, valueSize(key));
+			ASSERT_EQ(BED_SUCCESS, status);
+		}
+	}
+
+	bed_kv_get_statistics(kv, &statistics);
+	EXPECT_EQ(6U, statistics.key_count);
+	EXPECT_GT(statistics.dropped_tombstones, 0U);
+	EXPECT_EQ(7U - statistics.dropped_tombstones, statistics.tombstone_count);
+
+	for (int pass = 0; pass < 2; ++pass) {
+		for (uint32_t key = 0; key < 4; ++key) {
+			status = bed_kv_get(kv, key, value, sizeof(value), &n);
+			EXPECT_EQ(BED_SUCCESS, status);
+			EXPECT_EQ(valueSize(key), n);
+			EXPECT_TRUE(isValue(value, n, key, 99));
+		}
+
+		status = bed_kv_get(kv, 4, value, sizeof(value), &n);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isValue(value, 10, 5, 49));
+		status = bed_kv_get(kv, 5, value, sizeof(value), &n);
+		EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+		status = bed_kv_get(kv, 7, value, sizeof(value), &n);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isValue(value, 100, 7, 0));
+
+		for (uint32_t key = 10; key < 16; ++key) {
+			status = bed_kv_get(kv, key, value, sizeof(value), &n);
+
+			EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+		}
+
+		bed_kv_destroy(kv);
+		status = bed_kv_create(part, &config, &kv);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_kv_destroy(kv);
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * Device which reports an uncorrectable ECC error for reads of one page.
+ */
+static bed_device uncorrectableDevice;
+
+static bed_read_method uncorrectableParentRead;
+
+static bed_address uncorrectableAddress;
+
+static bed_status readUncorrectable(bed_device *bed, bed_address addr, void *data, size_t n)
+{
+	bed_status status = (*uncorrectableParentRead)(bed, addr, data, n);
+
+	if (addr == uncorrectableAddress) {
+		status = BED_ERROR_ECC_UNCORRECTABLE;
+	}
+
+	return status;
+}
+
+TEST(BED, KVUncorrectable)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_partition uncorrectable = *part;
+	uncorrectableDevice = *part->bed;
+	uncorrectableParentRead = uncorrectableDevice.read;
+	uncorrectableDevice.read = readUncorrectable;
+	uncorrectable.bed = &uncorrectableDevice;
+
+	bed_kv_config config = { 24 };
+	bed_kv *kv;
+	status = bed_kv_create(&uncorrectable, &config, &kv);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint8_t value [PAGE_SIZE];
+	size_t n;
+
+	// The first record goes to the first page of the first block, the cold
+	// keys fill the next blocks
+	createValue(value, 100, 7, 0);
+	status = bed_kv_put(kv, 7, value, 100);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t key = 0; key < 3; ++key) {
+		createValue(value, valueSize(key), key, 0);
+		status = bed_kv_put(kv, key, value, valueSize(key));
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	for (uint32_t key = 8; key < 27; ++key) {
+		createValue(value, 100, key, 0);
+		status = bed_kv_put(kv, key, value, 100);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	uncorrectableAddress = 0;
+	status = bed_kv_get(kv, 7, value, sizeof(value), &n);
+	EXPECT_EQ(BED_ERROR_ECC_UNCORRECTABLE, status);
+
+	// Update hot keys until the first block with the least count of live
+	// records is compacted
+	bed_kv_statistics statistics;
+	uint32_t generation = 1;
+
+	do {
+		for (uint32_t key = 0; key < 4; ++key) {
+			createValue(value, valueSize(key), key, generation);
+			status = bed_kv_put(kv, key, value, valueSize(key));
+			ASSERT_EQ(BED_SUCCESS, status);
+		}
+
+		++generation;
+		bed_kv_get_statistics(kv, &statistics);
+	} while (statistics.compacted_blocks == 0 && generation < 100);
+
+	EXPECT_GT(statistics.compacted_blocks, 0U);
+
+	// The relocated record is lost and not laundered by a fresh ECC
+	uncorrectableAddress = ~(bed_address) 0;
+	status = bed_kv_get(kv, 7, value, sizeof(value), &n);
+	EXPECT_EQ(BED_ERROR_ECC_UNCORRECTABLE, status);
+
+	bed_kv_destroy(kv);
+
+	status = bed_kv_create(&uncorrectable, &config, &kv);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_kv_get(kv, 7, value, sizeof(value), &n);
+	EXPECT_EQ(BED_ERROR_ECC_UNCORRECTABLE, status);
+
+	for (uint32_t key = 0; key < 4; ++key) {
+		status = bed_kv_get(kv, key, value, sizeof(value), &n);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isValue(value, n, key, generation - 1));
+	}
+
+	for (uint32_t key = 8; key < 27; ++key) {
+		status = bed_kv_get(kv, key, value, sizeof(value), &n);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isValue(value, n, key, 0));
+	}
+
+	createValue(value, 100, 7, 1);
+	status = bed_kv_put(kv, 7, value, 100);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_kv_get(kv, 7, value, sizeof(value), &n);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(100U, n);
+	EXPECT_TRUE(isValue(value, 100, 7, 1));
+
+	bed_kv_destroy(kv);
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * The keys are written, deleted and written again in ascending order.  After
+ * a power cut the keys must reflect a prefix of these operations.
+ */
+class PowerCutKV {
+	public:
+		static const uint32_t KEY_COUNT = 10;
+
+		PowerCutKV()
+			: mCutPoints(0), mKV(NULL)
+		{
+			mConfig.max_keys = KEY_COUNT;
+		}
+
+		static bed_status prepare(void *arg, const bed_partition *part)
+		{
+			PowerCutKV *self = static_cast<PowerCutKV *>(arg);
+			bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+
+			if (status == BED_SUCCESS) {
+				status = self->updateAll(part, 0);
+			}
+
+			return status;
+		}
+
+		static bed_status run(void *arg, const bed_partition *part)
+		{
+			PowerCutKV *self = static_cast<PowerCutKV *>(arg);
+			bed_status status = BED_SUCCESS;
+
+			for (uint32_t phase = 1; phase < PHASE_COUNT && status == BED_SUCCESS; ++phase) {
+				status = self->updateAll(part, phase);
+			}
+
+			return status;
+		}
+
+		static bed_status recover(void *arg, const bed_partition *part)
+		{
+			PowerCutKV *self = static_cast<PowerCutKV *>(arg);
+
+			return bed_kv_create(part, &self->mConfig, &self->mKV);
+		}
+
+		static bed_status check(void *arg, const bed_partition *part, size_t *lost)
+		{
+			PowerCutKV *self = static_cast<PowerCutKV *>(arg);
+			bed_status status = BED_ERROR_SYSTEM;
+
+			(void) part;
+			*lost = 0;
+
+			if (self->mKV != NULL) {
+				uint32_t first = 0;
+				uint32_t previous = 0;
+
+				status = BED_SUCCESS;
+
+				for (uint32_t key = 0; key < KEY_COUNT; ++key) {
+					uint32_t phase = self->phaseOf(key);
+
+					if (key == 0) {
+						first = phase;
+						previous = phase;
+					}
+
+					if (phase == PHASE_COUNT || phase > previous || phase + 1 < first) {
+						*lost += valueSize(key);
+					}
+
+					previous = phase;
+				}
+
+				bed_kv_destroy(self->mKV);
+				self->mKV = NULL;
+			}
+
+			return status;
+		}
+
+		static void report(void *arg, const bed_test_power_cut_result *result)
+		{
+			PowerCutKV *self = static_cast<PowerCutKV *>(arg);
+
+			if (result->operation == 0) {
+				EXPECT_EQ(BED_SUCCESS, result->run_status);
+				self->mCutPoints = result->operation_count;
+			}
+
+			EXPECT_EQ(BED_SUCCESS, result->recover_status);
+			EXPECT_EQ(BED_SUCCESS, result->check_status);
+			EXPECT_EQ(0U, result->lost);
+		}
+
+		uint32_t mCutPoints;
+
+	private:
+		/*
+		 * Phase 2 deletes the keys, the other phases write a generation.
+		 */
+		static const uint32_t PHASE_COUNT = 5;
+
+		static const uint32_t DELETE_PHASE = 2;
+
+		uint32_t phaseOf(uint32_t key)
+		{
+			uint8_t value [PAGE_SIZE];
+			size_t n;
+			bed_status status = bed_kv_get(mKV, key, value, sizeof(value), &n);
+			uint32_t phase = PHASE_COUNT;
+
+			if (status == BED_ERROR_UNSATISFIED) {
+				phase = DELETE_PHASE;
+			} else if (status == BED_SUCCESS && n == valueSize(key)) {
+				phase = value [0] >= key ? value [0] - key : PHASE_COUNT;
+
+				if (phase == DELETE_PHASE || !isValue(value, n, key, phase)) {
+					phase = PHASE_COUNT;
+				}
+			}
+
+			return phase;
+		}
+
+		bed_status updateAll(const bed_partition *part, uint32_t phase)
+		{
+			bed_kv *kv;
+			bed_status status = bed_kv_create(part, &mConfig, &kv);
+
+			if (status == BED_SUCCESS) {
+				uint8_t value [PAGE_SIZE];
+
+				for (uint32_t key = 0; key < KEY_COUNT && status == BED_SUCCESS; ++key) {
+					if (phase == DELETE_PHASE) {
+						status = bed_kv_delete(kv, key);
+					} else {
+						createValue(value, valueSize(key), key, phase);
+						status = bed_kv_put(kv, key, value, valueSize(key));
+					}
+				}
+
+				bed_kv_destroy(kv);
+			}
+
+			return status;
+		}
+
+		bed_kv_config mConfig;
+
+		bed_kv *mKV;
+};
+
+TEST(BED, PowerCutKV)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	PowerCutKV workload;
+	const bed_test_power_cut_workload w = {
+		PowerCutKV::prepare,
+		PowerCutKV::run,
+		PowerCutKV::recover,
+		PowerCutKV::check,
+		&workload
+	};
+
+	uint32_t cutPoints = bed_test_power_cut(part, &w, 50, PowerCutKV::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+	EXPECT_GT(cutPoints, 40U);
+
+	bed_nand_simulator_destroy(part);
+}
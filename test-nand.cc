@@ -13,11 +13,18 @@
  */
 
 #include "bed-nand.h"
+#include "bed-test.h"
 
 #include <gtest/gtest.h>
 
 #include <stdio.h>
 
+#ifndef __rtems__
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif /* __rtems__ */
+
 static const size_t CHIP_COUNT = 2;
 
 static const size_t BLOCK_COUNT = 2;
@@ -285,6 +292,311 @@ TEST(BED, WriteAndReadWithSkip)
 	bed_nand_simulator_destroy(part);
 }
 
+static bool stopAfterFirstBlock(void *arg, bed_address position, bed_address size)
+{
+	int *calls = static_cast<int *>(arg);
+
+	++(*calls);
+
+	return position == BLOCK_SIZE;
+}
+
+TEST(BED, LongRunningOperationsWithCursor)
+{
+	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	int calls = 0;
+	bed_cursor cursor;
+	bed_cursor_initialize(&cursor, stopAfterFirstBlock, &calls);
+	bed_status status = bed_erase_all_with_cursor(part, BED_ERASE_NORMAL, &cursor);
+	EXPECT_EQ(BED_ERROR_STOPPED, status);
+	EXPECT_EQ(BLOCK_SIZE, cursor.position);
+	EXPECT_EQ(1, calls);
+
+	status = bed_erase_all_with_cursor(part, BED_ERASE_NORMAL, &cursor);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(part->size, cursor.position);
+	EXPECT_EQ(CHIP_COUNT * BLOCK_COUNT, (size_t) calls);
+
+	uint32_t data [CHIP_SIZE / sizeof(uint32_t)];
+	uint8_t pageBuffer [PAGE_SIZE];
+	const size_t n = 2 * BLOCK_SIZE + PAGE_SIZE;
+	createDataWithSize(data, n, 0);
+	calls = 0;
+	bed_cursor_initialize(&cursor, stopAfterFirstBlock, &calls);
+	status = bed_write_with_skip_with_cursor(part, data, n, pageBuffer, &cursor);
+	EXPECT_EQ(BED_ERROR_STOPPED, status);
+	EXPECT_EQ(BLOCK_SIZE, cursor.position);
+	EXPECT_EQ(BLOCK_SIZE, cursor.offset);
+
+	status = bed_write_with_skip_with_cursor(part, data, n, pageBuffer, &cursor);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(3 * BLOCK_SIZE, cursor.position);
+	EXPECT_EQ(n, cursor.offset);
+
+	ReadProcess readProcess(data, n);
+	uint8_t oobBuffer [OOB_SIZE];
+	calls = 0;
+	bed_cursor_initialize(&cursor, stopAfterFirstBlock, &calls);
+	status = bed_read_with_skip_with_cursor(
+		part,
+		ReadProcess::process,
+		&readProcess,
+		pageBuffer,
+		oobBuffer,
+		&cursor
+	);
+	EXPECT_EQ(BED_ERROR_STOPPED, status);
+	EXPECT_EQ(BLOCK_SIZE, cursor.position);
+	EXPECT_FALSE(readProcess.complete());
+
+	status = bed_read_with_skip_with_cursor(
+		part,
+		ReadProcess::process,
+		&readProcess,
+		pageBuffer,
+		oobBuffer,
+		&cursor
+	);
+	EXPECT_EQ(BED_ERROR_STOPPED, status);
+	EXPECT_TRUE(readProcess.complete());
+
+	cursor.position = PAGE_SIZE;
+	status = bed_erase_all_with_cursor(part, BED_ERASE_NORMAL, &cursor);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_read_all_with_cursor(part, BED_OOB_MODE_AUTO, NULL, NULL, pageBuffer, oobBuffer, &cursor);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	bed_nand_simulator_destroy(part);
+}
+
+class LoadProcess {
+	public:
+		LoadProcess(uint8_t *dest, size_t stopAfter)
+			: mDest(dest), mStopAfter(stopAfter), mCalls(0), mLoaded(0), mOOBSize(0), mInPlace(true)
+		{
+			// Nothing to do
+		}
+
+		static bool process(
+			void *arg,
+			bed_address address,
+			void *data,
+			size_t n,
+			void *oob,
+			size_t m
+		)
+		{
+			LoadProcess *self = static_cast<LoadProcess *>(arg);
+
+			self->mInPlace = self->mInPlace && data == self->mDest + self->mLoaded;
+			self->mLoaded += n;
+			self->mOOBSize = oob != NULL ? m : 0;
+			++self->mCalls;
+
+			return self->mCalls == self->mStopAfter;
+		}
+
+		uint8_t *const mDest;
+
+		const size_t mStopAfter;
+
+		size_t mCalls;
+
+		size_t mLoaded;
+
+		size_t mOOBSize;
+
+		bool mInPlace;
+};
+
+TEST(BED, LoadWithSkip)
+{
+	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	uint32_t data [CHIP_SIZE / sizeof(uint32_t)];
+	const size_t n = 2 * BLOCK_SIZE + 100;
+	createDataWithSize(data, n, 0);
+	uint8_t pageBuffer [PAGE_SIZE];
+	status = bed_write_with_skip(part, data, n, pageBuffer);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	uint8_t dest [CHIP_SIZE + 1];
+	memset(dest, 0, sizeof(dest));
+	LoadProcess loadProcess(dest, 0);
+	size_t loaded;
+	status = bed_load_with_skip(part, dest, n, &loaded, LoadProcess::process, &loadProcess, NULL);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(n, loaded);
+	EXPECT_EQ(0, memcmp(data, dest, n));
+	EXPECT_EQ(0, dest [n]);
+	EXPECT_EQ(2 * PAGES_PER_BLOCK + 1, loadProcess.mCalls);
+	EXPECT_EQ(n, loadProcess.mLoaded);
+	EXPECT_EQ(0U, loadProcess.mOOBSize);
+	EXPECT_TRUE(loadProcess.mInPlace);
+
+	// The valid blocks limit the load
+	status = bed_load_with_skip(part, dest, sizeof(dest), &loaded, NULL, NULL, NULL);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(CHIP_SIZE - BLOCK_SIZE, loaded);
+	EXPECT_EQ(0, memcmp(data, dest, n));
+
+	// The OOB areas are delivered on demand
+	uint8_t oobBuffer [OOB_SIZE];
+	LoadProcess stopProcess(dest, 2);
+	status = bed_load_with_skip(part, dest, sizeof(dest), &loaded, LoadProcess::process, &stopProcess, oobBuffer);
+	EXPECT_EQ(BED_ERROR_STOPPED, status);
+	EXPECT_EQ(2 * PAGE_SIZE, loaded);
+	EXPECT_EQ(OOB_FREE_SIZE, stopProcess.mOOBSize);
+
+	LoadProcess partialProcess(dest, 0);
+	status = bed_load_with_skip(part, dest, 100, &loaded, LoadProcess::process, &partialProcess, oobBuffer);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(100U, loaded);
+	EXPECT_EQ(1U, partialProcess.mCalls);
+	EXPECT_EQ(OOB_FREE_SIZE, partialProcess.mOOBSize);
+	EXPECT_EQ(0, memcmp(data, dest, 100));
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, ReadPartial)
+{
+	const uint16_t pageSize = 2048;
+	bed_partition *part = bed_nand_simulator_create(1, 4, 4 * pageSize, pageSize);
+	ASSERT_TRUE(part != NULL);
+
+	uint8_t data [pageSize];
+	uint8_t in [pageSize];
+	for (size_t i = 0; i < sizeof(data); ++i) {
+		data [i] = (uint8_t) (i * 7 + 1);
+	}
+
+	bed_status status = bed_erase_all(part, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_write(part, 0, data, sizeof(data));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_read_partial(part, 0, 300, in, 16);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data + 300, in, 16));
+
+	status = bed_read_partial(part, 0, 250, in, 20);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data + 250, in, 20));
+
+	status = bed_read_partial(part, 0, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+
+	// Flip a bit in the second ECC chunk without an ECC update
+	uint8_t flipped [pageSize];
+	memset(flipped, 0xff, sizeof(flipped));
+	flipped [300] = (uint8_t) (data [300] & (data [300] - 1));
+	bed_oob_request oob = { BED_OOB_MODE_BLOODY, 0, 0, NULL };
+	status = bed_write_oob(part, 0, flipped, sizeof(flipped), &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_read_partial(part, 0, 0, in, 16);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, 16));
+
+	memset(in, 0, sizeof(in));
+	status = bed_read_partial(part, 0, 296, in, 16);
+	EXPECT_EQ(BED_ERROR_ECC_FIXED, status);
+	EXPECT_EQ(0, memcmp(data + 296, in, 16));
+
+	status = bed_read_partial(part, 0, pageSize - 8, in, 16);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_read_partial(part, 1, 0, in, 16);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	bed_nand_simulator_destroy(part);
+
+	// Small pages have no RANDOM DATA OUTPUT
+	part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	status = bed_erase_all(part, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_write(part, PAGE_SIZE, data, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read_partial(part, PAGE_SIZE, 100, in, 16);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data + 100, in, 16));
+
+	bed_nand_simulator_destroy(part);
+}
+
+static void writeOOBOnly(uint16_t pageSize)
+{
+	bed_partition *part = bed_nand_simulator_create(1, 4, 4 * pageSize, pageSize);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	uint8_t flags [6] = { 1, 2, 3, 4, 5, 6 };
+	uint8_t in [6];
+	bed_oob_request oob = { BED_OOB_MODE_AUTO, 0, 4, flags };
+	status = bed_write_oob(part, pageSize, NULL, 0, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	oob.offset = 4;
+	oob.size = 2;
+	oob.data = flags + 4;
+	status = bed_write_oob(part, pageSize, NULL, 0, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	oob.offset = 0;
+	oob.size = sizeof(in);
+	oob.data = in;
+	status = bed_read_oob(part, pageSize, NULL, 0, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(flags, in, sizeof(in)));
+
+	uint8_t data [2048];
+	status = bed_read_oob(part, pageSize, data, pageSize, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(flags, in, sizeof(in)));
+
+	for (uint16_t i = 0; i < pageSize; ++i) {
+		EXPECT_EQ(0xff, data [i]);
+	}
+
+	oob.size = 0;
+	status = bed_write_oob(part, 0, NULL, 0, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	oob.size = sizeof(in);
+	status = bed_write_oob(part, 0, data, 16, &oob);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	// The OOB-only program needs a page address within the partition
+	oob.data = flags;
+	status = bed_write_oob(part, pageSize + 1, NULL, 0, &oob);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	status = bed_write_oob(part, bed_size(part), NULL, 0, &oob);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, WriteOOBOnly)
+{
+	writeOOBOnly(512);
+	writeOOBOnly(2048);
+}
+
 TEST(BED, PrintBadBlocks)
 {
 	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
@@ -321,3 +633,831 @@ TEST(BED, NANDDevice)
 		++info;
 	}
 }
+
+TEST(BED, NANDSimulatorPowerCut)
+{
+	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	uint32_t data [PAGE_SIZE / sizeof(uint32_t)];
+	createData(data, 0);
+
+	bed_nand_simulator_set_power_cut(part, 2, 50);
+
+	bed_status status = bed_write(part, address(0, 0, 0), data, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_FALSE(bed_nand_simulator_is_powered_off(part));
+
+	status = bed_write(part, address(0, 0, 1), data, PAGE_SIZE);
+	EXPECT_EQ(BED_ERROR_WRITE, status);
+	EXPECT_TRUE(bed_nand_simulator_is_powered_off(part));
+
+	status = bed_erase(part, address(0, 0, 0), BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_ERROR_ERASE, status);
+
+	bed_nand_simulator_power_on(part);
+	EXPECT_FALSE(bed_nand_simulator_is_powered_off(part));
+
+	uint32_t in [PAGE_SIZE / sizeof(uint32_t)];
+	status = bed_read(part, address(0, 0, 0), in, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, PAGE_SIZE));
+
+	status = bed_read(part, address(0, 0, 1), in, PAGE_SIZE);
+	EXPECT_EQ(0, memcmp(data, in, PAGE_SIZE / 2));
+	EXPECT_NE(0, memcmp(data, in, PAGE_SIZE));
+
+	bed_nand_simulator_set_power_cut(part, 1, 50);
+	status = bed_erase(part, address(0, 0, 0), BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_ERROR_ERASE, status);
+	bed_nand_simulator_power_on(part);
+
+	status = bed_read(part, address(0, 0, 0), in, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0xffffffff, in [0]);
+
+	status = bed_read(part, address(0, 0, 1), in, PAGE_SIZE);
+	EXPECT_EQ(0, memcmp(data, in, PAGE_SIZE / 2));
+
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * The power cut sweeps cover bed_write_with_skip() and bed_erase_all().  A
+ * YAFFS write workload is missing, since the test application does not link
+ * the YAFFS library and the YAFFS glue cannot be built on the host.
+ */
+class PowerCutWriteWithSkip {
+	public:
+		PowerCutWriteWithSkip()
+			: mCutPoints(0), mLossCount(0)
+		{
+			createDataWithSize(mData, CHIP_SIZE, 0);
+		}
+
+		static bed_status prepare(void *arg, const bed_partition *part)
+		{
+			return bed_erase_all(part, BED_ERASE_FORCE);
+		}
+
+		static bed_status run(void *arg, const bed_partition *part)
+		{
+			PowerCutWriteWithSkip *self = static_cast<PowerCutWriteWithSkip *>(arg);
+
+			return bed_write_with_skip(part, self->mData, sizeof(self->mData), self->mPageBuffer);
+		}
+
+		static bed_status check(void *arg, const bed_partition *part, size_t *lost)
+		{
+			PowerCutWriteWithSkip *self = static_cast<PowerCutWriteWithSkip *>(arg);
+			ReadProcess readProcess(self->mData, sizeof(self->mData));
+			uint8_t oobBuffer [OOB_SIZE];
+
+			bed_status status = bed_read_with_skip(
+				part,
+				ReadProcess::process,
+				&readProcess,
+				self->mPageBuffer,
+				oobBuffer
+			);
+			*lost = status == BED_SUCCESS && readProcess.complete() ?
+				0 : sizeof(self->mData);
+
+			return status;
+		}
+
+		static void report(void *arg, const bed_test_power_cut_result *result)
+		{
+			PowerCutWriteWithSkip *self = static_cast<PowerCutWriteWithSkip *>(arg);
+
+			if (result->operation == 0) {
+				EXPECT_EQ(BED_SUCCESS, result->run_status);
+				EXPECT_EQ(BED_SUCCESS, result->check_status);
+				EXPECT_EQ(0U, result->lost);
+				self->mCutPoints = result->operation_count;
+			} else {
+				EXPECT_LE(result->operation, result->operation_count);
+				self->mLossCount += result->lost != 0;
+			}
+		}
+
+		uint32_t mCutPoints;
+
+		uint32_t mLossCount;
+
+	private:
+		uint32_t mData [CHIP_SIZE / sizeof(uint32_t)];
+
+		uint8_t mPageBuffer [PAGE_SIZE];
+};
+
+TEST(BED, PowerCutWriteWithSkip)
+{
+	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	PowerCutWriteWithSkip workload;
+	const bed_test_power_cut_workload w = {
+		PowerCutWriteWithSkip::prepare,
+		PowerCutWriteWithSkip::run,
+		NULL,
+		PowerCutWriteWithSkip::check,
+		&workload
+	};
+
+	uint32_t cutPoints = bed_test_power_cut(part, &w, 50, PowerCutWriteWithSkip::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+	EXPECT_EQ(CHIP_COUNT * BLOCK_COUNT * (1 + PAGES_PER_BLOCK), cutPoints);
+	EXPECT_EQ(cutPoints, workload.mLossCount);
+
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * Erases all blocks of a fully written partition.  After a power cut the
+ * erased blocks must be a prefix of the valid blocks followed by at most one
+ * partially erased block.
+ */
+class PowerCutEraseAll {
+	public:
+		PowerCutEraseAll()
+			: mCutPoints(0), mTornCount(0)
+		{
+			createDataWithSize(mData, CHIP_SIZE, 0);
+		}
+
+		static bed_status prepare(void *arg, const bed_partition *part)
+		{
+			PowerCutEraseAll *self = static_cast<PowerCutEraseAll *>(arg);
+			bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+
+			for (size_t page = 0; status == BED_SUCCESS && page < CHIP_SIZE / PAGE_SIZE; ++page) {
+				status = bed_write(part, page * PAGE_SIZE, self->mData + page * PAGE_SIZE / sizeof(uint32_t), PAGE_SIZE);
+			}
+
+			if (status == BED_SUCCESS) {
+				status = bed_mark_block_bad(part, address(0, 1, 0));
+			}
+
+			return status;
+		}
+
+		static bed_status run(void *arg, const bed_partition *part)
+		{
+			return bed_erase_all(part, BED_ERASE_NORMAL);
+		}
+
+		static bed_status check(void *arg, const bed_partition *part, size_t *lost)
+		{
+			PowerCutEraseAll *self = static_cast<PowerCutEraseAll *>(arg);
+			bed_status status = BED_SUCCESS;
+			bool erased = true;
+
+			*lost = 0;
+
+			for (size_t block = 0; block < CHIP_COUNT * BLOCK_COUNT; ++block) {
+				bed_address addr = block * BLOCK_SIZE;
+
+				if (bed_is_block_valid(part, addr) != BED_SUCCESS) {
+					continue;
+				}
+
+				uint8_t data [BLOCK_SIZE];
+				bed_status read_status = BED_SUCCESS;
+
+				for (size_t page = 0; read_status == BED_SUCCESS && page < PAGES_PER_BLOCK; ++page) {
+					read_status = bed_read(part, addr + page * PAGE_SIZE, data + page * PAGE_SIZE, PAGE_SIZE);
+				}
+
+				uint8_t erasedData [BLOCK_SIZE];
+				memset(erasedData, 0xff, BLOCK_SIZE);
+
+				if (read_status == BED_SUCCESS && memcmp(data, erasedData, BLOCK_SIZE) == 0) {
+					if (!erased) {
+						status = BED_ERROR_UNSATISFIED;
+					}
+				} else if (read_status == BED_SUCCESS && memcmp(data, reinterpret_cast<uint8_t *>(self->mData) + addr, BLOCK_SIZE) == 0) {
+					erased = false;
+				} else {
+					if (!erased) {
+						status = BED_ERROR_UNSATISFIED;
+					}
+
+					erased = false;
+					*lost += BLOCK_SIZE;
+				}
+			}
+
+			return status;
+		}
+
+		static void report(void *arg, const bed_test_power_cut_result *result)
+		{
+			PowerCutEraseAll *self = static_cast<PowerCutEraseAll *>(arg);
+
+			EXPECT_EQ(BED_SUCCESS, result->check_status);
+
+			if (result->operation == 0) {
+				EXPECT_EQ(BED_SUCCESS, result->run_status);
+				EXPECT_EQ(0U, result->lost);
+				self->mCutPoints = result->operation_count;
+			} else {
+				EXPECT_NE(BED_SUCCESS, result->run_status);
+				EXPECT_LE(result->lost, BLOCK_SIZE);
+				self->mTornCount += result->lost != 0;
+			}
+		}
+
+		uint32_t mCutPoints;
+
+		uint32_t mTornCount;
+
+	private:
+		uint32_t mData [CHIP_SIZE / sizeof(uint32_t)];
+};
+
+TEST(BED, PowerCutEraseAll)
+{
+	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	PowerCutEraseAll workload;
+	const bed_test_power_cut_workload w = {
+		PowerCutEraseAll::prepare,
+		PowerCutEraseAll::run,
+		NULL,
+		PowerCutEraseAll::check,
+		&workload
+	};
+
+	// The bad block is not erased
+	uint32_t cutPoints = bed_test_power_cut(part, &w, 50, PowerCutEraseAll::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+	EXPECT_EQ(CHIP_COUNT * BLOCK_COUNT - 1, cutPoints);
+	EXPECT_EQ(cutPoints, workload.mTornCount);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, NANDSimulatorSnapshot)
+{
+	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	uint32_t data [PAGE_SIZE / sizeof(uint32_t)];
+	createData(data, 0);
+
+	bed_status status = bed_write(part, address(1, 0, 1), data, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, address(0, 1, 0));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_nand_simulator_image *image = bed_nand_simulator_snapshot(part);
+	ASSERT_TRUE(image != NULL);
+
+	status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(checkIfErased(part));
+
+	bed_partition *fork = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(fork != NULL);
+
+	status = bed_nand_simulator_restore(fork, image);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_nand_simulator_restore(part, image);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_nand_simulator_image_destroy(image);
+
+	uint32_t in [PAGE_SIZE / sizeof(uint32_t)];
+	status = bed_read(part, address(1, 0, 1), in, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, PAGE_SIZE));
+
+	status = bed_is_block_valid(part, address(0, 1, 0));
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+
+	status = bed_erase(part, address(1, 0, 0), BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_read(fork, address(1, 0, 1), in, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, PAGE_SIZE));
+
+	bed_nand_simulator_destroy(part);
+
+	bed_partition *other = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, 2 * BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(other != NULL);
+
+	image = bed_nand_simulator_snapshot(other);
+	ASSERT_TRUE(image != NULL);
+
+	status = bed_nand_simulator_restore(fork, image);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	bed_nand_simulator_image_destroy(image);
+	bed_nand_simulator_destroy(other);
+	bed_nand_simulator_destroy(fork);
+}
+
+static void testProfile(const bed_nand_simulator_profile *profile, uint16_t oob_free_size)
+{
+	SCOPED_TRACE(profile->name);
+
+	bed_partition *part = bed_nand_simulator_create_with_profile(profile, 1);
+	ASSERT_TRUE(part != NULL);
+
+	const bed_device *bed = part->bed;
+	EXPECT_EQ(profile->page_size, bed->page_size);
+	EXPECT_EQ(profile->oob_size, bed->oob_size);
+	EXPECT_EQ(oob_free_size, bed->oob_free_size);
+	EXPECT_EQ(profile->pages_per_block, bed->pages_per_block);
+	EXPECT_EQ(profile->blocks_per_lun * profile->lun_count, bed->blocks_per_chip);
+
+	uint32_t data [BED_NAND_MAX_PAGE_SIZE / sizeof(uint32_t)];
+	createDataWithSize(data, bed->page_size, 0);
+
+	uint8_t oobData [OOB_FREE_SIZE];
+	createOOB(oobData, 0);
+
+	bed_oob_request oob = {
+		BED_OOB_MODE_AUTO,
+		0,
+		OOB_FREE_SIZE,
+		oobData
+	};
+
+	bed_address block = part->size - bed->block_size;
+	bed_address addr = block + bed->page_size;
+	uint64_t busy_time = bed_nand_simulator_busy_time(part);
+
+	bed_status status = bed_erase(part, block, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_write_oob(part, addr, data, bed->page_size, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(busy_time + profile->t_bers + profile->t_prog, bed_nand_simulator_busy_time(part));
+
+	uint32_t in [BED_NAND_MAX_PAGE_SIZE / sizeof(uint32_t)];
+	uint8_t oobIn [OOB_FREE_SIZE];
+	oob.data = oobIn;
+
+	status = bed_read_oob(part, addr, in, bed->page_size, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, bed->page_size));
+	EXPECT_EQ(0, memcmp(oobData, oobIn, OOB_FREE_SIZE));
+
+	status = bed_is_block_valid(part, block);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, block);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_is_block_valid(part, block);
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, NANDSimulatorProfiles)
+{
+	testProfile(&bed_nand_simulator_mt29f2g08aacwp, 38);
+	testProfile(&bed_nand_simulator_mt29f2g16aacwp, 38);
+	testProfile(&bed_nand_simulator_mt29f4g08abada, 16);
+	testProfile(&bed_nand_simulator_mt29f8g08adada, 16);
+	testProfile(&bed_nand_simulator_mt29f16g08cbaca, 78);
+	testProfile(&bed_nand_simulator_k9f1208u0c, 8);
+}
+
+TEST(BED, NANDSimulatorRegisters)
+{
+	bed_partition *part = bed_nand_simulator_create_with_profile(&bed_nand_simulator_mt29f2g08aacwp, 1);
+	ASSERT_TRUE(part != NULL);
+
+	bed_device *bed = part->bed;
+	bed_nand_context *nand = static_cast<bed_nand_context *>(bed->context);
+	const size_t page_size = 2048;
+	const uint32_t pages_per_block = 64;
+	uint32_t data [3][page_size / sizeof(uint32_t)];
+	uint32_t in [page_size / sizeof(uint32_t)];
+
+	for (uint32_t page = 0; page < 3; ++page) {
+		createDataWithSize(data [page], page_size, page << 16);
+		bed_status status = bed_write(part, page * page_size, data [page], page_size);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_select_chip(bed, 0);
+
+	/* Cache read */
+	(*nand->command)(bed, BED_NAND_CMD_READ_PAGE, 0, 0);
+	for (uint32_t page = 0; page < 3; ++page) {
+		(*nand->command)(
+			bed,
+			page < 2 ? BED_NAND_CMD_READ_PAGE_CACHE_SEQUENTIAL : BED_NAND_CMD_READ_PAGE_CACHE_LAST,
+			0,
+			0
+		);
+		(*nand->read_buffer)(bed, reinterpret_cast<uint8_t *>(in), page_size);
+		EXPECT_EQ(0, memcmp(data [page], in, page_size));
+	}
+
+	/* Random data output */
+	(*nand->command)(bed, BED_NAND_CMD_READ_PAGE, 1, 0);
+	(*nand->command)(bed, BED_NAND_CMD_RANDOM_DATA_READ, 0, 400);
+	(*nand->command)(bed, BED_NAND_CMD_RANDOM_DATA_READ_2, 0, 0);
+	(*nand->read_buffer)(bed, reinterpret_cast<uint8_t *>(in), 8);
+	EXPECT_EQ(0, memcmp(&data [1][100], in, 8));
+
+	/* Copyback with random data input */
+	uint32_t value = 0xdeadbeef;
+	(*nand->command)(bed, BED_NAND_CMD_READ_FOR_INTERNAL_DATA_MOVE, 2, 0);
+	(*nand->command)(bed, BED_NAND_CMD_READ_FOR_INTERNAL_DATA_MOVE_2, 0, 0);
+	(*nand->command)(bed, BED_NAND_CMD_PROGRAM_FOR_INTERNAL_DATA_MOVE, pages_per_block, 0);
+	(*nand->command)(bed, BED_NAND_CMD_RANDOM_DATA_INPUT, 0, 16);
+	(*nand->write_buffer)(bed, reinterpret_cast<const uint8_t *>(&value), sizeof(value));
+	(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE_2, 0, 0);
+	EXPECT_EQ(BED_SUCCESS, bed_nand_check_status(bed, BED_ERROR_WRITE));
+
+	bed_oob_request oob = { BED_OOB_MODE_BLOODY, 0, 0, NULL };
+	bed_status status = bed_read_oob(part, pages_per_block * page_size, in, page_size, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+	data [2][4] = value;
+	EXPECT_EQ(0, memcmp(data [2], in, page_size));
+
+	/* Cache program */
+	(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE_CACHE, pages_per_block + 1, 0);
+	(*nand->write_buffer)(bed, reinterpret_cast<const uint8_t *>(data [0]), page_size);
+	(*nand->command)(bed, BED_NAND_CMD_PROGRAM_PAGE_CACHE_2, 0, 0);
+	EXPECT_EQ(BED_SUCCESS, bed_nand_check_status(bed, BED_ERROR_WRITE));
+
+	status = bed_read_oob(part, (pages_per_block + 1) * page_size, in, page_size, &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data [0], in, page_size));
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, NANDSimulatorThreads)
+{
+	bed_partition *part = bed_nand_simulator_create_with_profile(&bed_nand_simulator_mt29f4g08abada, 2);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_nand_simulator_start_threads(part, 0);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_device *bed = part->bed;
+	bed_nand_context *nand = static_cast<bed_nand_context *>(bed->context);
+	const size_t page_size = bed->page_size;
+	const bed_address chip_size = part->size / 2;
+	uint32_t data [2048 / sizeof(uint32_t)];
+	uint32_t in [2048 / sizeof(uint32_t)];
+
+	for (uint32_t page = 0; page < 16; ++page) {
+		bed_address addr = (page % 2) * chip_size + (page / 2) * page_size;
+
+		createDataWithSize(data, page_size, page << 16);
+		status = bed_write(part, addr, data, page_size);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	for (uint32_t page = 0; page < 16; ++page) {
+		bed_address addr = (page % 2) * chip_size + (page / 2) * page_size;
+
+		createDataWithSize(data, page_size, page << 16);
+		status = bed_read(part, addr, in, page_size);
+		ASSERT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(0, memcmp(data, in, page_size));
+	}
+
+	bed_select_chip(bed, 1);
+
+	(*nand->command)(bed, BED_NAND_CMD_READ_PAGE, 0, 0);
+	for (uint32_t page = 0; page < 8; ++page) {
+		(*nand->command)(
+			bed,
+			page < 7 ? BED_NAND_CMD_READ_PAGE_CACHE_SEQUENTIAL : BED_NAND_CMD_READ_PAGE_CACHE_LAST,
+			0,
+			0
+		);
+		(*nand->read_buffer)(bed, reinterpret_cast<uint8_t *>(in), page_size);
+		createDataWithSize(data, page_size, (2 * page + 1) << 16);
+		EXPECT_EQ(0, memcmp(data, in, page_size));
+	}
+
+	bed_nand_simulator_stop_threads(part);
+
+	status = bed_nand_simulator_start_threads(part, 100);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_select_chip(bed, 0);
+	(*nand->command)(bed, BED_NAND_CMD_ERASE_BLOCK, 0, 0);
+	(*nand->command)(bed, BED_NAND_CMD_ERASE_BLOCK_2, 0, 0);
+	EXPECT_FALSE((*nand->is_ready)(bed));
+	EXPECT_EQ(BED_SUCCESS, bed_nand_check_status(bed, BED_ERROR_ERASE));
+	EXPECT_TRUE((*nand->is_ready)(bed));
+
+	bed_nand_simulator_destroy(part);
+}
+
+#ifndef __rtems__
+struct PageAccess {
+	bed_partition *part;
+	bed_address begin;
+	uint32_t page_count;
+	bool write;
+	bed_status status;
+};
+
+static void *accessPages(void *arg)
+{
+	PageAccess *access = static_cast<PageAccess *>(arg);
+	const size_t page_size = access->part->bed->page_size;
+	uint32_t data [2048 / sizeof(uint32_t)];
+	uint32_t in [2048 / sizeof(uint32_t)];
+
+	access->status = BED_SUCCESS;
+
+	for (uint32_t page = 0; page < access->page_count && access->status == BED_SUCCESS; ++page) {
+		bed_address addr = access->begin + page * page_size;
+
+		createDataWithSize(data, page_size, (uint32_t) addr);
+
+		if (access->write) {
+			access->status = bed_write(access->part, addr, data, page_size);
+		}
+
+		if (access->status == BED_SUCCESS) {
+			access->status = bed_read(access->part, addr, in, page_size);
+		}
+
+		if (access->status == BED_SUCCESS && memcmp(data, in, page_size) != 0) {
+			access->status = BED_ERROR_ECC_UNCORRECTABLE;
+		}
+	}
+
+	return NULL;
+}
+
+static void accessPagesConcurrently(bed_partition *part, bool write)
+{
+	const bed_address chip_size = part->size / 2;
+	PageAccess access [2];
+	pthread_t threads [2];
+
+	for (int i = 0; i < 2; ++i) {
+		access [i].part = part;
+		access [i].begin = i * chip_size;
+		access [i].page_count = 16;
+		access [i].write = write;
+		access [i].status = BED_ERROR_SYSTEM;
+		ASSERT_EQ(0, pthread_create(&threads [i], NULL, accessPages, &access [i]));
+	}
+
+	for (int i = 0; i < 2; ++i) {
+		ASSERT_EQ(0, pthread_join(threads [i], NULL));
+		EXPECT_EQ(BED_SUCCESS, access [i].status);
+	}
+}
+
+TEST(BED, LockStatistics)
+{
+	bed_partition *part = bed_nand_simulator_create(CHIP_COUNT, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_lock_statistics statistics;
+	bed_status status = bed_get_lock_statistics(part, &statistics);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, statistics.acquisitions);
+
+	status = bed_enable_lock_statistics(part, true);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_erase_all(part, BED_ERASE_FORCE);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_get_lock_statistics(part, &statistics);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(CHIP_COUNT * BLOCK_COUNT, statistics.acquisitions);
+	EXPECT_EQ(0U, statistics.contended_acquisitions);
+	EXPECT_EQ(0U, statistics.total_wait_nanoseconds);
+	EXPECT_GT(statistics.longest_hold_nanoseconds, 0U);
+
+	bed_nand_simulator_destroy(part);
+
+	part = bed_nand_simulator_create_with_profile(&bed_nand_simulator_mt29f4g08abada, 2);
+	ASSERT_TRUE(part != NULL);
+
+	status = bed_nand_simulator_start_threads(part, 100);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_enable_lock_statistics(part, true);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	accessPagesConcurrently(part, true);
+
+	status = bed_get_lock_statistics(part, &statistics);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(64U, statistics.acquisitions);
+	EXPECT_GT(statistics.contended_acquisitions, 0U);
+	EXPECT_GT(statistics.total_wait_nanoseconds, 0U);
+	EXPECT_GT(statistics.longest_hold_nanoseconds, 0U);
+
+	status = bed_enable_lock_statistics(part, false);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_read(part, 0, NULL, 0);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_get_lock_statistics(part, &statistics);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, statistics.acquisitions);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, NANDSimulatorChipLocking)
+{
+	bed_partition *part = bed_nand_simulator_create_with_profile(&bed_nand_simulator_mt29f4g08abada, 2);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_nand_simulator_enable_chip_locking(part);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_lock_statistics statistics;
+	status = bed_get_lock_statistics(part, &statistics);
+	EXPECT_EQ(BED_ERROR_OP_NOT_SUPPORTED, status);
+
+	bed_nand_context *nand = static_cast<bed_nand_context *>(part->bed->context);
+	status = bed_lock_enable_statistics(&nand->bus_lock, true);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_nand_simulator_start_threads(part, 100);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	accessPagesConcurrently(part, true);
+
+	status = bed_lock_get_statistics(&nand->bus_lock, &statistics);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_GE(statistics.acquisitions, 64U);
+
+	bed_nand_simulator_destroy(part);
+}
+
+struct Erase {
+	bed_partition *part;
+	bed_address addr;
+	bool started;
+	bool done;
+	bed_status status;
+};
+
+static void *eraseBlock(void *arg)
+{
+	Erase *erase = static_cast<Erase *>(arg);
+
+	__atomic_store_n(&erase->started, true, __ATOMIC_RELEASE);
+	erase->status = bed_erase(erase->part, erase->addr, BED_ERASE_FORCE);
+	__atomic_store_n(&erase->done, true, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static bool isEraseDone(const Erase *erase)
+{
+	return __atomic_load_n(&erase->done, __ATOMIC_ACQUIRE);
+}
+
+static bed_partition *createEraseSuspendPartition(bool erase_suspend, uint32_t time_scale)
+{
+	bed_nand_simulator_profile profile = bed_nand_simulator_mt29f4g08abada;
+	profile.t_bers = 60000;
+	profile.erase_suspend = erase_suspend;
+
+	bed_partition *part = bed_nand_simulator_create_with_profile(&profile, 1);
+	EXPECT_TRUE(part != NULL);
+
+	bed_status status = bed_nand_simulator_enable_chip_locking(part);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_nand_simulator_start_threads(part, time_scale);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	return part;
+}
+
+static void startErase(Erase *erase, bed_partition *part, pthread_t *thread)
+{
+	erase->part = part;
+	erase->addr = 0;
+	erase->started = false;
+	erase->done = false;
+	erase->status = BED_ERROR_SYSTEM;
+
+	EXPECT_EQ(0, pthread_create(thread, NULL, eraseBlock, erase));
+	while (!__atomic_load_n(&erase->started, __ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+}
+
+static void finishErase(Erase *erase, pthread_t thread)
+{
+	EXPECT_EQ(0, pthread_join(thread, NULL));
+	EXPECT_EQ(BED_SUCCESS, erase->status);
+
+	uint32_t in [2048 / sizeof(uint32_t)];
+	bed_status status = bed_read(erase->part, 0, in, erase->part->bed->page_size);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0xffffffffU, in [0]);
+}
+
+/*
+ * Returns true, if a page read issued during a block erase of the same chip
+ * completes before the erase.
+ */
+static bool isReadDoneBeforeErase(bool erase_suspend, uint32_t time_scale)
+{
+	bed_partition *part = createEraseSuspendPartition(erase_suspend, time_scale);
+
+	const size_t page_size = part->bed->page_size;
+	const bed_address block_size = part->bed->block_size;
+	uint32_t data [2048 / sizeof(uint32_t)];
+	uint32_t in [2048 / sizeof(uint32_t)];
+	createDataWithSize(data, page_size, 0);
+	bed_status status = bed_write(part, block_size, data, page_size);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	Erase erase;
+	pthread_t thread;
+	startErase(&erase, part, &thread);
+	usleep(5000);
+
+	status = bed_read(part, block_size, in, page_size);
+	bool before = !isEraseDone(&erase);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, page_size));
+
+	finishErase(&erase, thread);
+	bed_nand_simulator_destroy(part);
+
+	return before;
+}
+
+TEST(BED, NANDSimulatorEraseSuspend)
+{
+	// The erase takes 60ms without and 600ms with erase suspend
+	EXPECT_FALSE(isReadDoneBeforeErase(false, 100));
+	EXPECT_TRUE(isReadDoneBeforeErase(true, 1000));
+}
+
+struct ReadStream {
+	const Erase *erase;
+	uint32_t count;
+	bed_status status;
+};
+
+static void *readUntilEraseDone(void *arg)
+{
+	ReadStream *stream = static_cast<ReadStream *>(arg);
+	const bed_partition *part = stream->erase->part;
+	uint32_t in [2048 / sizeof(uint32_t)];
+
+	while (stream->status == BED_SUCCESS && !isEraseDone(stream->erase)) {
+		stream->status = bed_read(part, part->bed->block_size, in, part->bed->page_size);
+		++stream->count;
+	}
+
+	return NULL;
+}
+
+TEST(BED, NANDSimulatorEraseSuspendReadStream)
+{
+	bed_partition *part = createEraseSuspendPartition(true, 100);
+
+	Erase erase;
+	pthread_t eraseThread;
+	startErase(&erase, part, &eraseThread);
+
+	// Readers which keep the chip busy until the erase is done
+	ReadStream streams [2];
+	pthread_t readThreads [2];
+	for (size_t i = 0; i < 2; ++i) {
+		streams [i].erase = &erase;
+		streams [i].count = 0;
+		streams [i].status = BED_SUCCESS;
+		EXPECT_EQ(0, pthread_create(&readThreads [i], NULL, readUntilEraseDone, &streams [i]));
+	}
+
+	finishErase(&erase, eraseThread);
+
+	for (size_t i = 0; i < 2; ++i) {
+		EXPECT_EQ(0, pthread_join(readThreads [i], NULL));
+		EXPECT_EQ(BED_SUCCESS, streams [i].status);
+		EXPECT_GT(streams [i].count, 0U);
+	}
+
+	bed_nand_simulator_destroy(part);
+}
+#endif /* __rtems__ */
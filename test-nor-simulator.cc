@@ -103,3 +103,35 @@ TEST(BED, NORSimulator)
 
 	bed_nor_simulator_destroy(part);
 }
+
+TEST(BED, NORSimulatorSnapshot)
+{
+	bed_partition *part = bed_nor_simulator_create(BLOCK_COUNT, BLOCK_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	const uint8_t out[DEVICE_SIZE] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07 };
+	bed_status status = bed_write(part, 2, &out[2], 4);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_nor_simulator_image *image = bed_nor_simulator_snapshot(part);
+	ASSERT_TRUE(image != NULL);
+
+	status = bed_write(part, 0, &out[0], DEVICE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_erase(part, BLOCK_SIZE, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_nor_simulator_restore(part, image);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_nor_simulator_image_destroy(image);
+
+	const uint8_t expected[DEVICE_SIZE] = { 0xff, 0xff, 0x02, 0x03, 0x04, 0x05, 0xff, 0xff };
+	uint8_t in[DEVICE_SIZE];
+	status = bed_read(part, 0, &in[0], DEVICE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(expected, in, DEVICE_SIZE));
+
+	bed_nor_simulator_destroy(part);
+}
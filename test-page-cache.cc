@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-page-cache.h"
+#include "bed-nand.h"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 8;
+
+static const uint32_t BLOCK_SIZE = 2048;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static bool isBlank(const uint8_t *data)
+{
+	bool blank = true;
+
+	for (size_t i = 0; i < PAGE_SIZE; ++i) {
+		blank = blank && data [i] == 0xff;
+	}
+
+	return blank;
+}
+
+TEST(BED, PageCache)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_page_cache_config config = { 4, BED_PAGE_CACHE_LRU, 2 };
+	bed_page_cache *cache = bed_page_cache_create(part, &config);
+	ASSERT_TRUE(cache != NULL);
+
+	const bed_partition *cached = bed_page_cache_partition(cache);
+	EXPECT_EQ(part->size, cached->size);
+
+	uint8_t data [PAGE_SIZE];
+	uint8_t in [PAGE_SIZE];
+	memset(data, 0x5a, sizeof(data));
+
+	bed_status status = bed_erase_all(cached, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_write(cached, 0, data, sizeof(data));
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read(cached, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+	memset(in, 0, sizeof(in));
+	status = bed_read(cached, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+
+	bed_page_cache_statistics statistics;
+	bed_page_cache_get_statistics(cache, &statistics, true);
+	EXPECT_EQ(1U, statistics.hits);
+	EXPECT_EQ(1U, statistics.misses);
+	EXPECT_EQ(0U, statistics.evictions);
+	EXPECT_EQ(0U, statistics.invalidations);
+
+	// Modifications which bypass the cache need an explicit invalidation
+	status = bed_erase(part, 0, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read(cached, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+	bed_page_cache_invalidate(cache);
+	status = bed_read(cached, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isBlank(in));
+
+	// Writes through the cache invalidate the page
+	status = bed_write(cached, 0, data, sizeof(data));
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read(cached, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+
+	bed_page_cache_get_statistics(cache, &statistics, true);
+	EXPECT_EQ(1U, statistics.hits);
+	EXPECT_EQ(2U, statistics.misses);
+	EXPECT_EQ(2U, statistics.invalidations);
+
+	// Sequential reads trigger a read-ahead and evict the least recently used
+	// page
+	for (bed_address page = BLOCK_SIZE; page < 2 * BLOCK_SIZE; page += PAGE_SIZE) {
+		status = bed_read(cached, page, in, sizeof(in));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isBlank(in));
+	}
+
+	bed_page_cache_get_statistics(cache, &statistics, true);
+	EXPECT_EQ(2U, statistics.hits);
+	EXPECT_EQ(2U, statistics.misses);
+	EXPECT_EQ(2U, statistics.read_aheads);
+	EXPECT_EQ(1U, statistics.evictions);
+
+	status = bed_read(cached, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+
+	bed_page_cache_get_statistics(cache, &statistics, true);
+	EXPECT_EQ(0U, statistics.hits);
+	EXPECT_EQ(1U, statistics.misses);
+
+	// The OOB data is cached after the first read with an OOB request
+	uint8_t oobData [4];
+	uint8_t oobIn [4];
+	memset(oobData, 0xa5, sizeof(oobData));
+	bed_oob_request oob = {
+		BED_OOB_MODE_AUTO,
+		0,
+		sizeof(oobData),
+		oobData
+	};
+	status = bed_write_oob(cached, 3 * BLOCK_SIZE, data, sizeof(data), &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+	oob.data = oobIn;
+
+	for (int i = 0; i < 3; ++i) {
+		memset(in, 0, sizeof(in));
+		memset(oobIn, 0, sizeof(oobIn));
+		status = bed_read_oob(cached, 3 * BLOCK_SIZE, in, sizeof(in), &oob);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+		EXPECT_EQ(0, memcmp(oobData, oobIn, sizeof(oobIn)));
+	}
+
+	bed_page_cache_get_statistics(cache, &statistics, true);
+	EXPECT_EQ(2U, statistics.hits);
+	EXPECT_EQ(1U, statistics.misses);
+
+	// Bad block marks invalidate all pages of the block
+	status = bed_mark_block_bad(cached, BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_is_block_valid(cached, BLOCK_SIZE);
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+
+	bed_page_cache_get_statistics(cache, &statistics, true);
+	EXPECT_EQ(2U, statistics.invalidations);
+
+	bed_page_cache_destroy(cache);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, PageCacheClock)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_page_cache_config config = { 2, BED_PAGE_CACHE_CLOCK, 0 };
+	bed_page_cache *cache = bed_page_cache_create(part, &config);
+	ASSERT_TRUE(cache != NULL);
+
+	const bed_partition *cached = bed_page_cache_partition(cache);
+	bed_status status = bed_erase_all(cached, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	uint8_t data [PAGE_SIZE];
+	uint8_t in [PAGE_SIZE];
+
+	for (int i = 0; i < 4; ++i) {
+		memset(data, i, sizeof(data));
+		status = bed_write(cached, (bed_address) i * BLOCK_SIZE, data, sizeof(data));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	for (int j = 0; j < 2; ++j) {
+		for (int i = 0; i < 4; ++i) {
+			memset(data, i, sizeof(data));
+			status = bed_read(cached, (bed_address) i * BLOCK_SIZE, in, sizeof(in));
+			EXPECT_EQ(BED_SUCCESS, status);
+			EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+			status = bed_read(cached, (bed_address) i * BLOCK_SIZE, in, sizeof(in));
+			EXPECT_EQ(BED_SUCCESS, status);
+			EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+		}
+	}
+
+	bed_page_cache_statistics statistics;
+	bed_page_cache_get_statistics(cache, &statistics, false);
+	EXPECT_EQ(8U, statistics.hits);
+	EXPECT_EQ(8U, statistics.misses);
+	EXPECT_EQ(6U, statistics.evictions);
+	EXPECT_EQ(0U, statistics.read_aheads);
+
+	bed_page_cache_destroy(cache);
+	bed_nand_simulator_destroy(part);
+}
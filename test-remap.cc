@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-remap.h"
+#include "bed-nand.h"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 32;
+
+static const uint32_t BLOCK_SIZE = 4096;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static const uint32_t RESERVE_BLOCKS = 4;
+
+static const uint32_t TABLE_BLOCKS = 2;
+
+static const uint32_t LOGICAL_BLOCKS = BLOCK_COUNT - RESERVE_BLOCKS - TABLE_BLOCKS;
+
+static void writeBlocks(const bed_partition *part)
+{
+	uint8_t page [PAGE_SIZE];
+
+	for (uint32_t block = 0; block < LOGICAL_BLOCKS; ++block) {
+		memset(page, (int) block, sizeof(page));
+		bed_status status = bed_write(part, block * BLOCK_SIZE + PAGE_SIZE, page, sizeof(page));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+}
+
+static void checkBlocks(const bed_partition *part)
+{
+	uint8_t page [PAGE_SIZE];
+	uint8_t expected [PAGE_SIZE];
+
+	for (uint32_t block = 0; block < LOGICAL_BLOCKS; ++block) {
+		memset(expected, (int) block, sizeof(expected));
+		bed_status status = bed_read(part, block * BLOCK_SIZE + PAGE_SIZE, page, sizeof(page));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(0, memcmp(expected, page, sizeof(page)));
+	}
+}
+
+TEST(BED, Remap)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_remap_config config = { 0, TABLE_BLOCKS };
+	bed_remap *remap;
+	status = bed_remap_create(part, &config, &remap);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	EXPECT_TRUE(remap == NULL);
+
+	config.reserve_blocks = BLOCK_COUNT;
+	status = bed_remap_create(part, &config, &remap);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	// Factory bad blocks in the logical area are replaced on creation
+	status = bed_mark_block_bad(part, 3 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_mark_block_bad(part, 10 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	config.reserve_blocks = RESERVE_BLOCKS;
+	status = bed_remap_create(part, &config, &remap);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	const bed_partition *logical = bed_remap_partition(remap);
+	EXPECT_EQ(LOGICAL_BLOCKS * BLOCK_SIZE, bed_size(logical));
+
+	for (uint32_t block = 0; block < LOGICAL_BLOCKS; ++block) {
+		status = bed_is_block_valid(logical, block * BLOCK_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	EXPECT_EQ(2 * BLOCK_SIZE + 5, bed_remap_parent_address(remap, 2 * BLOCK_SIZE + 5));
+	EXPECT_GE(bed_remap_parent_address(remap, 3 * BLOCK_SIZE), LOGICAL_BLOCKS * BLOCK_SIZE);
+	EXPECT_GE(bed_remap_parent_address(remap, 10 * BLOCK_SIZE), LOGICAL_BLOCKS * BLOCK_SIZE);
+
+	bed_remap_statistics statistics;
+	bed_remap_get_statistics(remap, &statistics);
+	EXPECT_EQ(LOGICAL_BLOCKS, statistics.logical_blocks);
+	EXPECT_EQ(2U, statistics.remapped_blocks);
+	EXPECT_EQ(RESERVE_BLOCKS - 2, statistics.free_reserve_blocks);
+	EXPECT_EQ(0U, statistics.unreplaced_blocks);
+	EXPECT_EQ(2U, statistics.table_writes);
+
+	// Direct block addressing works through the remap partition
+	writeBlocks(logical);
+	checkBlocks(logical);
+
+	// The mapping survives a re-creation
+	bed_address moved = bed_remap_parent_address(remap, 10 * BLOCK_SIZE);
+	bed_remap_destroy(remap);
+	status = bed_remap_create(part, &config, &remap);
+	ASSERT_EQ(BED_SUCCESS, status);
+	logical = bed_remap_partition(remap);
+	EXPECT_EQ(moved, bed_remap_parent_address(remap, 10 * BLOCK_SIZE));
+	checkBlocks(logical);
+
+	bed_remap_get_statistics(remap, &statistics);
+	EXPECT_EQ(2U, statistics.remapped_blocks);
+	EXPECT_EQ(0U, statistics.table_writes);
+
+	// Grown bad blocks are replaced by erased reserve blocks
+	status = bed_mark_block_bad(logical, 7 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_is_block_valid(logical, 7 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_is_block_valid(part, 7 * BLOCK_SIZE);
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+
+	uint8_t page [PAGE_SIZE];
+	uint8_t erased [PAGE_SIZE];
+	memset(erased, 0xff, sizeof(erased));
+	status = bed_read(logical, 7 * BLOCK_SIZE + PAGE_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(erased, page, sizeof(page)));
+
+	memset(page, 7, sizeof(page));
+	status = bed_write(logical, 7 * BLOCK_SIZE + PAGE_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	// A bad reserve block is replaced as well
+	status = bed_mark_block_bad(logical, 10 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_NE(moved, bed_remap_parent_address(remap, 10 * BLOCK_SIZE));
+	memset(page, 10, sizeof(page));
+	status = bed_write(logical, 10 * BLOCK_SIZE + PAGE_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_remap_get_statistics(remap, &statistics);
+	EXPECT_EQ(3U, statistics.remapped_blocks);
+	EXPECT_EQ(0U, statistics.free_reserve_blocks);
+
+	bed_remap_destroy(remap);
+	status = bed_remap_create(part, &config, &remap);
+	ASSERT_EQ(BED_SUCCESS, status);
+	logical = bed_remap_partition(remap);
+	checkBlocks(logical);
+
+	// With an exhausted reserve pool bad blocks become visible
+	status = bed_mark_block_bad(logical, 0);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_is_block_valid(logical, 0);
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+	status = bed_erase(logical, 0, BED_ERASE_MARK_BAD_ON_ERROR);
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+
+	bed_remap_get_statistics(remap, &statistics);
+	EXPECT_EQ(1U, statistics.unreplaced_blocks);
+
+	// Sub-partitions of the remap partition
+	bed_partition child;
+	status = bed_partition_create(&child, logical, 4 * BLOCK_SIZE, 8 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read(&child, 3 * BLOCK_SIZE + PAGE_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(7, page [0]);
+
+	bed_remap_destroy(remap);
+	bed_nand_simulator_destroy(part);
+}
@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-ring-log.h"
+#include "bed-nand.h"
+#include "bed-test.h"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+static const uint16_t PAGE_SIZE = 2048;
+
+static const uint32_t PAGES_PER_BLOCK = 4;
+
+static const uint32_t BLOCK_SIZE = PAGES_PER_BLOCK * PAGE_SIZE;
+
+static size_t recordSize(uint32_t sequence)
+{
+	return 1 + (sequence * 37) % PAGE_SIZE;
+}
+
+static void createRecord(uint8_t *data, uint32_t sequence)
+{
+	size_t n = recordSize(sequence);
+
+	for (size_t i = 0; i < n; ++i) {
+		data [i] = (uint8_t) (sequence * 7 + i);
+	}
+}
+
+static bool isRecord(const uint8_t *data, size_t n, uint32_t sequence)
+{
+	uint8_t expected [PAGE_SIZE];
+
+	createRecord(expected, sequence);
+
+	return n == recordSize(sequence) && memcmp(expected, data, n) == 0;
+}
+
+static bed_status appendRecords(bed_ring_log *log, uint32_t begin, uint32_t end)
+{
+	bed_status status = BED_SUCCESS;
+	uint8_t data [PAGE_SIZE];
+
+	for (uint32_t sequence = begin; sequence < end && status == BED_SUCCESS; ++sequence) {
+		createRecord(data, sequence);
+		status = bed_ring_log_append(log, data, recordSize(sequence));
+	}
+
+	return status;
+}
+
+TEST(BED, RingLog)
+{
+	const uint32_t blockCount = 256;
+	const uint32_t goodBlockCount = blockCount - 2;
+	bed_partition *part = bed_nand_simulator_create(1, blockCount, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, 5 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, 100 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_ring_log *log;
+	status = bed_ring_log_create(part, &log);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(PAGE_SIZE, bed_ring_log_max_record_size(log));
+
+	bed_ring_log_info info;
+	bed_ring_log_get_info(log, &info);
+	EXPECT_EQ(0U, info.oldest_sequence);
+	EXPECT_EQ(0U, info.next_sequence);
+
+	uint8_t data [PAGE_SIZE + 1];
+	size_t n;
+	bed_ring_log_cursor cursor;
+	bed_ring_log_open_cursor(log, &cursor);
+	status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, n);
+
+	status = bed_ring_log_append(log, data, sizeof(data));
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	status = appendRecords(log, 0, 3);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t sequence = 0; sequence < 3; ++sequence) {
+		status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isRecord(data, n, sequence));
+	}
+
+	status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, cursor.lost);
+
+	const uint32_t recordCount = 3 * goodBlockCount * PAGES_PER_BLOCK + 7;
+	status = appendRecords(log, 3, recordCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_ring_log_get_info(log, &info);
+	EXPECT_EQ(recordCount, info.next_sequence);
+	EXPECT_EQ(recordCount - (goodBlockCount - 1) * PAGES_PER_BLOCK - 3, info.oldest_sequence);
+	EXPECT_EQ(0U, info.write_errors);
+
+	bed_ring_log_destroy(log);
+
+	status = bed_ring_log_create(part, &log);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_ring_log_get_info(log, &info);
+	EXPECT_EQ(recordCount, info.next_sequence);
+	EXPECT_EQ(recordCount - (goodBlockCount - 1) * PAGES_PER_BLOCK - 3, info.oldest_sequence);
+	EXPECT_LT(info.mount_reads, 20U);
+
+	bed_ring_log_open_cursor(log, &cursor);
+	EXPECT_EQ(info.oldest_sequence, cursor.sequence);
+
+	uint32_t expected = info.oldest_sequence;
+	while ((status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n)) == BED_SUCCESS) {
+		EXPECT_TRUE(isRecord(data, n, expected));
+		++expected;
+	}
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(recordCount, expected);
+	EXPECT_EQ(0U, cursor.lost);
+
+	status = appendRecords(log, recordCount, recordCount + 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isRecord(data, n, recordCount));
+
+	bed_ring_log_destroy(log);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, RingLogLost)
+{
+	const uint32_t blockCount = 8;
+	bed_partition *part = bed_nand_simulator_create(1, blockCount, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_ring_log *log;
+	status = bed_ring_log_create(part, &log);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint8_t data [PAGE_SIZE];
+	size_t n;
+	bed_ring_log_cursor cursor;
+	bed_ring_log_open_cursor(log, &cursor);
+
+	status = appendRecords(log, 0, 10);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t sequence = 0; sequence < 2; ++sequence) {
+		status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isRecord(data, n, sequence));
+	}
+
+	const uint32_t recordCount = 10 + 2 * blockCount * PAGES_PER_BLOCK;
+	status = appendRecords(log, 10, recordCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_ring_log_info info;
+	bed_ring_log_get_info(log, &info);
+
+	status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isRecord(data, n, info.oldest_sequence));
+	EXPECT_EQ(info.oldest_sequence - 2, cursor.lost);
+
+	bed_ring_log_destroy(log);
+
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * Device which fails page writes to one block from one page on.
+ */
+static bed_device failingDevice;
+
+static bed_write_oob_method parentWriteOOB;
+
+static bed_address failingAddress;
+
+static bed_status failingWriteOOB(bed_device *bed, bed_address addr, const void *data, size_t n, const bed_oob_request *oob)
+{
+	bed_status status = BED_ERROR_WRITE;
+
+	if (addr < failingAddress || addr / BLOCK_SIZE != failingAddress / BLOCK_SIZE) {
+		status = (*parentWriteOOB)(bed, addr, data, n, oob);
+	}
+
+	return status;
+}
+
+static void readRecords(bed_ring_log *log, uint32_t begin, uint32_t lostBegin, uint32_t lostEnd, uint32_t end)
+{
+	uint8_t data [PAGE_SIZE];
+	size_t n;
+	bed_ring_log_cursor cursor;
+	bed_ring_log_open_cursor(log, &cursor);
+
+	for (uint32_t sequence = begin; sequence < end; ++sequence) {
+		if (sequence < lostBegin || sequence >= lostEnd) {
+			bed_status status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+			EXPECT_EQ(BED_SUCCESS, status);
+			EXPECT_TRUE(isRecord(data, n, sequence));
+		}
+	}
+
+	bed_status status = bed_ring_log_read(log, &cursor, data, sizeof(data), &n);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	// The failed write consumed one sequence number
+	EXPECT_EQ(lostEnd - lostBegin + 1, cursor.lost);
+}
+
+TEST(BED, RingLogWriteError)
+{
+	const uint32_t blockCount = 8;
+	bed_partition *part = bed_nand_simulator_create(1, blockCount, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_partition failing = *part;
+	failingDevice = *part->bed;
+	parentWriteOOB = failingDevice.write_oob;
+	failingDevice.write_oob = failingWriteOOB;
+	failing.bed = &failingDevice;
+
+	// Writes fail in block 2 from page 2 on
+	failingAddress = 2 * BLOCK_SIZE + 2 * PAGE_SIZE;
+
+	bed_ring_log *log;
+	status = bed_ring_log_create(&failing, &log);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	const uint32_t recordCount = 5 * PAGES_PER_BLOCK;
+	status = appendRecords(log, 0, recordCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_ring_log_info info;
+	bed_ring_log_get_info(log, &info);
+	EXPECT_EQ(1U, info.write_errors);
+	EXPECT_EQ(recordCount + 1, info.next_sequence);
+
+	status = bed_is_block_valid(part, 2 * BLOCK_SIZE);
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+
+	// The records written to the bad block before are lost
+	const uint32_t lostBegin = 2 * PAGES_PER_BLOCK;
+	const uint32_t lostEnd = lostBegin + 2;
+	readRecords(log, 0, lostBegin, lostEnd, recordCount);
+
+	bed_ring_log_destroy(log);
+
+	status = bed_ring_log_create(part, &log);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_ring_log_get_info(log, &info);
+	EXPECT_EQ(0U, info.oldest_sequence);
+	EXPECT_EQ(recordCount + 1, info.next_sequence);
+	readRecords(log, 0, lostBegin, lostEnd, recordCount);
+
+	bed_ring_log_destroy(log);
+
+	bed_nand_simulator_destroy(part);
+}
+
+class PowerCutRingLog {
+	public:
+		static const uint32_t BLOCK_COUNT = 8;
+
+		PowerCutRingLog()
+			: mCutPoints(0), mLog(NULL)
+		{
+			// Nothing to do
+		}
+
+		static bed_status prepare(void *arg, const bed_partition *part)
+		{
+			bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+
+			(void) arg;
+
+			if (status == BED_SUCCESS) {
+				status = append(part, 0, PREPARE_COUNT);
+			}
+
+			return status;
+		}
+
+		static bed_status run(void *arg, const bed_partition *part)
+		{
+			bed_status status = BED_SUCCESS;
+
+			(void) arg;
+
+			for (uint32_t begin = PREPARE_COUNT; begin < RUN_COUNT && status == BED_SUCCESS; begin += 10) {
+				status = append(part, begin, begin + 10 < RUN_COUNT ? begin + 10 : RUN_COUNT);
+			}
+
+			return status;
+		}
+
+		static bed_status recover(void *arg, const bed_partition *part)
+		{
+			PowerCutRingLog *self = static_cast<PowerCutRingLog *>(arg);
+
+			return bed_ring_log_create(part, &self->mLog);
+		}
+
+		/*
+		 * The records must have consecutive sequence numbers up to the newest
+		 * record.  The newest record must not be older than the records appended
+		 * before the workload.  Appending must continue after the recovery.
+		 */
+		static bed_status check(void *arg, const bed_partition *part, size_t *lost)
+		{
+			PowerCutRingLog *self = static_cast<PowerCutRingLog *>(arg);
+			bed_status status = BED_ERROR_SYSTEM;
+
+			(void) part;
+			*lost = 0;
+
+			if (self->mLog != NULL) {
+				bed_ring_log_info info;
+				bed_ring_log_cursor cursor;
+				uint8_t data [PAGE_SIZE];
+				size_t n;
+				uint32_t expected;
+
+				bed_ring_log_get_info(self->mLog, &info);
+				bed_ring_log_open_cursor(self->mLog, &cursor);
+				expected = info.oldest_sequence;
+
+				while ((status = bed_ring_log_read(self->mLog, &cursor, data, sizeof(data), &n)) == BED_SUCCESS) {
+					if (!isRecord(data, n, expected)) {
+						++*lost;
+					}
+
+					++expected;
+				}
+
+				if (status == BED_ERROR_UNSATISFIED) {
+					status = BED_SUCCESS;
+				}
+
+				if (expected != info.next_sequence || info.next_sequence < PREPARE_COUNT) {
+					++*lost;
+				}
+
+				*lost += cursor.lost;
+
+				if (status == BED_SUCCESS) {
+					status = append(self->mLog, info.next_sequence, info.next_sequence + 1);
+				}
+
+				bed_ring_log_destroy(self->mLog);
+				self->mLog = NULL;
+			}
+
+			return status;
+		}
+
+		static void report(void *arg, const bed_test_power_cut_result *result)
+		{
+			PowerCutRingLog *self = static_cast<PowerCutRingLog *>(arg);
+
+			if (result->operation == 0) {
+				EXPECT_EQ(BED_SUCCESS, result->run_status);
+				self->mCutPoints = result->operation_count;
+			}
+
+			EXPECT_EQ(BED_SUCCESS, result->recover_status);
+			EXPECT_EQ(BED_SUCCESS, result->check_status);
+			EXPECT_EQ(0U, result->lost);
+		}
+
+		uint32_t mCutPoints;
+
+	private:
+		static const uint32_t PREPARE_COUNT = 20;
+
+		static const uint32_t RUN_COUNT = PREPARE_COUNT + 2 * BLOCK_COUNT * PAGES_PER_BLOCK;
+
+		static bed_status append(bed_ring_log *log, uint32_t begin, uint32_t end)
+		{
+			return appendRecords(log, begin, end);
+		}
+
+		static bed_status append(const bed_partition *part, uint32_t begin, uint32_t end)
+		{
+			bed_ring_log *log;
+			bed_status status = bed_ring_log_create(part, &log);
+
+			if (status == BED_SUCCESS) {
+				status = appendRecords(log, begin, end);
+				bed_ring_log_destroy(log);
+			}
+
+			return status;
+		}
+
+		bed_ring_log *mLog;
+};
+
+TEST(BED, PowerCutRingLog)
+{
+	bed_partition *part = bed_nand_simulator_create(1, PowerCutRingLog::BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	PowerCutRingLog workload;
+	const bed_test_power_cut_workload w = {
+		PowerCutRingLog::prepare,
+		PowerCutRingLog::run,
+		PowerCutRingLog::recover,
+		PowerCutRingLog::check,
+		&workload
+	};
+
+	uint32_t cutPoints = bed_test_power_cut(part, &w, 50, PowerCutRingLog::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+	EXPECT_GT(cutPoints, 40U);
+
+	bed_nand_simulator_destroy(part);
+}
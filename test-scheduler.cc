@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-scheduler.h"
+#include "bed-nand.h"
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+TEST(BED, Scheduler)
+{
+	bed_partition *part = bed_nand_simulator_create(1, 4, 1024, 512);
+	ASSERT_TRUE(part != NULL);
+
+	bed_scheduler *sched = bed_scheduler_create(part, NULL);
+	ASSERT_TRUE(sched != NULL);
+
+	const bed_partition *read = bed_scheduler_partition(sched, BED_SCHEDULER_CLASS_READ);
+	const bed_partition *write = bed_scheduler_partition(sched, BED_SCHEDULER_CLASS_WRITE);
+	const bed_partition *background = bed_scheduler_partition(sched, BED_SCHEDULER_CLASS_BACKGROUND);
+	EXPECT_EQ(part->size, read->size);
+	EXPECT_EQ(part->bed->page_size, read->bed->page_size);
+
+	uint8_t data [512];
+	uint8_t in [512];
+	memset(data, 0x5a, sizeof(data));
+
+	bed_status status = bed_erase_all(background, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_write(write, 1024, data, sizeof(data));
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read(read, 1024, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(data, in, sizeof(in)));
+	status = bed_mark_block_bad(background, 2048);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_is_block_valid(read, 2048);
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, status);
+
+	bed_scheduler_destroy(sched);
+	bed_nand_simulator_destroy(part);
+}
+
+#ifndef __rtems__
+struct EraseAll {
+	const bed_partition *part;
+	bool done;
+	bed_status status;
+};
+
+static void *eraseAll(void *arg)
+{
+	EraseAll *erase = static_cast<EraseAll *>(arg);
+
+	erase->status = bed_erase_all(erase->part, BED_ERASE_FORCE);
+	__atomic_store_n(&erase->done, true, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+TEST(BED, SchedulerReadDuringEraseAll)
+{
+	bed_nand_simulator_profile profile = bed_nand_simulator_mt29f4g08abada;
+	profile.blocks_per_lun = 128;
+
+	bed_partition *part = bed_nand_simulator_create_with_profile(&profile, 1);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_nand_simulator_start_threads(part, 100);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_scheduler *sched = bed_scheduler_create(part, NULL);
+	ASSERT_TRUE(sched != NULL);
+
+	EraseAll erase;
+	erase.part = bed_scheduler_partition(sched, BED_SCHEDULER_CLASS_BACKGROUND);
+	erase.done = false;
+	erase.status = BED_ERROR_SYSTEM;
+
+	pthread_t thread;
+	ASSERT_EQ(0, pthread_create(&thread, NULL, eraseAll, &erase));
+	usleep(10000);
+
+	const bed_partition *read = bed_scheduler_partition(sched, BED_SCHEDULER_CLASS_READ);
+	uint8_t in [2048];
+	for (bed_address page = 0; page < 16; ++page) {
+		status = bed_read(read, page * sizeof(in), in, sizeof(in));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	EXPECT_FALSE(__atomic_load_n(&erase.done, __ATOMIC_ACQUIRE));
+
+	ASSERT_EQ(0, pthread_join(thread, NULL));
+	EXPECT_TRUE(erase.done);
+	EXPECT_EQ(BED_SUCCESS, erase.status);
+
+	bed_scheduler_destroy(sched);
+	bed_nand_simulator_destroy(part);
+}
+#endif /* __rtems__ */
@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-scrubber.h"
+#include "bed-scheduler.h"
+#include "bed-nand.h"
+#include "bed-test.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 8;
+
+static const uint32_t BLOCK_SIZE = 4096;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static const uint32_t PAGES_PER_BLOCK = BLOCK_SIZE / PAGE_SIZE;
+
+static const uint32_t DATA_BLOCK_COUNT = BLOCK_COUNT - 2;
+
+/*
+ * The last two blocks of the simulator are the spare blocks.
+ */
+static bed_partition *createPartitions(bed_partition *part, bed_partition *spare)
+{
+	bed_partition *sim = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+
+	if (sim != NULL) {
+		bed_status status = bed_erase_all(sim, BED_ERASE_FORCE);
+		EXPECT_EQ(BED_SUCCESS, status);
+
+		status = bed_partition_create(part, sim, 0, DATA_BLOCK_COUNT * BLOCK_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+
+		status = bed_partition_create(spare, sim, DATA_BLOCK_COUNT * BLOCK_SIZE, 2 * BLOCK_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	return sim;
+}
+
+static void writeBlock(const bed_partition *part, uint32_t block)
+{
+	uint8_t page [PAGE_SIZE];
+
+	for (uint32_t i = 0; i < PAGES_PER_BLOCK - 1; ++i) {
+		memset(page, (int) (block + i), sizeof(page));
+		bed_status status = bed_write(part, block * BLOCK_SIZE + i * PAGE_SIZE, page, sizeof(page));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+}
+
+static void checkBlock(const bed_partition *part, uint32_t block)
+{
+	uint8_t page [PAGE_SIZE];
+	uint8_t expected [PAGE_SIZE];
+
+	for (uint32_t i = 0; i < PAGES_PER_BLOCK; ++i) {
+		memset(expected, i < PAGES_PER_BLOCK - 1 ? (int) (block + i) : 0xff, sizeof(expected));
+		bed_status status = bed_read(part, block * BLOCK_SIZE + i * PAGE_SIZE, page, sizeof(page));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(0, memcmp(expected, page, sizeof(page)));
+	}
+}
+
+static void flipBit(const bed_partition *part, bed_address addr)
+{
+	uint8_t page [PAGE_SIZE];
+	bed_status status = bed_read(part, addr, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	uint8_t flipped [PAGE_SIZE];
+	memset(flipped, 0xff, sizeof(flipped));
+	flipped [100] = (uint8_t) (page [100] & (page [100] - 1));
+	bed_oob_request oob = { BED_OOB_MODE_BLOODY, 0, 0, NULL };
+	status = bed_write_oob(part, addr, flipped, sizeof(flipped), &oob);
+	EXPECT_EQ(BED_SUCCESS, status);
+}
+
+TEST(BED, ScrubberReadDisturb)
+{
+	bed_partition data;
+	bed_partition spare;
+	bed_partition *sim = createPartitions(&data, &spare);
+	ASSERT_TRUE(sim != NULL);
+
+	const bed_partition *part = &data;
+	bed_status status;
+
+	bed_scrubber_config config = { 10, 0, 0, NULL, NULL, NULL };
+	bed_scrubber *scrubber;
+	status = bed_scrubber_create(part, &config, &scrubber);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	EXPECT_TRUE(scrubber == NULL);
+
+	// The refresh in place needs spare blocks
+	config.pages_per_step = 1;
+	status = bed_scrubber_create(part, &config, &scrubber);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	bed_partition overlap;
+	status = bed_partition_create(&overlap, sim, (DATA_BLOCK_COUNT - 1) * BLOCK_SIZE, 2 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	config.spare = &overlap;
+	status = bed_scrubber_create(part, &config, &scrubber);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	config.spare = &spare;
+	status = bed_scrubber_create(part, &config, &scrubber);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	const bed_partition *scrub = bed_scrubber_partition(scrubber);
+	EXPECT_EQ(bed_size(part), bed_size(scrub));
+
+	writeBlock(scrub, 2);
+	writeBlock(scrub, 5);
+
+	uint8_t page [PAGE_SIZE];
+	for (uint32_t i = 0; i < 9; ++i) {
+		status = bed_read(scrub, 2 * BLOCK_SIZE, page, sizeof(page));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	status = bed_read(scrub, 5 * BLOCK_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(9U, bed_scrubber_read_count(scrubber, 2 * BLOCK_SIZE));
+	EXPECT_EQ(1U, bed_scrubber_read_count(scrubber, 5 * BLOCK_SIZE));
+
+	// Below the threshold nothing is refreshed
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_statistics statistics;
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(1U, statistics.patrol_reads);
+	EXPECT_EQ(0U, statistics.read_disturb_refreshes);
+
+	// Patrol reads do not count as reads
+	EXPECT_EQ(0U, bed_scrubber_read_count(scrubber, 0));
+
+	status = bed_read(scrub, 2 * BLOCK_SIZE + PAGE_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_get_statistics(scrubber, &statistics, true);
+	EXPECT_EQ(2U, statistics.patrol_reads);
+	EXPECT_EQ(1U, statistics.read_disturb_refreshes);
+	EXPECT_EQ(0U, statistics.ecc_refreshes);
+	EXPECT_EQ(0U, statistics.refresh_errors);
+	EXPECT_EQ(0U, bed_scrubber_read_count(scrubber, 2 * BLOCK_SIZE));
+	EXPECT_EQ(1U, bed_scrubber_read_count(scrubber, 5 * BLOCK_SIZE));
+
+	// The refresh preserves the content
+	checkBlock(part, 2);
+	checkBlock(part, 5);
+
+	// An erase resets the read count
+	status = bed_erase(scrub, 5 * BLOCK_SIZE, BED_ERASE_MARK_BAD_ON_ERROR);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, bed_scrubber_read_count(scrubber, 5 * BLOCK_SIZE));
+
+	// A patrol pass skips bad blocks
+	status = bed_mark_block_bad(scrub, 3 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t i = 0; i < (DATA_BLOCK_COUNT - 1) * PAGES_PER_BLOCK; ++i) {
+		status = bed_scrubber_step(scrubber);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ((DATA_BLOCK_COUNT - 1) * PAGES_PER_BLOCK, statistics.patrol_reads);
+	EXPECT_EQ(1U, statistics.patrol_passes);
+	EXPECT_EQ(0U, statistics.read_disturb_refreshes);
+
+	bed_scrubber_destroy(scrubber);
+	bed_nand_simulator_destroy(sim);
+}
+
+TEST(BED, ScrubberPatrol)
+{
+	bed_partition data;
+	bed_partition spare;
+	bed_partition *sim = createPartitions(&data, &spare);
+	ASSERT_TRUE(sim != NULL);
+
+	const bed_partition *part = &data;
+	bed_status status;
+
+	bed_scheduler *sched = bed_scheduler_create(sim, NULL);
+	ASSERT_TRUE(sched != NULL);
+
+	bed_partition other;
+	status = bed_partition_create(&other, part, 0, BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_config config = { 0, 1, PAGES_PER_BLOCK, &other, NULL, NULL, &spare };
+	bed_scrubber *scrubber;
+	status = bed_scrubber_create(part, &config, &scrubber);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	bed_partition patrol;
+	status = bed_partition_create(&patrol, bed_scheduler_partition(sched, BED_SCHEDULER_CLASS_BACKGROUND), 0, bed_size(part));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	config.patrol = &patrol;
+	status = bed_scrubber_create(part, &config, &scrubber);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	writeBlock(part, 1);
+	flipBit(part, BLOCK_SIZE + 3 * PAGE_SIZE);
+
+	uint8_t page [PAGE_SIZE];
+	status = bed_read(part, BLOCK_SIZE + 3 * PAGE_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_ERROR_ECC_FIXED, status);
+
+	// The first step patrols block 0, the second block 1
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_statistics statistics;
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(2 * PAGES_PER_BLOCK, statistics.patrol_reads);
+	EXPECT_EQ(1U, statistics.fixed_reads);
+	EXPECT_EQ(0U, statistics.uncorrectable_reads);
+	EXPECT_EQ(1U, statistics.ecc_refreshes);
+	EXPECT_EQ(0U, statistics.read_disturb_refreshes);
+
+	status = bed_read(part, BLOCK_SIZE + 3 * PAGE_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	checkBlock(part, 1);
+
+	bed_scrubber_destroy(scrubber);
+	bed_scheduler_destroy(sched);
+	bed_nand_simulator_destroy(sim);
+}
+
+typedef struct {
+	uint32_t count;
+	bed_address block;
+	bed_status status;
+} refreshRecord;
+
+static bed_status recordRefresh(void *arg, bed_address block)
+{
+	refreshRecord *record = static_cast<refreshRecord *>(arg);
+
+	++record->count;
+	record->block = block;
+
+	return record->status;
+}
+
+TEST(BED, ScrubberRefreshHandler)
+{
+	bed_partition *parent = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(parent != NULL);
+
+	bed_status status = bed_erase_all(parent, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_partition part;
+	status = bed_partition_create(&part, parent, 2 * BLOCK_SIZE, 4 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	refreshRecord record = { 0, 0, BED_ERROR_WRITE };
+	bed_scrubber_config config = { 2, 0, 1, NULL, recordRefresh, &record };
+	bed_scrubber *scrubber;
+	status = bed_scrubber_create(&part, &config, &scrubber);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	const bed_partition *scrub = bed_scrubber_partition(scrubber);
+	uint8_t page [PAGE_SIZE];
+	for (uint32_t i = 0; i < 2; ++i) {
+		status = bed_read(scrub, 3 * BLOCK_SIZE, page, sizeof(page));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	// Block addresses are relative to the parent partition
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_ERROR_WRITE, status);
+	EXPECT_EQ(1U, record.count);
+	EXPECT_EQ(3 * BLOCK_SIZE, record.block);
+
+	bed_scrubber_statistics statistics;
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(1U, statistics.refresh_errors);
+	EXPECT_EQ(0U, statistics.read_disturb_refreshes);
+
+	// A failed refresh is retried after further reads
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(1U, record.count);
+
+	record.status = BED_SUCCESS;
+	status = bed_read(scrub, 3 * BLOCK_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(2U, record.count);
+	EXPECT_EQ(0U, bed_scrubber_read_count(scrubber, 3 * BLOCK_SIZE));
+
+	bed_scrubber_destroy(scrubber);
+	bed_nand_simulator_destroy(parent);
+}
+
+TEST(BED, ScrubberSetCounts)
+{
+	bed_partition data;
+	bed_partition spare;
+	bed_partition *sim = createPartitions(&data, &spare);
+	ASSERT_TRUE(sim != NULL);
+
+	bed_scrubber_config config = { 10, 3, 1, NULL, NULL, NULL, &spare };
+	bed_scrubber *scrubber;
+	bed_status status = bed_scrubber_create(&data, &config, &scrubber);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	writeBlock(&data, 2);
+
+	status = bed_scrubber_set_counts(scrubber, DATA_BLOCK_COUNT * BLOCK_SIZE, 1, 1);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	// Counts saved before a reboot continue to count towards the thresholds
+	status = bed_scrubber_set_counts(scrubber, 2 * BLOCK_SIZE, 9, 2);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(9U, bed_scrubber_read_count(scrubber, 2 * BLOCK_SIZE));
+	EXPECT_EQ(2U, bed_scrubber_fixed_count(scrubber, 2 * BLOCK_SIZE));
+
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_statistics statistics;
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(0U, statistics.read_disturb_refreshes);
+
+	uint8_t page [PAGE_SIZE];
+	status = bed_read(bed_scrubber_partition(scrubber), 2 * BLOCK_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(1U, statistics.read_disturb_refreshes);
+	EXPECT_EQ(0U, bed_scrubber_read_count(scrubber, 2 * BLOCK_SIZE));
+	EXPECT_EQ(0U, bed_scrubber_fixed_count(scrubber, 2 * BLOCK_SIZE));
+	checkBlock(&data, 2);
+
+	// Seeding the ECC threshold makes the block due as well
+	status = bed_scrubber_set_counts(scrubber, 2 * BLOCK_SIZE, 0, 3);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(1U, statistics.ecc_refreshes);
+	checkBlock(&data, 2);
+
+	bed_scrubber_destroy(scrubber);
+	bed_nand_simulator_destroy(sim);
+}
+
+static bed_device failingEraseDevice;
+
+static bed_erase_method failingEraseParent;
+
+static bed_address failingEraseAddress;
+
+static bed_status failingErase(bed_device *bed, bed_address addr)
+{
+	bed_status status;
+
+	if (addr == failingEraseAddress) {
+		status = BED_ERROR_ERASE;
+	} else {
+		status = (*failingEraseParent)(bed, addr);
+	}
+
+	return status;
+}
+
+TEST(BED, ScrubberEraseError)
+{
+	bed_partition data;
+	bed_partition spare;
+	bed_partition *sim = createPartitions(&data, &spare);
+	ASSERT_TRUE(sim != NULL);
+
+	failingEraseDevice = *sim->bed;
+	failingEraseParent = failingEraseDevice.erase;
+	failingEraseDevice.erase = failingErase;
+	failingEraseAddress = 2 * BLOCK_SIZE;
+
+	bed_partition failingData = data;
+	failingData.bed = &failingEraseDevice;
+	bed_partition failingSpare = spare;
+	failingSpare.bed = &failingEraseDevice;
+
+	bed_scrubber_config config = { 1, 0, 1, NULL, NULL, NULL, &failingSpare };
+	bed_scrubber *scrubber;
+	bed_status status = bed_scrubber_create(&failingData, &config, &scrubber);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	writeBlock(&data, 2);
+
+	status = bed_scrubber_set_counts(scrubber, 2 * BLOCK_SIZE, 1, 0);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	// The erase error neither marks the block bad nor loses its content
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_ERROR_ERASE, status);
+	EXPECT_EQ(BED_SUCCESS, bed_is_block_valid(&data, 2 * BLOCK_SIZE));
+	checkBlock(&data, 2);
+
+	// The pending restore is retried
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_ERROR_ERASE, status);
+
+	bed_scrubber_statistics statistics;
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(2U, statistics.refresh_errors);
+	EXPECT_EQ(0U, statistics.read_disturb_refreshes);
+
+	bed_scrubber_destroy(scrubber);
+
+	// The creation completes the pending restore of a damaged block
+	status = bed_erase(&data, 2 * BLOCK_SIZE, BED_ERASE_NORMAL);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	config.spare = &spare;
+	status = bed_scrubber_create(&data, &config, &scrubber);
+	ASSERT_EQ(BED_SUCCESS, status);
+	checkBlock(&data, 2);
+
+	status = bed_scrubber_step(scrubber);
+	EXPECT_EQ(BED_SUCCESS, status);
+	checkBlock(&data, 2);
+
+	bed_scrubber_destroy(scrubber);
+	bed_nand_simulator_destroy(sim);
+}
+
+struct Step {
+	bed_scrubber *scrubber;
+	bool done;
+	bed_status status;
+};
+
+static void *stepScrubber(void *arg)
+{
+	Step *step = static_cast<Step *>(arg);
+
+	step->status = bed_scrubber_step(step->scrubber);
+	__atomic_store_n(&step->done, true, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+TEST(BED, ScrubberChipLocking)
+{
+	bed_partition data;
+	bed_partition spare;
+	bed_partition *sim = createPartitions(&data, &spare);
+	ASSERT_TRUE(sim != NULL);
+
+	bed_status status = bed_nand_simulator_enable_chip_locking(sim);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_scrubber_config config = { 1, 0, 1, NULL, NULL, NULL, &spare };
+	bed_scrubber *scrubber;
+	status = bed_scrubber_create(&data, &config, &scrubber);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	const bed_partition *scrub = bed_scrubber_partition(scrubber);
+	writeBlock(scrub, 2);
+
+	status = bed_scrubber_set_counts(scrubber, 2 * BLOCK_SIZE, 1, 0);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	// The owner of the scrubber partition excludes the refresh in place
+	bed_obtain(scrub);
+
+	Step step = { scrubber, false, BED_ERROR_SYSTEM };
+	pthread_t thread;
+	ASSERT_EQ(0, pthread_create(&thread, NULL, stepScrubber, &step));
+
+	usleep(20000);
+	EXPECT_FALSE(__atomic_load_n(&step.done, __ATOMIC_ACQUIRE));
+
+	bed_release(scrub);
+	EXPECT_EQ(0, pthread_join(thread, NULL));
+	EXPECT_EQ(BED_SUCCESS, step.status);
+	checkBlock(scrub, 2);
+
+	bed_scrubber_statistics statistics;
+	bed_scrubber_get_statistics(scrubber, &statistics, false);
+	EXPECT_EQ(1U, statistics.read_disturb_refreshes);
+
+	bed_scrubber_destroy(scrubber);
+	bed_nand_simulator_destroy(sim);
+}
+
+class PowerCutScrubber {
+	public:
+		PowerCutScrubber()
+			: mCutPoints(0)
+		{
+			// Nothing to do
+		}
+
+		static bed_status prepare(void *arg, const bed_partition *part)
+		{
+			bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+
+			(void) arg;
+
+			if (status == BED_SUCCESS) {
+				writeBlock(part, 1);
+				writeBlock(part, 2);
+			}
+
+			return status;
+		}
+
+		static bed_status run(void *arg, const bed_partition *part)
+		{
+			(void) arg;
+
+			return refresh(part, 1);
+		}
+
+		static bed_status recover(void *arg, const bed_partition *part)
+		{
+			bed_partition data;
+			bed_partition spare;
+			bed_scrubber *scrubber;
+			bed_status status;
+
+			(void) arg;
+
+			createDataAndSpare(part, &data, &spare);
+			status = create(&data, &spare, &scrubber);
+
+			if (status == BED_SUCCESS) {
+				bed_scrubber_destroy(scrubber);
+			}
+
+			return status;
+		}
+
+		/*
+		 * The content of both blocks must survive and a refresh must work
+		 * after the recovery.
+		 */
+		static bed_status check(void *arg, const bed_partition *part, size_t *lost)
+		{
+			bed_status status;
+
+			(void) arg;
+
+			*lost = lostPages(part, 1) + lostPages(part, 2);
+			status = refresh(part, 2);
+			*lost += lostPages(part, 1) + lostPages(part, 2);
+
+			return status;
+		}
+
+		static void report(void *arg, const bed_test_power_cut_result *result)
+		{
+			PowerCutScrubber *self = static_cast<PowerCutScrubber *>(arg);
+
+			if (result->operation == 0) {
+				EXPECT_EQ(BED_SUCCESS, result->run_status);
+				self->mCutPoints = result->operation_count;
+			}
+
+			EXPECT_EQ(BED_SUCCESS, result->recover_status);
+			EXPECT_EQ(BED_SUCCESS, result->check_status);
+			EXPECT_EQ(0U, result->lost);
+		}
+
+		uint32_t mCutPoints;
+
+	private:
+		static void createDataAndSpare(const bed_partition *part, bed_partition *data, bed_partition *spare)
+		{
+			bed_partition_create(data, part, 0, DATA_BLOCK_COUNT * BLOCK_SIZE);
+			bed_partition_create(spare, part, DATA_BLOCK_COUNT * BLOCK_SIZE, 2 * BLOCK_SIZE);
+		}
+
+		static bed_status create(const bed_partition *data, const bed_partition *spare, bed_scrubber **scrubber)
+		{
+			bed_scrubber_config config = { 1, 0, 1, NULL, NULL, NULL, spare };
+
+			return bed_scrubber_create(data, &config, scrubber);
+		}
+
+		static bed_status refresh(const bed_partition *part, uint32_t block)
+		{
+			bed_partition data;
+			bed_partition spare;
+			bed_scrubber *scrubber;
+			bed_status status;
+
+			createDataAndSpare(part, &data, &spare);
+			status = create(&data, &spare, &scrubber);
+
+			if (status == BED_SUCCESS) {
+				status = bed_scrubber_set_counts(scrubber, block * BLOCK_SIZE, 1, 0);
+
+				if (status == BED_SUCCESS) {
+					status = bed_scrubber_step(scrubber);
+				}
+
+				bed_scrubber_destroy(scrubber);
+			}
+
+			return status;
+		}
+
+		static size_t lostPages(const bed_partition *part, uint32_t block)
+		{
+			size_t lost = 0;
+
+			for (uint32_t i = 0; i < PAGES_PER_BLOCK; ++i) {
+				uint8_t page [PAGE_SIZE];
+				uint8_t expected [PAGE_SIZE];
+				bed_status status = bed_read(part, block * BLOCK_SIZE + i * PAGE_SIZE, page, sizeof(page));
+
+				memset(expected, i < PAGES_PER_BLOCK - 1 ? (int) (block + i) : 0xff, sizeof(expected));
+
+				if (status != BED_SUCCESS || memcmp(expected, page, sizeof(page)) != 0) {
+					++lost;
+				}
+			}
+
+			return lost;
+		}
+};
+
+TEST(BED, PowerCutScrubber)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	PowerCutScrubber workload;
+	const bed_test_power_cut_workload w = {
+		PowerCutScrubber::prepare,
+		PowerCutScrubber::run,
+		PowerCutScrubber::recover,
+		PowerCutScrubber::check,
+		&workload
+	};
+
+	// The copy, the journal, the erase and the restore of the block
+	uint32_t cutPoints = bed_test_power_cut(part, &w, 50, PowerCutScrubber::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+	EXPECT_GT(cutPoints, 2 * (PAGES_PER_BLOCK - 1));
+
+	bed_nand_simulator_destroy(part);
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-skip-writer.h"
+#include "bed-nand.h"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 16;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static const uint32_t BLOCK_SIZE = 4 * PAGE_SIZE;
+
+static const size_t IMAGE_SIZE = 5 * BLOCK_SIZE + 3 * PAGE_SIZE + 100;
+
+static void createImage(uint8_t *image, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		image [i] = (uint8_t) (i * 13 + i / PAGE_SIZE);
+	}
+}
+
+class ImageReadProcess {
+	public:
+		ImageReadProcess(const uint8_t *image, size_t n)
+			: mImage(image), mSize(n), mIndex(0), mEqual(true)
+		{
+			// Nothing to do
+		}
+
+		static bool process(void *arg, bed_address addr, void *data, size_t n, void *oob, size_t m)
+		{
+			ImageReadProcess *self = static_cast<ImageReadProcess *>(arg);
+			size_t r = self->mSize - self->mIndex;
+
+			(void) addr;
+			(void) oob;
+			(void) m;
+
+			n = n < r ? n : r;
+			self->mEqual = self->mEqual && memcmp(data, self->mImage + self->mIndex, n) == 0;
+			self->mIndex += n;
+
+			return self->mIndex == self->mSize;
+		}
+
+		bool complete() const
+		{
+			return mEqual && mIndex == mSize;
+		}
+
+	private:
+		const uint8_t *mImage;
+		size_t mSize;
+		size_t mIndex;
+		bool mEqual;
+};
+
+/*
+ * Device which fails page writes to a set of blocks.
+ */
+static bed_device failingDevice;
+
+static bed_write_method parentWrite;
+
+static uint32_t failingBlocks;
+
+static bed_status failingWrite(bed_device *bed, bed_address addr, const void *data, size_t n)
+{
+	bed_status status = BED_ERROR_WRITE;
+
+	if ((failingBlocks & (1U << (addr / BLOCK_SIZE))) == 0 || addr % BLOCK_SIZE < PAGE_SIZE * (addr / BLOCK_SIZE % 4)) {
+		status = (*parentWrite)(bed, addr, data, n);
+	}
+
+	return status;
+}
+
+static bed_partition createFailingPartition(const bed_partition *part, uint32_t blocks)
+{
+	bed_partition failing = *part;
+
+	failingDevice = *part->bed;
+	parentWrite = failingDevice.write;
+	failingDevice.write = failingWrite;
+	failingBlocks = blocks;
+	failing.bed = &failingDevice;
+
+	return failing;
+}
+
+static bool isImage(const bed_partition *part, const uint8_t *image, size_t n)
+{
+	ImageReadProcess readProcess(image, n);
+	uint8_t pageBuffer [PAGE_SIZE];
+	uint8_t oobBuffer [16];
+	bed_status status = bed_read_with_skip(
+		part,
+		ImageReadProcess::process,
+		&readProcess,
+		pageBuffer,
+		oobBuffer
+	);
+
+	return (status == BED_SUCCESS || status == BED_ERROR_STOPPED) && readProcess.complete();
+}
+
+TEST(BED, SkipWriter)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_mark_block_bad(part, 2 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	// Data of a following image in the block after the image
+	uint8_t page [PAGE_SIZE];
+	memset(page, 0x5a, sizeof(page));
+	status = bed_write(part, 7 * BLOCK_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	static uint8_t image [IMAGE_SIZE];
+	createImage(image, IMAGE_SIZE);
+
+	uint8_t buffer [2 * PAGE_SIZE];
+	EXPECT_EQ(sizeof(buffer), bed_skip_writer_buffer_size(part));
+
+	bed_skip_writer writer;
+	status = bed_skip_writer_open(&writer, part, PAGE_SIZE, buffer);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	status = bed_skip_writer_open(&writer, part, BLOCK_COUNT * BLOCK_SIZE, buffer);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	status = bed_skip_writer_open(&writer, part, 0, buffer);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	// Chunks which are not page aligned
+	for (size_t i = 0; i < IMAGE_SIZE; i += 77) {
+		status = bed_skip_writer_append(&writer, image + i, IMAGE_SIZE - i < 77 ? IMAGE_SIZE - i : 77);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_skip_writer_layout layout;
+	status = bed_skip_writer_close(&writer, &layout);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(IMAGE_SIZE, layout.size);
+	EXPECT_EQ(0U, layout.begin);
+	EXPECT_EQ(7 * BLOCK_SIZE, layout.end);
+	EXPECT_EQ(6U, layout.block_count);
+	EXPECT_EQ(1U, layout.skipped_blocks);
+	EXPECT_EQ(0U, layout.failed_blocks);
+	EXPECT_EQ(0U, layout.copied_pages);
+	EXPECT_TRUE(isImage(part, image, IMAGE_SIZE));
+
+	// The block after the image is not erased ahead
+	memset(page, 0, sizeof(page));
+	status = bed_read(part, 7 * BLOCK_SIZE, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0x5a, page [0]);
+
+	// An image starting at the end of the previous image
+	status = bed_skip_writer_open(&writer, part, layout.end, buffer);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_skip_writer_append(&writer, image, 3 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_skip_writer_close(&writer, &layout);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(7 * BLOCK_SIZE, layout.begin);
+	EXPECT_EQ(10 * BLOCK_SIZE, layout.end);
+	EXPECT_EQ(3U, layout.block_count);
+
+	// Not enough valid blocks
+	status = bed_skip_writer_open(&writer, part, 13 * BLOCK_SIZE, buffer);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_skip_writer_append(&writer, image, IMAGE_SIZE);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	status = bed_skip_writer_append(&writer, image, 1);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	status = bed_skip_writer_close(&writer, &layout);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(3U, layout.block_count);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, SkipWriterWriteErrors)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	// Writes fail in block 0 at page 0, in block 2 at page 2 and in block 3
+	// at page 3
+	bed_partition failing = createFailingPartition(part, 0xd);
+
+	static uint8_t image [IMAGE_SIZE];
+	createImage(image, IMAGE_SIZE);
+
+	uint8_t buffer [2 * PAGE_SIZE];
+	bed_skip_writer writer;
+	status = bed_skip_writer_open(&writer, &failing, 0, buffer);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_skip_writer_append(&writer, image, IMAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_skip_writer_layout layout;
+	status = bed_skip_writer_close(&writer, &layout);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(IMAGE_SIZE, layout.size);
+	EXPECT_EQ(BLOCK_SIZE, layout.begin);
+	EXPECT_EQ(9 * BLOCK_SIZE, layout.end);
+	EXPECT_EQ(6U, layout.block_count);
+	EXPECT_EQ(0U, layout.skipped_blocks);
+	EXPECT_EQ(3U, layout.failed_blocks);
+	EXPECT_EQ(2U + 3U, layout.copied_pages);
+
+	for (uint32_t block = 0; block < 4; ++block) {
+		status = bed_is_block_valid(part, block * BLOCK_SIZE);
+		EXPECT_EQ(block == 1 ? BED_SUCCESS : BED_ERROR_BLOCK_IS_BAD, status);
+	}
+
+	EXPECT_TRUE(isImage(part, image, IMAGE_SIZE));
+
+	bed_nand_simulator_destroy(part);
+}
@@ -0,0 +1,575 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-volume.h"
+#include "bed-nand.h"
+#include "bed-test.h"
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 16;
+
+static const uint32_t BLOCK_SIZE = 4096;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static const uint32_t LEB_SIZE = BLOCK_SIZE - 2 * PAGE_SIZE;
+
+static void fillLEB(uint8_t *data, size_t n, uint32_t leb, uint32_t generation)
+{
+	for (size_t i = 0; i < n; ++i) {
+		data [i] = (uint8_t) (i + 7 * leb + 31 * generation);
+	}
+}
+
+static bool isLEB(const uint8_t *data, size_t n, uint32_t leb, uint32_t generation)
+{
+	for (size_t i = 0; i < n; ++i) {
+		if (data [i] != (uint8_t) (i + 7 * leb + 31 * generation)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+TEST(BED, Volume)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	const uint32_t tooManyLEBs [] = { 8, 8 };
+	bed_volume_config config = { tooManyLEBs, 2, 4 };
+	bed_volume_manager *vm;
+	status = bed_volume_attach(part, &config, &vm);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	EXPECT_TRUE(vm == NULL);
+
+	const uint32_t lebCounts [] = { 4, 6 };
+	config.leb_counts = lebCounts;
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(LEB_SIZE, bed_volume_leb_size(vm));
+
+	bed_volume_statistics statistics;
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(BLOCK_COUNT, statistics.peb_count);
+	EXPECT_EQ(0U, statistics.bad_pebs);
+	EXPECT_EQ(BLOCK_COUNT, statistics.free_pebs);
+	EXPECT_EQ(0U, statistics.used_pebs);
+	EXPECT_EQ(BLOCK_COUNT - 10 - 1, statistics.reserved_pebs);
+
+	// Unmapped LEBs read as erased
+	uint8_t out [LEB_SIZE];
+	uint8_t in [LEB_SIZE];
+	memset(in, 0, sizeof(in));
+	status = bed_volume_read(vm, 1, 5, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	memset(out, 0xff, sizeof(out));
+	EXPECT_EQ(0, memcmp(out, in, sizeof(in)));
+	EXPECT_FALSE(bed_volume_is_mapped(vm, 1, 5));
+
+	// Invalid addresses
+	status = bed_volume_read(vm, 2, 0, 0, in, 1);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_volume_read(vm, 0, 4, 0, in, 1);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_volume_read(vm, 0, 0, 1, in, LEB_SIZE);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_volume_write(vm, 0, 0, 1, out, 1);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_volume_change(vm, 0, 0, out, LEB_SIZE + 1);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_volume_unmap(vm, 1, 6);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	// Page-wise writes with a padded last page and column-limited reads
+	fillLEB(out, sizeof(out), 0, 0);
+	status = bed_volume_write(vm, 0, 0, 0, out, PAGE_SIZE + 100);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_volume_write(vm, 0, 0, 2 * PAGE_SIZE, out + 2 * PAGE_SIZE, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(bed_volume_is_mapped(vm, 0, 0));
+
+	status = bed_volume_read(vm, 0, 0, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isLEB(in, PAGE_SIZE + 100, 0, 0));
+	EXPECT_EQ(0xff, in [PAGE_SIZE + 100]);
+	EXPECT_EQ(0xff, in [2 * PAGE_SIZE - 1]);
+	EXPECT_EQ(0, memcmp(out + 2 * PAGE_SIZE, in + 2 * PAGE_SIZE, PAGE_SIZE));
+	EXPECT_EQ(0xff, in [3 * PAGE_SIZE]);
+
+	memset(in, 0, sizeof(in));
+	status = bed_volume_read(vm, 0, 0, 300, in, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(out + 300, in, PAGE_SIZE - 300 + 100));
+
+	// Atomic changes of LEBs in both volumes
+	for (uint32_t leb = 0; leb < 6; ++leb) {
+		fillLEB(out, sizeof(out), leb, 1);
+		status = bed_volume_change(vm, 1, leb, out, 1000 + leb);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	fillLEB(out, sizeof(out), 0, 2);
+	status = bed_volume_change(vm, 0, 0, out, sizeof(out));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(7U, statistics.used_pebs);
+	EXPECT_EQ(BLOCK_COUNT - 7, statistics.free_pebs);
+	EXPECT_EQ(2U, statistics.max_erase_count);
+
+	// The mapping survives a re-attach
+	bed_volume_detach(vm);
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_volume_read(vm, 0, 0, 0, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isLEB(in, sizeof(in), 0, 2));
+
+	for (uint32_t leb = 0; leb < 6; ++leb) {
+		status = bed_volume_read(vm, 1, leb, 0, in, sizeof(in));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isLEB(in, 1000 + leb, leb, 1));
+		EXPECT_EQ(0xff, in [1000 + leb]);
+	}
+
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(7U, statistics.used_pebs);
+
+	// Unmap erases the PEB
+	status = bed_volume_unmap(vm, 1, 3);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_FALSE(bed_volume_is_mapped(vm, 1, 3));
+	status = bed_volume_unmap(vm, 1, 3);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_volume_detach(vm);
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_FALSE(bed_volume_is_mapped(vm, 1, 3));
+	EXPECT_TRUE(bed_volume_is_mapped(vm, 1, 4));
+
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(6U, statistics.used_pebs);
+
+	// PEBs of LEBs outside the volumes are kept
+	bed_volume_detach(vm);
+	config.volume_count = 1;
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_FALSE(bed_volume_is_mapped(vm, 1, 4));
+
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(6U, statistics.used_pebs);
+	EXPECT_EQ(BLOCK_COUNT - 4 - 5 - 1, statistics.reserved_pebs);
+
+	bed_volume_detach(vm);
+	config.volume_count = 2;
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(bed_volume_is_mapped(vm, 1, 4));
+
+	bed_volume_detach(vm);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, VolumeBadBlocks)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	const uint32_t lebCounts [] = { 12 };
+	bed_volume_config config = { lebCounts, 1, 4 };
+	bed_volume_manager *vm;
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_volume_statistics statistics;
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(BLOCK_COUNT - 12 - 1, statistics.reserved_pebs);
+	bed_volume_detach(vm);
+
+	// Bad blocks consume the reserve
+	for (uint32_t i = 0; i < 3; ++i) {
+		status = bed_mark_block_bad(part, (2 * i + 1) * BLOCK_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(3U, statistics.bad_pebs);
+	EXPECT_EQ(0U, statistics.reserved_pebs);
+	EXPECT_EQ(BLOCK_COUNT - 3, statistics.free_pebs);
+
+	// The spare block still allows atomic changes of all LEBs
+	uint8_t out [LEB_SIZE];
+	uint8_t in [LEB_SIZE];
+	for (uint32_t generation = 0; generation < 3; ++generation) {
+		for (uint32_t leb = 0; leb < 12; ++leb) {
+			fillLEB(out, sizeof(out), leb, generation);
+			status = bed_volume_change(vm, 0, leb, out, sizeof(out));
+			ASSERT_EQ(BED_SUCCESS, status);
+		}
+	}
+
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(12U, statistics.used_pebs);
+	EXPECT_EQ(1U, statistics.free_pebs);
+	bed_volume_detach(vm);
+
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t leb = 0; leb < 12; ++leb) {
+		status = bed_volume_read(vm, 0, leb, 0, in, sizeof(in));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isLEB(in, sizeof(in), leb, 2));
+	}
+
+	bed_volume_detach(vm);
+
+	// One more bad block and the volume no longer fits
+	status = bed_mark_block_bad(part, 7 * BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_volume_attach(part, &config, &vm);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, VolumeBrokenECHeaders)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	const uint32_t lebCounts [] = { 4 };
+	bed_volume_config config = { lebCounts, 1, 4 };
+	bed_volume_manager *vm;
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint8_t out [LEB_SIZE];
+	uint8_t in [LEB_SIZE];
+	for (uint32_t leb = 0; leb < 4; ++leb) {
+		fillLEB(out, sizeof(out), leb, 0);
+		status = bed_volume_change(vm, 0, leb, out, sizeof(out));
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_volume_detach(vm);
+
+	// Program zeros over the written EC headers
+	uint8_t page [PAGE_SIZE];
+	memset(page, 0, sizeof(page));
+	uint32_t broken = 0;
+	for (uint32_t block = 0; block < BLOCK_COUNT; ++block) {
+		uint8_t header [PAGE_SIZE];
+		status = bed_read(part, block * BLOCK_SIZE, header, sizeof(header));
+		EXPECT_EQ(BED_SUCCESS, status);
+
+		if (header [0] != 0xff) {
+			status = bed_write(part, block * BLOCK_SIZE, page, sizeof(page));
+			EXPECT_EQ(BED_SUCCESS, status);
+			++broken;
+		}
+	}
+
+	EXPECT_GE(broken, 4U);
+
+	// Only the erase counts are lost, not the mapping
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t leb = 0; leb < 4; ++leb) {
+		EXPECT_TRUE(bed_volume_is_mapped(vm, 0, leb));
+		status = bed_volume_read(vm, 0, leb, 0, in, sizeof(in));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isLEB(in, sizeof(in), leb, 0));
+	}
+
+	bed_volume_statistics statistics;
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_EQ(4U, statistics.used_pebs);
+
+	// Changes still work and renew the EC headers with the erase
+	for (uint32_t leb = 0; leb < 4; ++leb) {
+		fillLEB(out, sizeof(out), leb, 1);
+		status = bed_volume_change(vm, 0, leb, out, sizeof(out));
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_volume_detach(vm);
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t leb = 0; leb < 4; ++leb) {
+		status = bed_volume_read(vm, 0, leb, 0, in, sizeof(in));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isLEB(in, sizeof(in), leb, 1));
+	}
+
+	bed_volume_detach(vm);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, VolumeWearLeveling)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	const uint32_t lebCounts [] = { 2, 2 };
+	bed_volume_config config = { lebCounts, 2, 4 };
+	bed_volume_manager *vm;
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	// Volume 0 holds cold data, volume 1 is changed many times
+	uint8_t out [LEB_SIZE];
+	for (uint32_t leb = 0; leb < 2; ++leb) {
+		fillLEB(out, sizeof(out), leb, 0);
+		status = bed_volume_change(vm, 0, leb, out, sizeof(out));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	status = bed_volume_level_wear(vm);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	for (uint32_t i = 0; i < 200; ++i) {
+		fillLEB(out, sizeof(out), i % 2, i);
+		status = bed_volume_change(vm, 1, i % 2, out, PAGE_SIZE);
+		ASSERT_EQ(BED_SUCCESS, status);
+
+		if (i % 8 == 0) {
+			bed_volume_level_wear(vm);
+		}
+	}
+
+	bed_volume_statistics statistics;
+	bed_volume_get_statistics(vm, &statistics);
+	EXPECT_GT(statistics.wear_moves, 0U);
+	EXPECT_LE(statistics.max_erase_count - statistics.min_erase_count, 2 * config.wear_threshold);
+
+	// The erase counts and the moved LEBs survive a re-attach
+	bed_volume_detach(vm);
+	status = bed_volume_attach(part, &config, &vm);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_volume_statistics recovered;
+	bed_volume_get_statistics(vm, &recovered);
+	EXPECT_EQ(statistics.min_erase_count, recovered.min_erase_count);
+	EXPECT_EQ(statistics.max_erase_count, recovered.max_erase_count);
+
+	uint8_t in [LEB_SIZE];
+	for (uint32_t leb = 0; leb < 2; ++leb) {
+		status = bed_volume_read(vm, 0, leb, 0, in, sizeof(in));
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isLEB(in, sizeof(in), leb, 0));
+
+		status = bed_volume_read(vm, 1, leb, 0, in, PAGE_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_TRUE(isLEB(in, PAGE_SIZE, leb, 198 + leb));
+	}
+
+	bed_volume_detach(vm);
+	bed_nand_simulator_destroy(part);
+}
+
+/*
+ * The workload changes each LEB twice in ascending order.  After a power cut
+ * each LEB must contain the complete data of one change and the LEBs must
+ * reflect a prefix of the changes.
+ */
+class PowerCutVolume {
+	public:
+		static const uint16_t PAGE_SIZE = 512;
+
+		static const uint32_t LEB_COUNT = 5;
+
+		PowerCutVolume()
+			: mCutPoints(0), mVM(NULL)
+		{
+			mConfig.leb_counts = &LEB_COUNT;
+			mConfig.volume_count = 1;
+			mConfig.wear_threshold = 4;
+		}
+
+		static bed_status prepare(void *arg, const bed_partition *part)
+		{
+			PowerCutVolume *self = static_cast<PowerCutVolume *>(arg);
+			bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+
+			if (status == BED_SUCCESS) {
+				status = self->changeAll(part, 0);
+			}
+
+			return status;
+		}
+
+		static bed_status run(void *arg, const bed_partition *part)
+		{
+			PowerCutVolume *self = static_cast<PowerCutVolume *>(arg);
+			bed_status status = self->changeAll(part, 1);
+
+			if (status == BED_SUCCESS) {
+				status = self->changeAll(part, 2);
+			}
+
+			return status;
+		}
+
+		static bed_status recover(void *arg, const bed_partition *part)
+		{
+			PowerCutVolume *self = static_cast<PowerCutVolume *>(arg);
+
+			return bed_volume_attach(part, &self->mConfig, &self->mVM);
+		}
+
+		static bed_status check(void *arg, const bed_partition *part, size_t *lost)
+		{
+			PowerCutVolume *self = static_cast<PowerCutVolume *>(arg);
+			bed_status status = BED_ERROR_SYSTEM;
+
+			*lost = 0;
+
+			if (self->mVM != NULL) {
+				uint32_t lebSize = bed_volume_leb_size(self->mVM);
+				uint8_t data [2 * PAGE_SIZE];
+				uint32_t first = 0;
+				uint32_t previous = 0;
+
+				for (uint32_t leb = 0; leb < LEB_COUNT; ++leb) {
+					uint32_t generation;
+
+					status = bed_volume_read(self->mVM, 0, leb, 0, data, lebSize);
+
+					for (generation = 0; generation < 3; ++generation) {
+						size_t n = size(leb, generation);
+
+						if (isLEB(data, n, leb, generation) && (n == lebSize || data [n] == 0xff)) {
+							break;
+						}
+					}
+
+					if (leb == 0) {
+						first = generation;
+						previous = generation;
+					}
+
+					if (
+						status != BED_SUCCESS
+							|| generation == 3
+							|| generation > previous
+							|| generation + 1 < first
+					) {
+						*lost += lebSize;
+					}
+
+					previous = generation;
+				}
+
+				bed_volume_detach(self->mVM);
+				self->mVM = NULL;
+			}
+
+			return status;
+		}
+
+		static void report(void *arg, const bed_test_power_cut_result *result)
+		{
+			PowerCutVolume *self = static_cast<PowerCutVolume *>(arg);
+
+			if (result->operation == 0) {
+				EXPECT_EQ(BED_SUCCESS, result->run_status);
+				self->mCutPoints = result->operation_count;
+			}
+
+			EXPECT_EQ(BED_SUCCESS, result->recover_status);
+			EXPECT_EQ(BED_SUCCESS, result->check_status);
+			EXPECT_EQ(0U, result->lost);
+		}
+
+		uint32_t mCutPoints;
+
+	private:
+		static size_t size(uint32_t leb, uint32_t generation)
+		{
+			return PAGE_SIZE + 100 * generation + leb;
+		}
+
+		bed_status changeAll(const bed_partition *part, uint32_t generation)
+		{
+			bed_volume_manager *vm;
+			bed_status status = bed_volume_attach(part, &mConfig, &vm);
+
+			if (status == BED_SUCCESS) {
+				uint8_t data [2 * PAGE_SIZE];
+
+				for (uint32_t leb = 0; leb < LEB_COUNT && status == BED_SUCCESS; ++leb) {
+					size_t n = size(leb, generation);
+
+					fillLEB(data, n, leb, generation);
+					status = bed_volume_change(vm, 0, leb, data, n);
+				}
+
+				bed_volume_detach(vm);
+			}
+
+			return status;
+		}
+
+		bed_volume_config mConfig;
+
+		bed_volume_manager *mVM;
+};
+
+const uint32_t PowerCutVolume::LEB_COUNT;
+
+TEST(BED, PowerCutVolume)
+{
+	bed_partition *part = bed_nand_simulator_create(1, 8, 4 * PowerCutVolume::PAGE_SIZE, PowerCutVolume::PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	PowerCutVolume workload;
+	const bed_test_power_cut_workload w = {
+		PowerCutVolume::prepare,
+		PowerCutVolume::run,
+		PowerCutVolume::recover,
+		PowerCutVolume::check,
+		&workload
+	};
+
+	uint32_t cutPoints = bed_test_power_cut(part, &w, 50, PowerCutVolume::report, &workload);
+	EXPECT_EQ(workload.mCutPoints, cutPoints);
+	EXPECT_GT(cutPoints, 40U);
+
+	bed_nand_simulator_destroy(part);
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-wear.h"
+#include "bed-ftl.h"
+#include "bed-nand.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 16;
+
+static const uint32_t BLOCK_SIZE = 4096;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static const uint32_t TABLE_BLOCKS = 2;
+
+static const uint32_t DATA_BLOCKS = BLOCK_COUNT - TABLE_BLOCKS;
+
+class Relocation {
+	public:
+		Relocation(const bed_partition *part)
+			: mPart(part), mFrom(0), mTo(0), mCount(0)
+		{
+		}
+
+		static bed_status relocate(void *arg, bed_address from, bed_address to)
+		{
+			Relocation *self = static_cast<Relocation *>(arg);
+			uint8_t data [PAGE_SIZE];
+
+			self->mFrom = from;
+			self->mTo = to;
+			++self->mCount;
+
+			bed_status status = bed_read(self->mPart, from, data, sizeof(data));
+
+			if (status == BED_SUCCESS) {
+				status = bed_write(self->mPart, to, data, sizeof(data));
+			}
+
+			return status;
+		}
+
+		const bed_partition *mPart;
+
+		bed_address mFrom;
+
+		bed_address mTo;
+
+		uint32_t mCount;
+};
+
+TEST(BED, WearLeveling)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_wear_config config = { TABLE_BLOCKS, 0, 4 };
+	bed_wear *wear;
+	status = bed_wear_create(part, &config, &wear);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	const bed_partition *data = bed_wear_data_partition(wear);
+	EXPECT_EQ(TABLE_BLOCKS * BLOCK_SIZE, data->begin);
+	EXPECT_EQ(DATA_BLOCKS * BLOCK_SIZE, data->size);
+
+	// Initially all blocks are in use
+	bed_address block;
+	status = bed_wear_allocate(wear, &block);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(0U, bed_wear_discarded_count(wear));
+
+	// Block 0 keeps cold data, all other blocks are discarded
+	uint8_t page [PAGE_SIZE];
+	memset(page, 0x5a, sizeof(page));
+	status = bed_write(data, 0, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t i = 1; i < DATA_BLOCKS; ++i) {
+		status = bed_wear_discard(wear, i * BLOCK_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	status = bed_wear_discard(wear, BLOCK_SIZE);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_wear_discard(wear, DATA_BLOCKS * BLOCK_SIZE);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	status = bed_wear_discard(wear, PAGE_SIZE);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	// A rewrite in place of a single block spreads the erases across all
+	// discarded blocks
+	for (uint32_t i = 0; i < 10 * (DATA_BLOCKS - 1); ++i) {
+		status = bed_wear_allocate(wear, &block);
+		ASSERT_EQ(BED_SUCCESS, status);
+		status = bed_wear_discard(wear, block);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	uint32_t eraseCount;
+	for (uint32_t i = 1; i < DATA_BLOCKS; ++i) {
+		status = bed_wear_erase_count(wear, i * BLOCK_SIZE, &eraseCount);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(10U, eraseCount);
+	}
+
+	status = bed_wear_erase_count(wear, 0, &eraseCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, eraseCount);
+
+	// Only the upper layer can follow the moved content
+	status = bed_wear_level(wear, NULL, NULL);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+
+	// The static wear leveling moves the cold data to the most worn block
+	Relocation relocation(data);
+	status = bed_wear_level(wear, Relocation::relocate, &relocation);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(1U, relocation.mCount);
+	EXPECT_EQ(0U, relocation.mFrom);
+	EXPECT_NE(0U, relocation.mTo);
+
+	uint8_t in [PAGE_SIZE];
+	status = bed_read(data, relocation.mTo, in, sizeof(in));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(page, in, sizeof(in)));
+
+	status = bed_wear_erase_count(wear, relocation.mTo, &eraseCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(11U, eraseCount);
+
+	// The least worn block is allocated next
+	status = bed_wear_allocate(wear, &block);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, block);
+	status = bed_wear_discard(wear, block);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	status = bed_wear_level(wear, Relocation::relocate, &relocation);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+	EXPECT_EQ(1U, relocation.mCount);
+
+	bed_wear_statistics statistics;
+	bed_wear_get_statistics(wear, &statistics);
+	EXPECT_EQ(1U, statistics.min_erase_count);
+	EXPECT_EQ(11U, statistics.max_erase_count);
+	EXPECT_EQ(10U * (DATA_BLOCKS - 1) + 2U, statistics.total_erase_count);
+	EXPECT_EQ(1U, statistics.static_moves);
+	EXPECT_EQ(0U, statistics.table_writes);
+
+	// The erase counts survive a re-creation after a sync
+	status = bed_wear_sync(wear);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_wear_sync(wear);
+	EXPECT_EQ(BED_SUCCESS, status);
+	bed_wear_destroy(wear);
+
+	status = bed_wear_create(part, &config, &wear);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_wear_statistics recovered;
+	bed_wear_get_statistics(wear, &recovered);
+	EXPECT_EQ(statistics.min_erase_count, recovered.min_erase_count);
+	EXPECT_EQ(statistics.max_erase_count, recovered.max_erase_count);
+	EXPECT_EQ(statistics.total_erase_count, recovered.total_erase_count);
+
+	// Syncs alternate between the table blocks once a table block is full
+	for (uint32_t i = 0; i < 2 * BLOCK_SIZE / PAGE_SIZE; ++i) {
+		status = bed_wear_sync(wear);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_wear_destroy(wear);
+
+	status = bed_wear_create(part, &config, &wear);
+	ASSERT_EQ(BED_SUCCESS, status);
+	bed_wear_get_statistics(wear, &recovered);
+	EXPECT_EQ(statistics.total_erase_count, recovered.total_erase_count);
+	bed_wear_destroy(wear);
+
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, WearLevelingSyncInterval)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_wear *wear;
+	bed_wear_config config = { 1, 0, 0 };
+	status = bed_wear_create(part, &config, &wear);
+	EXPECT_EQ(BED_ERROR_INVALID_ADDRESS, status);
+	EXPECT_TRUE(wear == NULL);
+
+	config.table_blocks = TABLE_BLOCKS;
+	config.sync_interval = 4;
+	status = bed_wear_create(part, &config, &wear);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	status = bed_wear_discard(wear, 0);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_address block;
+	for (int i = 0; i < 10; ++i) {
+		status = bed_wear_allocate(wear, &block);
+		ASSERT_EQ(BED_SUCCESS, status);
+		status = bed_wear_discard(wear, block);
+		ASSERT_EQ(BED_SUCCESS, status);
+	}
+
+	bed_wear_statistics statistics;
+	bed_wear_get_statistics(wear, &statistics);
+	EXPECT_EQ(2U, statistics.table_writes);
+
+	// The erases since the last table write are lost
+	bed_wear_destroy(wear);
+	status = bed_wear_create(part, &config, &wear);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	uint32_t eraseCount;
+	status = bed_wear_erase_count(wear, 0, &eraseCount);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(8U, eraseCount);
+
+	bed_wear_destroy(wear);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, WearLevelingFTL)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_erase_all(part, BED_ERASE_FORCE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_wear_config wearConfig = { TABLE_BLOCKS, 16, 8 };
+	bed_wear *wear;
+	status = bed_wear_create(part, &wearConfig, &wear);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	bed_ftl_config ftlConfig = { PAGE_SIZE, 4, BED_FTL_GC_GREEDY, wear };
+	bed_ftl *ftl;
+	status = bed_ftl_create(bed_wear_data_partition(wear), &ftlConfig, &ftl);
+	ASSERT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(DATA_BLOCKS, bed_wear_discarded_count(wear));
+
+	// Half of the sectors are cold, the other half is rewritten many times
+	uint32_t sectorCount = bed_ftl_sector_count(ftl);
+	std::vector<uint8_t> generations(sectorCount, 0);
+	uint8_t sector [PAGE_SIZE];
+
+	for (uint32_t i = 0; i < 40 * sectorCount; ++i) {
+		uint32_t s = i < sectorCount ? i : sectorCount / 2 + i % (sectorCount / 2);
+
+		++generations [s];
+		memset(sector, generations [s], sizeof(sector));
+		status = bed_ftl_write(ftl, s, sector, 1);
+		ASSERT_EQ(BED_SUCCESS, status);
+
+		if (i % 64 == 0) {
+			bed_ftl_level_wear(ftl);
+		}
+	}
+
+	bed_wear_statistics statistics;
+	bed_wear_get_statistics(wear, &statistics);
+	EXPECT_GT(statistics.static_moves, 0U);
+	EXPECT_LE(statistics.max_erase_count - statistics.min_erase_count, 2 * wearConfig.static_threshold);
+
+	bed_ftl_destroy(ftl);
+	status = bed_ftl_create(bed_wear_data_partition(wear), &ftlConfig, &ftl);
+	ASSERT_EQ(BED_SUCCESS, status);
+
+	for (uint32_t s = 0; s < sectorCount; ++s) {
+		status = bed_ftl_read(ftl, s, sector, 1);
+		EXPECT_EQ(BED_SUCCESS, status);
+		EXPECT_EQ(generations [s], sector [0]);
+		EXPECT_EQ(generations [s], sector [PAGE_SIZE - 1]);
+	}
+
+	bed_ftl_destroy(ftl);
+	bed_wear_destroy(wear);
+	bed_nand_simulator_destroy(part);
+}
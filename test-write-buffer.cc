@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2014 embedded brains GmbH.  All rights reserved.
+ *
+ *  embedded brains GmbH
+ *  Dornierstr. 4
+ *  82178 Puchheim
+ *  Germany
+ *  <rtems@embedded-brains.de>
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rtems.com/license/LICENSE.
+ */
+
+#include "bed-write-buffer.h"
+#include "bed-nand.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+static const uint32_t BLOCK_COUNT = 4;
+
+static const uint32_t BLOCK_SIZE = 2048;
+
+static const uint16_t PAGE_SIZE = 512;
+
+static const size_t RECORD_SIZE = 100;
+
+static void createRecord(uint8_t *record, size_t i)
+{
+	for (size_t j = 0; j < RECORD_SIZE; ++j) {
+		record [j] = (uint8_t) (i + j);
+	}
+}
+
+static bool isRecord(const uint8_t *data, size_t i)
+{
+	uint8_t record [RECORD_SIZE];
+
+	createRecord(record, i);
+
+	return memcmp(data, record, RECORD_SIZE) == 0;
+}
+
+static bool isBlank(const uint8_t *data, size_t n)
+{
+	bool blank = true;
+
+	for (size_t i = 0; i < n; ++i) {
+		blank = blank && data [i] == 0xff;
+	}
+
+	return blank;
+}
+
+static void appendRecord(bed_write_buffer *wb, size_t i)
+{
+	uint8_t record [RECORD_SIZE];
+
+	createRecord(record, i);
+	bed_status status = bed_write_buffer_append(wb, record, sizeof(record));
+	EXPECT_EQ(BED_SUCCESS, status);
+}
+
+TEST(BED, WriteBuffer)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_status status = bed_mark_block_bad(part, BLOCK_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	bed_write_buffer_config config = { 0, 0, 0 };
+	bed_write_buffer *wb = bed_write_buffer_create(part, &config);
+	ASSERT_TRUE(wb != NULL);
+
+	for (size_t i = 0; i < 12; ++i) {
+		appendRecord(wb, i);
+	}
+
+	EXPECT_EQ(12 * RECORD_SIZE, bed_write_buffer_position(wb));
+
+	uint8_t data [3 * PAGE_SIZE];
+	status = bed_read(part, 0, data, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read(part, PAGE_SIZE, data + PAGE_SIZE, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_read(part, 2 * PAGE_SIZE, data + 2 * PAGE_SIZE, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isBlank(data + 2 * PAGE_SIZE, PAGE_SIZE));
+
+	for (size_t i = 0; i < 10; ++i) {
+		EXPECT_TRUE(isRecord(data + i * RECORD_SIZE, i));
+	}
+
+	status = bed_write_buffer_sync(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(3 * PAGE_SIZE, bed_write_buffer_position(wb));
+	status = bed_write_buffer_sync(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(3 * PAGE_SIZE, bed_write_buffer_position(wb));
+
+	status = bed_read(part, 2 * PAGE_SIZE, data + 2 * PAGE_SIZE, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+
+	for (size_t i = 0; i < 12; ++i) {
+		EXPECT_TRUE(isRecord(data + i * RECORD_SIZE, i));
+	}
+
+	EXPECT_TRUE(isBlank(data + 12 * RECORD_SIZE, sizeof(data) - 12 * RECORD_SIZE));
+
+	// The bad block is skipped
+	uint8_t page [PAGE_SIZE];
+	memset(page, 0x5a, sizeof(page));
+	status = bed_write_buffer_append(wb, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_write_buffer_append(wb, page, sizeof(page));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(2 * BLOCK_SIZE + PAGE_SIZE, bed_write_buffer_position(wb));
+	status = bed_read(part, 2 * BLOCK_SIZE, data, PAGE_SIZE);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0, memcmp(page, data, PAGE_SIZE));
+
+	for (int i = 0; i < 7; ++i) {
+		status = bed_write_buffer_append(wb, page, sizeof(page));
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	status = bed_write_buffer_append(wb, page, 1);
+	EXPECT_EQ(BED_SUCCESS, status);
+	status = bed_write_buffer_sync(wb);
+	EXPECT_EQ(BED_ERROR_UNSATISFIED, status);
+
+	bed_write_buffer_destroy(wb);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, WriteBufferPartialPageProgramming)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_write_buffer_config config = { 2, 1000, 0 };
+	bed_write_buffer *wb = bed_write_buffer_create(part, &config);
+	EXPECT_TRUE(wb == NULL);
+
+	config.program_unit = 256;
+	wb = bed_write_buffer_create(part, &config);
+	ASSERT_TRUE(wb != NULL);
+
+	appendRecord(wb, 0);
+	bed_status status = bed_write_buffer_sync(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(256U, bed_write_buffer_position(wb));
+
+	appendRecord(wb, 1);
+	status = bed_write_buffer_sync(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(PAGE_SIZE, bed_write_buffer_position(wb));
+
+	uint8_t data [PAGE_SIZE];
+	status = bed_read(part, 0, data, sizeof(data));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isRecord(data, 0));
+	EXPECT_TRUE(isBlank(data + RECORD_SIZE, 256 - RECORD_SIZE));
+	EXPECT_TRUE(isRecord(data + 256, 1));
+	EXPECT_TRUE(isBlank(data + 256 + RECORD_SIZE, PAGE_SIZE - 256 - RECORD_SIZE));
+
+	bed_write_buffer_destroy(wb);
+	bed_nand_simulator_destroy(part);
+}
+
+TEST(BED, WriteBufferTimeout)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	bed_write_buffer_config config = { 4, 256, 1 };
+	bed_write_buffer *wb = bed_write_buffer_create(part, &config);
+	ASSERT_TRUE(wb != NULL);
+
+	bed_status status = bed_write_buffer_poll(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(0U, bed_write_buffer_position(wb));
+
+	appendRecord(wb, 0);
+	EXPECT_EQ(RECORD_SIZE, bed_write_buffer_position(wb));
+	usleep(2000);
+	status = bed_write_buffer_poll(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(256U, bed_write_buffer_position(wb));
+
+	uint8_t data [PAGE_SIZE];
+	status = bed_read(part, 0, data, sizeof(data));
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_TRUE(isRecord(data, 0));
+
+	bed_write_buffer_destroy(wb);
+	bed_nand_simulator_destroy(part);
+}
+
+static bed_device failingWriteDevice;
+
+static bed_write_method failingWriteParent;
+
+static bed_address failingWriteAddress;
+
+static bed_status failingWrite(bed_device *bed, bed_address addr, const void *data, size_t n)
+{
+	bed_status status;
+
+	if (addr == failingWriteAddress) {
+		status = BED_ERROR_WRITE;
+	} else {
+		status = (*failingWriteParent)(bed, addr, data, n);
+	}
+
+	return status;
+}
+
+TEST(BED, WriteBufferWriteError)
+{
+	bed_partition *part = bed_nand_simulator_create(1, BLOCK_COUNT, BLOCK_SIZE, PAGE_SIZE);
+	ASSERT_TRUE(part != NULL);
+
+	failingWriteDevice = *part->bed;
+	failingWriteParent = failingWriteDevice.write;
+	failingWriteDevice.write = failingWrite;
+	failingWriteAddress = UINT32_MAX;
+
+	bed_partition failing = *part;
+	failing.bed = &failingWriteDevice;
+
+	bed_write_buffer_config config = { 2, 256, 0 };
+	bed_write_buffer *wb = bed_write_buffer_create(&failing, &config);
+	ASSERT_TRUE(wb != NULL);
+
+	for (size_t i = 0; i < 12; ++i) {
+		appendRecord(wb, i);
+	}
+
+	// The first program unit of the third page holds a record
+	bed_status status = bed_write_buffer_sync(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(1280U, bed_write_buffer_position(wb));
+
+	// The program of the rest of the page fails in the middle of the block
+	failingWriteAddress = 2 * PAGE_SIZE;
+
+	for (size_t i = 12; i < 15; ++i) {
+		appendRecord(wb, i);
+	}
+
+	status = bed_write_buffer_sync(wb);
+	EXPECT_EQ(BED_SUCCESS, status);
+	EXPECT_EQ(BLOCK_SIZE + 1792U, bed_write_buffer_position(wb));
+	EXPECT_EQ(BED_ERROR_BLOCK_IS_BAD, bed_is_block_valid(part, 0));
+
+	uint8_t data [BLOCK_SIZE];
+	for (uint32_t i = 0; i < BLOCK_SIZE / PAGE_SIZE; ++i) {
+		status = bed_read(part, BLOCK_SIZE + i * PAGE_SIZE, data + i * PAGE_SIZE, PAGE_SIZE);
+		EXPECT_EQ(BED_SUCCESS, status);
+	}
+
+	for (size_t i = 0; i < 12; ++i) {
+		EXPECT_TRUE(isRecord(data + i * RECORD_SIZE, i));
+	}
+
+	for (size_t i = 12; i < 15; ++i) {
+		EXPECT_TRUE(isRecord(data + 1280 + (i - 12) * RECORD_SIZE, i));
+	}
+
+	EXPECT_TRUE(isBlank(data + 1200, 80));
+	EXPECT_TRUE(isBlank(data + 1580, 1792 - 1580));
+
+	bed_write_buffer_destroy(wb);
+	bed_nand_simulator_destroy(part);
+}